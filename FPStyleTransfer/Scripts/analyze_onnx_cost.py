@@ -0,0 +1,498 @@
+import argparse
+import csv
+import json
+import tempfile
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper
+
+from clean_onnx_initializers import strip_initializer_inputs
+from optimize_onnx_model import DEFAULT_BATCH, make_feed, parse_resolution, step_pin_shapes
+
+
+# Ops counted as one FLOP per output element.
+ELEMENTWISE_OPS = {
+    "Abs", "Add", "Ceil", "Clip", "Div", "Elu", "Equal", "Erf", "Exp", "Floor", "Greater", "HardSigmoid", "HardSwish",
+    "LeakyRelu", "Less", "Log", "Max", "Mean", "Min", "Mish", "Mul", "Neg", "Not", "Pow", "PRelu", "Reciprocal", "Relu",
+    "Round", "Selu", "Sigmoid", "Sign", "Softplus", "Softsign", "Sqrt", "Sub", "Sum", "Tanh", "Where",
+}
+# Mean, variance, normalize and affine per element.
+NORMALIZATION_FLOPS = {"BatchNormalization": 2, "InstanceNormalization": 5, "LayerNormalization": 5, "GroupNormalization": 5}
+RESIZE_FLOPS = {"nearest": 0, "linear": 8, "cubic": 32}
+REDUCE_OPS = {"ReduceMean", "ReduceSum", "ReduceMax", "ReduceMin", "ReduceL2", "ReduceSumSquare", "GlobalAveragePool", "GlobalMaxPool"}
+
+ELEMENT_BYTES = {
+    TensorProto.FLOAT: 4, TensorProto.FLOAT16: 2, TensorProto.BFLOAT16: 2, TensorProto.DOUBLE: 8,
+    TensorProto.INT8: 1, TensorProto.UINT8: 1, TensorProto.INT16: 2, TensorProto.UINT16: 2,
+    TensorProto.INT32: 4, TensorProto.UINT32: 4, TensorProto.INT64: 8, TensorProto.UINT64: 8, TensorProto.BOOL: 1,
+}
+
+
+@dataclass
+class TensorInfo:
+    shape: Tuple[int, ...]
+    bytes: int
+
+    @property
+    def elements(self) -> int:
+        return int(np.prod(self.shape)) if self.shape else 1
+
+
+@dataclass
+class LayerCost:
+    name: str
+    op_type: str
+    output_shape: Tuple[int, ...]
+    flops: int
+    param_bytes: int
+    activation_bytes: int
+    bytes_moved: int
+    cpu_ms: Optional[float] = None
+
+
+@dataclass
+class ModelCost:
+    resolution: Tuple[int, int]
+    layers: List[LayerCost] = field(default_factory=list)
+    peak_activation_bytes: int = 0
+    cpu_ms: Optional[float] = None
+
+    @property
+    def flops(self) -> int:
+        return sum(layer.flops for layer in self.layers)
+
+    @property
+    def param_bytes(self) -> int:
+        return sum(layer.param_bytes for layer in self.layers)
+
+    @property
+    def bytes_moved(self) -> int:
+        return sum(layer.bytes_moved for layer in self.layers)
+
+    @property
+    def peak_working_set_bytes(self) -> int:
+        return self.param_bytes + self.peak_activation_bytes
+
+
+def megabytes(value: int) -> float:
+    return value / (1024.0 * 1024.0)
+
+
+def name_nodes(model: onnx.ModelProto) -> None:
+    """Gives unnamed nodes stable names so profiler events map back to the graph."""
+    used = {node.name for node in model.graph.node if node.name}
+    for index, node in enumerate(model.graph.node):
+        if not node.name:
+            candidate = f"{node.op_type}_{index}"
+            while candidate in used:
+                candidate += "_"
+            node.name = candidate
+            used.add(candidate)
+
+
+def image_input(model: onnx.ModelProto) -> Optional[onnx.ValueInfoProto]:
+    initializer_names = {initializer.name for initializer in model.graph.initializer}
+    for graph_input in model.graph.input:
+        if graph_input.name not in initializer_names and len(graph_input.type.tensor_type.shape.dim) == 4:
+            return graph_input
+    return None
+
+
+def at_resolution(model: onnx.ModelProto, resolution: Tuple[int, int]) -> onnx.ModelProto:
+    """Copies model with the image input set to resolution. Fixed spatial dims are overridden too, which fully
+    convolutional models accept; models that reshape by constant sizes then fail to load at other resolutions."""
+    resized = onnx.ModelProto()
+    resized.CopyFrom(model)
+    graph_input = image_input(resized)
+    if graph_input is not None:
+        for dim in graph_input.type.tensor_type.shape.dim[2:]:
+            dim.Clear()
+            dim.dim_param = "spatial"
+    step_pin_shapes(resized, argparse.Namespace(resolution=resolution, batch=DEFAULT_BATCH))
+    return resized
+
+
+def session_options(args: argparse.Namespace):
+    import onnxruntime as ort
+
+    options = ort.SessionOptions()
+    # Unoptimized graphs keep one kernel per node, so timings map onto the layers of the exported model.
+    options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_DISABLE_ALL
+    if args.threads:
+        options.intra_op_num_threads = args.threads
+    return options
+
+
+def probe_tensors(model: onnx.ModelProto, feed: Dict[str, np.ndarray], args: argparse.Namespace) -> Dict[str, TensorInfo]:
+    """Runs the model once with every intermediate tensor exposed and records the actual shapes and sizes."""
+    import onnxruntime as ort
+
+    probe = onnx.ModelProto()
+    probe.CopyFrom(model)
+    exposed = {output.name for output in probe.graph.output}
+    for node in probe.graph.node:
+        for name in node.output:
+            if name and name not in exposed:
+                probe.graph.output.append(onnx.ValueInfoProto(name=name))
+                exposed.add(name)
+
+    session = ort.InferenceSession(probe.SerializeToString(), session_options(args), providers=["CPUExecutionProvider"])
+    values = session.run(None, feed)
+
+    tensors = {name: TensorInfo(tuple(array.shape), int(array.nbytes)) for name, array in feed.items()}
+    for output, array in zip(session.get_outputs(), values):
+        array = np.asarray(array)
+        tensors[output.name] = TensorInfo(tuple(array.shape), int(array.nbytes))
+    for initializer in model.graph.initializer:
+        shape = tuple(initializer.dims)
+        tensors[initializer.name] = TensorInfo(shape, int(np.prod(shape)) * ELEMENT_BYTES.get(initializer.data_type, 4))
+    return tensors
+
+
+def dequantized_weights(model: onnx.ModelProto) -> Dict[str, str]:
+    """Maps the outputs of DequantizeLinear nodes that read an initializer (the weights of QDQ models) to that initializer."""
+    initializer_names = {initializer.name for initializer in model.graph.initializer}
+    return {node.output[0]: node.input[0] for node in model.graph.node
+            if node.op_type == "DequantizeLinear" and node.input and node.output and node.input[0] in initializer_names}
+
+
+def attribute(node: onnx.NodeProto, name: str, default):
+    for attr in node.attribute:
+        if attr.name == name:
+            return helper.get_attribute_value(attr)
+    return default
+
+
+def node_flops(node: onnx.NodeProto, tensors: Dict[str, TensorInfo], weights: Dict[str, str]) -> int:
+    """Multiply-adds count as two FLOPs. Data movement ops (reshape, pad, concat, ...) count as none. Weights of QDQ
+    models are resolved through their DequantizeLinear, whose own cost runtimes fold away at load."""
+    inputs = [tensors.get(name) or tensors.get(weights.get(name, "")) for name in node.input]
+    output = tensors.get(node.output[0]) if node.output else None
+    if output is None or node.output[0] in weights:
+        return 0
+
+    op = node.op_type
+    if op == "Conv" and inputs[1] is not None:
+        weight = inputs[1].shape
+        per_output = int(np.prod(weight[1:]))
+        bias = output.elements if len(inputs) > 2 and inputs[2] is not None else 0
+        return 2 * output.elements * per_output + bias
+    if op == "QLinearConv" and inputs[3] is not None:
+        return 2 * output.elements * int(np.prod(inputs[3].shape[1:]))
+    if op in ("QuantizeLinear", "DequantizeLinear"):
+        return 2 * output.elements
+    if op == "ConvTranspose" and inputs[0] is not None and inputs[1] is not None:
+        # Weights are (Cin, Cout / group, kH, kW): every input element scatters into Cout / group * kH * kW outputs.
+        weight = inputs[1].shape
+        return 2 * inputs[0].elements * int(np.prod(weight[1:]))
+    if op in ("MatMul", "Gemm") and inputs[0] is not None:
+        reduction = inputs[0].shape[-2] if op == "Gemm" and attribute(node, "transA", 0) else inputs[0].shape[-1]
+        return 2 * output.elements * reduction
+    if op in NORMALIZATION_FLOPS:
+        return NORMALIZATION_FLOPS[op] * output.elements
+    if op in ("MaxPool", "AveragePool", "LpPool"):
+        return output.elements * int(np.prod(attribute(node, "kernel_shape", [1])))
+    if op in REDUCE_OPS and inputs[0] is not None:
+        return inputs[0].elements
+    if op in ("Resize", "Upsample"):
+        mode = attribute(node, "mode", b"nearest")
+        return RESIZE_FLOPS.get(mode.decode() if isinstance(mode, bytes) else mode, 8) * output.elements
+    if op in ("Softmax", "LogSoftmax"):
+        return 3 * output.elements
+    if op in ELEMENTWISE_OPS:
+        return output.elements
+    return 0
+
+
+def analyze(model: onnx.ModelProto, resolution: Tuple[int, int], args: argparse.Namespace, profile: bool, time_model: bool) -> ModelCost:
+    resized = at_resolution(model, resolution)
+    feed = make_feed(resized)
+    tensors = probe_tensors(resized, feed, args)
+
+    initializer_names = {initializer.name for initializer in resized.graph.initializer}
+    graph_outputs = {output.name for output in resized.graph.output}
+    # QDQ weights count as their quantized initializer on the layer that consumes them, not as a float activation.
+    weights = dequantized_weights(resized)
+
+    # Weights are attributed to their first consumer.
+    counted_params = set()
+    last_use: Dict[str, int] = {}
+    for index, node in enumerate(resized.graph.node):
+        for name in node.input:
+            last_use[name] = index
+
+    cost = ModelCost(resolution)
+    live = {name: tensors[name].bytes for name in feed}
+    live_bytes = sum(live.values())
+    cost.peak_activation_bytes = live_bytes
+
+    for index, node in enumerate(resized.graph.node):
+        dequantizes_weight = bool(node.output) and node.output[0] in weights
+        # A weight's DequantizeLinear keeps only its scale and zero point; the weight goes to the consumer.
+        sources = list(node.input[1:]) if dequantizes_weight else [weights.get(name, name) for name in node.input]
+        param_bytes = 0
+        for name in sources:
+            if name in initializer_names and name not in counted_params:
+                counted_params.add(name)
+                param_bytes += tensors[name].bytes
+
+        outputs = [] if dequantizes_weight else [tensors[name] for name in node.output if name in tensors]
+        activation_bytes = sum(info.bytes for info in outputs)
+        read_bytes = sum(tensors[name].bytes for name in sources if name in tensors)
+        cost.layers.append(LayerCost(
+            name=node.name,
+            op_type=node.op_type,
+            output_shape=tensors[node.output[0]].shape if node.output and node.output[0] in tensors else (),
+            flops=node_flops(node, tensors, weights),
+            param_bytes=param_bytes,
+            activation_bytes=activation_bytes,
+            bytes_moved=read_bytes + activation_bytes,
+        ))
+
+        # A node's inputs and outputs are resident together; inputs are freed after their last consumer.
+        for name in node.output:
+            if name in tensors and name not in live and name not in weights:
+                live[name] = tensors[name].bytes
+                live_bytes += live[name]
+        cost.peak_activation_bytes = max(cost.peak_activation_bytes, live_bytes)
+        for name in set(node.input):
+            if name in live and last_use.get(name) == index and name not in graph_outputs:
+                live_bytes -= live.pop(name)
+
+    if profile:
+        profile_layers(resized, feed, cost, args)
+    if time_model:
+        cost.cpu_ms = time_session(resized, feed, args)
+    return cost
+
+
+def time_session(model: onnx.ModelProto, feed: Dict[str, np.ndarray], args: argparse.Namespace) -> float:
+    import time
+    import onnxruntime as ort
+
+    session = ort.InferenceSession(model.SerializeToString(), session_options(args), providers=["CPUExecutionProvider"])
+    session.run(None, feed)
+    timings = []
+    for _ in range(args.runs):
+        start = time.perf_counter()
+        session.run(None, feed)
+        timings.append((time.perf_counter() - start) * 1000.0)
+    return float(np.median(timings))
+
+
+def profile_layers(model: onnx.ModelProto, feed: Dict[str, np.ndarray], cost: ModelCost, args: argparse.Namespace) -> None:
+    """Times each node with the ONNX Runtime profiler and stores the median over args.runs runs."""
+    import onnxruntime as ort
+
+    with tempfile.TemporaryDirectory() as directory:
+        options = session_options(args)
+        options.enable_profiling = True
+        options.profile_file_prefix = str(Path(directory) / "profile")
+        session = ort.InferenceSession(model.SerializeToString(), options, providers=["CPUExecutionProvider"])
+        session.run(None, feed)
+        for _ in range(args.runs):
+            session.run(None, feed)
+        with open(session.end_profiling()) as profile_file:
+            events = json.load(profile_file)
+
+    suffix = "_kernel_time"
+    durations: Dict[str, List[float]] = {}
+    for event in events:
+        name = event.get("name", "")
+        if event.get("cat") == "Node" and name.endswith(suffix):
+            durations.setdefault(name[:-len(suffix)], []).append(event["dur"] / 1000.0)
+
+    for layer in cost.layers:
+        samples = durations.get(layer.name)
+        if samples:
+            # The first sample is the warm-up run.
+            layer.cpu_ms = float(np.median(samples[1:] or samples))
+
+
+def roofline_ms(cost: ModelCost, args: argparse.Namespace) -> Optional[float]:
+    """Predicted time on the target device: each layer is bound by either its FLOPs or the bytes it moves."""
+    if not args.target_tflops and not args.target_gbps:
+        return None
+    total = 0.0
+    for layer in cost.layers:
+        compute = layer.flops / (args.target_tflops * 1e9) if args.target_tflops else 0.0
+        memory = layer.bytes_moved / (args.target_gbps * 1e6) if args.target_gbps else 0.0
+        total += max(compute, memory)
+    return total
+
+
+def default_curve(resolution: Tuple[int, int], align: int) -> List[Tuple[int, int]]:
+    curve = []
+    for scale in (0.25, 0.5, 0.75, 1.0, 1.5, 2.0):
+        width = max(align, int(round(resolution[0] * scale / align)) * align)
+        height = max(align, int(round(resolution[1] * scale / align)) * align)
+        if (width, height) not in curve:
+            curve.append((width, height))
+    return curve
+
+
+def format_shape(shape: Tuple[int, ...]) -> str:
+    return "x".join(str(dim) for dim in shape)
+
+
+def report_layers(source: Path, cost: ModelCost, args: argparse.Namespace) -> None:
+    layers = cost.layers
+    if args.top:
+        layers = sorted(layers, key=lambda layer: (layer.cpu_ms or 0.0, layer.flops), reverse=True)[:args.top]
+
+    width, height = cost.resolution
+    print(f"[INFO] {source.name} at {width}x{height}: {len(cost.layers)} layers")
+    print(f"{'Layer':<32} {'Op':<22} {'Output':<18} {'MFLOPs':>10} {'Params KiB':>11} {'Act KiB':>10} {'CPU ms':>8}")
+    total_ms = sum(layer.cpu_ms or 0.0 for layer in cost.layers)
+    for layer in layers:
+        cpu = f"{layer.cpu_ms:.3f}" if layer.cpu_ms is not None else "-"
+        print(f"{layer.name[:32]:<32} {layer.op_type[:22]:<22} {format_shape(layer.output_shape)[:18]:<18} "
+              f"{layer.flops / 1e6:>10.2f} {layer.param_bytes / 1024:>11.1f} {layer.activation_bytes / 1024:>10.1f} {cpu:>8}")
+
+    timed = any(layer.cpu_ms is not None for layer in cost.layers)
+    print(f"[TOTAL] {cost.flops / 1e9:.3f} GFLOPs, params {megabytes(cost.param_bytes):.2f} MB, "
+          f"peak activations {megabytes(cost.peak_activation_bytes):.2f} MB, "
+          f"peak working set {megabytes(cost.peak_working_set_bytes):.2f} MB"
+          + (f", layer CPU time {total_ms:.2f} ms" if timed else ""))
+
+    by_op: Dict[str, List[float]] = {}
+    for layer in cost.layers:
+        entry = by_op.setdefault(layer.op_type, [0.0, 0.0])
+        entry[0] += layer.flops
+        entry[1] += layer.cpu_ms or 0.0
+    shares = sorted(by_op.items(), key=lambda item: item[1][1] if timed else item[1][0], reverse=True)
+    print("[OPS] " + ", ".join(f"{op} {flops / max(cost.flops, 1) * 100:.0f}% FLOPs"
+                               + (f" / {ms / max(total_ms, 1e-9) * 100:.0f}% time" if timed else "")
+                               for op, (flops, ms) in shares))
+
+
+def report_curve(source: Path, curve: List[ModelCost], args: argparse.Namespace) -> None:
+    print(f"[CURVE] {source.name}")
+    header = f"{'Resolution':<12} {'GFLOPs':>9} {'Params MB':>10} {'Peak act MB':>12} {'Working set MB':>15} {'CPU ms':>9}"
+    if args.target_tflops or args.target_gbps:
+        header += f" {'Target ms':>10}"
+    print(header)
+
+    within_budget = None
+    for cost in curve:
+        predicted = roofline_ms(cost, args)
+        resolution = f"{cost.resolution[0]}x{cost.resolution[1]}"
+        line = (f"{resolution:<12} {cost.flops / 1e9:>9.3f} {megabytes(cost.param_bytes):>10.2f} "
+                f"{megabytes(cost.peak_activation_bytes):>12.2f} {megabytes(cost.peak_working_set_bytes):>15.2f} "
+                f"{cost.cpu_ms if cost.cpu_ms is not None else float('nan'):>9.2f}")
+        if predicted is not None:
+            line += f" {predicted:>10.3f}"
+        print(line)
+
+        budgeted = predicted if predicted is not None else cost.cpu_ms
+        if args.budget_ms and budgeted is not None and budgeted <= args.budget_ms:
+            if within_budget is None or cost.resolution[0] * cost.resolution[1] > within_budget[0] * within_budget[1]:
+                within_budget = cost.resolution
+
+    if args.budget_ms:
+        basis = "target" if args.target_tflops or args.target_gbps else "CPU"
+        if within_budget:
+            print(f"[OK] Largest resolution within {args.budget_ms:.2f} ms ({basis}): {within_budget[0]}x{within_budget[1]}")
+        else:
+            print(f"[WARN] No resolution fits {args.budget_ms:.2f} ms ({basis})")
+
+
+def write_csv(directory: Path, source: Path, detail: ModelCost, curve: List[ModelCost], args: argparse.Namespace) -> None:
+    if directory.suffix.lower() == ".csv" or directory.is_file():
+        raise ValueError(f"--csv-dir '{directory}' is a file; pass the directory to write <model>.layers.csv and <model>.curve.csv to.")
+    directory.mkdir(parents=True, exist_ok=True)
+    stem = source.stem
+
+    with open(directory / f"{stem}.layers.csv", "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(["Layer", "Op", "OutputShape", "FLOPs", "ParamBytes", "ActivationBytes", "BytesMoved", "CpuMs"])
+        for layer in detail.layers:
+            writer.writerow([layer.name, layer.op_type, format_shape(layer.output_shape), layer.flops, layer.param_bytes,
+                             layer.activation_bytes, layer.bytes_moved, "" if layer.cpu_ms is None else f"{layer.cpu_ms:.4f}"])
+
+    with open(directory / f"{stem}.curve.csv", "w", newline="") as file:
+        writer = csv.writer(file)
+        writer.writerow(["Width", "Height", "FLOPs", "ParamBytes", "PeakActivationBytes", "PeakWorkingSetBytes", "BytesMoved", "CpuMs", "TargetMs"])
+        for cost in curve:
+            predicted = roofline_ms(cost, args)
+            writer.writerow([cost.resolution[0], cost.resolution[1], cost.flops, cost.param_bytes, cost.peak_activation_bytes,
+                             cost.peak_working_set_bytes, cost.bytes_moved,
+                             "" if cost.cpu_ms is None else f"{cost.cpu_ms:.4f}",
+                             "" if predicted is None else f"{predicted:.4f}"])
+    print(f"[OK] Wrote '{stem}.layers.csv' and '{stem}.curve.csv' to '{directory}'")
+
+
+def analyze_file(source: Path, args: argparse.Namespace) -> bool:
+    model = onnx.load(str(source))
+    strip_initializer_inputs(model)
+    name_nodes(model)
+    if image_input(model) is None:
+        print(f"[FAIL] '{source.name}' has no rank-4 image input.")
+        return False
+
+    try:
+        detail = analyze(model, args.resolution, args, profile=not args.no_time, time_model=False)
+    except Exception as error:
+        print(f"[FAIL] '{source.name}' does not run at {args.resolution[0]}x{args.resolution[1]}: {error}")
+        return False
+    report_layers(source, detail, args)
+
+    curve = []
+    for resolution in args.curve or default_curve(args.resolution, args.align):
+        try:
+            curve.append(analyze(model, resolution, args, profile=False, time_model=not args.no_time))
+        except Exception as error:
+            print(f"[WARN] Skip {resolution[0]}x{resolution[1]}: {error}")
+    report_curve(source, curve, args)
+
+    if args.csv_dir:
+        try:
+            write_csv(args.csv_dir, source, detail, curve, args)
+        except (OSError, ValueError) as error:
+            print(f"[FAIL] {error}")
+            return False
+    return True
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Report per-layer FLOPs, parameter and activation memory, peak working set and ONNX Runtime CPU time "
+                    "of ONNX style models, plus a cost curve across input resolutions for picking the deployment resolution.",
+    )
+    parser.add_argument("inputs", nargs="+", help="Paths to .onnx files to analyze.")
+    parser.add_argument("--resolution", type=parse_resolution, default=(224, 224),
+                        help="Input resolution WIDTHxHEIGHT of the per-layer report (default: 224x224).")
+    parser.add_argument("--curve", type=parse_resolution, nargs="+",
+                        help="Resolutions of the cost curve (default: 0.25x to 2x of --resolution).")
+    parser.add_argument("--align", type=int, default=4,
+                        help="Default curve resolutions are rounded to multiples of this, to suit strided layers (default: %(default)s).")
+    parser.add_argument("--runs", type=int, default=10, help="Timed runs per measurement (default: %(default)s).")
+    parser.add_argument("--threads", type=int, help="ONNX Runtime intra-op threads (default: ONNX Runtime's choice).")
+    parser.add_argument("--no-time", action="store_true", help="Skip ONNX Runtime timing and report the static costs only.")
+    parser.add_argument("--top", type=int, help="Only list the N most expensive layers.")
+    parser.add_argument("--target-tflops", type=float,
+                        help="Sustained TFLOPs of the target GPU, for a roofline prediction of the curve.")
+    parser.add_argument("--target-gbps", type=float,
+                        help="Sustained memory bandwidth of the target GPU in GB/s, for a roofline prediction of the curve.")
+    parser.add_argument("--budget-ms", type=float,
+                        help="Frame budget for the model. Reports the largest curve resolution within it (target prediction if given, else CPU).")
+    parser.add_argument("--csv-dir", type=Path, help="Directory to write <model>.layers.csv and <model>.curve.csv to.")
+    args = parser.parse_args()
+
+    failed = False
+    for input_path in args.inputs:
+        source = Path(input_path).resolve()
+        if not source.is_file():
+            print(f"[WARN] Skip '{source}': not a file.")
+            continue
+        failed |= not analyze_file(source, args)
+
+    raise SystemExit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
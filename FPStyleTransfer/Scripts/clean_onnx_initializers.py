@@ -4,9 +4,7 @@ from pathlib import Path
 import onnx
 
 
-def clean_model(source_path: Path, destination_path: Path) -> bool:
-    model = onnx.load(str(source_path))
-
+def strip_initializer_inputs(model: onnx.ModelProto) -> bool:
     initializer_names = {initializer.name for initializer in model.graph.initializer}
     if not initializer_names:
         return False
@@ -21,6 +19,14 @@ def clean_model(source_path: Path, destination_path: Path) -> bool:
     # Replace the repeated field contents.
     del model.graph.input[:]
     model.graph.input.extend(filtered_inputs)
+    return True
+
+
+def clean_model(source_path: Path, destination_path: Path) -> bool:
+    model = onnx.load(str(source_path))
+
+    if not strip_initializer_inputs(model):
+        return False
 
     destination_path.parent.mkdir(parents=True, exist_ok=True)
     onnx.save(model, str(destination_path))
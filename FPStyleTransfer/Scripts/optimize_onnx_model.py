@@ -0,0 +1,456 @@
+import argparse
+import hashlib
+import tempfile
+import time
+from pathlib import Path
+from typing import Callable, Dict, List, Tuple
+
+import numpy as np
+import onnx
+from onnx import numpy_helper, shape_inference
+
+from clean_onnx_initializers import strip_initializer_inputs
+
+
+# Dimension values used for symbolic dims that are not spatial (batch, channels).
+DEFAULT_BATCH = 1
+DEFAULT_CHANNELS = 3
+
+
+def parse_resolution(value: str) -> Tuple[int, int]:
+    width, _, height = value.lower().partition("x")
+    if not width or not height:
+        raise argparse.ArgumentTypeError(f"Resolution must look like 640x360, got '{value}'.")
+    return int(width), int(height)
+
+
+def model_size(model: onnx.ModelProto) -> int:
+    return model.ByteSize()
+
+
+def make_feed(model: onnx.ModelProto, seed: int = 0) -> Dict[str, np.ndarray]:
+    import onnxruntime as ort
+
+    rng = np.random.default_rng(seed)
+    session = ort.InferenceSession(model.SerializeToString(), providers=["CPUExecutionProvider"])
+    feed = {}
+    for tensor in session.get_inputs():
+        shape = [dim if isinstance(dim, int) and dim > 0 else DEFAULT_BATCH for dim in tensor.shape]
+        if tensor.type == "tensor(float)":
+            feed[tensor.name] = rng.random(shape, dtype=np.float32)
+        elif tensor.type == "tensor(float16)":
+            feed[tensor.name] = rng.random(shape, dtype=np.float32).astype(np.float16)
+        elif tensor.type in ("tensor(uint8)", "tensor(int8)"):
+            low, high = (0, 256) if tensor.type == "tensor(uint8)" else (-128, 128)
+            feed[tensor.name] = rng.integers(low, high, shape, dtype=np.uint8 if tensor.type == "tensor(uint8)" else np.int8)
+        elif tensor.type in ("tensor(int64)", "tensor(int32)"):
+            feed[tensor.name] = np.zeros(shape, dtype=np.int64 if tensor.type == "tensor(int64)" else np.int32)
+        else:
+            raise RuntimeError(f"Unsupported input type {tensor.type} for '{tensor.name}'.")
+    return feed
+
+
+def run_model(model: onnx.ModelProto, feed: Dict[str, np.ndarray], runs: int, optimization: str) -> Tuple[float, List[np.ndarray]]:
+    """Returns the median CPU latency in milliseconds and the outputs of the last run."""
+    import onnxruntime as ort
+
+    options = ort.SessionOptions()
+    options.graph_optimization_level = {
+        "disabled": ort.GraphOptimizationLevel.ORT_DISABLE_ALL,
+        "basic": ort.GraphOptimizationLevel.ORT_ENABLE_BASIC,
+        "all": ort.GraphOptimizationLevel.ORT_ENABLE_ALL,
+    }[optimization]
+
+    session = ort.InferenceSession(model.SerializeToString(), options, providers=["CPUExecutionProvider"])
+    outputs = session.run(None, feed)
+
+    timings = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        outputs = session.run(None, feed)
+        timings.append((time.perf_counter() - start) * 1000.0)
+
+    return float(np.median(timings)), outputs
+
+
+def relative_error(expected: np.ndarray, actual: np.ndarray) -> float:
+    """Max abs difference divided by the output's range, so models emitting 0..255 and 0..1 compare alike."""
+    expected = expected.astype(np.float32)
+    scale = max(float(np.max(np.abs(expected))), 1e-6)
+    return float(np.max(np.abs(expected - actual.astype(np.float32)))) / scale
+
+
+def topological_sort(model: onnx.ModelProto) -> None:
+    """Reorders the graph's nodes so each comes after the producers of its inputs (and of names its subgraphs read)."""
+    nodes = list(model.graph.node)
+    producer = {name: index for index, node in enumerate(nodes) for name in node.output if name}
+
+    def subgraph_inputs(node: onnx.NodeProto) -> List[str]:
+        names = []
+        for attribute in node.attribute:
+            graphs = list(attribute.graphs) + ([attribute.g] if attribute.HasField("g") else [])
+            for graph in graphs:
+                for inner in graph.node:
+                    names.extend(inner.input)
+                    names.extend(subgraph_inputs(inner))
+        return names
+
+    dependents: List[List[int]] = [[] for _ in nodes]
+    pending = [0] * len(nodes)
+    for index, node in enumerate(nodes):
+        sources = {producer[name] for name in list(node.input) + subgraph_inputs(node) if name in producer}
+        sources.discard(index)
+        pending[index] = len(sources)
+        for source in sources:
+            dependents[source].append(index)
+
+    # Kahn's algorithm, taking ready nodes in their original order so sorted graphs stay unchanged.
+    ready = [index for index, count in enumerate(pending) if count == 0]
+    ready.reverse()
+    order = []
+    while ready:
+        index = ready.pop()
+        order.append(index)
+        for dependent in reversed(dependents[index]):
+            pending[dependent] -= 1
+            if pending[dependent] == 0:
+                ready.append(dependent)
+    if len(order) != len(nodes):
+        raise RuntimeError("The graph has a cycle and cannot be sorted.")
+
+    del model.graph.node[:]
+    model.graph.node.extend(nodes[index] for index in order)
+
+
+# --- Pipeline steps. Each returns True when it changed the model. ---
+
+def step_strip_initializer_inputs(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    return strip_initializer_inputs(model)
+
+
+def step_pin_shapes(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    """Replaces symbolic input dims with the deployment shape so the engine never falls back to 224."""
+    initializer_names = {initializer.name for initializer in model.graph.initializer}
+    width, height = args.resolution
+    changed = False
+
+    for graph_input in model.graph.input:
+        if graph_input.name in initializer_names:
+            continue
+
+        dims = graph_input.type.tensor_type.shape.dim
+        rank = len(dims)
+        for index, dim in enumerate(dims):
+            if dim.HasField("dim_value") and dim.dim_value > 0:
+                continue
+
+            if index == 0:
+                value = args.batch
+            elif rank == 4 and index == 1:
+                value = DEFAULT_CHANNELS
+            elif rank == 4 and index == 2:
+                value = height
+            elif rank == 4 and index == 3:
+                value = width
+            else:
+                value = DEFAULT_BATCH
+
+            dim.Clear()
+            dim.dim_value = value
+            changed = True
+
+    if changed:
+        # Stale intermediate shapes would otherwise keep the old symbols.
+        del model.graph.value_info[:]
+        for graph_output in model.graph.output:
+            graph_output.type.tensor_type.ClearField("shape")
+        inferred = shape_inference.infer_shapes(model)
+        inferred_types = {info.name: info.type for info in inferred.graph.value_info}
+        for graph_output in inferred.graph.output:
+            if not graph_output.type.tensor_type.HasField("shape") and graph_output.name in inferred_types:
+                graph_output.type.CopyFrom(inferred_types[graph_output.name])
+        model.CopyFrom(inferred)
+    return changed
+
+
+def step_fold_batch_norm(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    """Folds BatchNormalization nodes that directly follow a Conv into the Conv weights and bias."""
+    initializers = {initializer.name: initializer for initializer in model.graph.initializer}
+    consumers: Dict[str, int] = {}
+    for node in model.graph.node:
+        for name in node.input:
+            consumers[name] = consumers.get(name, 0) + 1
+    graph_outputs = {output.name for output in model.graph.output}
+    producers = {output: node for node in model.graph.node for output in node.output}
+
+    removed = []
+    for bn in model.graph.node:
+        if bn.op_type != "BatchNormalization" or len(bn.output) != 1:
+            continue
+
+        conv = producers.get(bn.input[0])
+        if conv is None or conv.op_type != "Conv" or consumers.get(conv.output[0], 0) != 1 or conv.output[0] in graph_outputs:
+            continue
+        if any(name not in initializers for name in bn.input[1:5]) or conv.input[1] not in initializers:
+            continue
+        if len(conv.input) > 2 and conv.input[2] not in initializers:
+            continue
+
+        epsilon = next((attr.f for attr in bn.attribute if attr.name == "epsilon"), 1e-5)
+        scale, bias, mean, var = (numpy_helper.to_array(initializers[name]).astype(np.float64) for name in bn.input[1:5])
+        weight = numpy_helper.to_array(initializers[conv.input[1]]).astype(np.float64)
+        conv_bias = numpy_helper.to_array(initializers[conv.input[2]]).astype(np.float64) if len(conv.input) > 2 else np.zeros(weight.shape[0])
+
+        factor = scale / np.sqrt(var + epsilon)
+        fused_weight = weight * factor.reshape(-1, *([1] * (weight.ndim - 1)))
+        fused_bias = (conv_bias - mean) * factor + bias
+
+        weight_name = conv.input[1] + "_bnfused"
+        bias_name = (conv.input[2] if len(conv.input) > 2 else conv.name + "_bias") + "_bnfused"
+        model.graph.initializer.append(numpy_helper.from_array(fused_weight.astype(np.float32), weight_name))
+        model.graph.initializer.append(numpy_helper.from_array(fused_bias.astype(np.float32), bias_name))
+
+        del conv.input[1:]
+        conv.input.extend([weight_name, bias_name])
+        conv.output[0] = bn.output[0]
+        removed.append(bn)
+
+    for node in removed:
+        model.graph.node.remove(node)
+
+    if removed:
+        remove_unused_initializers(model)
+    return bool(removed)
+
+
+def step_constant_fold(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    """Runs ONNX Runtime's basic level (constant folding, redundant node elimination) and keeps the result.
+
+    Extended levels are not used: they emit com.microsoft contrib ops (e.g. FusedConv) that NNE runtimes reject.
+    Conv + activation fusion is left to the execution provider, which performs it at load time.
+    """
+    import onnxruntime as ort
+
+    with tempfile.TemporaryDirectory() as directory:
+        optimized_path = Path(directory) / "folded.onnx"
+        options = ort.SessionOptions()
+        options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_BASIC
+        options.optimized_model_filepath = str(optimized_path)
+        ort.InferenceSession(model.SerializeToString(), options, providers=["CPUExecutionProvider"])
+        folded = onnx.load(str(optimized_path))
+
+    changed = len(folded.graph.node) != len(model.graph.node) or len(folded.graph.initializer) != len(model.graph.initializer)
+    model.CopyFrom(folded)
+    return changed
+
+
+def step_deduplicate_initializers(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    canonical: Dict[Tuple[int, Tuple[int, ...], str], str] = {}
+    renames: Dict[str, str] = {}
+
+    for initializer in model.graph.initializer:
+        array = numpy_helper.to_array(initializer)
+        key = (initializer.data_type, tuple(initializer.dims), hashlib.sha1(array.tobytes()).hexdigest())
+        if key in canonical:
+            renames[initializer.name] = canonical[key]
+        else:
+            canonical[key] = initializer.name
+
+    if not renames:
+        return False
+
+    for node in model.graph.node:
+        for index, name in enumerate(node.input):
+            if name in renames:
+                node.input[index] = renames[name]
+
+    remove_unused_initializers(model)
+    return True
+
+
+def step_convert_fp16(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    if not args.fp16:
+        return False
+
+    # ONNX Runtime ships the same converter as onnxconverter-common.
+    try:
+        from onnxruntime.transformers.float16 import convert_float_to_float16
+    except ImportError:
+        try:
+            from onnxconverter_common.float16 import convert_float_to_float16
+        except ImportError as error:
+            raise RuntimeError("--fp16 requires onnxruntime or onnxconverter-common.") from error
+
+    # Keep float32 I/O so the engine's encode/decode passes still bind float tensors.
+    converted = convert_float_to_float16(model, keep_io_types=True)
+    # The converter appends the I/O Casts at the end of the graph, after their consumers.
+    topological_sort(converted)
+    model.CopyFrom(converted)
+    return True
+
+
+def step_strip_unused_outputs(model: onnx.ModelProto, args: argparse.Namespace) -> bool:
+    keep = set(args.keep_output) if args.keep_output else {model.graph.output[0].name}
+    unused = [output for output in model.graph.output if output.name not in keep]
+    for output in unused:
+        model.graph.output.remove(output)
+
+    removed_nodes = remove_dead_nodes(model)
+    return bool(unused) or removed_nodes
+
+
+def remove_dead_nodes(model: onnx.ModelProto) -> bool:
+    live = {output.name for output in model.graph.output}
+    kept = []
+    for node in reversed(model.graph.node):
+        if any(name in live for name in node.output):
+            kept.append(node)
+            live.update(name for name in node.input if name)
+
+    if len(kept) == len(model.graph.node):
+        return False
+
+    del model.graph.node[:]
+    model.graph.node.extend(reversed(kept))
+    remove_unused_initializers(model)
+    return True
+
+
+def remove_unused_initializers(model: onnx.ModelProto) -> None:
+    used = {name for node in model.graph.node for name in node.input}
+    used.update(output.name for output in model.graph.output)
+    kept = [initializer for initializer in model.graph.initializer if initializer.name in used]
+    del model.graph.initializer[:]
+    model.graph.initializer.extend(kept)
+
+
+PIPELINE: List[Tuple[str, Callable[[onnx.ModelProto, argparse.Namespace], bool]]] = [
+    ("strip-initializer-inputs", step_strip_initializer_inputs),
+    ("pin-shapes", step_pin_shapes),
+    ("fold-batch-norm", step_fold_batch_norm),
+    ("constant-fold", step_constant_fold),
+    ("dedup-initializers", step_deduplicate_initializers),
+    ("strip-unused-outputs", step_strip_unused_outputs),
+    ("fp16", step_convert_fp16),
+]
+
+# Steps the engine needs to load the model at all; they are kept even when they do not make it faster.
+REQUIRED_STEPS = {"strip-initializer-inputs", "pin-shapes"}
+
+
+def optimize(source: Path, destination: Path, args: argparse.Namespace) -> bool:
+    model = onnx.load(str(source))
+    skipped = set(args.skip or [])
+
+    # The feed is fixed by the pinned deployment shape so every step is timed on identical input.
+    reference = onnx.ModelProto()
+    reference.CopyFrom(model)
+    step_pin_shapes(reference, args)
+    feed = make_feed(reference)
+
+    try:
+        onnx.checker.check_model(model)
+        validate = True
+    except onnx.checker.ValidationError as error:
+        print(f"[WARN] '{source.name}' does not pass the ONNX checker, steps are not validated: {error}")
+        validate = False
+
+    baseline_ms, baseline_outputs = run_model(model, feed, args.runs, args.ort_level)
+    baseline_size = model_size(model)
+    print(f"[BASE] {source.name}: {baseline_size / 1024:.1f} KiB, {baseline_ms:.2f} ms")
+
+    previous_ms, previous_size = baseline_ms, baseline_size
+    for name, step in PIPELINE:
+        if name in skipped:
+            continue
+
+        # A step that throws, breaks the checker or changes the outputs is reverted; the earlier steps are kept.
+        candidate = onnx.ModelProto()
+        candidate.CopyFrom(model)
+        try:
+            if not step(candidate, args):
+                print(f"[SKIP] {name}: nothing to do")
+                continue
+            if validate:
+                onnx.checker.check_model(candidate)
+            latency_ms, outputs = run_model(candidate, feed, args.runs, args.ort_level)
+        except Exception as error:  # noqa: BLE001 - any failure of one step reverts that step only
+            print(f"[WARN] {name}: failed, step reverted: {error}")
+            continue
+        size = model_size(candidate)
+
+        max_error = max(relative_error(a, b) for a, b in zip(baseline_outputs, outputs))
+        tolerance = args.fp16_tolerance if name == "fp16" else args.tolerance
+        if max_error > tolerance:
+            print(f"[WARN] {name}: relative error {max_error:.3g} exceeds {tolerance:.3g}, step reverted")
+            continue
+
+        if not args.keep_slower and name not in REQUIRED_STEPS and latency_ms > previous_ms * (1.0 + args.latency_noise):
+            print(f"[WARN] {name}: {previous_ms:.2f} -> {latency_ms:.2f} ms is slower, step reverted")
+            continue
+
+        print(f"[OK] {name}: {previous_size / 1024:.1f} -> {size / 1024:.1f} KiB, "
+              f"{previous_ms:.2f} -> {latency_ms:.2f} ms (relative error {max_error:.3g})")
+        model, previous_ms, previous_size = candidate, latency_ms, size
+
+    speedup = baseline_ms / previous_ms if previous_ms > 0 else float("inf")
+    print(f"[TOTAL] {baseline_size / 1024:.1f} -> {previous_size / 1024:.1f} KiB, "
+          f"{baseline_ms:.2f} -> {previous_ms:.2f} ms ({speedup:.2f}x)")
+
+    if args.require_faster and previous_ms > baseline_ms:
+        print(f"[FAIL] Optimized model is not faster than '{source.name}'. No file emitted.")
+        return False
+
+    destination.parent.mkdir(parents=True, exist_ok=True)
+    onnx.save(model, str(destination))
+    print(f"[OK] Wrote '{destination.name}'")
+    return True
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Optimize ONNX style models for import: pin shapes, fold BatchNorm and constants, "
+                    "deduplicate initializers, strip unused outputs and optionally convert to FP16. "
+                    "Every step is timed on ONNX Runtime CPU and checked against the original outputs; steps that fail, "
+                    "change the outputs or slow the model down are reverted.",
+    )
+    parser.add_argument("inputs", nargs="+", help="Paths to .onnx files to optimize.")
+    parser.add_argument("--resolution", type=parse_resolution, default=(224, 224),
+                        help="Deployment input resolution WIDTHxHEIGHT used to pin symbolic dims (default: 224x224).")
+    parser.add_argument("--batch", type=int, default=DEFAULT_BATCH, help="Batch size to pin (default: %(default)s).")
+    parser.add_argument("--fp16", action="store_true", help="Convert weights and math to FP16 (I/O stays FP32).")
+    parser.add_argument("--keep-output", action="append", help="Graph output to keep (repeatable). Defaults to the first output.")
+    parser.add_argument("--skip", action="append", choices=[name for name, _ in PIPELINE], help="Pipeline step to skip (repeatable).")
+    parser.add_argument("--runs", type=int, default=20, help="Timed runs per measurement (default: %(default)s).")
+    parser.add_argument("--ort-level", choices=["disabled", "basic", "all"], default="disabled",
+                        help="ONNX Runtime optimization level used for timing. 'disabled' measures the graph as shipped "
+                             "(default: %(default)s).")
+    parser.add_argument("--tolerance", type=float, default=1e-4,
+                        help="Max output error relative to the output range for FP32 steps (default: %(default)s).")
+    parser.add_argument("--fp16-tolerance", type=float, default=1e-2,
+                        help="Max output error relative to the output range for the FP16 step (default: %(default)s).")
+    parser.add_argument("--keep-slower", action="store_true",
+                        help="Keep optional steps that make the model slower instead of reverting them.")
+    parser.add_argument("--latency-noise", type=float, default=0.02,
+                        help="Relative latency increase still treated as timing noise rather than a slowdown "
+                             "(default: %(default)s).")
+    parser.add_argument("--require-faster", action="store_true", help="Fail instead of writing a model that is not faster.")
+    parser.add_argument("--suffix", default=".optimized.onnx", help="Suffix for optimized models (default: %(default)s).")
+    args = parser.parse_args()
+
+    failed = False
+    for input_path in args.inputs:
+        source = Path(input_path).resolve()
+        if not source.is_file():
+            print(f"[WARN] Skip '{source}': not a file.")
+            continue
+
+        destination = source.with_suffix("")
+        destination = destination.with_name(destination.name + args.suffix)
+        failed |= not optimize(source, destination, args)
+
+    raise SystemExit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,324 @@
+import argparse
+import tempfile
+from pathlib import Path
+from typing import Dict, Iterator, List, Optional, Tuple
+
+import numpy as np
+import onnx
+from onnx import TensorProto, helper, numpy_helper
+
+from clean_onnx_initializers import strip_initializer_inputs
+from optimize_onnx_model import parse_resolution, run_model, step_pin_shapes
+
+
+# Metadata read by UMyNeuralNetwork to map integer I/O tensors back to real values: Real = (Quantized - ZeroPoint) * Scale.
+METADATA_INPUT_SCALE = "style_transfer.input_scale"
+METADATA_INPUT_ZERO_POINT = "style_transfer.input_zero_point"
+METADATA_OUTPUT_SCALE = "style_transfer.output_scale"
+METADATA_OUTPUT_ZERO_POINT = "style_transfer.output_zero_point"
+
+IMAGE_SUFFIXES = {".png", ".jpg", ".jpeg", ".bmp", ".tga"}
+
+
+def load_frame(path: Path) -> np.ndarray:
+    """Loads a frame as HWC RGB float32 in 0..1."""
+    if path.suffix.lower() == ".npy":
+        frame = np.load(str(path))
+    else:
+        try:
+            from PIL import Image
+        except ImportError as error:
+            raise RuntimeError(f"Reading '{path.name}' requires Pillow; convert frames to .npy or pip install pillow.") from error
+        with Image.open(path) as image:
+            frame = np.asarray(image.convert("RGB"))
+
+    if frame.ndim == 3 and frame.shape[0] in (3, 4) and frame.shape[-1] not in (3, 4):
+        frame = frame.transpose(1, 2, 0)
+    frame = frame[..., :3]
+    return frame.astype(np.float32) / 255.0 if frame.dtype == np.uint8 else frame.astype(np.float32)
+
+
+def resize_frame(frame: np.ndarray, width: int, height: int) -> np.ndarray:
+    """Box-samples to the model resolution, like the encode pass does for large downscales."""
+    rows = ((np.arange(height) + 0.5) * frame.shape[0] / height).astype(np.int64)
+    cols = ((np.arange(width) + 0.5) * frame.shape[1] / width).astype(np.int64)
+    return frame[np.clip(rows, 0, frame.shape[0] - 1)][:, np.clip(cols, 0, frame.shape[1] - 1)]
+
+
+def frame_to_tensor(frame: np.ndarray, width: int, height: int, channels: int) -> np.ndarray:
+    """Matches the encode shader: saturated color, planar BGR, NCHW."""
+    resized = np.clip(resize_frame(frame, width, height), 0.0, 1.0)
+    bgr = resized[..., ::-1].transpose(2, 0, 1)
+    return np.ascontiguousarray(bgr[:channels][np.newaxis], dtype=np.float32)
+
+
+def collect_frames(corpus: Path) -> List[Path]:
+    frames = sorted(path for path in corpus.rglob("*") if path.suffix.lower() in IMAGE_SUFFIXES | {".npy"})
+    if not frames:
+        raise RuntimeError(f"No frames (.npy or images) found under '{corpus}'.")
+    return frames
+
+
+def image_input(model: onnx.ModelProto) -> onnx.ValueInfoProto:
+    initializer_names = {initializer.name for initializer in model.graph.initializer}
+    return next(graph_input for graph_input in model.graph.input if graph_input.name not in initializer_names)
+
+
+def make_feeds(model: onnx.ModelProto, frames: List[Path]) -> List[Dict[str, np.ndarray]]:
+    graph_input = image_input(model)
+    dims = [dim.dim_value for dim in graph_input.type.tensor_type.shape.dim]
+    if len(dims) != 4 or min(dims[1:]) <= 0:
+        raise RuntimeError(f"Input '{graph_input.name}' must be NCHW with static C, H and W; pass --resolution.")
+
+    _, channels, height, width = dims
+    initializer_names = {initializer.name for initializer in model.graph.initializer}
+    extra_inputs = [tensor for tensor in model.graph.input if tensor.name not in initializer_names and tensor.name != graph_input.name]
+
+    feeds = []
+    for path in frames:
+        feed = {graph_input.name: frame_to_tensor(load_frame(path), width, height, channels)}
+        for tensor in extra_inputs:
+            # Conditional models are calibrated on their first style.
+            shape = [max(dim.dim_value, 1) for dim in tensor.type.tensor_type.shape.dim]
+            dtype = helper.tensor_dtype_to_np_dtype(tensor.type.tensor_type.elem_type)
+            value = np.zeros(shape, dtype=dtype)
+            if value.size and np.issubdtype(dtype, np.floating):
+                value.flat[0] = 1.0
+            feed[tensor.name] = value
+        feeds.append(feed)
+    return feeds
+
+
+class FrameDataReader:
+    """CalibrationDataReader over the captured frame corpus."""
+
+    def __init__(self, feeds: List[Dict[str, np.ndarray]]):
+        self.feeds = feeds
+        self.iterator: Iterator[Dict[str, np.ndarray]] = iter(feeds)
+
+    def get_next(self) -> Optional[Dict[str, np.ndarray]]:
+        return next(self.iterator, None)
+
+    def rewind(self) -> None:
+        self.iterator = iter(self.feeds)
+
+
+def quantize(model: onnx.ModelProto, feeds: List[Dict[str, np.ndarray]], args: argparse.Namespace) -> onnx.ModelProto:
+    from onnxruntime.quantization import CalibrationMethod, QuantFormat, QuantType, quantize_static
+
+    with tempfile.TemporaryDirectory() as directory:
+        source_path = Path(directory) / "fp32.onnx"
+        quantized_path = Path(directory) / "int8.onnx"
+        onnx.save(model, str(source_path))
+        quantize_static(
+            str(source_path),
+            str(quantized_path),
+            FrameDataReader(feeds),
+            quant_format=QuantFormat.QDQ,
+            activation_type=QuantType.QUInt8 if args.activation_type == "uint8" else QuantType.QInt8,
+            weight_type=QuantType.QInt8,
+            per_channel=args.per_channel,
+            calibrate_method={
+                "minmax": CalibrationMethod.MinMax,
+                "entropy": CalibrationMethod.Entropy,
+                "percentile": CalibrationMethod.Percentile,
+            }[args.calibration],
+        )
+        return onnx.load(str(quantized_path))
+
+
+def scalar_initializer(model: onnx.ModelProto, name: str) -> Optional[np.ndarray]:
+    initializer = next((initializer for initializer in model.graph.initializer if initializer.name == name), None)
+    if initializer is None:
+        return None
+    value = numpy_helper.to_array(initializer)
+    return value if value.size == 1 else None
+
+
+def set_metadata(model: onnx.ModelProto, key: str, value: str) -> None:
+    for entry in model.metadata_props:
+        if entry.key == key:
+            entry.value = value
+            return
+    model.metadata_props.append(onnx.StringStringEntryProto(key=key, value=value))
+
+
+def absorb_io_quantization(model: onnx.ModelProto) -> Tuple[bool, bool]:
+    """Moves the image input's QuantizeLinear and the first output's DequantizeLinear into the engine.
+
+    The graph then takes and returns 8-bit tensors directly; the encode/decode shaders apply the scale and zero
+    point recorded in the model metadata. Returns whether the input and output were converted.
+    """
+    graph = model.graph
+    graph_input = image_input(model)
+    graph_output = graph.output[0]
+
+    input_converted = False
+    consumers = [node for node in graph.node if graph_input.name in node.input]
+    if consumers and all(node.op_type == "QuantizeLinear" for node in consumers):
+        params = [(scalar_initializer(model, node.input[1]), scalar_initializer(model, node.input[2]) if len(node.input) > 2 else None) for node in consumers]
+        scale, zero_point = params[0]
+        consistent = scale is not None and zero_point is not None and all(
+            other_scale is not None and other_zero_point is not None
+            and np.allclose(other_scale, scale) and other_zero_point == zero_point
+            for other_scale, other_zero_point in params[1:])
+        if consistent:
+            for node in consumers:
+                for consumer in graph.node:
+                    for index, name in enumerate(consumer.input):
+                        if name == node.output[0]:
+                            consumer.input[index] = graph_input.name
+                graph.node.remove(node)
+            graph_input.type.tensor_type.elem_type = helper.np_dtype_to_tensor_dtype(zero_point.dtype)
+            set_metadata(model, METADATA_INPUT_SCALE, repr(float(scale)))
+            set_metadata(model, METADATA_INPUT_ZERO_POINT, str(int(zero_point)))
+            input_converted = True
+
+    output_converted = False
+    producer = next((node for node in graph.node if graph_output.name in node.output), None)
+    if producer is not None and producer.op_type == "DequantizeLinear":
+        scale = scalar_initializer(model, producer.input[1])
+        zero_point = scalar_initializer(model, producer.input[2]) if len(producer.input) > 2 else None
+        quantized_name = producer.input[0]
+        other_consumers = [node for node in graph.node if node is not producer and quantized_name in node.input]
+        if scale is not None and zero_point is not None and not other_consumers:
+            for node in graph.node:
+                for index, name in enumerate(node.output):
+                    if name == quantized_name:
+                        node.output[index] = graph_output.name
+            graph.node.remove(producer)
+            graph_output.type.tensor_type.elem_type = helper.np_dtype_to_tensor_dtype(zero_point.dtype)
+            set_metadata(model, METADATA_OUTPUT_SCALE, repr(float(scale)))
+            set_metadata(model, METADATA_OUTPUT_ZERO_POINT, str(int(zero_point)))
+            output_converted = True
+
+    return input_converted, output_converted
+
+
+def quantize_feed(feed: Dict[str, np.ndarray], model: onnx.ModelProto, input_name: str) -> Dict[str, np.ndarray]:
+    """Applies the absorbed input quantization so integer-I/O models can be evaluated on the same frames."""
+    metadata = {entry.key: entry.value for entry in model.metadata_props}
+    if METADATA_INPUT_SCALE not in metadata:
+        return feed
+
+    graph_input = next(tensor for tensor in model.graph.input if tensor.name == input_name)
+    dtype = helper.tensor_dtype_to_np_dtype(graph_input.type.tensor_type.elem_type)
+    info = np.iinfo(dtype)
+    scale = float(metadata[METADATA_INPUT_SCALE])
+    zero_point = int(metadata[METADATA_INPUT_ZERO_POINT])
+    quantized = np.clip(np.rint(feed[input_name] / scale) + zero_point, info.min, info.max).astype(dtype)
+    return {**feed, input_name: quantized}
+
+
+def dequantize_output(output: np.ndarray, model: onnx.ModelProto) -> np.ndarray:
+    metadata = {entry.key: entry.value for entry in model.metadata_props}
+    if METADATA_OUTPUT_SCALE not in metadata:
+        return output.astype(np.float32)
+    return (output.astype(np.float32) - int(metadata[METADATA_OUTPUT_ZERO_POINT])) * float(metadata[METADATA_OUTPUT_SCALE])
+
+
+def psnr(reference: np.ndarray, actual: np.ndarray, peak: float) -> float:
+    mse = float(np.mean((reference.astype(np.float64) - actual.astype(np.float64)) ** 2))
+    return float("inf") if mse == 0.0 else 10.0 * np.log10(peak * peak / mse)
+
+
+def evaluate(fp32: onnx.ModelProto, int8: onnx.ModelProto, feeds: List[Dict[str, np.ndarray]], args: argparse.Namespace) -> Tuple[float, float, float]:
+    """Returns FP32 latency, INT8 latency (ms, median over frames) and the mean PSNR of INT8 against FP32."""
+    input_name = image_input(fp32).name
+    fp32_ms, int8_ms, scores = [], [], []
+    reference_outputs = []
+    for feed in feeds:
+        latency, outputs = run_model(fp32, feed, args.runs, args.ort_level)
+        fp32_ms.append(latency)
+        reference_outputs.append(outputs[0].astype(np.float32))
+
+    # PSNR peak is the FP32 output range, so 0..1 and 0..255 models are scored alike.
+    stacked = np.stack(reference_outputs)
+    peak = max(float(stacked.max() - stacked.min()), 1e-6)
+
+    for feed, reference in zip(feeds, reference_outputs):
+        latency, outputs = run_model(int8, quantize_feed(feed, int8, input_name), args.runs, args.ort_level)
+        int8_ms.append(latency)
+        scores.append(psnr(reference, dequantize_output(outputs[0], int8), peak))
+
+    return float(np.median(fp32_ms)), float(np.median(int8_ms)), float(np.mean(scores))
+
+
+def quantize_file(source: Path, destination: Path, args: argparse.Namespace) -> bool:
+    model = onnx.load(str(source))
+    strip_initializer_inputs(model)
+    if args.resolution:
+        step_pin_shapes(model, args)
+
+    frames = collect_frames(args.corpus)
+    rng = np.random.default_rng(0)
+    rng.shuffle(frames)
+    evaluation_count = max(1, int(len(frames) * args.holdout)) if len(frames) > 1 else 0
+    calibration_frames = frames[evaluation_count:] or frames
+    evaluation_frames = frames[:evaluation_count] or frames
+    if args.max_frames:
+        calibration_frames = calibration_frames[:args.max_frames]
+
+    print(f"[INFO] {source.name}: calibrating on {len(calibration_frames)} frame(s), evaluating on {len(evaluation_frames)}")
+    quantized = quantize(model, make_feeds(model, calibration_frames), args)
+
+    if not args.float_io:
+        input_converted, output_converted = absorb_io_quantization(quantized)
+        print(f"[INFO] Integer input: {'yes' if input_converted else 'no'}, integer output: {'yes' if output_converted else 'no'}")
+
+    fp32_ms, int8_ms, score = evaluate(model, quantized, make_feeds(model, evaluation_frames), args)
+    speedup = fp32_ms / int8_ms if int8_ms > 0 else float("inf")
+    print(f"[A/B] FP32 {fp32_ms:.2f} ms, {model.ByteSize() / 1024:.1f} KiB | "
+          f"INT8 {int8_ms:.2f} ms, {quantized.ByteSize() / 1024:.1f} KiB | {speedup:.2f}x, PSNR {score:.2f} dB")
+
+    if score < args.min_psnr:
+        print(f"[FAIL] PSNR {score:.2f} dB is below --min-psnr {args.min_psnr:.2f}. No file emitted.")
+        return False
+
+    destination.parent.mkdir(parents=True, exist_ok=True)
+    onnx.save(quantized, str(destination))
+    print(f"[OK] Wrote '{destination.name}'")
+    return True
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Quantize ONNX style models to INT8 (QDQ) using a corpus of captured frames, then report "
+                    "latency and PSNR against the FP32 model on held-out frames.",
+    )
+    parser.add_argument("inputs", nargs="+", help="Paths to FP32 .onnx files to quantize.")
+    parser.add_argument("--corpus", type=Path, required=True, help="Directory of captured frames (.npy HWC/CHW or images).")
+    parser.add_argument("--resolution", type=parse_resolution, help="Pin symbolic dims to WIDTHxHEIGHT before calibration.")
+    parser.add_argument("--batch", type=int, default=1, help=argparse.SUPPRESS)
+    parser.add_argument("--calibration", choices=["minmax", "entropy", "percentile"], default="minmax",
+                        help="Activation range calibration method (default: %(default)s).")
+    parser.add_argument("--activation-type", choices=["uint8", "int8"], default="uint8",
+                        help="Activation (and integer I/O) type (default: %(default)s).")
+    parser.add_argument("--per-channel", action="store_true", help="Quantize Conv weights per output channel.")
+    parser.add_argument("--float-io", action="store_true",
+                        help="Keep FP32 graph I/O instead of handing input quantization and output dequantization to the engine.")
+    parser.add_argument("--holdout", type=float, default=0.2, help="Fraction of frames held out for evaluation (default: %(default)s).")
+    parser.add_argument("--max-frames", type=int, help="Cap the number of calibration frames.")
+    parser.add_argument("--runs", type=int, default=10, help="Timed runs per frame and model (default: %(default)s).")
+    parser.add_argument("--ort-level", choices=["disabled", "basic", "all"], default="all",
+                        help="ONNX Runtime optimization level used for timing (default: %(default)s).")
+    parser.add_argument("--min-psnr", type=float, default=30.0, help="Refuse to emit models below this PSNR (default: %(default)s).")
+    parser.add_argument("--suffix", default=".int8.onnx", help="Suffix for quantized models (default: %(default)s).")
+    args = parser.parse_args()
+
+    failed = False
+    for input_path in args.inputs:
+        source = Path(input_path).resolve()
+        if not source.is_file():
+            print(f"[WARN] Skip '{source}': not a file.")
+            continue
+
+        destination = source.with_suffix("")
+        destination = destination.with_name(destination.name + args.suffix)
+        failed |= not quantize_file(source, destination, args)
+
+    raise SystemExit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
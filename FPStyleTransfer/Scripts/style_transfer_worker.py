@@ -0,0 +1,286 @@
+import argparse
+import os
+import platform
+import sys
+import time
+from multiprocessing import resource_tracker, shared_memory
+from typing import List, Optional, Tuple
+
+import numpy as np
+import onnxruntime as ort
+
+
+# Mirrors StyleTransferWorkerProtocol in Source/FPStyleTransfer/StyleTransferWorker.h.
+MAGIC = 0x4B575453
+VERSION = 1
+MAX_SLOTS = 32
+CONTROL_BYTES = 4096
+SLOT_ALIGNMENT = 64
+
+# uint32 indices into the control region.
+U32_MAGIC, U32_VERSION, U32_SLOT_COUNT, U32_MAX_BATCH = 0, 1, 2, 3
+U32_INPUT_CHANNELS, U32_WIDTH, U32_HEIGHT = 4, 5, 6
+U32_OUTPUT_CHANNELS, U32_OUTPUT_WIDTH, U32_OUTPUT_HEIGHT = 7, 8, 9
+U32_WORKER_STATE, U32_HOST_STATE = 10, 11
+# uint64 indices into the control region.
+U64_INPUT_SLOT_BYTES, U64_OUTPUT_SLOT_BYTES, U64_SUBMIT_TICKET = 6, 7, 8
+# Slots start at byte 128 and are 64 bytes each: fence u64, inference ms f32, batch size u32, status u32.
+SLOT_BASE_BYTES, SLOT_BYTES = 128, 64
+
+WORKER_STARTING, WORKER_SHAPE_READY, WORKER_READY, WORKER_FAILED, WORKER_EXITED = 0, 1, 2, 3, 4
+HOST_STARTING, HOST_DATA_READY, HOST_STOPPING = 0, 1, 2
+
+STATUS_OK, STATUS_FAILED = 0, 1
+
+# NumPy stores carry no memory fence, so the slot protocol relies on x86 store ordering (see Control.finish).
+X86_MACHINES = ("x86_64", "amd64", "i386", "i686", "x86")
+
+# Polling: spin this long after the last request before sleeping between checks.
+SPIN_SECONDS = 0.002
+IDLE_SLEEP_SECONDS = 0.0005
+PARENT_CHECK_SECONDS = 0.5
+
+
+def attach(name: str) -> shared_memory.SharedMemory:
+    region = shared_memory.SharedMemory(name=name)
+    # The game owns the region; without this the tracker would unlink it when the worker exits.
+    if os.name == "posix":
+        resource_tracker.unregister(region._name, "shared_memory")  # type: ignore[attr-defined]
+    return region
+
+
+def parent_alive(pid: Optional[int]) -> bool:
+    if pid is None:
+        return True
+    if os.name == "nt":
+        import ctypes
+
+        synchronize, wait_timeout = 0x00100000, 0x00000102
+        kernel32 = ctypes.windll.kernel32  # type: ignore[attr-defined]
+        handle = kernel32.OpenProcess(synchronize, False, pid)
+        if not handle:
+            return False
+        try:
+            return kernel32.WaitForSingleObject(handle, 0) == wait_timeout
+        finally:
+            kernel32.CloseHandle(handle)
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        pass
+    return True
+
+
+class Control:
+    """Typed views over the control region."""
+
+    def __init__(self, region: shared_memory.SharedMemory):
+        self.u32 = np.ndarray((CONTROL_BYTES // 4,), dtype=np.uint32, buffer=region.buf)
+        self.u64 = np.ndarray((CONTROL_BYTES // 8,), dtype=np.uint64, buffer=region.buf)
+        self.f32 = np.ndarray((CONTROL_BYTES // 4,), dtype=np.float32, buffer=region.buf)
+
+    def get(self, index: int) -> int:
+        return int(self.u32[index])
+
+    def set(self, index: int, value: int) -> None:
+        self.u32[index] = value
+
+    def fence(self, slot: int) -> int:
+        return int(self.u64[(SLOT_BASE_BYTES + slot * SLOT_BYTES) // 8])
+
+    def finish(self, slot: int, ticket: int, status: int, inference_ms: float, batch_size: int) -> None:
+        base = (SLOT_BASE_BYTES + slot * SLOT_BYTES) // 4
+        self.f32[base + 2] = inference_ms
+        self.u32[base + 3] = batch_size
+        self.u32[base + 4] = status
+        # Fence last: the host reads the slot once it sees ticket + 2. These are plain stores with no release fence,
+        # which only x86 keeps in program order; serve refuses to run elsewhere.
+        self.u64[(SLOT_BASE_BYTES + slot * SLOT_BYTES) // 8] = ticket + 2
+
+    def release(self) -> None:
+        del self.u32, self.u64, self.f32
+
+
+def resolve_input_shape(session: ort.InferenceSession, control: Control) -> Tuple[Tuple[int, int, int], bool]:
+    """Returns (channels, height, width) and whether the batch dimension is symbolic."""
+    shape = session.get_inputs()[0].shape
+    if len(shape) != 4:
+        raise ValueError(f"Expected one NCHW input, got shape {shape}.")
+
+    requested = (control.get(U32_INPUT_CHANNELS), control.get(U32_HEIGHT), control.get(U32_WIDTH))
+    resolved = []
+    for dim, value in zip(shape[1:], requested):
+        if isinstance(dim, int) and dim > 0:
+            resolved.append(dim)
+        elif value > 0:
+            resolved.append(value)
+        else:
+            raise ValueError(f"Input shape {shape} is symbolic and the game requested no resolution.")
+
+    dynamic_batch = not (isinstance(shape[0], int) and shape[0] > 0)
+    return (resolved[0], resolved[1], resolved[2]), dynamic_batch
+
+
+def wait_for_host(control: Control, state: int, parent_pid: Optional[int], timeout: float) -> bool:
+    deadline = time.perf_counter() + timeout
+    while control.get(U32_HOST_STATE) != state:
+        if control.get(U32_HOST_STATE) == HOST_STOPPING or not parent_alive(parent_pid) or time.perf_counter() > deadline:
+            return False
+        time.sleep(0.001)
+    return True
+
+
+def serve(args: argparse.Namespace, control_region: shared_memory.SharedMemory) -> int:
+    control = Control(control_region)
+    data_region: Optional[shared_memory.SharedMemory] = None
+    inputs: List[np.ndarray] = []
+    outputs: List[np.ndarray] = []
+    try:
+        if control.get(U32_MAGIC) != MAGIC or control.get(U32_VERSION) != VERSION:
+            print(f"[FAIL] '{args.control}' is not a version {VERSION} style transfer worker region.")
+            control.set(U32_WORKER_STATE, WORKER_FAILED)
+            return 1
+        if platform.machine().lower() not in X86_MACHINES:
+            print(f"[FAIL] The worker publishes slots with plain stores, which only x86 keeps ordered; {platform.machine()} is not supported.")
+            control.set(U32_WORKER_STATE, WORKER_FAILED)
+            return 1
+
+        options = ort.SessionOptions()
+        options.graph_optimization_level = ort.GraphOptimizationLevel.ORT_ENABLE_ALL
+        if args.threads > 0:
+            options.intra_op_num_threads = args.threads
+        session = ort.InferenceSession(args.model, options, providers=["CPUExecutionProvider"])
+        input_name = session.get_inputs()[0].name
+        output_name = session.get_outputs()[0].name
+
+        (channels, height, width), dynamic_batch = resolve_input_shape(session, control)
+        probe = session.run([output_name], {input_name: np.zeros((1, channels, height, width), dtype=np.float32)})[0]
+        if probe.ndim != 4:
+            raise ValueError(f"Expected one NCHW output, got shape {probe.shape}.")
+        _, out_channels, out_height, out_width = probe.shape
+
+        control.set(U32_INPUT_CHANNELS, channels)
+        control.set(U32_WIDTH, width)
+        control.set(U32_HEIGHT, height)
+        control.set(U32_OUTPUT_CHANNELS, out_channels)
+        control.set(U32_OUTPUT_WIDTH, out_width)
+        control.set(U32_OUTPUT_HEIGHT, out_height)
+        control.set(U32_WORKER_STATE, WORKER_SHAPE_READY)
+
+        if not wait_for_host(control, HOST_DATA_READY, args.parent_pid, args.startup_timeout):
+            print("[FAIL] The game did not create the tensor slots.")
+            control.set(U32_WORKER_STATE, WORKER_FAILED)
+            return 1
+
+        slot_count = min(control.get(U32_SLOT_COUNT), MAX_SLOTS)
+        max_batch = max(control.get(U32_MAX_BATCH), 1) if dynamic_batch else 1
+        input_bytes = int(control.u64[U64_INPUT_SLOT_BYTES])
+        output_bytes = int(control.u64[U64_OUTPUT_SLOT_BYTES])
+        data_region = attach(args.data)
+        for slot in range(slot_count):
+            offset = slot * (input_bytes + output_bytes)
+            inputs.append(np.ndarray((1, channels, height, width), dtype=np.float32, buffer=data_region.buf, offset=offset))
+            outputs.append(np.ndarray((1, out_channels, out_height, out_width), dtype=np.float32,
+                                      buffer=data_region.buf, offset=offset + input_bytes))
+
+        # Single frames run in place: the session reads the input slot and writes the output slot directly.
+        binding = session.io_binding()
+        control.set(U32_WORKER_STATE, WORKER_READY)
+        print(f"[INFO] Serving '{os.path.basename(args.model)}' at {width}x{height}, {slot_count} slots, "
+              f"batches of up to {max_batch}.")
+        sys.stdout.flush()
+
+        ticket = 0
+        last_work = time.perf_counter()
+        next_parent_check = last_work
+        while True:
+            slot = ticket % slot_count
+            if control.fence(slot) != ticket + 1:
+                now = time.perf_counter()
+                if control.get(U32_HOST_STATE) == HOST_STOPPING:
+                    break
+                if now >= next_parent_check:
+                    next_parent_check = now + PARENT_CHECK_SECONDS
+                    if not parent_alive(args.parent_pid):
+                        print("[WARN] The game exited; stopping.")
+                        break
+                if now - last_work > SPIN_SECONDS:
+                    time.sleep(IDLE_SLEEP_SECONDS)
+                continue
+
+            # Batch the consecutive tickets that are already submitted.
+            batch = [ticket]
+            while len(batch) < min(max_batch, slot_count):
+                next_ticket = ticket + len(batch)
+                if control.fence(next_ticket % slot_count) != next_ticket + 1:
+                    break
+                batch.append(next_ticket)
+            slots = [t % slot_count for t in batch]
+
+            status = STATUS_OK
+            start = time.perf_counter()
+            try:
+                if len(slots) == 1:
+                    binding.bind_cpu_input(input_name, inputs[slot])
+                    binding.bind_output(output_name, "cpu", 0, np.float32, list(outputs[slot].shape),
+                                        outputs[slot].ctypes.data)
+                    session.run_with_iobinding(binding)
+                else:
+                    result = session.run([output_name], {input_name: np.concatenate([inputs[s] for s in slots])})[0]
+                    for index, s in enumerate(slots):
+                        outputs[s][0] = result[index]
+            except Exception as error:  # noqa: BLE001 - a failed run fails its requests, not the worker
+                print(f"[WARN] Inference failed: {error}")
+                status = STATUS_FAILED
+            inference_ms = (time.perf_counter() - start) * 1000.0
+
+            for t, s in zip(batch, slots):
+                control.finish(s, t, status, inference_ms, len(batch))
+            ticket += len(batch)
+            last_work = time.perf_counter()
+
+        control.set(U32_WORKER_STATE, WORKER_EXITED)
+        return 0
+    except Exception as error:  # noqa: BLE001 - report any startup failure to the game
+        print(f"[FAIL] {error}")
+        control.set(U32_WORKER_STATE, WORKER_FAILED)
+        return 1
+    finally:
+        # Views must go before their regions can close.
+        inputs.clear()
+        outputs.clear()
+        control.release()
+        if data_region is not None:
+            data_region.close()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description="Serves one ONNX style model to the game over shared memory on ONNX Runtime CPU. "
+                    "Started by FStyleTransferWorkerModel; not meant to be run by hand.")
+    parser.add_argument("--control", required=True, help="Name of the control region the game created.")
+    parser.add_argument("--data", required=True, help="Name of the tensor slot region the game creates once the shapes are known.")
+    parser.add_argument("--model", required=True, help="ONNX model to serve.")
+    parser.add_argument("--threads", type=int, default=0, help="Intra-op threads, 0 for the runtime default (default: %(default)s).")
+    parser.add_argument("--parent-pid", type=int, help="Exit when this process does.")
+    parser.add_argument("--startup-timeout", type=float, default=30.0,
+                        help="Seconds to wait for the game to create the tensor slots (default: %(default)s).")
+    args = parser.parse_args()
+
+    try:
+        control_region = attach(args.control)
+    except FileNotFoundError:
+        print(f"[FAIL] Shared memory '{args.control}' does not exist.")
+        raise SystemExit(1)
+
+    try:
+        code = serve(args, control_region)
+    finally:
+        control_region.close()
+    raise SystemExit(code)
+
+
+if __name__ == "__main__":
+    main()
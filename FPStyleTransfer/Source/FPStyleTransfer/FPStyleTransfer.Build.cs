@@ -50,6 +50,7 @@ public class FPStyleTransfer : ModuleRules
 										"RHI",
 										"RHICore",
 										"D3D12RHI",
+										"Json",
 										"NNE",
 										"NNERuntimeORT",
 										"NNERuntimeRDG"
@@ -3,6 +3,9 @@
 #include "FPStyleTransfer.h"
 #include "Modules/ModuleManager.h"
 #include "RealtimeStyleTransferViewExtension.h"
+#include "StyleTransferInferenceService.h"
+#include "StyleTransferMemory.h"
+#include "StyleTransferPrecache.h"
 #include "Misc/Paths.h"
 #include "ShaderCore.h"
 #include "Misc/CoreDelegates.h"
@@ -13,6 +16,7 @@ void FPStyleTransferModule::StartupModule()
 {
 	const FString ShaderDir = FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders"));
 	AddShaderSourceDirectoryMapping(TEXT("/FPStyleTransfer"), ShaderDir);
+	StyleTransferMemory::Startup();
 
 	if (!PostEngineInitHandle.IsValid())
 	{
@@ -33,6 +37,9 @@ void FPStyleTransferModule::ShutdownModule()
 	}
 
 	RealtimeStyleTransferViewExtension.Reset();
+	FStyleTransferCpuInferenceService::Shutdown();
+	StyleTransferMemory::Shutdown();
+	StyleTransferPrecache::Shutdown();
 }
 
 void FPStyleTransferModule::RegisterViewExtension()
@@ -41,6 +48,7 @@ void FPStyleTransferModule::RegisterViewExtension()
 	{
 		UE_LOG(LogTemp, Log, TEXT("Registering FRealtimeStyleTransferViewExtension."));
 		RealtimeStyleTransferViewExtension = FSceneViewExtensions::NewExtension<FRealtimeStyleTransferViewExtension>();
+		StyleTransferPrecache::PrecacheShaders();
 	}
 }
  
@@ -6,6 +6,8 @@
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/InputSettings.h"
 
 //////////////////////////////////////////////////////////////////////////
@@ -35,6 +37,9 @@ AFPStyleTransferCharacter::AFPStyleTransferCharacter()
 	Mesh1P->CastShadow = false;
 	Mesh1P->SetRelativeRotation(FRotator(1.9f, -19.19f, 5.2f));
 	Mesh1P->SetRelativeLocation(FVector(-0.5f, -4.4f, -155.7f));
+	// Tags the arms in custom stencil so r.RealtimeStyleTransfer.Mask can leave them unstylized.
+	Mesh1P->SetRenderCustomDepth(true);
+	Mesh1P->SetCustomDepthStencilValue(1);
 
 }
 
@@ -47,6 +52,57 @@ void AFPStyleTransferCharacter::BeginPlay()
 // Called every frame
 void AFPStyleTransferCharacter::Tick(float DeltaTime) {
 	Super::Tick(DeltaTime);
+
+	// Input of this frame has been processed; replay the actions recorded with it.
+	const EStyleTransferInputAction Actions = InputRecorder.AdvanceFrame();
+	if (EnumHasAnyFlags(Actions, EStyleTransferInputAction::JumpPressed))
+	{
+		Jump();
+	}
+	if (EnumHasAnyFlags(Actions, EStyleTransferInputAction::JumpReleased))
+	{
+		StopJumping();
+	}
+	if (EnumHasAnyFlags(Actions, EStyleTransferInputAction::PrimaryAction))
+	{
+		OnPrimaryAction();
+	}
+}
+
+void AFPStyleTransferCharacter::StartInputRecording(float FramesPerSecond)
+{
+	const FRotator ControlRotation = Controller ? Controller->GetControlRotation() : GetActorRotation();
+	InputRecorder.StartRecording(GetActorLocation(), ControlRotation, UWorld::RemovePIEPrefix(GetWorld()->GetMapName()), 1.0 / FMath::Max(FramesPerSecond, 1.0f));
+}
+
+TSharedPtr<FStyleTransferInputRecording> AFPStyleTransferCharacter::StopInputRecording()
+{
+	return InputRecorder.StopRecording();
+}
+
+void AFPStyleTransferCharacter::StartInputPlayback(FStyleTransferInputRecordingPtr Recording)
+{
+	if (Recording.IsValid())
+	{
+		TeleportToInputStart(*Recording);
+		InputRecorder.StartPlayback(MoveTemp(Recording));
+	}
+}
+
+void AFPStyleTransferCharacter::StopInputPlayback()
+{
+	InputRecorder.StopPlayback();
+}
+
+void AFPStyleTransferCharacter::TeleportToInputStart(const FStyleTransferInputRecording& Recording)
+{
+	StopJumping();
+	GetCharacterMovement()->StopMovementImmediately();
+	SetActorLocationAndRotation(Recording.StartLocation, FRotator(0.0f, Recording.StartControlRotation.Yaw, 0.0f), false, nullptr, ETeleportType::ResetPhysics);
+	if (Controller)
+	{
+		Controller->SetControlRotation(Recording.StartControlRotation);
+	}
 }
 
 
@@ -58,11 +114,11 @@ void AFPStyleTransferCharacter::SetupPlayerInputComponent(class UInputComponent*
 	check(PlayerInputComponent);
 
 	// Bind jump events
-	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
-	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ACharacter::StopJumping);
+	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &AFPStyleTransferCharacter::OnJumpPressed);
+	PlayerInputComponent->BindAction("Jump", IE_Released, this, &AFPStyleTransferCharacter::OnJumpReleased);
 
 	// Bind fire event
-	PlayerInputComponent->BindAction("PrimaryAction", IE_Pressed, this, &AFPStyleTransferCharacter::OnPrimaryAction);
+	PlayerInputComponent->BindAction("PrimaryAction", IE_Pressed, this, &AFPStyleTransferCharacter::OnPrimaryActionPressed);
 
 	// Enable touchscreen input
 	EnableTouchscreenMovement(PlayerInputComponent);
@@ -74,8 +130,8 @@ void AFPStyleTransferCharacter::SetupPlayerInputComponent(class UInputComponent*
 	// We have 2 versions of the rotation bindings to handle different kinds of devices differently
 	// "Mouse" versions handle devices that provide an absolute delta, such as a mouse.
 	// "Gamepad" versions are for devices that we choose to treat as a rate of change, such as an analog joystick
-	PlayerInputComponent->BindAxis("Turn Right / Left Mouse", this, &APawn::AddControllerYawInput);
-	PlayerInputComponent->BindAxis("Look Up / Down Mouse", this, &APawn::AddControllerPitchInput);
+	PlayerInputComponent->BindAxis("Turn Right / Left Mouse", this, &AFPStyleTransferCharacter::Turn);
+	PlayerInputComponent->BindAxis("Look Up / Down Mouse", this, &AFPStyleTransferCharacter::LookUp);
 	PlayerInputComponent->BindAxis("Turn Right / Left Gamepad", this, &AFPStyleTransferCharacter::TurnAtRate);
 	PlayerInputComponent->BindAxis("Look Up / Down Gamepad", this, &AFPStyleTransferCharacter::LookUpAtRate);
 }
@@ -86,6 +142,30 @@ void AFPStyleTransferCharacter::OnPrimaryAction()
 	OnItemUsed.Broadcast();
 }
 
+void AFPStyleTransferCharacter::OnPrimaryActionPressed()
+{
+	if (InputRecorder.FilterAction(EStyleTransferInputAction::PrimaryAction))
+	{
+		OnPrimaryAction();
+	}
+}
+
+void AFPStyleTransferCharacter::OnJumpPressed()
+{
+	if (InputRecorder.FilterAction(EStyleTransferInputAction::JumpPressed))
+	{
+		Jump();
+	}
+}
+
+void AFPStyleTransferCharacter::OnJumpReleased()
+{
+	if (InputRecorder.FilterAction(EStyleTransferInputAction::JumpReleased))
+	{
+		StopJumping();
+	}
+}
+
 void AFPStyleTransferCharacter::BeginTouch(const ETouchIndex::Type FingerIndex, const FVector Location)
 {
 	if (TouchItem.bIsPressed == true)
@@ -94,7 +174,7 @@ void AFPStyleTransferCharacter::BeginTouch(const ETouchIndex::Type FingerIndex,
 	}
 	if ((FingerIndex == TouchItem.FingerIndex) && (TouchItem.bMoved == false))
 	{
-		OnPrimaryAction();
+		OnPrimaryActionPressed();
 	}
 	TouchItem.bIsPressed = true;
 	TouchItem.FingerIndex = FingerIndex;
@@ -151,6 +231,7 @@ void AFPStyleTransferCharacter::EndTouch(const ETouchIndex::Type FingerIndex, co
 
 void AFPStyleTransferCharacter::MoveForward(float Value)
 {
+	Value = InputRecorder.FilterAxis(EStyleTransferInputAxis::MoveForward, Value);
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -160,6 +241,7 @@ void AFPStyleTransferCharacter::MoveForward(float Value)
 
 void AFPStyleTransferCharacter::MoveRight(float Value)
 {
+	Value = InputRecorder.FilterAxis(EStyleTransferInputAxis::MoveRight, Value);
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -170,13 +252,23 @@ void AFPStyleTransferCharacter::MoveRight(float Value)
 void AFPStyleTransferCharacter::TurnAtRate(float Rate)
 {
 	// calculate delta for this frame from the rate information
-	AddControllerYawInput(Rate * TurnRateGamepad * GetWorld()->GetDeltaSeconds());
+	AddControllerYawInput(InputRecorder.FilterAxis(EStyleTransferInputAxis::Turn, Rate * TurnRateGamepad * GetWorld()->GetDeltaSeconds()));
 }
 
 void AFPStyleTransferCharacter::LookUpAtRate(float Rate)
 {
 	// calculate delta for this frame from the rate information
-	AddControllerPitchInput(Rate * TurnRateGamepad * GetWorld()->GetDeltaSeconds());
+	AddControllerPitchInput(InputRecorder.FilterAxis(EStyleTransferInputAxis::LookUp, Rate * TurnRateGamepad * GetWorld()->GetDeltaSeconds()));
+}
+
+void AFPStyleTransferCharacter::Turn(float Value)
+{
+	AddControllerYawInput(InputRecorder.FilterAxis(EStyleTransferInputAxis::Turn, Value));
+}
+
+void AFPStyleTransferCharacter::LookUp(float Value)
+{
+	AddControllerPitchInput(InputRecorder.FilterAxis(EStyleTransferInputAxis::LookUp, Value));
 }
 
 bool AFPStyleTransferCharacter::EnableTouchscreenMovement(class UInputComponent* PlayerInputComponent)
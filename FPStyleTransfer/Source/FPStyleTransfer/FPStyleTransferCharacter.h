@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "StyleTransferInputRecording.h"
 #include "FPStyleTransferCharacter.generated.h"
 
 class UInputComponent;
@@ -45,11 +46,32 @@ public:
 	UPROPERTY(EditAnywhere)
 	UTexture2D* MTexture;
 
+	/** Starts recording this character's input from where it stands, at a fixed timestep of 1 / FramesPerSecond. */
+	void StartInputRecording(float FramesPerSecond = 60.0f);
+
+	/** Stops recording and returns the recorded path, or null when not recording. */
+	TSharedPtr<FStyleTransferInputRecording> StopInputRecording();
+
+	/** Moves to the start of Recording and replays it, ignoring live input until the last frame. */
+	void StartInputPlayback(FStyleTransferInputRecordingPtr Recording);
+	void StopInputPlayback();
+
+	/** Puts the character and its controller where Recording starts, at rest. */
+	void TeleportToInputStart(const FStyleTransferInputRecording& Recording);
+
+	bool IsRecordingInput() const { return InputRecorder.IsRecording(); }
+	bool IsPlayingInput() const { return InputRecorder.IsPlaying(); }
+
 protected:
 	
 	/** Fires a projectile. */
 	void OnPrimaryAction();
 
+	/** Input handlers for the bound actions. They go through the input recorder before acting. */
+	void OnPrimaryActionPressed();
+	void OnJumpPressed();
+	void OnJumpReleased();
+
 	/** Handles moving forward/backward */
 	void MoveForward(float Val);
 
@@ -68,6 +90,12 @@ protected:
 	 */
 	void LookUpAtRate(float Rate);
 
+	/** Handles devices that provide an absolute yaw delta, such as a mouse */
+	void Turn(float Value);
+
+	/** Handles devices that provide an absolute pitch delta, such as a mouse */
+	void LookUp(float Value);
+
 	struct TouchData
 	{
 		TouchData() { bIsPressed = false;Location=FVector::ZeroVector;}
@@ -80,6 +108,8 @@ protected:
 	void EndTouch(const ETouchIndex::Type FingerIndex, const FVector Location);
 	void TouchUpdate(const ETouchIndex::Type FingerIndex, const FVector Location);
 	TouchData	TouchItem;
+
+	FStyleTransferInputRecorder InputRecorder;
 	
 protected:
 	// APawn interface
@@ -1,66 +1,408 @@
 #include "MyNeuralNetwork.h"
 
+#include "Algo/AllOf.h"
 #include "NNE.h"
 #include "NNEModelData.h"
 #include "NNERuntimeRDG.h"
+#include "StyleTransferMemory.h"
+#include "StyleTransferOnnx.h"
+#include "StyleTransferPasses.h"
+#include "HAL/PlatformFileManager.h"
+#include "Async/MappedFileHandle.h"
 #include "Logging/LogMacros.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectGlobals.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferNNE, Log, All);
 
 namespace
 {
 	constexpr TCHAR DefaultRuntimeName[] = TEXT("NNERuntimeORTDml");
+
+	// Written by Scripts/quantize_onnx_model.py when the model's image tensors are 8-bit.
+	constexpr TCHAR InputScaleKey[] = TEXT("style_transfer.input_scale");
+	constexpr TCHAR InputZeroPointKey[] = TEXT("style_transfer.input_zero_point");
+	constexpr TCHAR OutputScaleKey[] = TEXT("style_transfer.output_scale");
+	constexpr TCHAR OutputZeroPointKey[] = TEXT("style_transfer.output_zero_point");
+	// Number of styles a style id input selects from; the id tensor's shape does not say.
+	constexpr TCHAR StyleCountKey[] = TEXT("style_transfer.style_count");
+
+	/**
+	 * Samples physical memory use while a style loads, so asset and loose-file loads can be compared. The figures are
+	 * process-wide, so a load that overlaps package streaming is logged without them (INDEX_NONE) rather than with
+	 * another load's allocations folded in.
+	 */
+	struct FLoadMemoryProbe
+	{
+		double StartSeconds = FPlatformTime::Seconds();
+		uint64 BaselineBytes = FPlatformMemory::GetStats().UsedPhysical;
+		uint64 PeakBytes = BaselineBytes;
+		bool bIsolated = !IsAsyncLoading();
+
+		void Sample()
+		{
+			PeakBytes = FMath::Max<uint64>(PeakBytes, FPlatformMemory::GetStats().UsedPhysical);
+			bIsolated &= !IsAsyncLoading();
+		}
+
+		/** Logs the load and records its peak and resident growth on Proxy. */
+		void Log(const TCHAR* Source, const FString& Name, FStyleTransferProxy& Proxy)
+		{
+			Sample();
+			const double LoadMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+			if (!bIsolated)
+			{
+				Proxy.LoadPeakBytes = INDEX_NONE;
+				Proxy.LoadResidentBytes = INDEX_NONE;
+				UE_LOG(LogStyleTransferNNE, Log, TEXT("Loaded '%s' (%.1f MB model) from %s in %.1f ms: memory not measured, packages were streaming."),
+					*Name,
+					Proxy.ModelSizeBytes / (1024.0 * 1024.0),
+					Source,
+					LoadMs);
+				return;
+			}
+
+			Proxy.LoadPeakBytes = static_cast<int64>(PeakBytes - BaselineBytes);
+			Proxy.LoadResidentBytes = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(BaselineBytes);
+			UE_LOG(LogStyleTransferNNE, Log, TEXT("Loaded '%s' (%.1f MB model) from %s in %.1f ms: peak +%.1f MB, resident +%.1f MB."),
+				*Name,
+				Proxy.ModelSizeBytes / (1024.0 * 1024.0),
+				Source,
+				LoadMs,
+				Proxy.LoadPeakBytes / (1024.0 * 1024.0),
+				Proxy.LoadResidentBytes / (1024.0 * 1024.0));
+		}
+	};
+
+	bool IsQuantizedTensorType(ENNETensorDataType DataType)
+	{
+		return DataType == ENNETensorDataType::UInt8 || DataType == ENNETensorDataType::Int8;
+	}
+
+	bool IsSupportedImageTensorType(ENNETensorDataType DataType)
+	{
+		return DataType == ENNETensorDataType::Float || DataType == ENNETensorDataType::Half || IsQuantizedTensorType(DataType);
+	}
+
+	/** Records an instance of Proxy's model (or, for conv nets, the proxy itself) with the memory accounting. */
+	void TrackInstanceMemory(const TWeakPtr<const void, ESPMode::ThreadSafe>& Owner, const FStyleTransferProxy& Proxy, uint32 BatchSize, int64 CpuBytes)
+	{
+		FStyleTransferMemoryEntry Entry;
+		Entry.Kind = EStyleTransferMemoryKind::Instance;
+		Entry.StyleName = Proxy.ModelName;
+		Entry.RuntimeName = Proxy.RuntimeName;
+		Entry.Resolution = Proxy.InputResolution;
+		Entry.BatchSize = BatchSize;
+		Entry.CpuBytes = CpuBytes;
+		Entry.FrameGpuBytes = StyleTransferPasses::GetFrameResourceBytes(Proxy, BatchSize);
+		StyleTransferMemory::Track(Owner, Entry);
+	}
+
+	void TrackModelMemory(const TWeakPtr<const void, ESPMode::ThreadSafe>& Owner, const FStyleTransferProxy& Proxy, int64 CpuBytes, int64 GpuBytes)
+	{
+		FStyleTransferMemoryEntry Entry;
+		Entry.Kind = EStyleTransferMemoryKind::Model;
+		Entry.StyleName = Proxy.ModelName;
+		Entry.RuntimeName = Proxy.RuntimeName;
+		Entry.Resolution = Proxy.InputResolution;
+		Entry.CpuBytes = CpuBytes;
+		Entry.GpuBytes = GpuBytes;
+		StyleTransferMemory::Track(Owner, Entry);
+	}
+
+	/**
+	 * Scale and zero point for an 8-bit image tensor. Models without metadata fall back to the float convention the
+	 * passes already use: input in 0..1 (scale 1/255) and output in 0..255 (scale 1), offset by 128 for int8.
+	 */
+	FStyleTransferTensorQuantization ResolveQuantization(
+		ENNETensorDataType DataType,
+		const TMap<FString, FString>& Metadata,
+		const TCHAR* ScaleKey,
+		const TCHAR* ZeroPointKey,
+		float DefaultScale,
+		const FString& ModelName)
+	{
+		FStyleTransferTensorQuantization Quantization;
+		Quantization.Scale = DefaultScale;
+		Quantization.ZeroPoint = DataType == ENNETensorDataType::Int8 ? -128 : 0;
+
+		const FString* Scale = Metadata.Find(ScaleKey);
+		const FString* ZeroPoint = Metadata.Find(ZeroPointKey);
+		if (!Scale || !ZeroPoint)
+		{
+			UE_LOG(LogStyleTransferNNE, Warning, TEXT("Model '%s' has an 8-bit tensor but no '%s'/'%s' metadata; assuming scale %f, zero point %d."),
+				*ModelName,
+				ScaleKey,
+				ZeroPointKey,
+				Quantization.Scale,
+				Quantization.ZeroPoint);
+			return Quantization;
+		}
+
+		float ParsedScale = 0.0f;
+		int32 ParsedZeroPoint = 0;
+		if (!LexTryParseString(ParsedScale, **Scale) || ParsedScale <= 0.0f || !LexTryParseString(ParsedZeroPoint, **ZeroPoint))
+		{
+			UE_LOG(LogStyleTransferNNE, Warning, TEXT("Model '%s' has invalid quantization metadata ('%s', '%s'); using defaults."),
+				*ModelName,
+				**Scale,
+				**ZeroPoint);
+			return Quantization;
+		}
+
+		Quantization.Scale = ParsedScale;
+		Quantization.ZeroPoint = ParsedZeroPoint;
+		return Quantization;
+	}
+
+	/**
+	 * Number of styles the style id inputs IdInputs of an ONNX model select from: the StyleCountKey metadata, else the
+	 * row count of the table a Gather looks the id up in (or the depth of a OneHot), through Cast/Reshape/Squeeze nodes.
+	 * Zero when neither is found.
+	 */
+	int32 ResolveIdStyleCount(UNNEModelData* ModelData, TConstArrayView<FString> IdInputs)
+	{
+		if (IdInputs.IsEmpty() || !ModelData->GetFileType().Equals(TEXT("onnx"), ESearchCase::IgnoreCase))
+		{
+			return 0;
+		}
+
+		const auto FileData = ModelData->GetFileData();
+		const TMap<FString, FString> Metadata = StyleTransferOnnx::ReadMetadata(FileData.GetData(), FileData.Num());
+		if (const FString* Value = Metadata.Find(StyleCountKey))
+		{
+			int32 StyleCount = 0;
+			if (LexTryParseString(StyleCount, **Value) && StyleCount > 0)
+			{
+				return StyleCount;
+			}
+			UE_LOG(LogStyleTransferNNE, Warning, TEXT("Model '%s' has invalid '%s' metadata ('%s')."), *ModelData->GetName(), StyleCountKey, **Value);
+		}
+
+		// Without the metadata the graph is parsed once, initializers included.
+		StyleTransferOnnx::FGraph Graph;
+		FString Error;
+		if (!StyleTransferOnnx::ReadGraph(FileData.GetData(), FileData.Num(), Graph, Error))
+		{
+			UE_LOG(LogStyleTransferNNE, Warning, TEXT("Could not read the graph of '%s' to count its styles: %s"), *ModelData->GetName(), *Error);
+			return 0;
+		}
+
+		// Nodes are topologically sorted, so one pass follows the id through every node that carries it.
+		TSet<FString> IdValues(IdInputs);
+		int32 StyleCount = 0;
+		for (const StyleTransferOnnx::FNode& Node : Graph.Nodes)
+		{
+			if (Node.Inputs.IsEmpty() || Node.Outputs.IsEmpty())
+			{
+				continue;
+			}
+
+			const bool bCarriesId = Node.OpType == TEXT("Cast") || Node.OpType == TEXT("Reshape") || Node.OpType == TEXT("Squeeze")
+				|| Node.OpType == TEXT("Unsqueeze") || Node.OpType == TEXT("Flatten") || Node.OpType == TEXT("Identity");
+			if (bCarriesId && IdValues.Contains(Node.Inputs[0]))
+			{
+				IdValues.Add(Node.Outputs[0]);
+			}
+			else if (Node.OpType == TEXT("Gather") && Node.Inputs.Num() >= 2 && IdValues.Contains(Node.Inputs[1]))
+			{
+				if (const StyleTransferOnnx::FTensor* Table = Graph.Initializers.Find(Node.Inputs[0]))
+				{
+					const int64 Axis = Node.GetInt(TEXT("axis"), 0);
+					const int64 Dim = Axis < 0 ? Table->Dims.Num() + Axis : Axis;
+					if (Table->Dims.IsValidIndex(Dim))
+					{
+						StyleCount = FMath::Max(StyleCount, static_cast<int32>(Table->Dims[Dim]));
+					}
+				}
+			}
+			else if (Node.OpType == TEXT("OneHot") && Node.Inputs.Num() >= 2 && IdValues.Contains(Node.Inputs[0]))
+			{
+				const StyleTransferOnnx::FTensor* Depth = Graph.Initializers.Find(Node.Inputs[1]);
+				if (Depth && !Depth->Data.IsEmpty())
+				{
+					StyleCount = FMath::Max(StyleCount, FMath::RoundToInt32(Depth->Data[0]));
+				}
+			}
+		}
+
+		if (StyleCount <= 0)
+		{
+			UE_LOG(LogStyleTransferNNE, Warning, TEXT("Model '%s' takes a style id but its style count is unknown; add '%s' metadata."), *ModelData->GetName(), StyleCountKey);
+		}
+		return StyleCount;
+	}
+
+	FStyleTransferProxyPtr CreateConvNetProxy(UNNEModelData* ModelData)
+	{
+		// Same spatial default as NNE models with symbolic dimensions.
+		constexpr int32 DefaultSpatial = 224;
+
+		if (!ModelData->GetFileType().Equals(TEXT("onnx"), ESearchCase::IgnoreCase))
+		{
+			UE_LOG(LogStyleTransferNNE, Error, TEXT("The built-in executor needs an ONNX model, but '%s' is '%s'."), *ModelData->GetName(), *ModelData->GetFileType());
+			return nullptr;
+		}
+
+		const StyleTransferMemory::FCpuProbe Probe;
+		FStyleTransferConvNetPtr ConvNet;
+		{
+			LLM_SCOPE_BYTAG(StyleTransfer_Models);
+			const auto FileData = ModelData->GetFileData();
+			ConvNet = FStyleTransferConvNet::Create(FileData.GetData(), FileData.Num(), ModelData->GetName());
+		}
+		if (!ConvNet.IsValid())
+		{
+			return nullptr;
+		}
+
+		const FIntPoint DeclaredResolution = ConvNet->GetDeclaredResolution();
+		const bool bDynamicSpatial = DeclaredResolution.X <= 0 || DeclaredResolution.Y <= 0;
+		const FIntPoint InputResolution = bDynamicSpatial ? FIntPoint(DefaultSpatial, DefaultSpatial) : DeclaredResolution;
+		const FIntPoint OutputResolution = ConvNet->GetOutputResolution(InputResolution);
+		if (OutputResolution.X <= 0 || ConvNet->GetOutputChannels() < 3)
+		{
+			UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' must produce a 3 channel image at %dx%d."), *ModelData->GetName(), InputResolution.X, InputResolution.Y);
+			return nullptr;
+		}
+
+		FStyleTransferProxyPtr NewProxy = MakeShared<FStyleTransferProxy, ESPMode::ThreadSafe>();
+		NewProxy->ModelName = ModelData->GetName();
+		NewProxy->RuntimeName = FStyleTransferConvNet::RuntimeName;
+		NewProxy->ConvNet = ConvNet;
+		NewProxy->InputValueScale = StyleTransferPasses::EncodeScale;
+		NewProxy->OutputValueScale = StyleTransferPasses::DecodeScale;
+		NewProxy->InputResolution = InputResolution;
+		NewProxy->OutputResolution = OutputResolution;
+		NewProxy->InputChannels = ConvNet->GetInputChannels();
+		NewProxy->OutputChannels = ConvNet->GetOutputChannels();
+		NewProxy->InputTensorShape = UE::NNE::FTensorShape::Make(TArray<uint32>{ 1u, static_cast<uint32>(NewProxy->InputChannels), static_cast<uint32>(InputResolution.Y), static_cast<uint32>(InputResolution.X) });
+		NewProxy->OutputTensorShape = UE::NNE::FTensorShape::Make(TArray<uint32>{ 1u, static_cast<uint32>(NewProxy->OutputChannels), static_cast<uint32>(OutputResolution.Y), static_cast<uint32>(OutputResolution.X) });
+		NewProxy->ModelSizeBytes = ConvNet->GetParameterBytes();
+		NewProxy->bDynamicSpatial = bDynamicSpatial;
+
+		// The network has no instances; its per-frame activations are accounted to the proxy.
+		TrackModelMemory(ConvNet, *NewProxy, Probe.GetBytes(), ConvNet->GetGpuParameterBytes());
+		TrackInstanceMemory(NewProxy, *NewProxy, 1, 0);
+
+		UE_LOG(LogStyleTransferNNE, Log, TEXT("Initialized style model '%s' (runtime: %s, input: %dx%d, output: %dx%d)."),
+			*ModelData->GetName(),
+			FStyleTransferConvNet::RuntimeName,
+			InputResolution.X,
+			InputResolution.Y,
+			OutputResolution.X,
+			OutputResolution.Y);
+		return NewProxy;
+	}
+}
+
+bool FStyleTransferProxy::CanBatchStyles() const
+{
+	return bDynamicBatch
+		&& IsConditional()
+		&& Algo::AllOf(ConditioningInputs, [](const FStyleTransferConditioningInput& Conditioning) { return Conditioning.bPerFrame; });
+}
+
+bool FStyleTransferProxy::IsQuantized() const
+{
+	return IsQuantizedTensorType(InputDataType) || IsQuantizedTensorType(OutputDataType);
+}
+
+int32 FStyleTransferProxy::GetStyleCount() const
+{
+	int32 StyleCount = 0;
+	for (const FStyleTransferConditioningInput& Conditioning : ConditioningInputs)
+	{
+		// A weight vector spans all styles; an id tensor only selects one, so its count comes from the model.
+		StyleCount = FMath::Max(StyleCount, Conditioning.DataType == ENNETensorDataType::Float ? static_cast<int32>(Conditioning.Shape.Volume()) : IdStyleCount);
+	}
+	return StyleCount;
 }
 
 bool UMyNeuralNetwork::Initialize(UNNEModelData* ModelData, FName RuntimeName)
+{
+	FLoadMemoryProbe Probe;
+	FStyleTransferProxyPtr NewProxy = CreateProxy(ModelData, RuntimeName);
+	if (!NewProxy.IsValid())
+	{
+		return false;
+	}
+	Probe.Log(TEXT("asset"), ModelData->GetName(), *NewProxy);
+
+	Proxy = MoveTemp(NewProxy);
+	return true;
+}
+
+void UMyNeuralNetwork::InitializeFromProxy(FStyleTransferProxyPtr InProxy)
+{
+	Proxy = MoveTemp(InProxy);
+}
+
+FStyleTransferProxyPtr UMyNeuralNetwork::CreateProxy(UNNEModelData* ModelData, FName RuntimeName)
 {
 	if (!ModelData)
 	{
 		UE_LOG(LogStyleTransferNNE, Warning, TEXT("Initialize called with null model data."));
-		return false;
+		return nullptr;
 	}
 
 	const FString RuntimeToUse = RuntimeName.IsNone() ? DefaultRuntimeName : RuntimeName.ToString();
+	if (RuntimeToUse == FStyleTransferConvNet::RuntimeName)
+	{
+		return CreateConvNetProxy(ModelData);
+	}
 
 	TWeakInterfacePtr<INNERuntimeRDG> RuntimeRDG = UE::NNE::GetRuntime<INNERuntimeRDG>(RuntimeToUse);
 	if (!RuntimeRDG.IsValid())
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Unable to find RDG runtime '%s'."), *RuntimeToUse);
-		return false;
+		return nullptr;
 	}
 
 	if (RuntimeRDG->CanCreateModelRDG(ModelData) != INNERuntimeRDG::ECanCreateModelRDGStatus::Ok)
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Runtime '%s' cannot create a model from '%s'."), *RuntimeToUse, *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
 
-	TSharedPtr<UE::NNE::IModelRDG> ModelRDG = RuntimeRDG->CreateModelRDG(ModelData);
+	const StyleTransferMemory::FCpuProbe ModelProbe;
+	TSharedPtr<UE::NNE::IModelRDG> ModelRDG;
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Models);
+		ModelRDG = RuntimeRDG->CreateModelRDG(ModelData);
+	}
+	const int64 ModelCpuBytes = ModelProbe.GetBytes();
 	if (!ModelRDG.IsValid())
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to create RDG model for '%s' using runtime '%s'."), *ModelData->GetName(), *RuntimeToUse);
-		return false;
+		return nullptr;
 	}
 
-	TSharedPtr<UE::NNE::IModelInstanceRDG> ModelInstance = ModelRDG->CreateModelInstanceRDG();
+	const StyleTransferMemory::FCpuProbe InstanceProbe;
+	TSharedPtr<UE::NNE::IModelInstanceRDG> ModelInstance;
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+		ModelInstance = ModelRDG->CreateModelInstanceRDG();
+	}
 	if (!ModelInstance.IsValid())
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to create model instance for '%s'."), *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
 
 	const TConstArrayView<UE::NNE::FTensorDesc> InputDescs = ModelInstance->GetInputTensorDescs();
 	if (InputDescs.IsEmpty())
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' does not expose any input tensors."), *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
 
 	const UE::NNE::FSymbolicTensorShape InputShapeSymbolic = InputDescs[0].GetShape();
 	if (InputShapeSymbolic.Rank() != 4)
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' must expose a 4D input tensor (NCHW)."), *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
 
 	constexpr uint32 DefaultBatch = 1u;
@@ -95,17 +437,62 @@ bool UMyNeuralNetwork::Initialize(UNNEModelData* ModelData, FName RuntimeName)
 
 	const UE::NNE::FTensorShape InputShape = UE::NNE::FTensorShape::Make(ResolvedInputDimensions);
 
-	if (ModelInstance->SetInputTensorShapes({ InputShape }) != UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus::Ok)
+	// Every input after the image carries the style condition (weights or a style id) of multi-style models.
+	TArray<UE::NNE::FTensorShape> InputShapes = { InputShape };
+	TArray<FStyleTransferConditioningInput> ConditioningInputs;
+	TArray<FString> IdInputs;
+	for (int32 InputIndex = 1; InputIndex < InputDescs.Num(); ++InputIndex)
+	{
+		const UE::NNE::FTensorDesc& Desc = InputDescs[InputIndex];
+		const ENNETensorDataType DataType = Desc.GetDataType();
+		if (DataType != ENNETensorDataType::Float && DataType != ENNETensorDataType::Int32 && DataType != ENNETensorDataType::Int64)
+		{
+			UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' input %d ('%s') must be float (style weights) or int32/int64 (style id)."),
+				*ModelData->GetName(),
+				InputIndex,
+				*Desc.GetName());
+			return nullptr;
+		}
+
+		const UE::NNE::FSymbolicTensorShape SymbolicShape = Desc.GetShape();
+		TArray<uint32> Dimensions;
+		Dimensions.SetNum(SymbolicShape.Rank());
+		for (int32 DimIndex = 0; DimIndex < SymbolicShape.Rank(); ++DimIndex)
+		{
+			const int64 DimValue = SymbolicShape.GetData()[DimIndex];
+			Dimensions[DimIndex] = DimValue > 0 ? static_cast<uint32>(DimValue) : DefaultBatch;
+		}
+
+		FStyleTransferConditioningInput& Conditioning = ConditioningInputs.AddDefaulted_GetRef();
+		Conditioning.TensorIndex = InputIndex;
+		Conditioning.DataType = DataType;
+		Conditioning.Shape = UE::NNE::FTensorShape::Make(Dimensions);
+		Conditioning.ElementByteSize = Desc.GetElementByteSize();
+		Conditioning.bPerFrame = SymbolicShape.Rank() >= 2 && SymbolicShape.GetData()[0] <= 0;
+		InputShapes.Add(Conditioning.Shape);
+		if (DataType != ENNETensorDataType::Float)
+		{
+			IdInputs.Add(Desc.GetName());
+		}
+	}
+
+	UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus SetShapesStatus;
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+		SetShapesStatus = ModelInstance->SetInputTensorShapes(InputShapes);
+	}
+	if (SetShapesStatus != UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus::Ok)
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to set input tensor shape for model '%s'."), *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
+	const int64 InstanceCpuBytes = InstanceProbe.GetBytes();
 
 	TConstArrayView<UE::NNE::FTensorShape> OutputShapes = ModelInstance->GetOutputTensorShapes();
 	if (OutputShapes.IsEmpty())
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Unable to resolve output tensor shape for model '%s'."), *ModelData->GetName());
-		return false;
+		return nullptr;
 	}
 
 	const UE::NNE::FTensorShape& RawOutputShape = OutputShapes[0];
@@ -135,22 +522,72 @@ bool UMyNeuralNetwork::Initialize(UNNEModelData* ModelData, FName RuntimeName)
 
 	const UE::NNE::FTensorShape OutputShape = UE::NNE::FTensorShape::Make(ResolvedOutputDimensions);
 
+	// Extra outputs are not consumed but still need a binding for EnqueueRDG.
+	const TConstArrayView<UE::NNE::FTensorDesc> OutputDescs = ModelInstance->GetOutputTensorDescs();
+	TArray<uint64> AuxiliaryOutputBytes;
+	for (int32 OutputIndex = 1; OutputIndex < OutputShapes.Num(); ++OutputIndex)
+	{
+		const uint64 ElementByteSize = OutputDescs.IsValidIndex(OutputIndex) ? OutputDescs[OutputIndex].GetElementByteSize() : sizeof(float);
+		AuxiliaryOutputBytes.Add(FMath::Max<uint64>(OutputShapes[OutputIndex].Volume(), 1) * ElementByteSize);
+	}
+
 	if (ResolvedInputDimensions[1] < 3 || ResolvedOutputDimensions[1] < 3)
 	{
 		UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' must have at least 3 channels on both input and output."), *ModelData->GetName());
-		return false;
+		return nullptr;
+	}
+
+	const ENNETensorDataType InputDataType = InputDescs[0].GetDataType();
+	const ENNETensorDataType OutputDataType = OutputDescs.IsEmpty() ? ENNETensorDataType::Float : OutputDescs[0].GetDataType();
+	if (!IsSupportedImageTensorType(InputDataType) || !IsSupportedImageTensorType(OutputDataType))
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Model '%s' image tensors must be float, half, uint8 or int8 (input %d, output %d)."),
+			*ModelData->GetName(),
+			static_cast<int32>(InputDataType),
+			static_cast<int32>(OutputDataType));
+		return nullptr;
 	}
 
 	FStyleTransferProxyPtr NewProxy = MakeShared<FStyleTransferProxy, ESPMode::ThreadSafe>();
+	NewProxy->ModelName = ModelData->GetName();
+	NewProxy->RuntimeName = RuntimeToUse;
+	NewProxy->Model = ModelRDG;
 	NewProxy->ModelInstance = ModelInstance;
+	NewProxy->InputValueScale = StyleTransferPasses::EncodeScale;
+	NewProxy->OutputValueScale = StyleTransferPasses::DecodeScale;
 	NewProxy->InputResolution = FIntPoint(ResolvedInputDimensions[3], ResolvedInputDimensions[2]);
 	NewProxy->OutputResolution = FIntPoint(ResolvedOutputDimensions[3], ResolvedOutputDimensions[2]);
 	NewProxy->InputChannels = static_cast<int32>(ResolvedInputDimensions[1]);
 	NewProxy->OutputChannels = static_cast<int32>(ResolvedOutputDimensions[1]);
 	NewProxy->InputTensorShape = InputShape;
 	NewProxy->OutputTensorShape = OutputShape;
+	NewProxy->InputDataType = InputDataType;
+	NewProxy->OutputDataType = OutputDataType;
+	NewProxy->InputElementByteSize = InputDescs[0].GetElementByteSize();
+	NewProxy->OutputElementByteSize = OutputDescs.IsEmpty() ? sizeof(float) : OutputDescs[0].GetElementByteSize();
+	if (IsQuantizedTensorType(InputDataType))
+	{
+		NewProxy->InputQuantization = ResolveImageQuantization(ModelData, InputDataType, true);
+	}
+	if (IsQuantizedTensorType(OutputDataType))
+	{
+		NewProxy->OutputQuantization = ResolveImageQuantization(ModelData, OutputDataType, false);
+	}
+	NewProxy->ModelSizeBytes = ModelData->GetFileData().Num();
+	NewProxy->bDynamicBatch = InputShapeSymbolic.GetData()[0] <= 0;
+	NewProxy->bDynamicSpatial = InputShapeSymbolic.GetData()[2] <= 0 && InputShapeSymbolic.GetData()[3] <= 0;
+	NewProxy->ConditioningInputs = MoveTemp(ConditioningInputs);
+	NewProxy->IdStyleCount = ResolveIdStyleCount(ModelData, IdInputs);
+	NewProxy->AuxiliaryOutputBytes = MoveTemp(AuxiliaryOutputBytes);
+	NewProxy->StyleWeights.SetNumZeroed(NewProxy->GetStyleCount());
+	if (!NewProxy->StyleWeights.IsEmpty())
+	{
+		NewProxy->StyleWeights[0] = 1.0f;
+	}
 
-	Proxy = MoveTemp(NewProxy);
+	// RDG runtimes upload the weights to the GPU; the serialized model size is the estimate.
+	TrackModelMemory(ModelRDG, *NewProxy, ModelCpuBytes, NewProxy->ModelSizeBytes);
+	TrackInstanceMemory(ModelInstance, *NewProxy, 1, InstanceCpuBytes);
 
 	UE_LOG(LogStyleTransferNNE, Log, TEXT("Initialized style model '%s' (runtime: %s, NCHW input: %u x %u x %u x %u)."),
 		*ModelData->GetName(),
@@ -160,5 +597,222 @@ bool UMyNeuralNetwork::Initialize(UNNEModelData* ModelData, FName RuntimeName)
 		ResolvedInputDimensions[2],
 		ResolvedInputDimensions[3]);
 
-	return true;
+	if (NewProxy->IsConditional())
+	{
+		UE_LOG(LogStyleTransferNNE, Log, TEXT("Model '%s' is conditional: %d style(s) selected through %d extra input tensor(s)."),
+			*ModelData->GetName(),
+			NewProxy->GetStyleCount(),
+			NewProxy->ConditioningInputs.Num());
+	}
+
+	if (NewProxy->IsQuantized())
+	{
+		UE_LOG(LogStyleTransferNNE, Log, TEXT("Model '%s' has quantized image tensors: input type %d (scale %f, zero point %d), output type %d (scale %f, zero point %d)."),
+			*ModelData->GetName(),
+			static_cast<int32>(InputDataType),
+			NewProxy->InputQuantization.Scale,
+			NewProxy->InputQuantization.ZeroPoint,
+			static_cast<int32>(OutputDataType),
+			NewProxy->OutputQuantization.Scale,
+			NewProxy->OutputQuantization.ZeroPoint);
+	}
+
+	return NewProxy;
+}
+
+FStyleTransferProxyPtr UMyNeuralNetwork::CreateProxyFromFile(const FString& FilePath, FName RuntimeName)
+{
+	check(IsInGameThread());
+
+	FLoadMemoryProbe Probe;
+	UNNEModelData* TransientModelData = CreateTransientModelData(FilePath);
+	if (!TransientModelData)
+	{
+		return nullptr;
+	}
+	Probe.Sample();
+
+	FStyleTransferProxyPtr NewProxy = CreateProxy(TransientModelData, RuntimeName);
+	Probe.Sample();
+
+	ReleaseTransientModelData(TransientModelData);
+
+	if (NewProxy.IsValid())
+	{
+		Probe.Log(TEXT("mapped file"), FilePath, *NewProxy);
+	}
+	return NewProxy;
+}
+
+UNNEModelData* UMyNeuralNetwork::CreateTransientModelData(const FString& FilePath)
+{
+	check(IsInGameThread());
+
+	TUniquePtr<IMappedFileHandle> MappedFile(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile.IsValid() ? MappedFile->MapRegion() : nullptr);
+	if (!MappedRegion.IsValid())
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Unable to memory-map '%s'. Loose models must be staged outside the pak (DirectoriesToAlwaysStageAsNonUFS)."), *FilePath);
+		return nullptr;
+	}
+
+	// NNE runtimes only take a UNNEModelData, which owns its bytes, so Init copies the mapped pages into a heap buffer and
+	// the mapping is closed on return. No runtime consumes the mapping itself: the load peak is at least an asset load's
+	// (mapped pages, this copy and the runtime's model coexist), and the only saving is that the copy is freed once the
+	// runtime model exists (ReleaseTransientModelData) instead of staying resident with the asset.
+	UNNEModelData* ModelData = NewObject<UNNEModelData>(GetTransientPackage(), FName(*FPaths::GetBaseFilename(FilePath)), RF_Transient);
+	ModelData->Init(FPaths::GetExtension(FilePath), TConstArrayView64<uint8>(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize()));
+	return ModelData;
+}
+
+void UMyNeuralNetwork::ReleaseTransientModelData(UNNEModelData* ModelData)
+{
+	if (ModelData)
+	{
+		// Re-initializing with an empty buffer frees the file data and cached runtime data now rather than at the next GC.
+		ModelData->Init(ModelData->GetFileType(), TConstArrayView64<uint8>());
+		ModelData->MarkAsGarbage();
+	}
+}
+
+FStyleTransferTensorQuantization UMyNeuralNetwork::ResolveImageQuantization(UNNEModelData* ModelData, ENNETensorDataType DataType, bool bInput)
+{
+	TMap<FString, FString> Metadata;
+	if (ModelData->GetFileType().Equals(TEXT("onnx"), ESearchCase::IgnoreCase))
+	{
+		const auto FileData = ModelData->GetFileData();
+		Metadata = StyleTransferOnnx::ReadMetadata(FileData.GetData(), FileData.Num());
+	}
+
+	return bInput
+		? ResolveQuantization(DataType, Metadata, InputScaleKey, InputZeroPointKey, 1.0f / 255.0f, ModelData->GetName())
+		: ResolveQuantization(DataType, Metadata, OutputScaleKey, OutputZeroPointKey, 1.0f, ModelData->GetName());
+}
+
+FStyleTransferProxyPtr UMyNeuralNetwork::CreateResizedProxy(const FStyleTransferProxy& Proxy, FIntPoint Resolution)
+{
+	if (!Proxy.bDynamicSpatial || Resolution.X <= 0 || Resolution.Y <= 0)
+	{
+		return nullptr;
+	}
+
+	// The built-in executor has no instances; the proxy only records the resolution it runs at.
+	if (Proxy.ConvNet.IsValid())
+	{
+		const FIntPoint OutputResolution = Proxy.ConvNet->GetOutputResolution(Resolution);
+		if (OutputResolution.X <= 0)
+		{
+			UE_LOG(LogStyleTransferNNE, Error, TEXT("Resolution %dx%d is too small for the network."), Resolution.X, Resolution.Y);
+			return nullptr;
+		}
+
+		FStyleTransferProxyPtr NewProxy = MakeShared<FStyleTransferProxy, ESPMode::ThreadSafe>(Proxy);
+		NewProxy->InputResolution = Resolution;
+		NewProxy->OutputResolution = OutputResolution;
+		NewProxy->InputTensorShape = UE::NNE::FTensorShape::Make(TArray<uint32>{ 1u, static_cast<uint32>(Proxy.InputChannels), static_cast<uint32>(Resolution.Y), static_cast<uint32>(Resolution.X) });
+		NewProxy->OutputTensorShape = UE::NNE::FTensorShape::Make(TArray<uint32>{ 1u, static_cast<uint32>(Proxy.OutputChannels), static_cast<uint32>(OutputResolution.Y), static_cast<uint32>(OutputResolution.X) });
+		TrackInstanceMemory(NewProxy, *NewProxy, 1, 0);
+		return NewProxy;
+	}
+
+	if (!Proxy.Model.IsValid())
+	{
+		return nullptr;
+	}
+
+	LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+	const StyleTransferMemory::FCpuProbe Probe;
+	TSharedPtr<UE::NNE::IModelInstanceRDG> Instance = Proxy.Model->CreateModelInstanceRDG();
+	if (!Instance.IsValid())
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to create model instance at %dx%d."), Resolution.X, Resolution.Y);
+		return nullptr;
+	}
+
+	TArray<uint32> Dimensions(Proxy.InputTensorShape.GetData());
+	Dimensions[2] = static_cast<uint32>(Resolution.Y);
+	Dimensions[3] = static_cast<uint32>(Resolution.X);
+	const UE::NNE::FTensorShape InputShape = UE::NNE::FTensorShape::Make(Dimensions);
+
+	TArray<UE::NNE::FTensorShape> InputShapes = { InputShape };
+	for (const FStyleTransferConditioningInput& Conditioning : Proxy.ConditioningInputs)
+	{
+		InputShapes.Add(Conditioning.Shape);
+	}
+
+	if (Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus::Ok)
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to set input shape %dx%d."), Resolution.X, Resolution.Y);
+		return nullptr;
+	}
+
+	const TConstArrayView<UE::NNE::FTensorShape> OutputShapes = Instance->GetOutputTensorShapes();
+	if (OutputShapes.IsEmpty() || OutputShapes[0].Rank() != 4)
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Unable to resolve output tensor shape at %dx%d."), Resolution.X, Resolution.Y);
+		return nullptr;
+	}
+
+	const TConstArrayView<UE::NNE::FTensorDesc> OutputDescs = Instance->GetOutputTensorDescs();
+	TArray<uint64> AuxiliaryOutputBytes;
+	for (int32 OutputIndex = 1; OutputIndex < OutputShapes.Num(); ++OutputIndex)
+	{
+		const uint64 ElementByteSize = OutputDescs.IsValidIndex(OutputIndex) ? OutputDescs[OutputIndex].GetElementByteSize() : sizeof(float);
+		AuxiliaryOutputBytes.Add(FMath::Max<uint64>(OutputShapes[OutputIndex].Volume(), 1) * ElementByteSize);
+	}
+
+	FStyleTransferProxyPtr NewProxy = MakeShared<FStyleTransferProxy, ESPMode::ThreadSafe>(Proxy);
+	NewProxy->ModelInstance = Instance;
+	NewProxy->InputResolution = Resolution;
+	NewProxy->OutputResolution = FIntPoint(OutputShapes[0].GetData()[3], OutputShapes[0].GetData()[2]);
+	NewProxy->InputTensorShape = InputShape;
+	NewProxy->OutputTensorShape = OutputShapes[0];
+	NewProxy->AuxiliaryOutputBytes = MoveTemp(AuxiliaryOutputBytes);
+	TrackInstanceMemory(Instance, *NewProxy, 1, Probe.GetBytes());
+	return NewProxy;
+}
+
+TSharedPtr<UE::NNE::IModelInstanceRDG> UMyNeuralNetwork::CreateBatchedInstance(const FStyleTransferProxy& Proxy, uint32 BatchSize, bool bPerFrameConditioning)
+{
+	if (!Proxy.Model.IsValid() || (BatchSize > 1 && !Proxy.bDynamicBatch))
+	{
+		return nullptr;
+	}
+
+	LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+	const StyleTransferMemory::FCpuProbe Probe;
+	TSharedPtr<UE::NNE::IModelInstanceRDG> Instance = Proxy.Model->CreateModelInstanceRDG();
+	if (!Instance.IsValid())
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to create batched model instance (batch %u)."), BatchSize);
+		return nullptr;
+	}
+
+	TArray<uint32> Dimensions(Proxy.InputTensorShape.GetData());
+	Dimensions[0] = BatchSize;
+
+	// Condition tensors keep their single-frame shape unless asked otherwise: every frame of the batch shares the current style weights.
+	TArray<UE::NNE::FTensorShape> InputShapes = { UE::NNE::FTensorShape::Make(Dimensions) };
+	for (const FStyleTransferConditioningInput& Conditioning : Proxy.ConditioningInputs)
+	{
+		if (bPerFrameConditioning && Conditioning.bPerFrame)
+		{
+			TArray<uint32> ConditionDimensions(Conditioning.Shape.GetData());
+			ConditionDimensions[0] = BatchSize;
+			InputShapes.Add(UE::NNE::FTensorShape::Make(ConditionDimensions));
+		}
+		else
+		{
+			InputShapes.Add(Conditioning.Shape);
+		}
+	}
+
+	if (Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceRDG::ESetInputTensorShapesStatus::Ok)
+	{
+		UE_LOG(LogStyleTransferNNE, Error, TEXT("Failed to set batched input shape (batch %u)."), BatchSize);
+		return nullptr;
+	}
+
+	TrackInstanceMemory(Instance, Proxy, BatchSize, Probe.GetBytes());
+	return Instance;
 }
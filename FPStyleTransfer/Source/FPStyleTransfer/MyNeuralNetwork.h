@@ -5,19 +5,84 @@
 #include "CoreMinimal.h"
 #include "NNETypes.h"
 #include "NNERuntimeRDG.h"
+#include "StyleTransferConvNet.h"
 #include "MyNeuralNetwork.generated.h"
 
 class UNNEModelData;
 
+/** Extra model input that selects or blends styles in a conditional (multi-style) network. */
+struct FStyleTransferConditioningInput
+{
+	int32 TensorIndex = 0;
+	ENNETensorDataType DataType = ENNETensorDataType::Float;
+	UE::NNE::FTensorShape Shape;
+	uint32 ElementByteSize = sizeof(float);
+	/** True when the leading dimension is the symbolic batch dimension, so each frame of a batch can carry its own condition. */
+	bool bPerFrame = false;
+};
+
+/** Maps an 8-bit image tensor to the real values the encode/decode passes work with: Real = (Quantized - ZeroPoint) * Scale. */
+struct FStyleTransferTensorQuantization
+{
+	float Scale = 1.0f;
+	int32 ZeroPoint = 0;
+};
+
 struct FStyleTransferProxy
 {
+	/** Model asset (or file) name and runtime the style was created with, for logs and memory accounting. */
+	FString ModelName;
+	FString RuntimeName;
+	TSharedPtr<UE::NNE::IModelRDG> Model;
 	TSharedPtr<UE::NNE::IModelInstanceRDG> ModelInstance;
+	/** Set instead of Model/ModelInstance when the style runs on the built-in executor (runtime "StyleTransferConvNet"). */
+	FStyleTransferConvNetPtr ConvNet;
 	FIntPoint InputResolution = FIntPoint::ZeroValue;
 	FIntPoint OutputResolution = FIntPoint::ZeroValue;
 	int32 InputChannels = 0;
 	int32 OutputChannels = 0;
 	UE::NNE::FTensorShape InputTensorShape;
 	UE::NNE::FTensorShape OutputTensorShape;
+	/** Element types of the image tensors. UInt8/Int8 tensors are quantized by the encode pass and dequantized by the decode pass. */
+	ENNETensorDataType InputDataType = ENNETensorDataType::Float;
+	ENNETensorDataType OutputDataType = ENNETensorDataType::Float;
+	uint32 InputElementByteSize = sizeof(float);
+	uint32 OutputElementByteSize = sizeof(float);
+	FStyleTransferTensorQuantization InputQuantization;
+	FStyleTransferTensorQuantization OutputQuantization;
+	/**
+	 * Model input value of a scene color of 1, and scene color of a model output value of 1. CreateProxy sets them to
+	 * the style model convention (StyleTransferPasses::EncodeScale/DecodeScale); chain stages trained on other ranges
+	 * override them.
+	 */
+	float InputValueScale = 1.0f;
+	float OutputValueScale = 1.0f;
+	int64 ModelSizeBytes = 0;
+	/**
+	 * Physical memory growth measured while the style loaded: the highest point, and what was still in use after.
+	 * INDEX_NONE when packages were streaming during the load, since the process-wide figures would include them.
+	 */
+	int64 LoadPeakBytes = 0;
+	int64 LoadResidentBytes = 0;
+	/** True when the model's batch dimension is symbolic, so several frames can share one inference. */
+	bool bDynamicBatch = false;
+	/** True when the model's spatial dimensions are symbolic, so it can run at other resolutions (see CreateResizedProxy). */
+	bool bDynamicSpatial = false;
+	TArray<FStyleTransferConditioningInput> ConditioningInputs;
+	/** Styles a style id input selects from (style_transfer.style_count metadata or the table the id indexes), 0 when unknown. */
+	int32 IdStyleCount = 0;
+	TArray<uint64> AuxiliaryOutputBytes;
+
+	/** Style weights uploaded to the conditioning inputs every frame. Render thread only once the proxy is active. */
+	TArray<float> StyleWeights;
+	/** Set once StyleTransferPrecache::WarmUp has run ModelInstance (or ConvNet). Render thread only. */
+	bool bWarmedUp = false;
+
+	bool IsConditional() const { return !ConditioningInputs.IsEmpty(); }
+	/** True when one batched inference can run a different style in every frame (see UMyNeuralNetwork::CreateBatchedInstance). */
+	bool CanBatchStyles() const;
+	bool IsQuantized() const;
+	int32 GetStyleCount() const;
 };
 
 using FStyleTransferProxyPtr = TSharedPtr<FStyleTransferProxy, ESPMode::ThreadSafe>;
@@ -29,8 +94,45 @@ class FPSTYLETRANSFER_API UMyNeuralNetwork : public UObject
 
 public:
 	bool Initialize(UNNEModelData* ModelData, FName RuntimeName);
+	void InitializeFromProxy(FStyleTransferProxyPtr InProxy);
 	FStyleTransferProxyPtr GetProxy() const { return Proxy; }
 
+	/**
+	 * Creates the runtime model, instance and tensor metadata without touching any UObject state.
+	 * Safe to call from a worker thread as long as the caller keeps ModelData alive.
+	 */
+	static FStyleTransferProxyPtr CreateProxy(UNNEModelData* ModelData, FName RuntimeName);
+
+	/**
+	 * Creates a proxy that shares Proxy's model but owns a new instance running at Resolution.
+	 * Requires a model with symbolic spatial dimensions.
+	 */
+	static FStyleTransferProxyPtr CreateResizedProxy(const FStyleTransferProxy& Proxy, FIntPoint Resolution);
+
+	/**
+	 * Creates a proxy from a loose .onnx file instead of a UNNEModelData asset. NNE copies the file into transient model
+	 * data, so this does not lower the load peak; it only keeps the serialized model from staying resident once the
+	 * runtime model is built. Game thread only.
+	 */
+	static FStyleTransferProxyPtr CreateProxyFromFile(const FString& FilePath, FName RuntimeName);
+
+	/**
+	 * Memory-maps a loose model file and initializes a transient UNNEModelData from it, as CreateProxyFromFile does, for
+	 * runtimes other than CreateProxy's. Release it with ReleaseTransientModelData once the runtime model is built.
+	 * Null if the file cannot be mapped. Game thread only.
+	 */
+	static UNNEModelData* CreateTransientModelData(const FString& FilePath);
+	static void ReleaseTransientModelData(UNNEModelData* ModelData);
+
+	/** Scale and zero point of an 8-bit image input (bInput) or output of ModelData, resolved as CreateProxy does. */
+	static FStyleTransferTensorQuantization ResolveImageQuantization(UNNEModelData* ModelData, ENNETensorDataType DataType, bool bInput);
+
+	/**
+	 * Creates an additional instance of the proxy's model whose image input holds BatchSize frames. Null for conv-net proxies.
+	 * With bPerFrameConditioning, per-frame condition inputs also hold BatchSize frames instead of one shared condition.
+	 */
+	static TSharedPtr<UE::NNE::IModelInstanceRDG> CreateBatchedInstance(const FStyleTransferProxy& Proxy, uint32 BatchSize, bool bPerFrameConditioning = false);
+
 private:
 	FStyleTransferProxyPtr Proxy;
 };
@@ -2,17 +2,29 @@
 
 #include "RealtimeStyleTransferViewExtension.h"
 
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
 #include "Modules/ModuleManager.h"
 #include "PostProcess/PostProcessMaterial.h"
 #include "PostProcess/SceneRenderTargets.h"
 #include "RenderGraphBuilder.h"
 #include "RenderGraphUtils.h"
-#include "StyleTransferShaders.h"
+#include "SceneRendering.h"
+#include "StyleTransferMemory.h"
+#include "StyleTransferModelLODSet.h"
+#include "StyleTransferPasses.h"
+#include "StyleTransferPrecache.h"
 #include "HAL/IConsoleManager.h"
 #include "NNERuntimeRDG.h"
+#include "Scalability.h"
+#include <atomic>
 
 DEFINE_LOG_CATEGORY_STATIC(LogRealtimeStyleTransfer, Log, All);
 
+DECLARE_CYCLE_STAT(TEXT("ExecuteStyleTransfer"), STAT_StyleTransfer_Execute, STATGROUP_StyleTransfer);
+DECLARE_CYCLE_STAT(TEXT("BeginRenderViewFamily"), STAT_StyleTransfer_BeginRenderViewFamily, STATGROUP_StyleTransfer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Model LOD"), STAT_StyleTransfer_ModelLOD, STATGROUP_StyleTransfer);
+
 namespace RealtimeStyleTransfer
 {
 	static int32 IsActive = 0;
@@ -22,10 +34,358 @@ namespace RealtimeStyleTransfer
 		TEXT("Allows an additional rendering pass that will apply a neural style to the frame.\n")
 		TEXT("=0:off (default), >0: on"),
 		ECVF_Cheat | ECVF_RenderThreadSafe);
+
+	static int32 Foveation = 0;
+	static FAutoConsoleVariableRef CVarFoveation(
+		TEXT("r.RealtimeStyleTransfer.Foveation"),
+		Foveation,
+		TEXT("Stylizes a region around the foveation center (screen center unless set with SetFoveationCenter) at model density\n")
+		TEXT("and the periphery with a lower resolution pass, or not at all.\n")
+		TEXT("=0: whole view (default), 1: foveated"),
+		ECVF_RenderThreadSafe);
+
+	static float FoveationInnerSize = 0.5f;
+	static FAutoConsoleVariableRef CVarFoveationInnerSize(
+		TEXT("r.RealtimeStyleTransfer.Foveation.InnerSize"),
+		FoveationInnerSize,
+		TEXT("Height of the foveal region as a fraction of the view height (default 0.5). Models with symbolic spatial dims\n")
+		TEXT("run the fovea at this fraction of their resolution, keeping the whole-view density; applied on the next SetStyle."),
+		ECVF_RenderThreadSafe);
+
+	static float FoveationFeather = 0.1f;
+	static FAutoConsoleVariableRef CVarFoveationFeather(
+		TEXT("r.RealtimeStyleTransfer.Foveation.Feather"),
+		FoveationFeather,
+		TEXT("Width of the blend between fovea and periphery as a fraction of the foveal region height (default 0.1)."),
+		ECVF_RenderThreadSafe);
+
+	static float FoveationPeripheryScale = 0.25f;
+	static FAutoConsoleVariableRef CVarFoveationPeripheryScale(
+		TEXT("r.RealtimeStyleTransfer.Foveation.PeripheryScale"),
+		FoveationPeripheryScale,
+		TEXT("Resolution of the periphery pass relative to the model resolution (default 0.25). 0 leaves the periphery unstylized.\n")
+		TEXT("Requires a model with symbolic spatial dims; applied on the next SetStyle."),
+		ECVF_RenderThreadSafe);
+
+	static int32 Mask = 0;
+	static FAutoConsoleVariableRef CVarMask(
+		TEXT("r.RealtimeStyleTransfer.Mask"),
+		Mask,
+		TEXT("Classifies the view into 8x8 tiles against a mask (custom stencil, sky depth and HUD rects, see r.RealtimeStyleTransfer.Mask.*)\n")
+		TEXT("and upscales and writes back only tiles with unmasked pixels; masked pixels keep the original frame. Not used with foveation.\n")
+		TEXT("=0: off (default), 1: on"),
+		ECVF_RenderThreadSafe);
+
+	static int32 StageGpuTimings = 0;
+	static FAutoConsoleVariableRef CVarStageGpuTimings(
+		TEXT("r.RealtimeStyleTransfer.StageGpuTimings"),
+		StageGpuTimings,
+		TEXT("Writes GPU timestamps around the encode, inference, decode and composite passes, read back a few frames later\n")
+		TEXT("into the stage timings (GetLastStageTimings). Each timestamp ends the current render pass. The performance test\n")
+		TEXT("and the benchmark game mode turn them on while they measure (AddStageGpuTimingsRequest).\n")
+		TEXT("=0: off (default), 1: on"),
+		ECVF_RenderThreadSafe);
+	/** Held by AddStageGpuTimingsRequest; timestamps are written while this or StageGpuTimings is non-zero. */
+	static std::atomic<int32> StageGpuTimingsRequests = 0;
+
+	static float LODTargetGpuMs = 16.6f;
+	static FAutoConsoleVariableRef CVarLODTargetGpuMs(
+		TEXT("r.RealtimeStyleTransfer.LOD.TargetGpuMs"),
+		LODTargetGpuMs,
+		TEXT("GPU frame time the style LOD governor keeps below by switching to cheaper variants of a LOD set (default 16.6)."));
+
+	static float LODUpThreshold = 0.8f;
+	static FAutoConsoleVariableRef CVarLODUpThreshold(
+		TEXT("r.RealtimeStyleTransfer.LOD.UpThreshold"),
+		LODUpThreshold,
+		TEXT("Fraction of TargetGpuMs the GPU frame time must stay under before the governor tries a more expensive variant (default 0.8)."));
+
+	static int32 LODDownFrames = 30;
+	static FAutoConsoleVariableRef CVarLODDownFrames(
+		TEXT("r.RealtimeStyleTransfer.LOD.DownFrames"),
+		LODDownFrames,
+		TEXT("Frames the GPU frame time must stay over TargetGpuMs before the governor switches to a cheaper variant (default 30)."));
+
+	static int32 LODUpFrames = 180;
+	static FAutoConsoleVariableRef CVarLODUpFrames(
+		TEXT("r.RealtimeStyleTransfer.LOD.UpFrames"),
+		LODUpFrames,
+		TEXT("Frames the GPU frame time must stay under UpThreshold before the governor switches to a more expensive variant\n")
+		TEXT("(default 180). Doubled, up to 8x, each time such a switch is undone within this many frames."));
+
+	static int32 LODForce = -1;
+	static FAutoConsoleVariableRef CVarLODForce(
+		TEXT("r.RealtimeStyleTransfer.LOD.Force"),
+		LODForce,
+		TEXT("Runs this variant of the active LOD set regardless of GPU time and scalability.\n")
+		TEXT("<0: governed (default)"));
+}
+
+namespace
+{
+	/** Region of ViewRect with the fovea's aspect ratio, InnerSize of the view high, centered on Center (0..1) and kept inside the view. */
+	FIntRect ComputeFoveaRect(const FIntRect& ViewRect, FIntPoint FoveaResolution, FVector2f Center)
+	{
+		const float Aspect = static_cast<float>(FoveaResolution.X) / FMath::Max(FoveaResolution.Y, 1);
+		const int32 Height = FMath::Clamp(FMath::RoundToInt(ViewRect.Height() * RealtimeStyleTransfer::FoveationInnerSize), 1, ViewRect.Height());
+		const FIntPoint Size(FMath::Clamp(FMath::RoundToInt(Height * Aspect), 1, ViewRect.Width()), Height);
+
+		FIntPoint Min(
+			ViewRect.Min.X + FMath::RoundToInt(Center.X * ViewRect.Width() - Size.X * 0.5f),
+			ViewRect.Min.Y + FMath::RoundToInt(Center.Y * ViewRect.Height() - Size.Y * 0.5f));
+		Min.X = FMath::Clamp(Min.X, ViewRect.Min.X, ViewRect.Max.X - Size.X);
+		Min.Y = FMath::Clamp(Min.Y, ViewRect.Min.Y, ViewRect.Max.Y - Size.Y);
+		return FIntRect(Min, Min + Size);
+	}
+
+	/** True when ModelData run on RuntimeName (None for the default runtime) is the model Active was created from. */
+	bool IsSameModel(const FStyleTransferProxy& Active, const UNNEModelData* ActiveData, const UNNEModelData* ModelData, FName RuntimeName)
+	{
+		return ModelData && ModelData == ActiveData && (RuntimeName.IsNone() || RuntimeName.ToString() == Active.RuntimeName);
+	}
+
+	FIntPoint ScaleResolution(FIntPoint Resolution, float Scale)
+	{
+		return FIntPoint(
+			FMath::Max(FMath::RoundToInt(Resolution.X * Scale), 1),
+			FMath::Max(FMath::RoundToInt(Resolution.Y * Scale), 1));
+	}
+
+	enum class EStyleTransferStage : uint8
+	{
+		Encode,
+		Inference,
+		Decode,
+		Composite,
+		Total,
+	};
+
+	constexpr int32 StageCount = static_cast<int32>(EStyleTransferStage::Total) + 1;
+
+	/**
+	 * GPU timestamps around the stages of the stylized frames in flight. Results are read back without waiting, a few
+	 * frames after the GPU ran them, so each reading belongs to an earlier frame than the render thread timings beside
+	 * it. Render thread only.
+	 */
+	class FStageGpuQueries
+	{
+	public:
+		/** Frames whose timestamps may be unread at once; further frames are not timed until one completes. */
+		static constexpr int32 MaxPendingFrames = 8;
+
+		/** Opens the timestamps of Frame; later calls add nothing when timing is off or unsupported. */
+		void BeginFrame(uint64 Frame)
+		{
+			const bool bEnabled = RealtimeStyleTransfer::StageGpuTimings > 0 || RealtimeStyleTransfer::StageGpuTimingsRequests.load() > 0;
+			bFrameOpen = bEnabled && GSupportsTimestampRenderQueries && PendingFrames.Num() < MaxPendingFrames;
+			if (!bFrameOpen)
+			{
+				return;
+			}
+
+			if (!QueryPool.IsValid())
+			{
+				QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+			}
+			PendingFrames.AddDefaulted_GetRef().Frame = Frame;
+		}
+
+		/** Adds a pass that writes a timestamp once the GPU reaches it; returns its index in the open frame, or INDEX_NONE. */
+		int32 AddTimestamp(FRDGBuilder& GraphBuilder)
+		{
+			if (!bFrameOpen)
+			{
+				return INDEX_NONE;
+			}
+
+			FPendingFrame& Pending = PendingFrames.Last();
+			FRHIRenderQuery* Query = Pending.Queries.Add_GetRef(QueryPool->AllocateQuery()).GetQuery();
+			GraphBuilder.AddPass(RDG_EVENT_NAME("StyleTransfer.Timestamp"), ERDGPassFlags::NeverCull, [Query](FRHICommandListImmediate& RHICmdList)
+			{
+				RHICmdList.EndRenderQuery(Query);
+			});
+			return Pending.Queries.Num() - 1;
+		}
+
+		void AddInterval(EStyleTransferStage Stage, int32 BeginQuery, int32 EndQuery)
+		{
+			if (bFrameOpen && BeginQuery != INDEX_NONE && EndQuery != INDEX_NONE)
+			{
+				PendingFrames.Last().Intervals.Add({ Stage, BeginQuery, EndQuery });
+			}
+		}
+
+		/** Closes the open frame; frames without a total interval (nothing was stylized) are dropped once read. */
+		void EndFrame()
+		{
+			bFrameOpen = false;
+		}
+
+		/** Copies the GPU stage times of the newest frame whose timestamps have all landed into OutTimings. */
+		void Resolve(FStyleTransferStageTimings& OutTimings)
+		{
+			while (!PendingFrames.IsEmpty() && (!bFrameOpen || PendingFrames.Num() > 1))
+			{
+				const FPendingFrame& Oldest = PendingFrames[0];
+				TArray<uint64, TInlineAllocator<32>> Microseconds;
+				for (const FRHIPooledRenderQuery& Query : Oldest.Queries)
+				{
+					uint64 Result = 0;
+					if (!RHIGetRenderQueryResult(Query.GetQuery(), Result, false))
+					{
+						return;
+					}
+					Microseconds.Add(Result);
+				}
+
+				double StageMs[StageCount] = {};
+				bool bHasTotal = false;
+				for (const FInterval& Interval : Oldest.Intervals)
+				{
+					const uint64 Begin = Microseconds[Interval.BeginQuery];
+					const uint64 End = Microseconds[Interval.EndQuery];
+					StageMs[static_cast<int32>(Interval.Stage)] += End > Begin ? (End - Begin) / 1000.0 : 0.0;
+					bHasTotal |= Interval.Stage == EStyleTransferStage::Total;
+				}
+
+				if (bHasTotal)
+				{
+					LastTimings.EncodeGpuMs = StageMs[static_cast<int32>(EStyleTransferStage::Encode)];
+					LastTimings.InferenceGpuMs = StageMs[static_cast<int32>(EStyleTransferStage::Inference)];
+					LastTimings.DecodeGpuMs = StageMs[static_cast<int32>(EStyleTransferStage::Decode)];
+					LastTimings.CompositeGpuMs = StageMs[static_cast<int32>(EStyleTransferStage::Composite)];
+					LastTimings.TotalGpuMs = StageMs[static_cast<int32>(EStyleTransferStage::Total)];
+					LastTimings.GpuFrame = Oldest.Frame;
+				}
+				PendingFrames.RemoveAt(0, EAllowShrinking::No);
+			}
+
+			OutTimings.EncodeGpuMs = LastTimings.EncodeGpuMs;
+			OutTimings.InferenceGpuMs = LastTimings.InferenceGpuMs;
+			OutTimings.DecodeGpuMs = LastTimings.DecodeGpuMs;
+			OutTimings.CompositeGpuMs = LastTimings.CompositeGpuMs;
+			OutTimings.TotalGpuMs = LastTimings.TotalGpuMs;
+			OutTimings.GpuFrame = LastTimings.GpuFrame;
+		}
+
+	private:
+		struct FInterval
+		{
+			EStyleTransferStage Stage;
+			int32 BeginQuery;
+			int32 EndQuery;
+		};
+
+		struct FPendingFrame
+		{
+			uint64 Frame = 0;
+			/** Pooled queries return to the pool when the frame is read, never while the GPU may still write them. */
+			TArray<FRHIPooledRenderQuery> Queries;
+			TArray<FInterval> Intervals;
+		};
+
+		FRenderQueryPoolRHIRef QueryPool;
+		TArray<FPendingFrame> PendingFrames;
+		FStyleTransferStageTimings LastTimings;
+		bool bFrameOpen = false;
+	};
+
+	/** Created on first use and released with the view extension, while the RHI is still up. */
+	TUniquePtr<FStageGpuQueries> StageGpuQueries;
+
+	FStageGpuQueries& GetStageGpuQueries()
+	{
+		check(IsInRenderingThread());
+		if (!StageGpuQueries.IsValid())
+		{
+			StageGpuQueries = MakeUnique<FStageGpuQueries>();
+		}
+		return *StageGpuQueries;
+	}
+
+	/**
+	 * Adds the render thread time between construction and destruction to AccumulatorMs, and times the passes added
+	 * meanwhile on the GPU as Stage.
+	 */
+	struct FScopedStageTimer
+	{
+		double& AccumulatorMs;
+		FRDGBuilder& GraphBuilder;
+		const EStyleTransferStage Stage;
+		const int32 BeginQuery;
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+
+		FScopedStageTimer(FRDGBuilder& InGraphBuilder, EStyleTransferStage InStage, double& InAccumulatorMs)
+			: AccumulatorMs(InAccumulatorMs)
+			, GraphBuilder(InGraphBuilder)
+			, Stage(InStage)
+			, BeginQuery(GetStageGpuQueries().AddTimestamp(InGraphBuilder))
+		{
+		}
+
+		~FScopedStageTimer()
+		{
+			FStageGpuQueries& Queries = GetStageGpuQueries();
+			Queries.AddInterval(Stage, BeginQuery, Queries.AddTimestamp(GraphBuilder));
+			AccumulatorMs += FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+		}
+	};
+
+	/** Whether CheckCustomDepthMode has warned since the stencil was last needed. Game thread only. */
+	bool bWarnedCustomDepthMode = false;
+
+	/**
+	 * Warns once each time the mask or stencil styles start to need the custom stencil while r.CustomDepth is not 3
+	 * (custom depth with stencil, set in DefaultEngine.ini). The console variable is left alone; without the stencil
+	 * every pixel reads 0, so stencil masking is skipped and stencil styles fall back to the active style. Game thread.
+	 */
+	void CheckCustomDepthMode(bool bNeedsStencil)
+	{
+		if (!bNeedsStencil)
+		{
+			bWarnedCustomDepthMode = false;
+			return;
+		}
+
+		static const IConsoleVariable* CustomDepthVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.CustomDepth"));
+		if (!bWarnedCustomDepthMode && CustomDepthVar && CustomDepthVar->GetInt() != 3)
+		{
+			bWarnedCustomDepthMode = true;
+			UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("The style transfer mask or stencil styles read the custom stencil, but r.CustomDepth is %d; set r.CustomDepth=3. Stencil values read as 0 until then."),
+				CustomDepthVar->GetInt());
+		}
+	}
 }
 
 TStrongObjectPtr<UMyNeuralNetwork> FRealtimeStyleTransferViewExtension::ModelOwner;
 FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::ModelProxy;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::FoveaProxy;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::PeripheryProxy;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::FoveationStyle_RenderThread;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::FoveaProxy_RenderThread;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::PeripheryProxy_RenderThread;
+FVector2f FRealtimeStyleTransferViewExtension::FoveationCenter_RenderThread(0.5f, 0.5f);
+TArray<FVector4f> FRealtimeStyleTransferViewExtension::MaskRects_RenderThread;
+TArray<FStyleTransferProxyPtr> FRealtimeStyleTransferViewExtension::ChainProxies;
+FStyleTransferProxyPtr FRealtimeStyleTransferViewExtension::ChainStyle_RenderThread;
+TArray<FStyleTransferProxyPtr> FRealtimeStyleTransferViewExtension::ChainStages_RenderThread;
+TArray<FRealtimeStyleTransferViewExtension::FStencilStyleEntry> FRealtimeStyleTransferViewExtension::StencilStyles;
+TSharedPtr<const FRealtimeStyleTransferViewExtension::FStencilStyleLayers, ESPMode::ThreadSafe> FRealtimeStyleTransferViewExtension::StencilLayers_RenderThread;
+TWeakObjectPtr<UNNEModelData> FRealtimeStyleTransferViewExtension::ActiveModelData;
+TSharedPtr<FStyleTransferFrameCapture, ESPMode::ThreadSafe> FRealtimeStyleTransferViewExtension::FrameCapture_RenderThread;
+TArray<TSharedPtr<FStyleTransferFrameCapture, ESPMode::ThreadSafe>> FRealtimeStyleTransferViewExtension::RetiringFrameCaptures_RenderThread;
+FStyleTransferStageTimings FRealtimeStyleTransferViewExtension::StageTimings_RenderThread;
+TSharedPtr<const StyleTransferPasses::FDispatchPlan> FRealtimeStyleTransferViewExtension::ViewPlan_RenderThread;
+TSharedPtr<const StyleTransferPasses::FDispatchPlan> FRealtimeStyleTransferViewExtension::FoveaPlan_RenderThread;
+TSharedPtr<const StyleTransferPasses::FDispatchPlan> FRealtimeStyleTransferViewExtension::PeripheryPlan_RenderThread;
+FStyleTransferStageTimings FRealtimeStyleTransferViewExtension::LastStageTimings;
+FCriticalSection FRealtimeStyleTransferViewExtension::LastStageTimingsLock;
+TStrongObjectPtr<UStyleTransferModelLODSet> FRealtimeStyleTransferViewExtension::ActiveLODSet;
+TArray<FRealtimeStyleTransferViewExtension::FStyleLOD> FRealtimeStyleTransferViewExtension::StyleLODs;
+int32 FRealtimeStyleTransferViewExtension::ActiveStyleLOD = INDEX_NONE;
+FStyleTransferLODGovernor FRealtimeStyleTransferViewExtension::LODGovernor;
+uint64 FRealtimeStyleTransferViewExtension::LODGovernorTickFrame = 0;
+TArray<FStyleTransferProxyPtr> FRealtimeStyleTransferViewExtension::StyleLODProxies_RenderThread;
 
 FRealtimeStyleTransferViewExtension::FRealtimeStyleTransferViewExtension(const FAutoRegister& AutoRegister)
 	: FSceneViewExtensionBase(AutoRegister)
@@ -38,6 +398,15 @@ FRealtimeStyleTransferViewExtension::FRealtimeStyleTransferViewExtension(const F
 		ViewExtensionIsActive ? TEXT("true") : TEXT("false"));
 }
 
+FRealtimeStyleTransferViewExtension::~FRealtimeStyleTransferViewExtension()
+{
+	ENQUEUE_RENDER_COMMAND(ReleaseStyleTransferStageQueries)(
+		[](FRHICommandListImmediate&)
+		{
+			StageGpuQueries.Reset();
+		});
+}
+
 void FRealtimeStyleTransferViewExtension::SetStyle(UNNEModelData* ModelData, FName RuntimeName)
 {
 	if (!ModelData)
@@ -45,6 +414,12 @@ void FRealtimeStyleTransferViewExtension::SetStyle(UNNEModelData* ModelData, FNa
 		UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Style transfer disabled (no model)."));
 		ModelOwner.Reset();
 		ModelProxy.Reset();
+		FoveaProxy.Reset();
+		PeripheryProxy.Reset();
+		SendFoveationToRenderThread(nullptr, nullptr, nullptr);
+		ActiveModelData.Reset();
+		ResetStyleLODs();
+		ResolveChain();
 
 		RealtimeStyleTransfer::IsActive = 0;
 
@@ -61,20 +436,526 @@ void FRealtimeStyleTransferViewExtension::SetStyle(UNNEModelData* ModelData, FNa
 		UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Failed to initialize NNE model '%s'"), *ModelData->GetName());
 		ModelOwner.Reset();
 		ModelProxy.Reset();
+		FoveaProxy.Reset();
+		PeripheryProxy.Reset();
+		SendFoveationToRenderThread(nullptr, nullptr, nullptr);
+		ActiveModelData.Reset();
+		ResetStyleLODs();
+		ResolveChain();
+		return;
+	}
+
+	ActivateStyle(Instance, ModelData, RuntimeName);
+}
+
+void FRealtimeStyleTransferViewExtension::SetStyleWithProxy(UNNEModelData* ModelData, FName RuntimeName, FStyleTransferProxyPtr PrewarmedProxy)
+{
+	if (!PrewarmedProxy.IsValid())
+	{
+		SetStyle(ModelData, RuntimeName);
+		return;
+	}
+
+	UMyNeuralNetwork* Instance = NewObject<UMyNeuralNetwork>();
+	Instance->InitializeFromProxy(MoveTemp(PrewarmedProxy));
+	ActivateStyle(Instance, ModelData, RuntimeName);
+}
+
+void FRealtimeStyleTransferViewExtension::SetStyleFromFile(const FString& FilePath, FName RuntimeName)
+{
+	const FString FullPath = FPaths::IsRelative(FilePath) ? FPaths::Combine(FPaths::ProjectContentDir(), FilePath) : FilePath;
+	FStyleTransferProxyPtr Proxy = UMyNeuralNetwork::CreateProxyFromFile(FullPath, RuntimeName);
+	if (!Proxy.IsValid())
+	{
+		UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Failed to initialize NNE model from '%s'"), *FullPath);
+		return;
+	}
+
+	UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Activating memory-mapped model '%s'."), *FullPath);
+
+	UMyNeuralNetwork* Instance = NewObject<UMyNeuralNetwork>();
+	Instance->InitializeFromProxy(MoveTemp(Proxy));
+	ActivateStyle(Instance, nullptr, RuntimeName);
+}
+
+void FRealtimeStyleTransferViewExtension::SetStyleWeights(TArray<float> Weights)
+{
+	if (!ModelProxy.IsValid() || !ModelProxy->IsConditional())
+	{
+		UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("SetStyleWeights ignored: the active model has no style condition input."));
+		return;
+	}
+
+	const int32 StyleCount = ModelProxy->GetStyleCount();
+	if (StyleCount > 0)
+	{
+		Weights.SetNumZeroed(StyleCount);
+	}
+
+	// Style blending only changes the small condition tensor uploaded each frame; the weights stay resident.
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferWeights)(
+		[Proxy = ModelProxy, Fovea = FoveaProxy, Periphery = PeripheryProxy, Weights = MoveTemp(Weights)](FRHICommandListImmediate&) mutable
+		{
+			for (const FStyleTransferProxyPtr& Resized : { Fovea, Periphery })
+			{
+				if (Resized.IsValid() && Resized != Proxy)
+				{
+					Resized->StyleWeights = Weights;
+				}
+			}
+			Proxy->StyleWeights = MoveTemp(Weights);
+		});
+}
+
+int32 FRealtimeStyleTransferViewExtension::GetStyleCount()
+{
+	return ModelProxy.IsValid() ? ModelProxy->GetStyleCount() : 0;
+}
+
+void FRealtimeStyleTransferViewExtension::StartFrameCapture(FOnStyleTransferFrameCaptured Callback, int32 RingDepth, EStyleTransferCaptureSource Source)
+{
+	TSharedPtr<FStyleTransferFrameCapture, ESPMode::ThreadSafe> Capture =
+		MakeShared<FStyleTransferFrameCapture, ESPMode::ThreadSafe>(MoveTemp(Callback), RingDepth, Source);
+
+	UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Frame capture started (ring depth %d)."), RingDepth);
+
+	ENQUEUE_RENDER_COMMAND(StartStyleTransferFrameCapture)(
+		[Capture = MoveTemp(Capture)](FRHICommandListImmediate&) mutable
+		{
+			if (FrameCapture_RenderThread.IsValid())
+			{
+				RetiringFrameCaptures_RenderThread.Add(MoveTemp(FrameCapture_RenderThread));
+			}
+			FrameCapture_RenderThread = MoveTemp(Capture);
+		});
+}
+
+void FRealtimeStyleTransferViewExtension::StopFrameCapture()
+{
+	// No frame is delivered after this returns, even one whose readback or callback task is still queued.
+	FStyleTransferFrameCapture::InvalidateAll();
+
+	ENQUEUE_RENDER_COMMAND(StopStyleTransferFrameCapture)(
+		[](FRHICommandListImmediate&)
+		{
+			if (FrameCapture_RenderThread.IsValid())
+			{
+				UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Frame capture stopped (%llu frame(s) dropped)."), FrameCapture_RenderThread->GetDroppedFrameCount());
+				RetiringFrameCaptures_RenderThread.Add(MoveTemp(FrameCapture_RenderThread));
+			}
+		});
+}
+
+void FRealtimeStyleTransferViewExtension::SetFoveationCenter(FVector2f NormalizedCenter)
+{
+	const FVector2f Center(FMath::Clamp(NormalizedCenter.X, 0.0f, 1.0f), FMath::Clamp(NormalizedCenter.Y, 0.0f, 1.0f));
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferFoveationCenter)(
+		[Center](FRHICommandListImmediate&)
+		{
+			FoveationCenter_RenderThread = Center;
+		});
+}
+
+void FRealtimeStyleTransferViewExtension::SetMaskRects(const TArray<FBox2f>& NormalizedRects)
+{
+	if (NormalizedRects.Num() > FPStyleTransferShaders::kMaxMaskRects)
+	{
+		UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("SetMaskRects: only the first %d of %d rects are used."),
+			FPStyleTransferShaders::kMaxMaskRects,
+			NormalizedRects.Num());
+	}
+
+	TArray<FVector4f> Rects;
+	for (const FBox2f& Rect : NormalizedRects)
+	{
+		if (Rects.Num() == FPStyleTransferShaders::kMaxMaskRects)
+		{
+			break;
+		}
+		if (Rect.bIsValid)
+		{
+			Rects.Emplace(Rect.Min.X, Rect.Min.Y, Rect.Max.X, Rect.Max.Y);
+		}
+	}
+
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferMaskRects)(
+		[Rects = MoveTemp(Rects)](FRHICommandListImmediate&) mutable
+		{
+			MaskRects_RenderThread = MoveTemp(Rects);
+		});
+}
+
+bool FRealtimeStyleTransferViewExtension::SetChainStages(const TArray<FStyleTransferChainStage>& Stages)
+{
+	TArray<FStyleTransferProxyPtr> Proxies;
+	for (const FStyleTransferChainStage& Stage : Stages)
+	{
+		FStyleTransferProxyPtr Proxy = Stage.ModelData ? UMyNeuralNetwork::CreateProxy(Stage.ModelData, Stage.RuntimeName) : nullptr;
+		if (!Proxy.IsValid() || Proxy->ConvNet.IsValid())
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("SetChainStages: failed to create an NNE model for stage %d ('%s'); keeping the current chain."),
+				Proxies.Num(),
+				*GetNameSafe(Stage.ModelData));
+			return false;
+		}
+
+		Proxy->InputValueScale = Stage.InputValueScale;
+		Proxy->OutputValueScale = Stage.OutputValueScale;
+		Proxies.Add(MoveTemp(Proxy));
+	}
+
+	ChainProxies = MoveTemp(Proxies);
+	ResolveChain();
+	return true;
+}
+
+void FRealtimeStyleTransferViewExtension::ResolveChain()
+{
+	if (ActiveLODSet.IsValid())
+	{
+		ResolveStyleLODs();
 		return;
 	}
 
+	SendChainToRenderThread(ModelProxy, CreateChainStages(ModelProxy));
+
+	// Whether the active style can join a batch depends on the chain.
+	ResolveStencilStyles();
+}
+
+TArray<FStyleTransferProxyPtr> FRealtimeStyleTransferViewExtension::CreateChainStages(const FStyleTransferProxyPtr& Style)
+{
+	TArray<FStyleTransferProxyPtr> Stages;
+	if (Style.IsValid() && !ChainProxies.IsEmpty())
+	{
+		const FStyleTransferProxy* Previous = Style.Get();
+		for (const FStyleTransferProxyPtr& Proxy : ChainProxies)
+		{
+			FStyleTransferProxyPtr Stage = Proxy;
+			if (Stage->InputResolution != Previous->OutputResolution)
+			{
+				Stage = UMyNeuralNetwork::CreateResizedProxy(*Proxy, Previous->OutputResolution);
+			}
+
+			if (!Stage.IsValid() || !StyleTransferPasses::CanChain(*Previous, *Stage))
+			{
+				UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Chain stage '%s' takes %dx%dx%d but '%s' outputs %dx%dx%d; the chain is disabled for this style."),
+					*Proxy->ModelName,
+					Proxy->InputChannels,
+					Proxy->InputResolution.Y,
+					Proxy->InputResolution.X,
+					*Previous->ModelName,
+					Previous->OutputChannels,
+					Previous->OutputResolution.Y,
+					Previous->OutputResolution.X);
+				Stages.Reset();
+				break;
+			}
+
+			Previous = Stage.Get();
+			Stages.Add(MoveTemp(Stage));
+		}
+
+		if (!Stages.IsEmpty())
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Style model runs at %dx%d, followed by %d chain stage(s) up to %dx%d."),
+				Style->InputResolution.X,
+				Style->InputResolution.Y,
+				Stages.Num(),
+				Stages.Last()->OutputResolution.X,
+				Stages.Last()->OutputResolution.Y);
+		}
+	}
+
+	for (const FStyleTransferProxyPtr& Stage : Stages)
+	{
+		StyleTransferPrecache::WarmUp(Stage);
+	}
+	return Stages;
+}
+
+void FRealtimeStyleTransferViewExtension::SendChainToRenderThread(const FStyleTransferProxyPtr& Style, TArray<FStyleTransferProxyPtr> Stages)
+{
+	// The chain only runs behind the style it was resolved for, so a frame between SetStyle and this command skips it.
+	FStyleTransferProxyPtr ChainStyle = Stages.IsEmpty() ? FStyleTransferProxyPtr() : Style;
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferChain)(
+		[ChainStyle = MoveTemp(ChainStyle), Stages = MoveTemp(Stages)](FRHICommandListImmediate&) mutable
+		{
+			ChainStyle_RenderThread = MoveTemp(ChainStyle);
+			ChainStages_RenderThread = MoveTemp(Stages);
+		});
+}
+
+bool FRealtimeStyleTransferViewExtension::SetStencilStyles(const TArray<FStyleTransferStencilStyle>& Styles)
+{
+	TArray<FStencilStyleEntry> Entries;
+	for (const FStyleTransferStencilStyle& Style : Styles)
+	{
+		// A later style for the same stencil value replaces an earlier one.
+		Entries.RemoveAll([&Style](const FStencilStyleEntry& Entry) { return Entry.StencilValue == Style.StencilValue; });
+
+		FStencilStyleEntry Entry;
+		Entry.StencilValue = Style.StencilValue;
+		Entry.ModelData = Style.ModelData;
+		Entry.RuntimeName = Style.RuntimeName;
+		Entry.StyleIndex = Style.StyleIndex;
+
+		if (Style.ModelData)
+		{
+			// Styles of one model share its proxy: the active style's, another entry's, or one from the previous call.
+			auto SameModel = [&Style](const FStencilStyleEntry& Other)
+			{
+				return Other.Proxy.IsValid() && Other.ModelData.Get() == Style.ModelData && Other.RuntimeName == Style.RuntimeName;
+			};
+
+			if (ModelProxy.IsValid() && IsSameModel(*ModelProxy, ActiveModelData.Get(), Style.ModelData, Style.RuntimeName))
+			{
+				Entry.Proxy = ModelProxy;
+			}
+			else if (const FStencilStyleEntry* Existing = Entries.FindByPredicate(SameModel))
+			{
+				Entry.Proxy = Existing->Proxy;
+			}
+			else if (const FStencilStyleEntry* Previous = StencilStyles.FindByPredicate(SameModel))
+			{
+				Entry.Proxy = Previous->Proxy;
+			}
+			else
+			{
+				Entry.Proxy = UMyNeuralNetwork::CreateProxy(Style.ModelData, Style.RuntimeName);
+			}
+
+			if (!Entry.Proxy.IsValid() || Entry.Proxy->ConvNet.IsValid())
+			{
+				UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("SetStencilStyles: failed to create an NNE model for stencil %d ('%s'); keeping the current stencil styles."),
+					Style.StencilValue,
+					*Style.ModelData->GetName());
+				return false;
+			}
+		}
+
+		Entries.Add(MoveTemp(Entry));
+	}
+
+	StencilStyles = MoveTemp(Entries);
+	ResolveStencilStyles();
+	return true;
+}
+
+TArray<FStyleTransferStencilStyle> FRealtimeStyleTransferViewExtension::GetStencilStyles()
+{
+	TArray<FStyleTransferStencilStyle> Styles;
+	for (const FStencilStyleEntry& Entry : StencilStyles)
+	{
+		FStyleTransferStencilStyle& Style = Styles.AddDefaulted_GetRef();
+		Style.StencilValue = Entry.StencilValue;
+		Style.ModelData = Entry.ModelData.Get();
+		Style.RuntimeName = Entry.RuntimeName;
+		Style.StyleIndex = Entry.StyleIndex;
+	}
+	return Styles;
+}
+
+void FRealtimeStyleTransferViewExtension::ResolveStencilStyles()
+{
+	if (ActiveLODSet.IsValid())
+	{
+		ResolveStyleLODs();
+		return;
+	}
+
+	SendStencilLayersToRenderThread(CreateStencilLayers(ModelProxy, ActiveModelData.Get()));
+}
+
+TSharedPtr<const FRealtimeStyleTransferViewExtension::FStencilStyleLayers, ESPMode::ThreadSafe> FRealtimeStyleTransferViewExtension::CreateStencilLayers(const FStyleTransferProxyPtr& Style, const UNNEModelData* StyleModelData)
+{
+	TSharedPtr<FStencilStyleLayers, ESPMode::ThreadSafe> Layers;
+	if (Style.IsValid() && !StencilStyles.IsEmpty())
+	{
+		Layers = MakeShared<FStencilStyleLayers, ESPMode::ThreadSafe>();
+		Layers->Style = Style;
+		Layers->StencilToLayer.Init(0, 256);
+
+		// The active style becomes slice 0 of its own model's batch, unless a chain has to run on its output alone.
+		const bool bBatchWithActive = Style->CanBatchStyles() && ChainProxies.IsEmpty();
+		TArray<TPair<FStyleTransferProxyPtr, TArray<float>>> LayerStyles;
+
+		for (const FStencilStyleEntry& Entry : StencilStyles)
+		{
+			uint8& Layer = Layers->StencilToLayer[Entry.StencilValue];
+			if (!Entry.Proxy.IsValid())
+			{
+				Layer = FPStyleTransferShaders::kStencilLayerOriginal;
+				continue;
+			}
+
+			const bool bActiveModel = Entry.Proxy == Style || IsSameModel(*Style, StyleModelData, Entry.ModelData.Get(), Entry.RuntimeName);
+			const FStyleTransferProxyPtr Proxy = bActiveModel ? Style : Entry.Proxy;
+			if (bActiveModel && (!Proxy->IsConditional() || Entry.StyleIndex == INDEX_NONE))
+			{
+				// Nothing to run: the pixels already get the active style.
+				continue;
+			}
+
+			TArray<float> Weights;
+			if (Proxy->IsConditional())
+			{
+				if (Entry.StyleIndex != INDEX_NONE)
+				{
+					Weights.SetNumZeroed(FMath::Max(Proxy->GetStyleCount(), Entry.StyleIndex + 1));
+					Weights[Entry.StyleIndex] = 1.0f;
+				}
+				else
+				{
+					Weights = Proxy->StyleWeights;
+				}
+			}
+
+			const int32 ExistingLayer = LayerStyles.IndexOfByPredicate([&Proxy, &Weights](const TPair<FStyleTransferProxyPtr, TArray<float>>& Other)
+			{
+				return Other.Key == Proxy && Other.Value == Weights;
+			});
+			if (ExistingLayer != INDEX_NONE)
+			{
+				Layer = static_cast<uint8>(ExistingLayer + 1);
+				continue;
+			}
+
+			if (LayerStyles.Num() == FPStyleTransferShaders::kMaxStencilStyles)
+			{
+				UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("Stencil %d keeps the active style: at most %d distinct stencil styles are supported."),
+					Entry.StencilValue,
+					FPStyleTransferShaders::kMaxStencilStyles);
+				continue;
+			}
+
+			int32 GroupIndex = Proxy->CanBatchStyles()
+				? Layers->Groups.IndexOfByPredicate([&Proxy](const FStencilStyleGroup& Group) { return Group.Proxy == Proxy; })
+				: INDEX_NONE;
+			if (GroupIndex == INDEX_NONE)
+			{
+				GroupIndex = Layers->Groups.AddDefaulted();
+				Layers->Groups[GroupIndex].Proxy = Proxy;
+				if (bActiveModel && bBatchWithActive)
+				{
+					Layers->Groups[GroupIndex].SliceWeights.AddDefaulted();
+					Layers->BaseGroup = GroupIndex;
+				}
+			}
+
+			FStencilStyleGroup& Group = Layers->Groups[GroupIndex];
+			Layers->Layers.Emplace(GroupIndex, Group.SliceWeights.Num());
+			Group.SliceWeights.Add(Weights);
+			LayerStyles.Emplace(Proxy, MoveTemp(Weights));
+			Layer = static_cast<uint8>(LayerStyles.Num());
+		}
+
+		// A single-slice group runs on its style's own instance unless the active style or an earlier group already does.
+		TSet<const FStyleTransferProxy*> UsedInstances = { Style.Get() };
+		bool bInstancesCreated = true;
+		for (FStencilStyleGroup& Group : Layers->Groups)
+		{
+			const uint32 BatchSize = Group.SliceWeights.Num();
+			bool bInstanceUsed = false;
+			UsedInstances.Add(Group.Proxy.Get(), &bInstanceUsed);
+			Group.Instance = BatchSize == 1 && !bInstanceUsed
+				? Group.Proxy->ModelInstance
+				: UMyNeuralNetwork::CreateBatchedInstance(*Group.Proxy, BatchSize, true);
+
+			if (!Group.Instance.IsValid())
+			{
+				UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Failed to create a %u-frame instance of '%s' for the stencil styles; they are disabled for this style."),
+					BatchSize,
+					*Group.Proxy->ModelName);
+				bInstancesCreated = false;
+				break;
+			}
+		}
+
+		if (!bInstancesCreated)
+		{
+			Layers.Reset();
+		}
+		else
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Stencil styles: %d style(s) in %d inference(s)%s."),
+				LayerStyles.Num(),
+				Layers->Groups.Num(),
+				Layers->BaseGroup != INDEX_NONE ? TEXT(", batched with the active style") : TEXT(""));
+
+			for (const FStencilStyleGroup& Group : Layers->Groups)
+			{
+				if (Group.Instance == Group.Proxy->ModelInstance)
+				{
+					StyleTransferPrecache::WarmUp(Group.Proxy);
+				}
+				else
+				{
+					StyleTransferPrecache::WarmUp(Group.Proxy, Group.Instance, Group.SliceWeights);
+				}
+			}
+		}
+	}
+
+	return Layers;
+}
+
+void FRealtimeStyleTransferViewExtension::SendStencilLayersToRenderThread(TSharedPtr<const FStencilStyleLayers, ESPMode::ThreadSafe> Layers)
+{
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferStencilStyles)(
+		[Layers = MoveTemp(Layers)](FRHICommandListImmediate&) mutable
+		{
+			StencilLayers_RenderThread = MoveTemp(Layers);
+		});
+}
+
+const FRealtimeStyleTransferViewExtension::FStencilStyleLayers* FRealtimeStyleTransferViewExtension::GetStencilLayers(const FStyleTransferProxyPtr& Proxy, bool bChained)
+{
+	// A frame between SetStyle or SetChainStages and the matching update skips them.
+	const FStencilStyleLayers* Layers = StencilLayers_RenderThread.Get();
+	if (!Layers || Layers->Style != Proxy || RealtimeStyleTransfer::Foveation > 0 || (bChained && Layers->BaseGroup != INDEX_NONE))
+	{
+		return nullptr;
+	}
+	return Layers;
+}
+
+UNNEModelData* FRealtimeStyleTransferViewExtension::GetActiveModelData()
+{
+	return ActiveModelData.Get();
+}
+
+FStyleTransferStageTimings FRealtimeStyleTransferViewExtension::GetLastStageTimings()
+{
+	FScopeLock Lock(&LastStageTimingsLock);
+	return LastStageTimings;
+}
+
+void FRealtimeStyleTransferViewExtension::AddStageGpuTimingsRequest()
+{
+	++RealtimeStyleTransfer::StageGpuTimingsRequests;
+}
+
+void FRealtimeStyleTransferViewExtension::RemoveStageGpuTimingsRequest()
+{
+	verify(--RealtimeStyleTransfer::StageGpuTimingsRequests >= 0);
+}
+
+void FRealtimeStyleTransferViewExtension::ActivateStyle(UMyNeuralNetwork* Instance, UNNEModelData* ModelData, FName RuntimeName)
+{
+	ResetStyleLODs();
 	ModelOwner.Reset(Instance);
 	ModelProxy = Instance->GetProxy();
+	ActiveModelData = ModelData;
 
 	if (!ModelProxy.IsValid())
 	{
-		UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Model proxy returned invalid after initialization of '%s'."), *ModelData->GetName());
+		UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("Model proxy returned invalid after initialization of '%s'."), *GetNameSafe(ModelData));
 		return;
 	}
 
 	UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Style transfer enabled with model '%s' (runtime: %s). InputTensor %ux%ux%u%u, OutputTensor %ux%ux%u%u"),
-		*ModelData->GetName(),
+		*GetNameSafe(ModelData),
 		RuntimeName.IsNone() ? TEXT("default") : *RuntimeName.ToString(),
 		ModelProxy->InputTensorShape.GetData()[0],
 		ModelProxy->InputTensorShape.GetData()[1],
@@ -85,6 +966,23 @@ void FRealtimeStyleTransferViewExtension::SetStyle(UNNEModelData* ModelData, FNa
 		ModelProxy->OutputTensorShape.GetData()[2],
 		ModelProxy->OutputTensorShape.GetData()[3]);
 
+	CreateFoveationProxies(ModelProxy, FoveaProxy, PeripheryProxy);
+	SendFoveationToRenderThread(ModelProxy, FoveaProxy, PeripheryProxy);
+
+	UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Foveation: fovea %dx%d, periphery %s."),
+		FoveaProxy->InputResolution.X,
+		FoveaProxy->InputResolution.Y,
+		PeripheryProxy.IsValid() ? *FString::Printf(TEXT("%dx%d"), PeripheryProxy->InputResolution.X, PeripheryProxy->InputResolution.Y) : TEXT("unstylized"));
+
+	StyleTransferPrecache::WarmUp(ModelProxy);
+	if (RealtimeStyleTransfer::Foveation > 0)
+	{
+		StyleTransferPrecache::WarmUp(FoveaProxy);
+		StyleTransferPrecache::WarmUp(PeripheryProxy);
+	}
+
+	ResolveChain();
+
 	RealtimeStyleTransfer::IsActive = 1;
 
 	if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Enable")))
@@ -93,45 +991,296 @@ void FRealtimeStyleTransferViewExtension::SetStyle(UNNEModelData* ModelData, FNa
 	}
 }
 
-bool FRealtimeStyleTransferViewExtension::IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const
+void FRealtimeStyleTransferViewExtension::SendFoveationToRenderThread(const FStyleTransferProxyPtr& Style, FStyleTransferProxyPtr Fovea, FStyleTransferProxyPtr Periphery)
 {
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("IsActiveThisFrame_Internal -> %s"), ViewExtensionIsActive ? TEXT("true") : TEXT("false"));
-	return ViewExtensionIsActive;
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferFoveation)(
+		[Style, Fovea = MoveTemp(Fovea), Periphery = MoveTemp(Periphery)](FRHICommandListImmediate&) mutable
+		{
+			FoveationStyle_RenderThread = Style;
+			FoveaProxy_RenderThread = MoveTemp(Fovea);
+			PeripheryProxy_RenderThread = MoveTemp(Periphery);
+		});
 }
 
-void FRealtimeStyleTransferViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+void FRealtimeStyleTransferViewExtension::GetFoveationProxies(const FStyleTransferProxyPtr& Proxy, FStyleTransferProxyPtr& OutFovea, FStyleTransferProxyPtr& OutPeriphery)
 {
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("BeginRenderViewFamily: %p"), static_cast<const void*>(&InViewFamily));
+	// A frame between SetStyle and the matching update stylizes the fovea with Proxy itself and leaves the periphery unstylized.
+	const bool bCurrent = FoveationStyle_RenderThread == Proxy;
+	OutFovea = bCurrent && FoveaProxy_RenderThread.IsValid() ? FoveaProxy_RenderThread : Proxy;
+	OutPeriphery = bCurrent ? PeripheryProxy_RenderThread : FStyleTransferProxyPtr();
 }
 
-void FRealtimeStyleTransferViewExtension::PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily)
+void FRealtimeStyleTransferViewExtension::CreateFoveationProxies(const FStyleTransferProxyPtr& Proxy, FStyleTransferProxyPtr& OutFovea, FStyleTransferProxyPtr& OutPeriphery)
 {
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("PreRenderViewFamily_RenderThread: %p"), static_cast<const void*>(&InViewFamily));
+	// Models with symbolic spatial dims get dedicated fovea and periphery instances; fixed-shape models stylize the fovea at their own resolution.
+	OutFovea = Proxy;
+	OutPeriphery.Reset();
+	if (Proxy->bDynamicSpatial)
+	{
+		const float InnerSize = FMath::Clamp(RealtimeStyleTransfer::FoveationInnerSize, 0.1f, 1.0f);
+		if (FStyleTransferProxyPtr Resized = UMyNeuralNetwork::CreateResizedProxy(*Proxy, ScaleResolution(Proxy->InputResolution, InnerSize)))
+		{
+			OutFovea = MoveTemp(Resized);
+		}
+
+		if (RealtimeStyleTransfer::FoveationPeripheryScale > 0.0f)
+		{
+			OutPeriphery = UMyNeuralNetwork::CreateResizedProxy(*Proxy, ScaleResolution(Proxy->InputResolution, RealtimeStyleTransfer::FoveationPeripheryScale));
+		}
+	}
 }
 
-void FRealtimeStyleTransferViewExtension::PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView)
+bool FRealtimeStyleTransferViewExtension::SetStyleLODSet(UStyleTransferModelLODSet* LODSet)
+{
+	if (!LODSet || LODSet->LODs.IsEmpty())
+	{
+		UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("SetStyleLODSet: '%s' has no LODs; keeping the current style."), *GetNameSafe(LODSet));
+		return false;
+	}
+
+	// Every variant, with its chain stages and stencil styles, is created and warmed up now, so the governor's switches
+	// never load a model or create an instance.
+	TArray<FStyleLOD> LODs;
+	for (int32 LODIndex = 0; LODIndex < LODSet->LODs.Num(); ++LODIndex)
+	{
+		const FStyleTransferModelLOD& LOD = LODSet->LODs[LODIndex];
+		FStyleLOD& Entry = LODs.AddDefaulted_GetRef();
+		Entry.ModelData = LOD.ModelData;
+		Entry.Proxy = ModelProxy.IsValid() && IsSameModel(*ModelProxy, ActiveModelData.Get(), LOD.ModelData, LOD.RuntimeName)
+			? ModelProxy
+			: UMyNeuralNetwork::CreateProxy(LOD.ModelData, LOD.RuntimeName);
+
+		if (!Entry.Proxy.IsValid())
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Error, TEXT("SetStyleLODSet: failed to create LOD %d ('%s') of '%s'; keeping the current style."),
+				LODIndex,
+				*GetNameSafe(LOD.ModelData),
+				*LODSet->GetName());
+			return false;
+		}
+
+		if (Entry.Proxy == ModelProxy)
+		{
+			Entry.FoveaProxy = FoveaProxy;
+			Entry.PeripheryProxy = PeripheryProxy;
+		}
+		else
+		{
+			CreateFoveationProxies(Entry.Proxy, Entry.FoveaProxy, Entry.PeripheryProxy);
+		}
+
+		for (const FStyleTransferProxyPtr& Proxy : { Entry.Proxy, Entry.FoveaProxy, Entry.PeripheryProxy })
+		{
+			StyleTransferPrecache::WarmUp(Proxy);
+		}
+
+		UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Style LOD %d: '%s' at %dx%d."),
+			LODIndex,
+			*LOD.ModelData->GetName(),
+			Entry.Proxy->InputResolution.X,
+			Entry.Proxy->InputResolution.Y);
+	}
+
+	ActiveLODSet.Reset(LODSet);
+	StyleLODs = MoveTemp(LODs);
+	ActiveStyleLOD = INDEX_NONE;
+	LODGovernor.Reset(GFrameCounter);
+	for (FStyleLOD& LOD : StyleLODs)
+	{
+		LOD.ChainStages = CreateChainStages(LOD.Proxy);
+		LOD.StencilLayers = CreateStencilLayers(LOD.Proxy, LOD.ModelData.Get());
+	}
+
+	TArray<FStyleTransferProxyPtr> Proxies;
+	for (const FStyleLOD& LOD : StyleLODs)
+	{
+		Proxies.Add(LOD.Proxy);
+	}
+	ENQUEUE_RENDER_COMMAND(SetStyleTransferLODs)(
+		[Proxies = MoveTemp(Proxies)](FRHICommandListImmediate&) mutable
+		{
+			StyleLODProxies_RenderThread = MoveTemp(Proxies);
+		});
+
+	const int32 ForcedLOD = RealtimeStyleTransfer::LODForce;
+	SwitchStyleLOD(ForcedLOD >= 0
+		? FMath::Min(ForcedLOD, StyleLODs.Num() - 1)
+		: LODSet->GetFirstAllowedLOD(Scalability::GetQualityLevels().PostProcessQuality));
+
+	RealtimeStyleTransfer::IsActive = 1;
+
+	if (IConsoleVariable* CVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Enable")))
+	{
+		CVar->Set(1, ECVF_SetByCode);
+	}
+	return true;
+}
+
+int32 FRealtimeStyleTransferViewExtension::GetActiveStyleLOD()
 {
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("PreRenderView_RenderThread: View=%p"), static_cast<const void*>(&InView));
+	return ActiveStyleLOD;
 }
 
-namespace
+void FRealtimeStyleTransferViewExtension::SwitchStyleLOD(int32 LODIndex)
 {
-	FIntVector MakeGroupCount(FIntPoint Resolution)
+	const FStyleLOD& LOD = StyleLODs[LODIndex];
+
+	// Variants of one conditional style share its style layout, so a blend set with SetStyleWeights carries over.
+	if (ModelProxy.IsValid() && ModelProxy != LOD.Proxy && ModelProxy->GetStyleCount() == LOD.Proxy->GetStyleCount())
 	{
-		const int32 GroupSize = FPStyleTransferShaders::kThreadGroupSize;
-		return FIntVector(
-			FMath::DivideAndRoundUp(Resolution.X, GroupSize),
-			FMath::DivideAndRoundUp(Resolution.Y, GroupSize),
-			1);
+		ENQUEUE_RENDER_COMMAND(CopyStyleTransferWeights)(
+			[Previous = ModelProxy, LOD](FRHICommandListImmediate&)
+			{
+				for (const FStyleTransferProxyPtr& Proxy : { LOD.Proxy, LOD.FoveaProxy, LOD.PeripheryProxy })
+				{
+					if (Proxy.IsValid())
+					{
+						Proxy->StyleWeights = Previous->StyleWeights;
+					}
+				}
+			});
 	}
+
+	UMyNeuralNetwork* Instance = NewObject<UMyNeuralNetwork>();
+	Instance->InitializeFromProxy(LOD.Proxy);
+	ModelOwner.Reset(Instance);
+	ModelProxy = LOD.Proxy;
+	FoveaProxy = LOD.FoveaProxy;
+	PeripheryProxy = LOD.PeripheryProxy;
+	ActiveModelData = LOD.ModelData;
+	ActiveStyleLOD = LODIndex;
+
+	// The variant's foveation instances, chain stages and stencil styles were resolved when the LOD set was activated.
+	SendFoveationToRenderThread(LOD.Proxy, LOD.FoveaProxy, LOD.PeripheryProxy);
+	SendChainToRenderThread(LOD.Proxy, LOD.ChainStages);
+	SendStencilLayersToRenderThread(LOD.StencilLayers);
+}
+
+void FRealtimeStyleTransferViewExtension::ResolveStyleLODs()
+{
+	for (FStyleLOD& LOD : StyleLODs)
+	{
+		LOD.ChainStages = CreateChainStages(LOD.Proxy);
+		LOD.StencilLayers = CreateStencilLayers(LOD.Proxy, LOD.ModelData.Get());
+	}
+
+	if (StyleLODs.IsValidIndex(ActiveStyleLOD))
+	{
+		const FStyleLOD& LOD = StyleLODs[ActiveStyleLOD];
+		SendChainToRenderThread(LOD.Proxy, LOD.ChainStages);
+		SendStencilLayersToRenderThread(LOD.StencilLayers);
+	}
+}
+
+void FRealtimeStyleTransferViewExtension::ResetStyleLODs()
+{
+	if (!ActiveLODSet.IsValid())
+	{
+		return;
+	}
+
+	ActiveLODSet.Reset();
+	StyleLODs.Reset();
+	ActiveStyleLOD = INDEX_NONE;
+	ENQUEUE_RENDER_COMMAND(ResetStyleTransferLODs)(
+		[](FRHICommandListImmediate&)
+		{
+			StyleLODProxies_RenderThread.Reset();
+		});
+}
+
+void FRealtimeStyleTransferViewExtension::TickStyleLODGovernor()
+{
+	if (StyleLODs.IsEmpty() || !ActiveLODSet.IsValid() || RealtimeStyleTransfer::IsActive <= 0 || LODGovernorTickFrame == GFrameCounter)
+	{
+		return;
+	}
+	LODGovernorTickFrame = GFrameCounter;
+
+	const int32 LastLOD = StyleLODs.Num() - 1;
+	int32 TargetLOD = ActiveStyleLOD;
+	if (RealtimeStyleTransfer::LODForce >= 0)
+	{
+		TargetLOD = FMath::Min(RealtimeStyleTransfer::LODForce, LastLOD);
+		if (TargetLOD != ActiveStyleLOD)
+		{
+			LODGovernor.Reset(GFrameCounter);
+		}
+	}
+	else
+	{
+		FStyleTransferLODGovernorSettings Settings;
+		Settings.TargetGpuMs = RealtimeStyleTransfer::LODTargetGpuMs;
+		Settings.UpThreshold = RealtimeStyleTransfer::LODUpThreshold;
+		Settings.DownFrames = RealtimeStyleTransfer::LODDownFrames;
+		Settings.UpFrames = RealtimeStyleTransfer::LODUpFrames;
+
+		const int32 FirstAllowedLOD = FMath::Clamp(ActiveLODSet->GetFirstAllowedLOD(Scalability::GetQualityLevels().PostProcessQuality), 0, LastLOD);
+		const double SmoothedGpuMs = LODGovernor.SmoothedGpuMs;
+		TargetLOD = LODGovernor.Tick(GFrameCounter, FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()), ActiveStyleLOD, FirstAllowedLOD, LastLOD, Settings);
+		if (TargetLOD != ActiveStyleLOD)
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Log, TEXT("Style LOD %d -> %d (GPU %.1f ms, target %.1f ms, up backoff %dx)."),
+				ActiveStyleLOD,
+				TargetLOD,
+				SmoothedGpuMs,
+				Settings.TargetGpuMs,
+				LODGovernor.UpBackoff);
+		}
+	}
+
+	if (TargetLOD != ActiveStyleLOD)
+	{
+		SwitchStyleLOD(TargetLOD);
+	}
+}
+
+bool FRealtimeStyleTransferViewExtension::IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const
+{
+	return ViewExtensionIsActive;
+}
+
+void FRealtimeStyleTransferViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+	SCOPE_CYCLE_COUNTER(STAT_StyleTransfer_BeginRenderViewFamily);
+
+	TickStyleLODGovernor();
+
+	static const IConsoleVariable* MaskStencilVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Mask.Stencil"));
+	const bool bMaskStencil = RealtimeStyleTransfer::Mask > 0 && MaskStencilVar && MaskStencilVar->GetInt() != 0;
+	CheckCustomDepthMode(RealtimeStyleTransfer::IsActive > 0 && (bMaskStencil || !StencilStyles.IsEmpty()));
+}
+
+void FRealtimeStyleTransferViewExtension::PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily)
+{
+	if (FrameCapture_RenderThread.IsValid())
+	{
+		FrameCapture_RenderThread->Poll();
+	}
+
+	for (int32 Index = RetiringFrameCaptures_RenderThread.Num() - 1; Index >= 0; --Index)
+	{
+		RetiringFrameCaptures_RenderThread[Index]->Poll();
+		if (!RetiringFrameCaptures_RenderThread[Index]->HasPendingReadbacks())
+		{
+			RetiringFrameCaptures_RenderThread.RemoveAtSwap(Index);
+		}
+	}
+}
+
+void FRealtimeStyleTransferViewExtension::PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView)
+{
 }
 
 FRDGTextureRef FRealtimeStyleTransferViewExtension::ExecuteStyleTransfer(
 	FRDGBuilder& GraphBuilder,
 	FRDGTextureRef SourceTexture,
 	const FIntRect& ViewRect,
-	FRDGTextureRef DestinationTexture)
+	FRDGTextureRef DestinationTexture,
+	const StyleTransferPasses::FMaskInputs* MaskInputs)
 {
+	SCOPE_CYCLE_COUNTER(STAT_StyleTransfer_Execute);
+
 	if (!ModelProxy.IsValid() || SourceTexture == nullptr || !ViewRect.Area())
 	{
 		if (!ModelProxy.IsValid())
@@ -152,17 +1301,8 @@ FRDGTextureRef FRealtimeStyleTransferViewExtension::ExecuteStyleTransfer(
 		return DestinationTexture ? DestinationTexture : SourceTexture;
 	}
 
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("ExecuteStyleTransfer start: source=%p, view=(%d,%d)-(%d,%d)."),
-		static_cast<const void*>(SourceTexture),
-		ViewRect.Min.X,
-		ViewRect.Min.Y,
-		ViewRect.Max.X,
-		ViewRect.Max.Y);
-
 	const FStyleTransferProxyPtr LocalProxy = ModelProxy;
-	IConsoleVariable* EnableCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Enable"));
-	const bool bCVarEnabled = !EnableCVar || EnableCVar->GetInt() > 0;
-	if (!bCVarEnabled)
+	if (RealtimeStyleTransfer::IsActive <= 0)
 	{
 		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Skipping style transfer: console variable disabled."));
 		return DestinationTexture ? DestinationTexture : SourceTexture;
@@ -175,137 +1315,395 @@ FRDGTextureRef FRealtimeStyleTransferViewExtension::ExecuteStyleTransfer(
 		return SourceTexture;
 	}
 
-	const uint32 ChannelCount = static_cast<uint32>(FMath::Max(LocalProxy->InputChannels, 1));
-	const uint32 PlaneSize = ModelResolution.X * ModelResolution.Y;
-	const uint32 TensorElementCount = PlaneSize * ChannelCount;
+	StageTimings_RenderThread = FStyleTransferStageTimings();
+	FStageGpuQueries& GpuQueries = GetStageGpuQueries();
+	GpuQueries.Resolve(StageTimings_RenderThread);
+	GpuQueries.BeginFrame(GFrameCounterRenderThread);
+	ON_SCOPE_EXIT
+	{
+		GpuQueries.EndFrame();
+	};
+	const int32 TotalBeginQuery = GpuQueries.AddTimestamp(GraphBuilder);
+	const uint64 StartCycles = FPlatformTime::Cycles64();
 
-	FRDGBufferRef InputTensor = GraphBuilder.CreateBuffer(
-		FRDGBufferDesc::CreateBufferDesc(sizeof(float), TensorElementCount),
-		TEXT("StyleTransfer.InputTensor"));
+	const TConstArrayView<FStyleTransferProxyPtr> ChainStages = ChainStyle_RenderThread == LocalProxy
+		? TConstArrayView<FStyleTransferProxyPtr>(ChainStages_RenderThread)
+		: TConstArrayView<FStyleTransferProxyPtr>();
 
-	FRDGBufferRef OutputTensor = GraphBuilder.CreateBuffer(
-		FRDGBufferDesc::CreateBufferDesc(sizeof(float), TensorElementCount),
-		TEXT("StyleTransfer.OutputTensor"));
+	// Masked tiles are never written, so they must already hold the original frame in the destination.
+	const bool bTiled = MaskInputs != nullptr
+		&& RealtimeStyleTransfer::Mask > 0
+		&& RealtimeStyleTransfer::Foveation <= 0
+		&& DestinationTexture == SourceTexture;
 
-	// Encode screen texture into CHW tensor
+	const FStencilStyleLayers* StencilLayers = MaskInputs != nullptr && MaskInputs->CustomStencil != nullptr
+		? GetStencilLayers(LocalProxy, !ChainStages.IsEmpty())
+		: nullptr;
+
+	// The raster composite never binds the output as a UAV, so it keeps its render target compression.
+	const bool bRaster = !bTiled && !StencilLayers && RealtimeStyleTransfer::Foveation <= 0 && StyleTransferPasses::UseRasterComposite();
+
+	FRDGTextureDesc OutputDesc = SourceTexture->Desc;
+	if (bRaster)
 	{
-		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling encode pass: ModelResolution=%dx%d, ViewSize=%dx%d."),
-			ModelResolution.X,
-			ModelResolution.Y,
-			ViewRect.Width(),
-			ViewRect.Height());
-		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FEncodeCS::FParameters>();
-		Parameters->ModelResolution = ModelResolution;
-		Parameters->ViewMin = FVector2f(ViewRect.Min.X, ViewRect.Min.Y);
-		Parameters->ViewSize = FVector2f(ViewRect.Width(), ViewRect.Height());
-		Parameters->SourceExtent = FVector2f(SourceTexture->Desc.Extent.X, SourceTexture->Desc.Extent.Y);
-		Parameters->EncodeScale = 1.0f;
-		Parameters->EncodeBias = 0.0f;
-		Parameters->ChannelCount = ChannelCount;
-		Parameters->SourceTexture = SourceTexture;
-		Parameters->SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		Parameters->OutputTensor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(InputTensor, PF_R32_FLOAT));
-
-		TShaderMapRef<FPStyleTransferShaders::FEncodeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-		FComputeShaderUtils::AddPass(
-			GraphBuilder,
-			RDG_EVENT_NAME("StyleTransfer.Encode"),
-			Shader,
-			Parameters,
-			MakeGroupCount(ModelResolution));
+		OutputDesc.Flags |= TexCreate_ShaderResource | TexCreate_RenderTargetable;
+		OutputDesc.Flags &= ~TexCreate_UAV;
+	}
+	else
+	{
+		OutputDesc.Flags |= TexCreate_ShaderResource | TexCreate_UAV;
 	}
+	FRDGTextureRef OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("StyleTransfer.Output"));
 
-	// Inference
+	FRDGTextureRef StylizedTexture = nullptr;
+	StyleTransferPasses::FTileClassification Tiles;
+	if (RealtimeStyleTransfer::Foveation > 0)
+	{
+		StylizedTexture = AddFoveatedStyleTransfer(GraphBuilder, LocalProxy, SourceTexture, ViewRect, OutputTexture);
+	}
+	else
 	{
-		TArray<UE::NNE::FTensorBindingRDG> InputBindings;
-		TArray<UE::NNE::FTensorBindingRDG> OutputBindings;
-		InputBindings.Emplace_GetRef().Buffer = InputTensor;
-		OutputBindings.Emplace_GetRef().Buffer = OutputTensor;
+		const StyleTransferPasses::FDispatchPlan& Plan = UpdateDispatchPlan(ViewPlan_RenderThread, LocalProxy, ViewRect, SourceTexture->Desc.Extent, ChainStages);
+		if (bTiled)
+		{
+			FScopedStageTimer CompositeTimer(GraphBuilder, EStyleTransferStage::Composite, StageTimings_RenderThread.CompositeMs);
+			Tiles = StyleTransferPasses::AddTileClassificationPass(GraphBuilder, ViewRect, *MaskInputs);
+		}
+
+		TArray<FRDGTextureRef> LayerTextures;
+		StylizedTexture = StencilLayers
+			? AddStencilStylizePasses(GraphBuilder, *LocalProxy, Plan, SourceTexture, *StencilLayers, LayerTextures)
+			: AddStylizePasses(GraphBuilder, *LocalProxy, Plan, SourceTexture);
+		if (StylizedTexture)
+		{
+			// Upscale and composite back to the scene texture size
+			FScopedStageTimer CompositeTimer(GraphBuilder, EStyleTransferStage::Composite, StageTimings_RenderThread.CompositeMs);
+			if (bTiled)
+			{
+				StyleTransferPasses::AddTiledUpscalePass(GraphBuilder, Plan, Tiles, StylizedTexture, OutputTexture, SourceTexture);
+			}
+			else if (bRaster)
+			{
+				StyleTransferPasses::AddRasterUpscalePass(GraphBuilder, Plan, StylizedTexture, OutputTexture, SourceTexture);
+			}
+			else
+			{
+				StyleTransferPasses::AddUpscalePass(GraphBuilder, Plan, StylizedTexture, OutputTexture, SourceTexture);
+			}
 
-		const UE::NNE::IModelInstanceRDG::EEnqueueRDGStatus Status =
-			LocalProxy->ModelInstance->EnqueueRDG(GraphBuilder, InputBindings, OutputBindings);
+			if (StencilLayers)
+			{
+				StyleTransferPasses::AddStencilCompositePass(GraphBuilder, ViewRect, *MaskInputs, bTiled, StencilLayers->StencilToLayer, LayerTextures, SourceTexture, OutputTexture);
+			}
+		}
+	}
 
-	if (Status != UE::NNE::IModelInstanceRDG::EEnqueueRDGStatus::Ok)
+	if (!StylizedTexture)
 	{
-		UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("Failed to enqueue NNE inference, status=%d"), static_cast<int32>(Status));
 		return SourceTexture;
 	}
 
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("NNE inference enqueued successfully."));
+	// StyleTransfer.* RDG resources of this frame: the output target, a periphery target and each pass's tensors.
+	const int64 TargetBytes = static_cast<int64>(OutputDesc.Extent.X) * OutputDesc.Extent.Y * GPixelFormats[OutputDesc.Format].BlockBytes;
+	int64 FrameResourceBytes = TargetBytes;
+	if (RealtimeStyleTransfer::Foveation > 0)
+	{
+		FStyleTransferProxyPtr Fovea;
+		FStyleTransferProxyPtr Periphery;
+		GetFoveationProxies(LocalProxy, Fovea, Periphery);
+		FrameResourceBytes += StyleTransferPasses::GetFrameResourceBytes(*Fovea, 1);
+		if (Periphery.IsValid())
+		{
+			FrameResourceBytes += StyleTransferPasses::GetFrameResourceBytes(*Periphery, 1) + TargetBytes;
+		}
+	}
+	else
+	{
+		if (!StencilLayers || StencilLayers->BaseGroup == INDEX_NONE)
+		{
+			FrameResourceBytes += StyleTransferPasses::GetFrameResourceBytes(*LocalProxy, 1);
+		}
+		if (StencilLayers)
+		{
+			for (const FStencilStyleGroup& Group : StencilLayers->Groups)
+			{
+				FrameResourceBytes += StyleTransferPasses::GetFrameResourceBytes(*Group.Proxy, Group.SliceWeights.Num());
+			}
+		}
+		for (const FStyleTransferProxyPtr& Stage : ChainStages)
+		{
+			FrameResourceBytes += StyleTransferPasses::GetFrameResourceBytes(*Stage, 1);
+		}
+		if (bTiled)
+		{
+			FrameResourceBytes += Tiles.TileList->Desc.GetSize() + Tiles.IndirectArgs->Desc.GetSize();
+		}
 	}
+	StyleTransferMemory::SetFrameResourceBytes(FrameResourceBytes);
 
-	// Decode tensor to low-res texture
-	FRDGTextureDesc StylizedDesc = FRDGTextureDesc::Create2D(
-		ModelResolution,
-		PF_FloatRGBA,
-		FClearValueBinding::Transparent,
-		TexCreate_ShaderResource | TexCreate_UAV);
-	FRDGTextureRef StylizedTexture = GraphBuilder.CreateTexture(StylizedDesc, TEXT("StyleTransfer.StylizedLowRes"));
-
-	{
-		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling decode pass to texture %p."),
-			static_cast<const void*>(StylizedTexture));
-		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FDecodeCS::FParameters>();
-		Parameters->ModelResolution = ModelResolution;
-		Parameters->DecodeScale = 1.0f / 255.0f;
-		Parameters->DecodeBias = 0.0f;
-		Parameters->ChannelCount = ChannelCount;
-		Parameters->InputTensor = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(OutputTensor, PF_R32_FLOAT));
-		Parameters->StylizedOutput = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(StylizedTexture));
-
-		TShaderMapRef<FPStyleTransferShaders::FDecodeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-		FComputeShaderUtils::AddPass(
+	if (bTiled)
+	{
+		FScopedStageTimer CompositeTimer(GraphBuilder, EStyleTransferStage::Composite, StageTimings_RenderThread.CompositeMs);
+		StyleTransferPasses::AddTileCopyPass(GraphBuilder, Tiles, OutputTexture, DestinationTexture);
+	}
+	else if (DestinationTexture)
+	{
+		if (DestinationTexture != OutputTexture)
+		{
+			AddCopyTexturePass(GraphBuilder, OutputTexture, DestinationTexture);
+		}
+		else
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("Destination texture is identical to output texture; skipping copy."));
+		}
+	}
+	GpuQueries.AddInterval(EStyleTransferStage::Total, TotalBeginQuery, GpuQueries.AddTimestamp(GraphBuilder));
+
+	// Published after the tile copy, whose composite time and the total both include it.
+	StageTimings_RenderThread.TotalMs = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+	StageTimings_RenderThread.Frame = GFrameCounterRenderThread;
+	StageTimings_RenderThread.ModelLOD = StyleLODProxies_RenderThread.Find(LocalProxy);
+	if (StageTimings_RenderThread.ModelLOD != INDEX_NONE)
+	{
+		SET_DWORD_STAT(STAT_StyleTransfer_ModelLOD, StageTimings_RenderThread.ModelLOD);
+	}
+	{
+		FScopeLock Lock(&LastStageTimingsLock);
+		LastStageTimings = StageTimings_RenderThread;
+	}
+
+	if (FrameCapture_RenderThread.IsValid())
+	{
+		// With tiling, masked tiles of the output were never written; the destination holds the full frame.
+		const bool bCaptureOutput = FrameCapture_RenderThread->GetSource() == EStyleTransferCaptureSource::Output;
+		FrameCapture_RenderThread->Enqueue(
 			GraphBuilder,
-			RDG_EVENT_NAME("StyleTransfer.Decode"),
-			Shader,
-			Parameters,
-			MakeGroupCount(ModelResolution));
+			bCaptureOutput ? (bTiled ? DestinationTexture : OutputTexture) : StylizedTexture,
+			bCaptureOutput ? ViewRect : FIntRect(FIntPoint::ZeroValue, StylizedTexture->Desc.Extent),
+			GFrameCounterRenderThread);
 	}
 
-	// Upscale and composite back to the scene texture size
-	FRDGTextureDesc OutputDesc = SourceTexture->Desc;
-	OutputDesc.Flags |= TexCreate_ShaderResource | TexCreate_UAV;
-	FRDGTextureRef OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("StyleTransfer.Output"));
+	return DestinationTexture ? DestinationTexture : OutputTexture;
+}
 
+const StyleTransferPasses::FDispatchPlan& FRealtimeStyleTransferViewExtension::UpdateDispatchPlan(
+	TSharedPtr<const StyleTransferPasses::FDispatchPlan>& CachedPlan,
+	const FStyleTransferProxyPtr& Proxy,
+	const FIntRect& Rect,
+	FIntPoint SourceExtent,
+	TConstArrayView<FStyleTransferProxyPtr> Stages)
+{
+	if (!CachedPlan.IsValid() || !CachedPlan->IsCurrent(Proxy, Rect, SourceExtent, Stages))
 	{
-		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscaleCS::FParameters>();
-		Parameters->SourceResolution = ModelResolution;
-		Parameters->TargetResolution = ViewRect.Size();
-		Parameters->TargetOffset = ViewRect.Min;
-		Parameters->SourceTexture = StylizedTexture;
-		Parameters->SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(OutputTexture));
+		CachedPlan = StyleTransferPasses::CreateDispatchPlan(Proxy, Rect, SourceExtent, Stages);
+		StyleTransferPrecache::EnsurePipelines(*CachedPlan);
+	}
+	return *CachedPlan;
+}
 
-		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling upscale pass: %dx%d -> %dx%d."),
-			ModelResolution.X,
-			ModelResolution.Y,
-			ViewRect.Width(),
-			ViewRect.Height());
+FRDGTextureRef FRealtimeStyleTransferViewExtension::AddStylizePasses(
+	FRDGBuilder& GraphBuilder,
+	const FStyleTransferProxy& Proxy,
+	const StyleTransferPasses::FDispatchPlan& Plan,
+	FRDGTextureRef SourceTexture,
+	FRDGBufferRef* OutInputTensor)
+{
+	// The built-in executor encodes and decodes inside its first and last layers.
+	if (Proxy.ConvNet.IsValid())
+	{
+		FScopedStageTimer InferenceTimer(GraphBuilder, EStyleTransferStage::Inference, StageTimings_RenderThread.InferenceMs);
+		return Proxy.ConvNet->AddPasses(GraphBuilder, SourceTexture, Plan.Rect, Proxy.InputResolution);
+	}
 
-		TShaderMapRef<FPStyleTransferShaders::FUpscaleCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-		FComputeShaderUtils::AddPass(
-			GraphBuilder,
-			RDG_EVENT_NAME("StyleTransfer.UpScale"),
-			Shader,
-			Parameters,
-			MakeGroupCount(ViewRect.Size()));
+	FRDGBufferRef InputTensor = nullptr;
+	FRDGBufferRef OutputTensor = nullptr;
+
+	// Encode screen texture into CHW tensor
+	{
+		FScopedStageTimer EncodeTimer(GraphBuilder, EStyleTransferStage::Encode, StageTimings_RenderThread.EncodeMs);
+		InputTensor = StyleTransferPasses::CreateInputTensor(GraphBuilder, Proxy, 1);
+		OutputTensor = StyleTransferPasses::CreateOutputTensor(GraphBuilder, Proxy, 1);
+		StyleTransferPasses::AddEncodePass(GraphBuilder, Plan, SourceTexture, InputTensor);
 	}
 
-	if (DestinationTexture)
+	if (OutInputTensor)
 	{
-		if (DestinationTexture != OutputTexture)
+		*OutInputTensor = InputTensor;
+	}
+
+	// Inference
+	{
+		FScopedStageTimer InferenceTimer(GraphBuilder, EStyleTransferStage::Inference, StageTimings_RenderThread.InferenceMs);
+		if (!StyleTransferPasses::AddInferencePass(GraphBuilder, Proxy, *Proxy.ModelInstance, InputTensor, OutputTensor))
 		{
-			AddCopyTexturePass(GraphBuilder, OutputTexture, DestinationTexture);
-			UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Copying stylized texture back into destination."));
+			return nullptr;
 		}
-		else
+
+		// Chain stages (e.g. super-resolution) consume the output tensor directly
+		OutputTensor = StyleTransferPasses::AddChainPasses(GraphBuilder, Plan, OutputTensor);
+		if (!OutputTensor)
 		{
-			UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("Destination texture is identical to output texture; skipping copy."));
+			return nullptr;
 		}
-		return DestinationTexture;
 	}
 
-	return OutputTexture;
+	// Decode tensor to low-res texture
+	FScopedStageTimer DecodeTimer(GraphBuilder, EStyleTransferStage::Decode, StageTimings_RenderThread.DecodeMs);
+	return StyleTransferPasses::AddDecodePass(GraphBuilder, Plan, OutputTensor);
+}
+
+FRDGTextureRef FRealtimeStyleTransferViewExtension::AddStencilStylizePasses(
+	FRDGBuilder& GraphBuilder,
+	const FStyleTransferProxy& Proxy,
+	const StyleTransferPasses::FDispatchPlan& Plan,
+	FRDGTextureRef SourceTexture,
+	const FStencilStyleLayers& Layers,
+	TArray<FRDGTextureRef>& LayerTextures)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.StencilStyles");
+
+	FRDGTextureRef StylizedTexture = nullptr;
+	FRDGBufferRef SharedInput = nullptr;
+	if (Layers.BaseGroup == INDEX_NONE)
+	{
+		StylizedTexture = AddStylizePasses(GraphBuilder, Proxy, Plan, SourceTexture, &SharedInput);
+		if (!StylizedTexture)
+		{
+			return nullptr;
+		}
+	}
+
+	// The active style's group runs first, so the others can copy its encoded frame.
+	TArray<int32, TInlineAllocator<FPStyleTransferShaders::kMaxStencilStyles>> GroupOrder;
+	for (int32 GroupIndex = 0; GroupIndex < Layers.Groups.Num(); ++GroupIndex)
+	{
+		GroupOrder.Insert(GroupIndex, GroupIndex == Layers.BaseGroup ? 0 : GroupOrder.Num());
+	}
+
+	TArray<TArray<FRDGTextureRef>, TInlineAllocator<FPStyleTransferShaders::kMaxStencilStyles>> GroupTextures;
+	GroupTextures.SetNum(Layers.Groups.Num());
+	for (const int32 GroupIndex : GroupOrder)
+	{
+		const FStencilStyleGroup& Group = Layers.Groups[GroupIndex];
+		const FStyleTransferProxy& GroupProxy = *Group.Proxy;
+		const uint32 BatchSize = Group.SliceWeights.Num();
+		const bool bBaseGroup = GroupIndex == Layers.BaseGroup;
+		const bool bSharesInput = SharedInput && StyleTransferPasses::SharesInput(Proxy, GroupProxy);
+
+		FRDGBufferRef InputTensor = nullptr;
+		FRDGBufferRef OutputTensor = nullptr;
+		{
+			FScopedStageTimer EncodeTimer(GraphBuilder, EStyleTransferStage::Encode, StageTimings_RenderThread.EncodeMs);
+
+			// Every slice stylizes the same frame, so it is encoded once per input layout and copied into the slices.
+			FRDGBufferRef FrameTensor = bSharesInput ? SharedInput : nullptr;
+			if (!FrameTensor)
+			{
+				FrameTensor = StyleTransferPasses::CreateInputTensor(GraphBuilder, GroupProxy, 1);
+				if (bBaseGroup)
+				{
+					StyleTransferPasses::AddEncodePass(GraphBuilder, Plan, SourceTexture, FrameTensor);
+				}
+				else
+				{
+					StyleTransferPasses::AddEncodePass(GraphBuilder, GroupProxy, SourceTexture, Plan.Rect, FrameTensor, 0);
+				}
+			}
+			if (bBaseGroup)
+			{
+				SharedInput = FrameTensor;
+			}
+
+			if (BatchSize == 1)
+			{
+				InputTensor = FrameTensor;
+			}
+			else
+			{
+				InputTensor = StyleTransferPasses::CreateInputTensor(GraphBuilder, GroupProxy, BatchSize);
+				for (uint32 Slice = 0; Slice < BatchSize; ++Slice)
+				{
+					StyleTransferPasses::AddCopyInputSlicePass(GraphBuilder, GroupProxy, FrameTensor, InputTensor, Slice);
+				}
+			}
+			OutputTensor = StyleTransferPasses::CreateOutputTensor(GraphBuilder, GroupProxy, BatchSize);
+		}
+
+		{
+			FScopedStageTimer InferenceTimer(GraphBuilder, EStyleTransferStage::Inference, StageTimings_RenderThread.InferenceMs);
+			TArray<TArray<float>> BaseSliceWeights;
+			if (bBaseGroup)
+			{
+				BaseSliceWeights = Group.SliceWeights;
+				BaseSliceWeights[0] = Proxy.StyleWeights;
+			}
+
+			if (!StyleTransferPasses::AddInferencePass(GraphBuilder, GroupProxy, *Group.Instance, InputTensor, OutputTensor, bBaseGroup ? BaseSliceWeights : Group.SliceWeights))
+			{
+				return nullptr;
+			}
+		}
+
+		FScopedStageTimer DecodeTimer(GraphBuilder, EStyleTransferStage::Decode, StageTimings_RenderThread.DecodeMs);
+		GroupTextures[GroupIndex].SetNumZeroed(BatchSize);
+		for (uint32 Slice = 0; Slice < BatchSize; ++Slice)
+		{
+			if (bBaseGroup && Slice == 0)
+			{
+				StylizedTexture = StyleTransferPasses::AddDecodePass(GraphBuilder, Plan, OutputTensor);
+			}
+			else
+			{
+				GroupTextures[GroupIndex][Slice] = StyleTransferPasses::AddDecodePass(GraphBuilder, GroupProxy, OutputTensor, Slice);
+			}
+		}
+	}
+
+	for (const FIntPoint& Layer : Layers.Layers)
+	{
+		LayerTextures.Add(GroupTextures[Layer.X][Layer.Y]);
+	}
+	return StylizedTexture;
+}
+
+FRDGTextureRef FRealtimeStyleTransferViewExtension::AddFoveatedStyleTransfer(
+	FRDGBuilder& GraphBuilder,
+	const FStyleTransferProxyPtr& Proxy,
+	FRDGTextureRef SourceTexture,
+	const FIntRect& ViewRect,
+	FRDGTextureRef OutputTexture)
+{
+	FStyleTransferProxyPtr LocalFovea;
+	FStyleTransferProxyPtr LocalPeriphery;
+	GetFoveationProxies(Proxy, LocalFovea, LocalPeriphery);
+	const FIntRect FoveaRect = ComputeFoveaRect(ViewRect, LocalFovea->InputResolution, FoveationCenter_RenderThread);
+
+	// Without a periphery pass the fovea fades into the original frame.
+	FRDGTextureRef BackgroundTexture = SourceTexture;
+	if (LocalPeriphery.IsValid())
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.Periphery");
+		const StyleTransferPasses::FDispatchPlan& PeripheryPlan = UpdateDispatchPlan(PeripheryPlan_RenderThread, LocalPeriphery, ViewRect, SourceTexture->Desc.Extent);
+		if (FRDGTextureRef PeripheryStylized = AddStylizePasses(GraphBuilder, *LocalPeriphery, PeripheryPlan, SourceTexture))
+		{
+			FScopedStageTimer CompositeTimer(GraphBuilder, EStyleTransferStage::Composite, StageTimings_RenderThread.CompositeMs);
+			BackgroundTexture = GraphBuilder.CreateTexture(OutputTexture->Desc, TEXT("StyleTransfer.Periphery"));
+			StyleTransferPasses::AddUpscalePass(GraphBuilder, PeripheryPlan, PeripheryStylized, BackgroundTexture, SourceTexture);
+		}
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.Fovea");
+	const StyleTransferPasses::FDispatchPlan& FoveaPlan = UpdateDispatchPlan(FoveaPlan_RenderThread, LocalFovea, FoveaRect, SourceTexture->Desc.Extent);
+	FRDGTextureRef FoveaStylized = AddStylizePasses(GraphBuilder, *LocalFovea, FoveaPlan, SourceTexture);
+	if (!FoveaStylized)
+	{
+		return nullptr;
+	}
+
+	FScopedStageTimer CompositeTimer(GraphBuilder, EStyleTransferStage::Composite, StageTimings_RenderThread.CompositeMs);
+	const float FeatherWidth = FoveaRect.Height() * FMath::Clamp(RealtimeStyleTransfer::FoveationFeather, 0.0f, 0.5f);
+	StyleTransferPasses::AddFoveatedCompositePass(GraphBuilder, BackgroundTexture, FoveaStylized, ViewRect, FoveaRect, FeatherWidth, OutputTexture);
+	return FoveaStylized;
 }
 
 void FRealtimeStyleTransferViewExtension::SubscribeToPostProcessingPass(
@@ -320,8 +1718,7 @@ void FRealtimeStyleTransferViewExtension::SubscribeToPostProcessingPass(
     	return;
     }
 
-    IConsoleVariable* EnableCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Enable"));
-    const bool bCVarEnabled = !EnableCVar || EnableCVar->GetInt() > 0;
+    const bool bCVarEnabled = RealtimeStyleTransfer::IsActive > 0;
     const bool bModelAvailable = ModelProxy.IsValid();
 
     if (!bModelAvailable)
@@ -367,15 +1764,41 @@ FScreenPassTexture FRealtimeStyleTransferViewExtension::ApplyStyleTransfer(
 		return SceneColor;
 	}
 
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("ApplyStyleTransfer executing on %p, rect=(%d,%d)-(%d,%d)."),
-		static_cast<const void*>(SceneColor.Texture),
-		SceneColor.ViewRect.Min.X,
-		SceneColor.ViewRect.Min.Y,
-		SceneColor.ViewRect.Max.X,
-		SceneColor.ViewRect.Max.Y);
+	// Stencil styles read the custom stencil through the mask inputs.
+	const bool bStencilStyles = StencilLayers_RenderThread.IsValid() && RealtimeStyleTransfer::Foveation <= 0;
+	const bool bMaskInputs = RealtimeStyleTransfer::Mask > 0 || bStencilStyles;
+
+	StyleTransferPasses::FMaskInputs MaskInputs;
+	if (bMaskInputs)
+	{
+		if (InOutInputs.SceneTextures.SceneTextures)
+		{
+			const FSceneTextureUniformParameters* SceneTextures = InOutInputs.SceneTextures.SceneTextures->GetParameters();
+			MaskInputs.CustomStencil = SceneTextures->CustomStencilTexture;
+			MaskInputs.SceneDepth = SceneTextures->SceneDepthTexture;
+		}
+
+		check(View.bIsViewInfo);
+		MaskInputs.SceneViewRect = static_cast<const FViewInfo&>(View).ViewRect;
+		MaskInputs.InvDeviceZToWorldZ = FVector4f(View.InvDeviceZToWorldZTransform);
+		MaskInputs.Rects.Append(MaskRects_RenderThread);
+	}
+
+	// The raster composite hands its output on as the new scene color instead of copying it back, unless the tonemapper
+	// output has to be written in place (an override output, or masked tiles that keep the original frame).
+	const bool bReplaceSceneColor = StyleTransferPasses::UseRasterComposite()
+		&& !InOutInputs.OverrideOutput.IsValid()
+		&& RealtimeStyleTransfer::Mask <= 0
+		&& RealtimeStyleTransfer::Foveation <= 0
+		&& !bStencilStyles;
 
-	ExecuteStyleTransfer(GraphBuilder, SceneColor.Texture, SceneColor.ViewRect, SceneColor.Texture);
-	return SceneColor;
+	FRDGTextureRef Result = ExecuteStyleTransfer(
+		GraphBuilder,
+		SceneColor.Texture,
+		SceneColor.ViewRect,
+		bReplaceSceneColor ? nullptr : SceneColor.Texture,
+		bMaskInputs ? &MaskInputs : nullptr);
+	return bReplaceSceneColor ? FScreenPassTexture(Result, SceneColor.ViewRect) : SceneColor;
 }
 
 FScreenPassTexture FRealtimeStyleTransferViewExtension::AfterTonemap_RenderThread(
@@ -384,8 +1807,6 @@ FScreenPassTexture FRealtimeStyleTransferViewExtension::AfterTonemap_RenderThrea
 	const FPostProcessMaterialInputs& InOutInputs)
 {
 	RDG_EVENT_SCOPE(GraphBuilder, "RealtimeStyleTransfer_AfterTonemap");
-	UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("AfterTonemap_RenderThread invoked (ViewFamily=%p)"),
-		static_cast<const void*>(View.Family));
 	return ApplyStyleTransfer(GraphBuilder, View, InOutInputs, TEXT("StyleTransferTonemap"));
 }
 
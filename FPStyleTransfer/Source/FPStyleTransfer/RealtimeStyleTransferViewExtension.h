@@ -7,13 +7,143 @@
 #include "MyNeuralNetwork.h"
 #include "UObject/StrongObjectPtr.h"
 #include "NNEModelData.h"
+#include "StyleTransferFrameCapture.h"
+#include "StyleTransferModelLODSet.h"
+
+namespace StyleTransferPasses
+{
+	struct FDispatchPlan;
+	struct FMaskInputs;
+}
+
+/**
+ * Time spent on each stage of one ExecuteStyleTransfer call, in milliseconds: render thread time recording its passes,
+ * and GPU time between timestamps around them (r.RealtimeStyleTransfer.StageGpuTimings).
+ */
+struct FStyleTransferStageTimings
+{
+	double EncodeMs = 0.0;
+	/** NNE enqueue, or every layer of the built-in executor (which encodes and decodes inside its first and last layers). */
+	double InferenceMs = 0.0;
+	double DecodeMs = 0.0;
+	/** Upscale and, when foveated, the fovea/periphery composite. */
+	double CompositeMs = 0.0;
+	double TotalMs = 0.0;
+	/** Variant of the active LOD set that ran (see SetStyleLODSet), INDEX_NONE for a plain style. */
+	int32 ModelLOD = INDEX_NONE;
+	/** GFrameCounterRenderThread of the recorded frame; zero until a frame has been stylized. */
+	uint64 Frame = 0;
+	/** GPU time of the same stages; TotalGpuMs also covers the copy back to the scene texture. */
+	double EncodeGpuMs = 0.0;
+	double InferenceGpuMs = 0.0;
+	double DecodeGpuMs = 0.0;
+	double CompositeGpuMs = 0.0;
+	double TotalGpuMs = 0.0;
+	/** GFrameCounterRenderThread of the frame the GPU times were measured on, a few frames before Frame; zero until read. */
+	uint64 GpuFrame = 0;
+};
+
+/** A model SetChainStages runs on the output of the style model, e.g. a 2x/4x super-resolution network. */
+struct FStyleTransferChainStage
+{
+	UNNEModelData* ModelData = nullptr;
+	FName RuntimeName;
+	/** Model input value of a scene color of 1, and scene color of a model output value of 1. The defaults fit models trained on 0..1 images. */
+	float InputValueScale = 1.0f;
+	float OutputValueScale = 1.0f;
+};
+
+/** A style SetStencilStyles applies to the pixels of one custom stencil value instead of the active style. */
+struct FStyleTransferStencilStyle
+{
+	uint8 StencilValue = 0;
+	/** Null keeps the original frame under the stencil value. */
+	UNNEModelData* ModelData = nullptr;
+	FName RuntimeName;
+	/** Style of a conditional (multi-style) model; INDEX_NONE uses the model's default weights, or the active weights for the active model. */
+	int32 StyleIndex = INDEX_NONE;
+};
 
 class FRealtimeStyleTransferViewExtension : public FSceneViewExtensionBase
 {
 public:
 	FRealtimeStyleTransferViewExtension(const FAutoRegister& AutoRegister);
+	virtual ~FRealtimeStyleTransferViewExtension();
 
 	static void SetStyle(UNNEModelData* ModelData, FName RuntimeName);
+	/**
+	 * Activates a style whose proxy was already created (e.g. prefetched by the streaming subsystem). ModelData may be
+	 * null for proxies without one, such as memory-mapped files; without a proxy this is SetStyle.
+	 */
+	static void SetStyleWithProxy(UNNEModelData* ModelData, FName RuntimeName, FStyleTransferProxyPtr PrewarmedProxy);
+	/**
+	 * Activates a loose .onnx file (relative paths resolve against the project Content directory) through a memory-mapped
+	 * load, so no serialized copy of the model stays resident. GetActiveModelData returns null for such styles.
+	 */
+	static void SetStyleFromFile(const FString& FilePath, FName RuntimeName);
+	/**
+	 * Loads and warms up every variant of LODSet, activates the most expensive one the scalability settings allow and
+	 * from then on lets a governor move between them as the GPU frame time crosses r.RealtimeStyleTransfer.LOD.TargetGpuMs.
+	 * Switches swap preloaded proxies, chain stages and stencil styles, so they create no model instances. Any other
+	 * SetStyle call ends it. Returns false, keeping the current style, if a variant cannot be created. Game thread.
+	 */
+	static bool SetStyleLODSet(UStyleTransferModelLODSet* LODSet);
+	/** Variant of the LOD set the governor last picked, INDEX_NONE without a LOD set. Game thread. */
+	static int32 GetActiveStyleLOD();
+	static UNNEModelData* GetActiveModelData();
+	static FStyleTransferProxyPtr GetActiveProxy() { return ModelProxy; }
+	/** Object that owns the active style's model; it is only freed by garbage collection after the style is replaced. */
+	static UMyNeuralNetwork* GetActiveModelOwner() { return ModelOwner.Get(); }
+
+	/** Blends the styles of a conditional model. Weights are indexed by style; id-conditioned models use the largest weight. */
+	static void SetStyleWeights(TArray<float> Weights);
+	static int32 GetStyleCount();
+
+	/**
+	 * Starts delivering stylized frames to Callback on a worker thread, using a ring of RingDepth
+	 * non-blocking GPU readbacks. Frames are dropped oldest-first when the GPU falls behind.
+	 */
+	static void StartFrameCapture(FOnStyleTransferFrameCaptured Callback, int32 RingDepth = 3, EStyleTransferCaptureSource Source = EStyleTransferCaptureSource::Output);
+	static void StopFrameCapture();
+
+	/** Moves the center of the foveal region (r.RealtimeStyleTransfer.Foveation), in normalized view coordinates. Defaults to the screen center. */
+	static void SetFoveationCenter(FVector2f NormalizedCenter);
+
+	/**
+	 * Screen regions that keep the original frame while r.RealtimeStyleTransfer.Mask is on, e.g. under opaque HUD
+	 * widgets, in normalized view coordinates. At most FPStyleTransferShaders::kMaxMaskRects; an empty array clears them.
+	 */
+	static void SetMaskRects(const TArray<FBox2f>& NormalizedRects);
+
+	/**
+	 * Runs Stages, in order, on the style model's output tensor before it is decoded, so a low-resolution style model can
+	 * feed a super-resolution model instead of the upscale filter. Tensors stay in RDG buffers between stages. Each stage
+	 * must take the previous model's output shape; models with symbolic spatial dims are resized to it. Applies to the
+	 * whole-view pass only and follows later SetStyle calls. An empty array removes the chain. Returns false, keeping
+	 * the current chain, if a stage cannot be created. Game thread.
+	 */
+	static bool SetChainStages(const TArray<FStyleTransferChainStage>& Stages);
+
+	/**
+	 * Stylizes the pixels of each custom stencil value in Styles with its own style; all other pixels keep the active
+	 * style. Styles of one conditional model with a per-frame condition input run as the batch slices of one inference
+	 * (together with the active style when it is that model and no chain is set), models that take the active style's
+	 * input tensor reuse its encode, and one composite pass selects every pixel's style by stencil. At most
+	 * FPStyleTransferShaders::kMaxStencilStyles distinct styles; the rest keep the active style. Requires r.CustomDepth=3
+	 * and is not used with foveation. An empty array removes them. Returns false, keeping the current styles, if a model
+	 * cannot be created. Game thread.
+	 */
+	static bool SetStencilStyles(const TArray<FStyleTransferStencilStyle>& Styles);
+	static TArray<FStyleTransferStencilStyle> GetStencilStyles();
+
+	/** Stage timings of the most recently stylized frame. Any thread. */
+	static FStyleTransferStageTimings GetLastStageTimings();
+	/**
+	 * Stage GPU timestamps are written while r.RealtimeStyleTransfer.StageGpuTimings is on or at least one request is
+	 * held, so measurements can turn them on without touching the console variable. Any thread.
+	 */
+	static void AddStageGpuTimingsRequest();
+	static void RemoveStageGpuTimingsRequest();
 	
 	//~ ISceneViewExtension interface
 	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
@@ -31,8 +161,169 @@ private:
 	bool ViewExtensionIsActive;
 	static TStrongObjectPtr<UMyNeuralNetwork> ModelOwner;
 	static FStyleTransferProxyPtr ModelProxy;
+	/** Instances used by foveated rendering; FoveaProxy equals ModelProxy for fixed-shape models. */
+	static FStyleTransferProxyPtr FoveaProxy;
+	static FStyleTransferProxyPtr PeripheryProxy;
+	/** The render thread's copies of FoveaProxy and PeripheryProxy, and the style they were created for. */
+	static FStyleTransferProxyPtr FoveationStyle_RenderThread;
+	static FStyleTransferProxyPtr FoveaProxy_RenderThread;
+	static FStyleTransferProxyPtr PeripheryProxy_RenderThread;
+	static FVector2f FoveationCenter_RenderThread;
+	static TArray<FVector4f> MaskRects_RenderThread;
+	/** Chain stages as created by SetChainStages, and the stages resolved against the style they were resized for. */
+	static TArray<FStyleTransferProxyPtr> ChainProxies;
+	static FStyleTransferProxyPtr ChainStyle_RenderThread;
+	static TArray<FStyleTransferProxyPtr> ChainStages_RenderThread;
+	/** A stencil style as set by SetStencilStyles, with its model created; a null Proxy keeps the original frame. */
+	struct FStencilStyleEntry
+	{
+		uint8 StencilValue = 0;
+		TWeakObjectPtr<UNNEModelData> ModelData;
+		FName RuntimeName;
+		int32 StyleIndex = INDEX_NONE;
+		FStyleTransferProxyPtr Proxy;
+	};
+
+	/** One inference of the stencil styles: a model and the style weights of each of its batch slices. */
+	struct FStencilStyleGroup
+	{
+		FStyleTransferProxyPtr Proxy;
+		TSharedPtr<UE::NNE::IModelInstanceRDG> Instance;
+		/** Slice 0 of the base group takes the active style's live weights instead of its entry here. */
+		TArray<TArray<float>> SliceWeights;
+	};
+
+	/** Stencil styles resolved against the active style, as the render thread runs them. */
+	struct FStencilStyleLayers
+	{
+		FStyleTransferProxyPtr Style;
+		TArray<FStencilStyleGroup> Groups;
+		/** Group whose slice 0 is the active style itself, or INDEX_NONE when the active style runs on its own. */
+		int32 BaseGroup = INDEX_NONE;
+		/** Group (X) and batch slice (Y) of each stylized texture the composite selects between. */
+		TArray<FIntPoint> Layers;
+		/** Layer of each custom stencil value: 0 the active style, 1 + an index into Layers, or kStencilLayerOriginal. */
+		TArray<uint8> StencilToLayer;
+	};
+
+	static TArray<FStencilStyleEntry> StencilStyles;
+	static TSharedPtr<const FStencilStyleLayers, ESPMode::ThreadSafe> StencilLayers_RenderThread;
+	static TWeakObjectPtr<UNNEModelData> ActiveModelData;
+	static TSharedPtr<FStyleTransferFrameCapture, ESPMode::ThreadSafe> FrameCapture_RenderThread;
+	/** Stopped or replaced captures, polled until their in-flight readbacks retire. */
+	static TArray<TSharedPtr<FStyleTransferFrameCapture, ESPMode::ThreadSafe>> RetiringFrameCaptures_RenderThread;
+	static FStyleTransferStageTimings StageTimings_RenderThread;
+	/** Dispatch plans of the whole-view, fovea and periphery passes, rebuilt when their proxy, rect or the render cvars change. */
+	static TSharedPtr<const StyleTransferPasses::FDispatchPlan> ViewPlan_RenderThread;
+	static TSharedPtr<const StyleTransferPasses::FDispatchPlan> FoveaPlan_RenderThread;
+	static TSharedPtr<const StyleTransferPasses::FDispatchPlan> PeripheryPlan_RenderThread;
+	static FStyleTransferStageTimings LastStageTimings;
+	static FCriticalSection LastStageTimingsLock;
+
+	/** One preloaded variant of the active LOD set, with its chain stages and stencil styles resolved against it. */
+	struct FStyleLOD
+	{
+		FStyleTransferProxyPtr Proxy;
+		FStyleTransferProxyPtr FoveaProxy;
+		FStyleTransferProxyPtr PeripheryProxy;
+		TWeakObjectPtr<UNNEModelData> ModelData;
+		TArray<FStyleTransferProxyPtr> ChainStages;
+		TSharedPtr<const FStencilStyleLayers, ESPMode::ThreadSafe> StencilLayers;
+	};
+
+	static TStrongObjectPtr<UStyleTransferModelLODSet> ActiveLODSet;
+	static TArray<FStyleLOD> StyleLODs;
+	static int32 ActiveStyleLOD;
+	static FStyleTransferLODGovernor LODGovernor;
+	static uint64 LODGovernorTickFrame;
+	/** Proxies of StyleLODs, to tell which variant each frame ran. */
+	static TArray<FStyleTransferProxyPtr> StyleLODProxies_RenderThread;
+
+	static void ActivateStyle(UMyNeuralNetwork* Instance, UNNEModelData* ModelData, FName RuntimeName);
+
+	/** Creates the resized fovea and periphery proxies of a model with symbolic spatial dims; otherwise the fovea is Proxy itself. */
+	static void CreateFoveationProxies(const FStyleTransferProxyPtr& Proxy, FStyleTransferProxyPtr& OutFovea, FStyleTransferProxyPtr& OutPeriphery);
+
+	/** Makes StyleLODs[LODIndex] the active style, keeping the style weights of a conditional model. */
+	static void SwitchStyleLOD(int32 LODIndex);
+
+	/** Forgets the active LOD set, so the active style stays as it is. */
+	static void ResetStyleLODs();
+
+	/** Picks the LOD of the active LOD set for this frame from the GPU frame time and scalability. Game thread, once per frame. */
+	static void TickStyleLODGovernor();
+
+	/** Resizes ChainProxies to the active style's output and hands them to the render thread. */
+	static void ResolveChain();
+
+	/** Groups StencilStyles into inferences for the active style and hands them to the render thread. */
+	static void ResolveStencilStyles();
+
+	/** Re-resolves the chain stages and stencil styles of every variant of the active LOD set, then hands over the active one's. */
+	static void ResolveStyleLODs();
+
+	/** ChainProxies resized to follow Style, warmed up; empty when the chain is unset or does not fit. Game thread. */
+	static TArray<FStyleTransferProxyPtr> CreateChainStages(const FStyleTransferProxyPtr& Style);
+
+	/** StencilStyles grouped into warmed-up inferences for Style, created from StyleModelData; null when there are none. Game thread. */
+	static TSharedPtr<const FStencilStyleLayers, ESPMode::ThreadSafe> CreateStencilLayers(const FStyleTransferProxyPtr& Style, const UNNEModelData* StyleModelData);
+
+	/** Hands the chain stages of Style to the render thread; Stages empty disables the chain. */
+	static void SendChainToRenderThread(const FStyleTransferProxyPtr& Style, TArray<FStyleTransferProxyPtr> Stages);
+	static void SendStencilLayersToRenderThread(TSharedPtr<const FStencilStyleLayers, ESPMode::ThreadSafe> Layers);
+	/** Hands the fovea and periphery instances of Style to the render thread. */
+	static void SendFoveationToRenderThread(const FStyleTransferProxyPtr& Style, FStyleTransferProxyPtr Fovea, FStyleTransferProxyPtr Periphery);
+
+	/** The fovea and periphery instances foveated rendering uses for Proxy this frame. Render thread. */
+	static void GetFoveationProxies(const FStyleTransferProxyPtr& Proxy, FStyleTransferProxyPtr& OutFovea, FStyleTransferProxyPtr& OutPeriphery);
+
+	/** The stencil styles ExecuteStyleTransfer runs for Proxy this frame, or null. Render thread. */
+	static const FStencilStyleLayers* GetStencilLayers(const FStyleTransferProxyPtr& Proxy, bool bChained);
+
+	/**
+	 * Stylizes ViewRect of SourceTexture into DestinationTexture. With MaskInputs and r.RealtimeStyleTransfer.Mask, a
+	 * whole-view stylization in place (DestinationTexture == SourceTexture) only upscales and writes back unmasked tiles.
+	 */
+	FRDGTextureRef ExecuteStyleTransfer(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef SourceTexture,
+		const FIntRect& ViewRect,
+		FRDGTextureRef DestinationTexture,
+		const StyleTransferPasses::FMaskInputs* MaskInputs = nullptr);
+
+	/** Returns CachedPlan, first replacing it when it no longer matches Proxy, Stages, Rect and SourceExtent. */
+	static const StyleTransferPasses::FDispatchPlan& UpdateDispatchPlan(
+		TSharedPtr<const StyleTransferPasses::FDispatchPlan>& CachedPlan,
+		const FStyleTransferProxyPtr& Proxy,
+		const FIntRect& Rect,
+		FIntPoint SourceExtent,
+		TConstArrayView<FStyleTransferProxyPtr> Stages = {});
+
+	/**
+	 * Encodes the plan's rect of SourceTexture, runs Proxy and the plan's chain stages and returns the decoded texture at
+	 * the last model's output resolution, or null if inference could not be enqueued.
+	 */
+	static FRDGTextureRef AddStylizePasses(
+		FRDGBuilder& GraphBuilder,
+		const FStyleTransferProxy& Proxy,
+		const StyleTransferPasses::FDispatchPlan& Plan,
+		FRDGTextureRef SourceTexture,
+		FRDGBufferRef* OutInputTensor = nullptr);
+
+	/**
+	 * AddStylizePasses for the active style plus the inferences of the stencil styles, sharing its encode where the input
+	 * tensors match. Returns the active style's decoded texture and fills LayerTextures in the order of Layers.Layers.
+	 */
+	static FRDGTextureRef AddStencilStylizePasses(
+		FRDGBuilder& GraphBuilder,
+		const FStyleTransferProxy& Proxy,
+		const StyleTransferPasses::FDispatchPlan& Plan,
+		FRDGTextureRef SourceTexture,
+		const FStencilStyleLayers& Layers,
+		TArray<FRDGTextureRef>& LayerTextures);
 
-	FRDGTextureRef ExecuteStyleTransfer(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FRDGTextureRef DestinationTexture);
+	/** Stylizes the foveal region (and the periphery, if enabled) and composites ViewRect of OutputTexture. Returns the fovea texture. */
+	FRDGTextureRef AddFoveatedStyleTransfer(FRDGBuilder& GraphBuilder, const FStyleTransferProxyPtr& Proxy, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FRDGTextureRef OutputTexture);
 
 protected:
 	FScreenPassTexture ApplyStyleTransfer(FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessMaterialInputs& InOutInputs, const FString& DDSFileName);
@@ -0,0 +1,371 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferBenchmarkGameMode.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "FPStyleTransferCharacter.h"
+#include "FPStyleTransferProjectile.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "NNEModelData.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "RenderCore.h"
+#include "RHI.h"
+#include "StyleTransferBenchmarkUtils.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferBenchmark, Log, All);
+
+namespace
+{
+	using namespace StyleTransferBenchmarkUtils;
+
+	const TCHAR* OffPassName = TEXT("Off");
+	const TCHAR* ChainedPassSuffix = TEXT("+Chain");
+}
+
+AStyleTransferBenchmarkGameMode::AStyleTransferBenchmarkGameMode()
+	: Super()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+}
+
+void AStyleTransferBenchmarkGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	const FString RecordingName = UGameplayStatics::HasOption(Options, TEXT("Recording")) ? UGameplayStatics::ParseOption(Options, TEXT("Recording")) : TEXT("Flythrough");
+	Recording = FStyleTransferInputRecording::LoadFromFile(FStyleTransferInputRecording::GetRecordingPath(RecordingName));
+	if (Recording.IsValid() && Recording->MapName != FPaths::GetBaseFilename(MapName))
+	{
+		UE_LOG(LogStyleTransferBenchmark, Warning, TEXT("'%s' was recorded on '%s', not '%s'; the replayed path may differ."),
+			*RecordingName,
+			*Recording->MapName,
+			*FPaths::GetBaseFilename(MapName));
+	}
+
+	TArray<FString> Styles;
+	if (UGameplayStatics::HasOption(Options, TEXT("Styles")))
+	{
+		UGameplayStatics::ParseOption(Options, TEXT("Styles")).ParseIntoArray(Styles, TEXT("+"));
+	}
+	else
+	{
+		Styles = FindProjectStyles();
+	}
+
+	// Chain stages as asset paths joined with '+'; each one maps scene color 0..1 to its input and its output back.
+	ChainStages.Reset();
+	if (UGameplayStatics::HasOption(Options, TEXT("Chain")))
+	{
+		TArray<FString> ChainPaths;
+		UGameplayStatics::ParseOption(Options, TEXT("Chain")).ParseIntoArray(ChainPaths, TEXT("+"));
+		for (const FString& ChainPath : ChainPaths)
+		{
+			FStyleTransferChainStage& Stage = ChainStages.AddDefaulted_GetRef();
+			Stage.ModelData = LoadObject<UNNEModelData>(nullptr, *ChainPath);
+			if (!Stage.ModelData)
+			{
+				UE_LOG(LogStyleTransferBenchmark, Error, TEXT("Unable to load chain stage '%s'; the chained passes will be skipped."), *ChainPath);
+			}
+		}
+	}
+
+	PassStyles.Reset();
+	PassChained.Reset();
+	PassStyles.Add(FString());
+	PassChained.Add(false);
+	for (const FString& Style : Styles)
+	{
+		PassStyles.Add(Style);
+		PassChained.Add(false);
+		if (!ChainStages.IsEmpty())
+		{
+			PassStyles.Add(Style);
+			PassChained.Add(true);
+		}
+	}
+
+	WarmupFrames = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("WarmupFrames"), WarmupFrames), 0);
+
+	CsvPath = UGameplayStatics::ParseOption(Options, TEXT("Csv"));
+	if (CsvPath.IsEmpty())
+	{
+		CsvPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), FString::Printf(TEXT("StyleTransferBenchmark-%s.csv"), *FDateTime::Now().ToString()));
+	}
+	else if (FPaths::IsRelative(CsvPath))
+	{
+		CsvPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), CsvPath);
+	}
+
+	// The *GpuMs* columns need the stage timestamps, which are off by default.
+	FRealtimeStyleTransferViewExtension::AddStageGpuTimingsRequest();
+	bHoldsStageGpuTimings = true;
+}
+
+void AStyleTransferBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	switch (Phase)
+	{
+	case EPhase::Starting:
+		if (!Recording.IsValid())
+		{
+			Finish(false);
+		}
+		else if (GetBenchmarkCharacter())
+		{
+			BeginPass();
+		}
+		break;
+
+	case EPhase::Warmup:
+		// Shader compilation and model uploads settle before the replay starts.
+		if (++PhaseFrames >= WarmupFrames)
+		{
+			if (AFPStyleTransferCharacter* Character = GetBenchmarkCharacter())
+			{
+				Character->StartInputPlayback(Recording);
+				Phase = EPhase::Playback;
+				PhaseFrames = 0;
+				LastFrameSeconds = FPlatformTime::Seconds();
+				LastStageFrame = FRealtimeStyleTransferViewExtension::GetLastStageTimings().Frame;
+				LastStageGpuFrame = FRealtimeStyleTransferViewExtension::GetLastStageTimings().GpuFrame;
+			}
+			else
+			{
+				Finish(false);
+			}
+		}
+		break;
+
+	case EPhase::Playback:
+		SampleFrame();
+		if (const AFPStyleTransferCharacter* Character = GetBenchmarkCharacter(); !Character || !Character->IsPlayingInput())
+		{
+			EndPass();
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void AStyleTransferBenchmarkGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Phase != EPhase::Done && Phase != EPhase::Starting)
+	{
+		UE_LOG(LogStyleTransferBenchmark, Warning, TEXT("The benchmark ended during pass %d of %d; no CSV was written."), PassIndex + 1, PassStyles.Num());
+		FRealtimeStyleTransferViewExtension::SetChainStages({});
+		FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+	}
+	ReleaseStageGpuTimings();
+	Super::EndPlay(EndPlayReason);
+}
+
+void AStyleTransferBenchmarkGameMode::BeginPass()
+{
+	for (; PassIndex < PassStyles.Num(); ++PassIndex)
+	{
+		const FString& Style = PassStyles[PassIndex];
+		if (!FRealtimeStyleTransferViewExtension::SetChainStages(PassChained[PassIndex] ? ChainStages : TArray<FStyleTransferChainStage>()))
+		{
+			UE_LOG(LogStyleTransferBenchmark, Error, TEXT("Unable to create the chain for '%s'; skipping the chained pass."), *Style);
+			continue;
+		}
+		if (ActivateStyle(Style))
+		{
+			break;
+		}
+		UE_LOG(LogStyleTransferBenchmark, Error, TEXT("Unable to activate '%s'; skipping it."), *Style);
+	}
+
+	AFPStyleTransferCharacter* Character = GetBenchmarkCharacter();
+	if (PassIndex >= PassStyles.Num() || !Character)
+	{
+		Finish(Character && !Results.IsEmpty());
+		return;
+	}
+
+	// Projectiles of the previous pass would otherwise still be in flight.
+	for (TActorIterator<AFPStyleTransferProjectile> It(GetWorld()); It; ++It)
+	{
+		It->Destroy();
+	}
+
+	Character->StopInputPlayback();
+	Character->TeleportToInputStart(*Recording);
+
+	FPassSamples& Samples = Results.AddDefaulted_GetRef();
+	Samples.Name = PassStyles[PassIndex].IsEmpty() ? FString(OffPassName) : FPaths::GetBaseFilename(PassStyles[PassIndex]);
+	if (PassChained[PassIndex])
+	{
+		Samples.Name += ChainedPassSuffix;
+	}
+	UE_LOG(LogStyleTransferBenchmark, Display, TEXT("Pass %d of %d: %s, %d frames."), PassIndex + 1, PassStyles.Num(), *Samples.Name, Recording->Frames.Num());
+
+	Phase = EPhase::Warmup;
+	PhaseFrames = 0;
+}
+
+void AStyleTransferBenchmarkGameMode::SampleFrame()
+{
+	FPassSamples& Samples = Results.Last();
+
+	// Wall time between game ticks. The world advances by the recording's fixed step whatever this is.
+	const double NowSeconds = FPlatformTime::Seconds();
+	Samples.FrameMs.Add((NowSeconds - LastFrameSeconds) * 1000.0);
+	LastFrameSeconds = NowSeconds;
+
+	Samples.GameThreadMs.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+	Samples.RenderThreadMs.Add(FPlatformTime::ToMilliseconds(GRenderThreadTime));
+	Samples.GpuMs.Add(FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+
+	// Stage timings arrive a frame or two late and only for stylized frames.
+	const FStyleTransferStageTimings Timings = FRealtimeStyleTransferViewExtension::GetLastStageTimings();
+	Samples.ModelLOD.Add(Timings.ModelLOD);
+	if (Timings.Frame != LastStageFrame)
+	{
+		LastStageFrame = Timings.Frame;
+		Samples.EncodeMs.Add(Timings.EncodeMs);
+		Samples.InferenceMs.Add(Timings.InferenceMs);
+		Samples.DecodeMs.Add(Timings.DecodeMs);
+		Samples.CompositeMs.Add(Timings.CompositeMs);
+		Samples.StyleTotalMs.Add(Timings.TotalMs);
+	}
+	if (Timings.GpuFrame != LastStageGpuFrame)
+	{
+		LastStageGpuFrame = Timings.GpuFrame;
+		Samples.EncodeGpuMs.Add(Timings.EncodeGpuMs);
+		Samples.InferenceGpuMs.Add(Timings.InferenceGpuMs);
+		Samples.DecodeGpuMs.Add(Timings.DecodeGpuMs);
+		Samples.CompositeGpuMs.Add(Timings.CompositeGpuMs);
+		Samples.StyleGpuMs.Add(Timings.TotalGpuMs);
+	}
+}
+
+void AStyleTransferBenchmarkGameMode::EndPass()
+{
+	const FPassSamples& Samples = Results.Last();
+	UE_LOG(LogStyleTransferBenchmark, Display, TEXT("%s: frame p50 %.2f ms, p95 %.2f ms, p99 %.2f ms; style transfer recording p50 %.2f ms over %d frames."),
+		*Samples.Name,
+		Percentile(Samples.FrameMs, 0.5),
+		Percentile(Samples.FrameMs, 0.95),
+		Percentile(Samples.FrameMs, 0.99),
+		Percentile(Samples.StyleTotalMs, 0.5),
+		Samples.StyleTotalMs.Num());
+
+	++PassIndex;
+	BeginPass();
+}
+
+void AStyleTransferBenchmarkGameMode::Finish(bool bSucceeded)
+{
+	if (Phase == EPhase::Done)
+	{
+		return;
+	}
+	Phase = EPhase::Done;
+
+	FRealtimeStyleTransferViewExtension::SetChainStages({});
+	FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+	ReleaseStageGpuTimings();
+	if (!Recording.IsValid())
+	{
+		UE_LOG(LogStyleTransferBenchmark, Error, TEXT("No input recording to replay; record one with StyleTransfer.RecordInput."));
+	}
+	else if (!Results.IsEmpty() && !WriteCsv())
+	{
+		bSucceeded = false;
+	}
+
+	if (FApp::IsUnattended() || FParse::Param(FCommandLine::Get(), TEXT("ExitAfterBenchmark")))
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bSucceeded ? 0 : 1);
+	}
+}
+
+void AStyleTransferBenchmarkGameMode::ReleaseStageGpuTimings()
+{
+	if (bHoldsStageGpuTimings)
+	{
+		bHoldsStageGpuTimings = false;
+		FRealtimeStyleTransferViewExtension::RemoveStageGpuTimingsRequest();
+	}
+}
+
+bool AStyleTransferBenchmarkGameMode::WriteCsv() const
+{
+	// *RecordMs columns are render thread time spent recording each stage, *GpuMs columns its GPU time from the stage
+	// timestamps (0 when the RHI has no timestamp queries); GpuMs is the whole frame.
+	FString Summary = TEXT("Pass,Frames,FrameMsMean,FrameMsP50,FrameMsP90,FrameMsP95,FrameMsP99,FrameMsMax,GameThreadMsP50,RenderThreadMsP50,GpuMsP50,GpuMsP95,")
+		TEXT("StylizedFrames,EncodeRecordMsP50,InferenceRecordMsP50,DecodeRecordMsP50,CompositeRecordMsP50,StyleRecordMsP50,StyleRecordMsP95,")
+		TEXT("GpuTimedFrames,EncodeGpuMsP50,InferenceGpuMsP50,DecodeGpuMsP50,CompositeGpuMsP50,StyleGpuMsP50,StyleGpuMsP95\n");
+	FString Frames = TEXT("Pass,Frame,FrameMs,GameThreadMs,RenderThreadMs,GpuMs,ModelLOD\n");
+
+	for (const FPassSamples& Samples : Results)
+	{
+		Summary += FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n"),
+			*Samples.Name,
+			Samples.FrameMs.Num(),
+			Mean(Samples.FrameMs),
+			Percentile(Samples.FrameMs, 0.5),
+			Percentile(Samples.FrameMs, 0.9),
+			Percentile(Samples.FrameMs, 0.95),
+			Percentile(Samples.FrameMs, 0.99),
+			Percentile(Samples.FrameMs, 1.0),
+			Percentile(Samples.GameThreadMs, 0.5),
+			Percentile(Samples.RenderThreadMs, 0.5),
+			Percentile(Samples.GpuMs, 0.5),
+			Percentile(Samples.GpuMs, 0.95),
+			Samples.StyleTotalMs.Num(),
+			Percentile(Samples.EncodeMs, 0.5),
+			Percentile(Samples.InferenceMs, 0.5),
+			Percentile(Samples.DecodeMs, 0.5),
+			Percentile(Samples.CompositeMs, 0.5),
+			Percentile(Samples.StyleTotalMs, 0.5),
+			Percentile(Samples.StyleTotalMs, 0.95),
+			Samples.StyleGpuMs.Num(),
+			Percentile(Samples.EncodeGpuMs, 0.5),
+			Percentile(Samples.InferenceGpuMs, 0.5),
+			Percentile(Samples.DecodeGpuMs, 0.5),
+			Percentile(Samples.CompositeGpuMs, 0.5),
+			Percentile(Samples.StyleGpuMs, 0.5),
+			Percentile(Samples.StyleGpuMs, 0.95));
+
+		for (int32 FrameIndex = 0; FrameIndex < Samples.FrameMs.Num(); ++FrameIndex)
+		{
+			Frames += FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.3f,%.3f,%d\n"),
+				*Samples.Name,
+				FrameIndex,
+				Samples.FrameMs[FrameIndex],
+				Samples.GameThreadMs[FrameIndex],
+				Samples.RenderThreadMs[FrameIndex],
+				Samples.GpuMs[FrameIndex],
+				Samples.ModelLOD[FrameIndex]);
+		}
+	}
+
+	const FString FramesPath = FPaths::Combine(FPaths::GetPath(CsvPath), FPaths::GetBaseFilename(CsvPath) + TEXT("_frames.csv"));
+	if (!FFileHelper::SaveStringToFile(Summary, *CsvPath) || !FFileHelper::SaveStringToFile(Frames, *FramesPath))
+	{
+		UE_LOG(LogStyleTransferBenchmark, Error, TEXT("Unable to write the benchmark results to '%s'."), *CsvPath);
+		return false;
+	}
+
+	UE_LOG(LogStyleTransferBenchmark, Display, TEXT("Wrote the benchmark summary to '%s' and per-frame times to '%s'."), *CsvPath, *FramesPath);
+	return true;
+}
+
+AFPStyleTransferCharacter* AStyleTransferBenchmarkGameMode::GetBenchmarkCharacter() const
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	return PlayerController ? Cast<AFPStyleTransferCharacter>(PlayerController->GetPawn()) : nullptr;
+}
@@ -0,0 +1,91 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FPStyleTransferGameMode.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "StyleTransferInputRecording.h"
+#include "StyleTransferBenchmarkGameMode.generated.h"
+
+class AFPStyleTransferCharacter;
+
+/**
+ * Replays an input recording once with style transfer off and once per style, then writes frame-time percentiles
+ * and stage costs to CSV. With Chain, every style is replayed a second time with those chain stages after it, so the
+ * chain's cost shows next to the plain style's. Options come from the map URL, e.g.
+ * FirstPersonMap?game=/Script/FPStyleTransfer.StyleTransferBenchmarkGameMode?Recording=Flythrough?Styles=/Game/Models/A.A+/Game/Models/B.B
+ */
+UCLASS(minimalapi)
+class AStyleTransferBenchmarkGameMode : public AFPStyleTransferGameMode
+{
+	GENERATED_BODY()
+
+public:
+	AStyleTransferBenchmarkGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** Per-frame samples of one pass, in milliseconds. */
+	struct FPassSamples
+	{
+		FString Name;
+		TArray<double> FrameMs;
+		TArray<double> GameThreadMs;
+		TArray<double> RenderThreadMs;
+		TArray<double> GpuMs;
+		/** LOD set variant of the last stylized frame at each frame, -1 for plain styles. */
+		TArray<int32> ModelLOD;
+		/** Render thread recording time of each stage (FStyleTransferStageTimings), per stylized frame. */
+		TArray<double> EncodeMs;
+		TArray<double> InferenceMs;
+		TArray<double> DecodeMs;
+		TArray<double> CompositeMs;
+		TArray<double> StyleTotalMs;
+		/** GPU time of each stage, per frame whose stage timestamps were read back. */
+		TArray<double> EncodeGpuMs;
+		TArray<double> InferenceGpuMs;
+		TArray<double> DecodeGpuMs;
+		TArray<double> CompositeGpuMs;
+		TArray<double> StyleGpuMs;
+	};
+
+	enum class EPhase : uint8
+	{
+		Starting,
+		Warmup,
+		Playback,
+		Done,
+	};
+
+	void BeginPass();
+	void SampleFrame();
+	void EndPass();
+	void Finish(bool bSucceeded);
+	bool WriteCsv() const;
+	/** Drops the stage GPU timestamp request InitGame made. */
+	void ReleaseStageGpuTimings();
+
+	AFPStyleTransferCharacter* GetBenchmarkCharacter() const;
+
+	FStyleTransferInputRecordingPtr Recording;
+	/** Style of each pass: empty for the pass without style transfer, else an asset path or a .onnx file path. */
+	TArray<FString> PassStyles;
+	/** Whether each pass runs ChainStages after its style. */
+	TArray<bool> PassChained;
+	TArray<FStyleTransferChainStage> ChainStages;
+	TArray<FPassSamples> Results;
+	FString CsvPath;
+	int32 WarmupFrames = 60;
+
+	EPhase Phase = EPhase::Starting;
+	int32 PassIndex = 0;
+	int32 PhaseFrames = 0;
+	double LastFrameSeconds = 0.0;
+	uint64 LastStageFrame = 0;
+	uint64 LastStageGpuFrame = 0;
+	bool bHoldsStageGpuTimings = false;
+};
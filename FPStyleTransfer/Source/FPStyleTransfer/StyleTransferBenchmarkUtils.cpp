@@ -0,0 +1,91 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferBenchmarkUtils.h"
+
+#include "AssetRegistry/IAssetRegistry.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "NNEModelData.h"
+#include "RealtimeStyleTransferViewExtension.h"
+
+namespace StyleTransferBenchmarkUtils
+{
+	double Percentile(TArray<double> Samples, double Fraction)
+	{
+		if (Samples.IsEmpty())
+		{
+			return 0.0;
+		}
+		Samples.Sort();
+		const int32 Rank = FMath::CeilToInt32(Fraction * Samples.Num()) - 1;
+		return Samples[FMath::Clamp(Rank, 0, Samples.Num() - 1)];
+	}
+
+	double Mean(TConstArrayView<double> Samples)
+	{
+		double Sum = 0.0;
+		for (const double Sample : Samples)
+		{
+			Sum += Sample;
+		}
+		return Samples.IsEmpty() ? 0.0 : Sum / Samples.Num();
+	}
+
+	TArray<FString> FindProjectStyles()
+	{
+		FARFilter Filter;
+		Filter.ClassPaths.Add(UNNEModelData::StaticClass()->GetClassPathName());
+		Filter.PackagePaths.Add(TEXT("/Game"));
+		Filter.bRecursivePaths = true;
+
+		IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+		AssetRegistry.SearchAllAssets(true);
+
+		TArray<FAssetData> Assets;
+		AssetRegistry.GetAssets(Filter, Assets);
+
+		TArray<FString> Styles;
+		for (const FAssetData& Asset : Assets)
+		{
+			Styles.Add(Asset.GetObjectPathString());
+		}
+		Styles.Sort();
+
+		// The same loose models the performance suite covers; ActivateStyle maps them from disk.
+		TArray<FString> LooseModels;
+		IFileManager::Get().FindFiles(LooseModels, *FPaths::Combine(FPaths::ProjectContentDir(), TEXT("StyleModels"), TEXT("*.onnx")), true, false);
+		LooseModels.Sort();
+		for (const FString& FileName : LooseModels)
+		{
+			Styles.Add(TEXT("StyleModels/") + FileName);
+		}
+		return Styles;
+	}
+
+	bool ActivateStyle(const FString& Style)
+	{
+		if (Style.IsEmpty())
+		{
+			FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+			return true;
+		}
+
+		const FStyleTransferProxyPtr PreviousProxy = FRealtimeStyleTransferViewExtension::GetActiveProxy();
+		if (FPaths::GetExtension(Style) == TEXT("onnx"))
+		{
+			FRealtimeStyleTransferViewExtension::SetStyleFromFile(Style, NAME_None);
+		}
+		else if (UNNEModelData* ModelData = LoadObject<UNNEModelData>(nullptr, *Style))
+		{
+			FRealtimeStyleTransferViewExtension::SetStyle(ModelData, NAME_None);
+		}
+		else
+		{
+			return false;
+		}
+
+		// Every successful activation creates a new proxy, even for the style that was already active.
+		const FStyleTransferProxyPtr ActiveProxy = FRealtimeStyleTransferViewExtension::GetActiveProxy();
+		return ActiveProxy.IsValid() && ActiveProxy != PreviousProxy;
+	}
+}
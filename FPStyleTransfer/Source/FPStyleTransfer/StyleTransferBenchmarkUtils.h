@@ -0,0 +1,27 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Style discovery, activation and statistics shared by the benchmark, soak and worker benchmark tools. */
+namespace StyleTransferBenchmarkUtils
+{
+	/** Nearest-rank percentile, Fraction in 0..1; 0 for no samples. */
+	double Percentile(TArray<double> Samples, double Fraction);
+
+	double Mean(TConstArrayView<double> Samples);
+
+	/**
+	 * Every NNE model asset under /Game as an object path, then every loose model in Content/StyleModels as a
+	 * "StyleModels/<name>.onnx" path, each group sorted.
+	 */
+	TArray<FString> FindProjectStyles();
+
+	/**
+	 * Activates Style, an object path or a .onnx path (relative to Content), or turns style transfer off when Style is
+	 * empty. True only if a new style became active: a failed SetStyleFromFile keeps the previous style, which must
+	 * not count as a success. Game thread.
+	 */
+	bool ActivateStyle(const FString& Style);
+}
@@ -13,3 +13,86 @@ void UStyleTransferBlueprintLibrary::SetStyle(UNNEModelData* ModelData, FName Ru
 {
 	FRealtimeStyleTransferViewExtension::SetStyle(ModelData, RuntimeName);
 }
+
+void UStyleTransferBlueprintLibrary::SetStyleFromFile(const FString& FilePath, FName RuntimeName)
+{
+	FRealtimeStyleTransferViewExtension::SetStyleFromFile(FilePath, RuntimeName);
+}
+
+void UStyleTransferBlueprintLibrary::SetStyleWeights(const TArray<float>& Weights)
+{
+	FRealtimeStyleTransferViewExtension::SetStyleWeights(Weights);
+}
+
+void UStyleTransferBlueprintLibrary::SetStyleIndex(int32 StyleIndex)
+{
+	TArray<float> Weights;
+	Weights.SetNumZeroed(FMath::Max(FRealtimeStyleTransferViewExtension::GetStyleCount(), StyleIndex + 1));
+	if (Weights.IsValidIndex(StyleIndex))
+	{
+		Weights[StyleIndex] = 1.0f;
+	}
+	FRealtimeStyleTransferViewExtension::SetStyleWeights(MoveTemp(Weights));
+}
+
+void UStyleTransferBlueprintLibrary::SetSuperResolutionModel(UNNEModelData* ModelData, FName RuntimeName, float InputValueScale, float OutputValueScale)
+{
+	TArray<FStyleTransferChainStage> Stages;
+	if (ModelData)
+	{
+		FStyleTransferChainStage& Stage = Stages.AddDefaulted_GetRef();
+		Stage.ModelData = ModelData;
+		Stage.RuntimeName = RuntimeName;
+		Stage.InputValueScale = InputValueScale;
+		Stage.OutputValueScale = OutputValueScale;
+	}
+	FRealtimeStyleTransferViewExtension::SetChainStages(Stages);
+}
+
+void UStyleTransferBlueprintLibrary::SetMaskRects(const TArray<FBox2D>& NormalizedRects)
+{
+	TArray<FBox2f> Rects;
+	Rects.Reserve(NormalizedRects.Num());
+	for (const FBox2D& Rect : NormalizedRects)
+	{
+		Rects.Add(FBox2f(Rect));
+	}
+	FRealtimeStyleTransferViewExtension::SetMaskRects(Rects);
+}
+
+bool UStyleTransferBlueprintLibrary::SetStencilStyle(uint8 StencilValue, UNNEModelData* ModelData, FName RuntimeName, int32 StyleIndex)
+{
+	TArray<FStyleTransferStencilStyle> Styles = FRealtimeStyleTransferViewExtension::GetStencilStyles();
+	Styles.RemoveAll([StencilValue](const FStyleTransferStencilStyle& Style) { return Style.StencilValue == StencilValue; });
+
+	FStyleTransferStencilStyle& Style = Styles.AddDefaulted_GetRef();
+	Style.StencilValue = StencilValue;
+	Style.ModelData = ModelData;
+	Style.RuntimeName = RuntimeName;
+	Style.StyleIndex = StyleIndex < 0 ? INDEX_NONE : StyleIndex;
+	return FRealtimeStyleTransferViewExtension::SetStencilStyles(Styles);
+}
+
+void UStyleTransferBlueprintLibrary::ClearStencilStyle(uint8 StencilValue)
+{
+	TArray<FStyleTransferStencilStyle> Styles = FRealtimeStyleTransferViewExtension::GetStencilStyles();
+	if (Styles.RemoveAll([StencilValue](const FStyleTransferStencilStyle& Style) { return Style.StencilValue == StencilValue; }) > 0)
+	{
+		FRealtimeStyleTransferViewExtension::SetStencilStyles(Styles);
+	}
+}
+
+bool UStyleTransferBlueprintLibrary::SetStyleLODSet(UStyleTransferModelLODSet* LODSet)
+{
+	return FRealtimeStyleTransferViewExtension::SetStyleLODSet(LODSet);
+}
+
+int32 UStyleTransferBlueprintLibrary::GetActiveStyleLOD()
+{
+	return FRealtimeStyleTransferViewExtension::GetActiveStyleLOD();
+}
+
+int32 UStyleTransferBlueprintLibrary::GetStyleCount()
+{
+	return FRealtimeStyleTransferViewExtension::GetStyleCount();
+}
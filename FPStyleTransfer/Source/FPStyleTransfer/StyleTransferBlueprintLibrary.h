@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
 #include "NNEModelData.h"
+#include "StyleTransferModelLODSet.h"
 #include "StyleTransferBlueprintLibrary.generated.h"
 
 UCLASS()
@@ -14,4 +15,50 @@ class FPSTYLETRANSFER_API UStyleTransferBlueprintLibrary : public UBlueprintFunc
 	
 	UFUNCTION(Exec, BlueprintCallable, Category = "Style Transfer")
 	static void SetStyle(UNNEModelData* ModelData, FName RuntimeName = NAME_None);
+
+	/** Activates every variant of LODSet and lets the GPU time governor pick between them (r.RealtimeStyleTransfer.LOD.*). */
+	UFUNCTION(BlueprintCallable, Category = "Style Transfer")
+	static bool SetStyleLODSet(UStyleTransferModelLODSet* LODSet);
+
+	/** Variant of the active LOD set that is running, -1 without a LOD set. */
+	UFUNCTION(BlueprintPure, Category = "Style Transfer")
+	static int32 GetActiveStyleLOD();
+
+	/** Activates a loose .onnx file (e.g. "StyleModels/candy.onnx" under Content) through a memory-mapped load instead of an asset. */
+	UFUNCTION(Exec, BlueprintCallable, Category = "Style Transfer")
+	static void SetStyleFromFile(const FString& FilePath, FName RuntimeName = NAME_None);
+
+	/** Blends the styles embedded in a conditional (multi-style) model. */
+	UFUNCTION(BlueprintCallable, Category = "Style Transfer")
+	static void SetStyleWeights(const TArray<float>& Weights);
+
+	/** Selects a single style of a conditional (multi-style) model. */
+	UFUNCTION(Exec, BlueprintCallable, Category = "Style Transfer")
+	static void SetStyleIndex(int32 StyleIndex);
+
+	/**
+	 * Runs a super-resolution model on the style model's output in place of most of the upscale filter; null removes it.
+	 * The value scales map scene color 0..1 to the model's input and its output back (1 for models trained on 0..1 images).
+	 */
+	UFUNCTION(Exec, BlueprintCallable, Category = "Style Transfer")
+	static void SetSuperResolutionModel(UNNEModelData* ModelData, FName RuntimeName = NAME_None, float InputValueScale = 1.0f, float OutputValueScale = 1.0f);
+
+	/** Screen regions (normalized view coordinates) that stay unstylized while r.RealtimeStyleTransfer.Mask is on, e.g. opaque HUD panels. */
+	UFUNCTION(BlueprintCallable, Category = "Style Transfer")
+	static void SetMaskRects(const TArray<FBox2D>& NormalizedRects);
+
+	/**
+	 * Stylizes pixels whose custom stencil is StencilValue with ModelData (StyleIndex picks a style of a conditional model,
+	 * -1 its default) instead of the active style; a null model keeps them unstylized. Requires r.CustomDepth=3.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Style Transfer")
+	static bool SetStencilStyle(uint8 StencilValue, UNNEModelData* ModelData, FName RuntimeName = NAME_None, int32 StyleIndex = -1);
+
+	/** Removes the style of one stencil value, so its pixels get the active style again. */
+	UFUNCTION(BlueprintCallable, Category = "Style Transfer")
+	static void ClearStencilStyle(uint8 StencilValue);
+
+	/** Number of styles embedded in the active model, 0 for single-style models. */
+	UFUNCTION(BlueprintPure, Category = "Style Transfer")
+	static int32 GetStyleCount();
 };
@@ -0,0 +1,31 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferComponent.h"
+
+#include "Engine/World.h"
+#include "StyleTransferRenderTargetSubsystem.h"
+
+UStyleTransferComponent::UStyleTransferComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UStyleTransferComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UStyleTransferRenderTargetSubsystem* Subsystem = UWorld::GetSubsystem<UStyleTransferRenderTargetSubsystem>(GetWorld()))
+	{
+		Subsystem->RegisterComponent(this);
+	}
+}
+
+void UStyleTransferComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UStyleTransferRenderTargetSubsystem* Subsystem = UWorld::GetSubsystem<UStyleTransferRenderTargetSubsystem>(GetWorld()))
+	{
+		Subsystem->UnregisterComponent(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,49 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "NNEModelData.h"
+#include "StyleTransferComponent.generated.h"
+
+class UTextureRenderTarget2D;
+
+/**
+ * Stylizes a render target (scene capture, mirror, in-world monitor) in place. Requests are scheduled by
+ * UStyleTransferRenderTargetSubsystem, which batches every target due in a frame into one inference per model.
+ */
+UCLASS(ClassGroup = (Rendering), meta = (BlueprintSpawnableComponent))
+class FPSTYLETRANSFER_API UStyleTransferComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UStyleTransferComponent();
+
+	/**
+	 * Render target stylized in place once per frame, after the frame's scene captures have rendered and before the
+	 * main view renders. Targets drawn later in the frame (e.g. by a widget or a canvas) are stylized the next frame.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Style Transfer")
+	TObjectPtr<UTextureRenderTarget2D> RenderTarget;
+
+	/** Stylizations per second; 0 stylizes every frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Style Transfer", meta = (ClampMin = "0.0"))
+	float RefreshRate = 30.0f;
+
+	/** Higher priority targets are served first when the per-frame budget is exceeded. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Style Transfer")
+	int32 Priority = 0;
+
+	/** Optional model for this target only. None uses the active style of the main view. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Style Transfer")
+	TObjectPtr<UNNEModelData> ModelData;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Style Transfer")
+	FName RuntimeName;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
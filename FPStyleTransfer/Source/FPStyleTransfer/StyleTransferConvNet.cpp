@@ -0,0 +1,1551 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferConvNet.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntimeCPU.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "StyleTransferOnnx.h"
+#include "StyleTransferPasses.h"
+#include "StyleTransferShaders.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferConvNet, Log, All);
+
+DECLARE_GPU_STAT_NAMED(StyleTransferConvNet, TEXT("StyleTransfer ConvNet"));
+
+namespace
+{
+	/** An ONNX tensor name resolved to a network value, plus an upsample and padding that the consuming Conv applies. */
+	struct FValueRef
+	{
+		int32 Value = INDEX_NONE;
+		int32 Upsample = 1;
+		int32 Padding = 0;
+		EStyleTransferConvNetPadding PaddingMode = EStyleTransferConvNetPadding::Zero;
+		/** True when nothing else reads the value, so following ops may be fused into the layer that produced it. */
+		bool bExclusive = false;
+
+		bool HasPendingTransform() const { return Upsample != 1 || Padding != 0; }
+	};
+
+	bool HasIdentityOutput(const FStyleTransferConvNetLayer& Layer)
+	{
+		return Layer.Activation == EStyleTransferConvNetActivation::None && Layer.OutputScale == 1.0f && Layer.OutputBias == 0.0f;
+	}
+
+	float ApplyLayerOutput(float Value, const FStyleTransferConvNetLayer& Layer)
+	{
+		switch (Layer.Activation)
+		{
+		case EStyleTransferConvNetActivation::Relu:
+			Value = FMath::Max(Value, 0.0f);
+			break;
+		case EStyleTransferConvNetActivation::Sigmoid:
+			Value = 1.0f / (1.0f + FMath::Exp(-Value));
+			break;
+		case EStyleTransferConvNetActivation::Tanh:
+			Value = 2.0f / (1.0f + FMath::Exp(-2.0f * Value)) - 1.0f;
+			break;
+		case EStyleTransferConvNetActivation::Clip:
+			Value = FMath::Clamp(Value, Layer.ClipMin, Layer.ClipMax);
+			break;
+		default:
+			break;
+		}
+		return Value * Layer.OutputScale + Layer.OutputBias;
+	}
+
+	void ApplyLayerOutput(float* Data, int32 Count, const FStyleTransferConvNetLayer& Layer)
+	{
+		if (HasIdentityOutput(Layer))
+		{
+			return;
+		}
+
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			Data[Index] = ApplyLayerOutput(Data[Index], Layer);
+		}
+	}
+
+	/** Maps a coordinate of the padded input to a stored coordinate, or INDEX_NONE where it reads zero padding. */
+	int32 MapPaddedCoord(int32 Coord, int32 Size, EStyleTransferConvNetPadding Mode)
+	{
+		if (Coord >= 0 && Coord < Size)
+		{
+			return Coord;
+		}
+
+		switch (Mode)
+		{
+		case EStyleTransferConvNetPadding::Reflect:
+			return Coord < 0 ? -Coord : 2 * Size - 2 - Coord;
+		case EStyleTransferConvNetPadding::Replicate:
+			return FMath::Clamp(Coord, 0, Size - 1);
+		default:
+			return INDEX_NONE;
+		}
+	}
+
+	int32 GetPlaneSize(FIntPoint Size)
+	{
+		return Size.X * Size.Y;
+	}
+
+	void RunConvCPU(const FStyleTransferConvNetLayer& Layer, const float* Parameters, const float* Input, FIntPoint InputSize, float* Output, FIntPoint OutputSize)
+	{
+		const int32 KernelSize = Layer.KernelSize;
+		const int32 Stride = Layer.Stride;
+		const FIntPoint Upsampled = InputSize * Layer.InputUpsample;
+		const FIntPoint Padded(Upsampled.X + 2 * Layer.Padding, Upsampled.Y + 2 * Layer.Padding);
+		const int32 PaddedPlaneSize = GetPlaneSize(Padded);
+
+		// Materializing the upsampled, padded input once makes the inner loop a plain strided multiply-add.
+		TArray<float> PaddedInput;
+		PaddedInput.SetNumUninitialized(Layer.InChannels * PaddedPlaneSize);
+		ParallelFor(Layer.InChannels, [&](int32 Channel)
+		{
+			const float* InputPlane = Input + Channel * GetPlaneSize(InputSize);
+			float* PaddedPlane = PaddedInput.GetData() + Channel * PaddedPlaneSize;
+			for (int32 Y = 0; Y < Padded.Y; ++Y)
+			{
+				const int32 SourceY = MapPaddedCoord(Y - Layer.Padding, Upsampled.Y, Layer.PaddingMode);
+				for (int32 X = 0; X < Padded.X; ++X)
+				{
+					const int32 SourceX = MapPaddedCoord(X - Layer.Padding, Upsampled.X, Layer.PaddingMode);
+					PaddedPlane[Y * Padded.X + X] = (SourceX == INDEX_NONE || SourceY == INDEX_NONE)
+						? 0.0f
+						: InputPlane[(SourceY / Layer.InputUpsample) * InputSize.X + SourceX / Layer.InputUpsample];
+				}
+			}
+		});
+
+		ParallelFor(Layer.OutChannels, [&](int32 OutChannel)
+		{
+			float* OutputPlane = Output + OutChannel * GetPlaneSize(OutputSize);
+			const float Bias = Parameters[Layer.BiasOffset + OutChannel];
+			for (int32 Index = 0; Index < GetPlaneSize(OutputSize); ++Index)
+			{
+				OutputPlane[Index] = Bias;
+			}
+
+			const float* Weight = Parameters + Layer.WeightOffset + OutChannel * Layer.InChannels * KernelSize * KernelSize;
+			for (int32 InChannel = 0; InChannel < Layer.InChannels; ++InChannel)
+			{
+				const float* PaddedPlane = PaddedInput.GetData() + InChannel * PaddedPlaneSize;
+				for (int32 KernelY = 0; KernelY < KernelSize; ++KernelY)
+				{
+					for (int32 KernelX = 0; KernelX < KernelSize; ++KernelX, ++Weight)
+					{
+						if (*Weight == 0.0f)
+						{
+							continue;
+						}
+
+						const VectorRegister4Float WeightVector = VectorSetFloat1(*Weight);
+						for (int32 Y = 0; Y < OutputSize.Y; ++Y)
+						{
+							const float* Row = PaddedPlane + (Y * Stride + KernelY) * Padded.X + KernelX;
+							float* OutputRow = OutputPlane + Y * OutputSize.X;
+
+							int32 X = 0;
+							if (Stride == 1)
+							{
+								for (; X + 4 <= OutputSize.X; X += 4)
+								{
+									VectorStore(VectorMultiplyAdd(WeightVector, VectorLoad(Row + X), VectorLoad(OutputRow + X)), OutputRow + X);
+								}
+							}
+
+							for (; X < OutputSize.X; ++X)
+							{
+								OutputRow[X] += *Weight * Row[X * Stride];
+							}
+						}
+					}
+				}
+			}
+
+			ApplyLayerOutput(OutputPlane, GetPlaneSize(OutputSize), Layer);
+		});
+	}
+
+	void RunInstanceNormCPU(const FStyleTransferConvNetLayer& Layer, const float* Parameters, const float* Input, FIntPoint Size, float* Output)
+	{
+		const int32 PlaneSize = GetPlaneSize(Size);
+		ParallelFor(Layer.OutChannels, [&](int32 Channel)
+		{
+			const float* InputPlane = Input + Channel * PlaneSize;
+			float* OutputPlane = Output + Channel * PlaneSize;
+
+			double Sum = 0.0;
+			for (int32 Index = 0; Index < PlaneSize; ++Index)
+			{
+				Sum += InputPlane[Index];
+			}
+			const double Mean = Sum / PlaneSize;
+
+			double SquaredDeviation = 0.0;
+			for (int32 Index = 0; Index < PlaneSize; ++Index)
+			{
+				SquaredDeviation += FMath::Square(InputPlane[Index] - Mean);
+			}
+
+			const float InverseDeviation = FMath::InvSqrt(static_cast<float>(SquaredDeviation / PlaneSize) + Layer.Epsilon);
+			const float Scale = Parameters[Layer.WeightOffset + Channel] * InverseDeviation;
+			const float Bias = Parameters[Layer.BiasOffset + Channel] - static_cast<float>(Mean) * Scale;
+			for (int32 Index = 0; Index < PlaneSize; ++Index)
+			{
+				OutputPlane[Index] = ApplyLayerOutput(InputPlane[Index] * Scale + Bias, Layer);
+			}
+		});
+	}
+
+	void SetLayerOutputParameters(FPStyleTransferShaders::FConvNetLayerOutputParameters& OutParameters, const FStyleTransferConvNetLayer& Layer)
+	{
+		OutParameters.ActivationType = static_cast<uint32>(Layer.Activation);
+		OutParameters.ClipMin = Layer.ClipMin;
+		OutParameters.ClipMax = Layer.ClipMax;
+		OutParameters.OutputScale = Layer.OutputScale;
+		OutParameters.OutputBias = Layer.OutputBias;
+	}
+
+	FRDGBufferSRVRef CreateTensorSRV(FRDGBuilder& GraphBuilder, FRDGBufferRef Buffer)
+	{
+		return GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Buffer, PF_R32_FLOAT));
+	}
+
+	FRDGBufferUAVRef CreateTensorUAV(FRDGBuilder& GraphBuilder, FRDGBufferRef Buffer)
+	{
+		return GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Buffer, PF_R32_FLOAT));
+	}
+
+	void AddElementwisePass(
+		FRDGBuilder& GraphBuilder,
+		FPStyleTransferShaders::EConvNetElementwiseOp Op,
+		const FStyleTransferConvNetLayer* Layer,
+		FIntPoint InputSize,
+		FIntPoint OutputSize,
+		uint32 Channels,
+		FRDGBufferRef Input,
+		FRDGBufferRef Residual,
+		FRDGBufferRef Output,
+		FRDGTextureRef OutputTexture)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FConvNetElementwiseCS::FParameters>();
+		Parameters->InputResolution = InputSize;
+		Parameters->OutputResolution = OutputSize;
+		Parameters->Channels = Channels;
+		Parameters->UpsampleFactor = Layer ? Layer->InputUpsample : 1;
+		Parameters->DecodeScale = StyleTransferPasses::DecodeScale;
+		Parameters->DecodeBias = 0.0f;
+		SetLayerOutputParameters(Parameters->LayerOutput, Layer ? *Layer : FStyleTransferConvNetLayer());
+		Parameters->InputTensor = CreateTensorSRV(GraphBuilder, Input);
+		if (Residual)
+		{
+			Parameters->ResidualTensor = CreateTensorSRV(GraphBuilder, Residual);
+		}
+		if (Output)
+		{
+			Parameters->OutputTensor = CreateTensorUAV(GraphBuilder, Output);
+		}
+		if (OutputTexture)
+		{
+			Parameters->OutputTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(OutputTexture));
+		}
+
+		FPStyleTransferShaders::FConvNetElementwiseCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FPStyleTransferShaders::FConvNetElementwiseOpDim>(Op);
+		TShaderMapRef<FPStyleTransferShaders::FConvNetElementwiseCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+		FIntVector GroupCount = StyleTransferPasses::MakeGroupCount(OutputSize);
+		GroupCount.Z = Op == FPStyleTransferShaders::EConvNetElementwiseOp::Decode ? 1 : Channels;
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.ConvNet.Elementwise"),
+			Shader,
+			Parameters,
+			GroupCount);
+	}
+}
+
+/** Lowers an ONNX graph to fused layers. ONNX nodes are topologically sorted, so one forward walk is enough. */
+struct FStyleTransferConvNetCompiler
+{
+	FStyleTransferConvNetCompiler(FStyleTransferConvNet& InNet, const StyleTransferOnnx::FGraph& InGraph)
+		: Net(InNet)
+		, Graph(InGraph)
+	{
+	}
+
+	bool Compile();
+
+	FString Error;
+
+private:
+	bool Fail(const FString& Message)
+	{
+		Error = Message;
+		return false;
+	}
+
+	int32 GetConsumerCount(const FString& Name) const
+	{
+		return ConsumerCounts.FindRef(Name);
+	}
+
+	const StyleTransferOnnx::FTensor* FindConstant(const FString& Name) const
+	{
+		if (const StyleTransferOnnx::FTensor* Initializer = Graph.Initializers.Find(Name))
+		{
+			return Initializer;
+		}
+		return ConstantOutputs.Find(Name);
+	}
+
+	bool GetScalar(const FString& Name, float& OutValue) const
+	{
+		const StyleTransferOnnx::FTensor* Tensor = FindConstant(Name);
+		if (!Tensor || Tensor->Data.Num() != 1)
+		{
+			return false;
+		}
+		OutValue = Tensor->Data[0];
+		return true;
+	}
+
+	bool GetValue(const StyleTransferOnnx::FNode& Node, int32 InputIndex, FValueRef& OutRef)
+	{
+		if (!Node.Inputs.IsValidIndex(InputIndex))
+		{
+			return Fail(FString::Printf(TEXT("%s node '%s' is missing input %d"), *Node.OpType, *Node.Name, InputIndex));
+		}
+
+		const FValueRef* Ref = Values.Find(Node.Inputs[InputIndex]);
+		if (!Ref)
+		{
+			return Fail(FString::Printf(TEXT("%s node '%s' reads '%s', which is not an image tensor"), *Node.OpType, *Node.Name, *Node.Inputs[InputIndex]));
+		}
+
+		OutRef = *Ref;
+		return true;
+	}
+
+	int32 AddValue(int32 Channels)
+	{
+		ValueChannels.Add(Channels);
+		Producers.Add(INDEX_NONE);
+		Net.ValueCount = ValueChannels.Num();
+		return ValueChannels.Num() - 1;
+	}
+
+	FStyleTransferConvNetLayer& AddLayer(EStyleTransferConvNetOp Op, int32 Input, int32 InChannels, int32 OutChannels)
+	{
+		FStyleTransferConvNetLayer& Layer = Net.Layers.AddDefaulted_GetRef();
+		Layer.Op = Op;
+		Layer.Input = Input;
+		Layer.InChannels = InChannels;
+		Layer.OutChannels = OutChannels;
+		Layer.Output = AddValue(OutChannels);
+		Producers[Layer.Output] = Net.Layers.Num() - 1;
+		return Layer;
+	}
+
+	int32 AddParameters(TConstArrayView<float> Data)
+	{
+		const int32 Offset = Net.Parameters.Num();
+		Net.Parameters.Append(Data.GetData(), Data.Num());
+		return Offset;
+	}
+
+	void Bind(const FString& Name, int32 Value)
+	{
+		FValueRef Ref;
+		Ref.Value = Value;
+		Ref.bExclusive = GetConsumerCount(Name) <= 1;
+		Values.Add(Name, Ref);
+	}
+
+	void BindAlias(const FString& Name, FValueRef Ref)
+	{
+		Ref.bExclusive = Ref.bExclusive && GetConsumerCount(Name) <= 1;
+		Values.Add(Name, Ref);
+	}
+
+	/** A copy layer (upsample by the pending factor, or by 1) that a following activation or affine can be fused into. */
+	FStyleTransferConvNetLayer& AddCopyLayer(const FValueRef& Ref)
+	{
+		const int32 Channels = ValueChannels[Ref.Value];
+		FStyleTransferConvNetLayer& Layer = AddLayer(EStyleTransferConvNetOp::Upsample, Ref.Value, Channels, Channels);
+		Layer.InputUpsample = Ref.Upsample;
+		return Layer;
+	}
+
+	/** Applies a pending upsample as its own layer for consumers that are not a Conv. */
+	bool Materialize(const StyleTransferOnnx::FNode& Node, FValueRef& Ref)
+	{
+		if (Ref.Padding != 0)
+		{
+			return Fail(FString::Printf(TEXT("Pad must feed a Conv, but feeds %s node '%s'"), *Node.OpType, *Node.Name));
+		}
+
+		if (Ref.Upsample != 1)
+		{
+			Ref.Value = AddCopyLayer(Ref).Output;
+			Ref.Upsample = 1;
+			Ref.bExclusive = true;
+		}
+		return true;
+	}
+
+	/** The layer that produced Ref when nothing else reads its output, so it can absorb a following op. */
+	FStyleTransferConvNetLayer* FindFusableProducer(const FValueRef& Ref)
+	{
+		if (!Ref.bExclusive || Ref.HasPendingTransform() || Producers[Ref.Value] == INDEX_NONE)
+		{
+			return nullptr;
+		}
+		return &Net.Layers[Producers[Ref.Value]];
+	}
+
+	bool CompileNode(const StyleTransferOnnx::FNode& Node);
+	bool CompileConstant(const StyleTransferOnnx::FNode& Node);
+	bool CompileConv(const StyleTransferOnnx::FNode& Node);
+	bool CompileBatchNormalization(const StyleTransferOnnx::FNode& Node);
+	bool CompileInstanceNormalization(const StyleTransferOnnx::FNode& Node);
+	bool CompileActivation(const StyleTransferOnnx::FNode& Node);
+	bool CompileArithmetic(const StyleTransferOnnx::FNode& Node);
+	bool CompileAffine(const StyleTransferOnnx::FNode& Node, FValueRef Ref, float Scale, float Bias);
+	bool CompilePad(const StyleTransferOnnx::FNode& Node);
+	bool CompileUpsample(const StyleTransferOnnx::FNode& Node);
+	void PackGpuParameters();
+
+	FStyleTransferConvNet& Net;
+	const StyleTransferOnnx::FGraph& Graph;
+	TMap<FString, FValueRef> Values;
+	TMap<FString, StyleTransferOnnx::FTensor> ConstantOutputs;
+	TMap<FString, int32> ConsumerCounts;
+	TArray<int32> ValueChannels;
+	/** Layer index that writes each value; INDEX_NONE for the network input. */
+	TArray<int32> Producers;
+};
+
+bool FStyleTransferConvNetCompiler::Compile()
+{
+	if (Graph.Inputs.Num() != 1 || Graph.Outputs.IsEmpty())
+	{
+		return Fail(FString::Printf(TEXT("expected one image input and an output, found %d input(s) and %d output(s)"), Graph.Inputs.Num(), Graph.Outputs.Num()));
+	}
+
+	const StyleTransferOnnx::FValueInfo& Input = Graph.Inputs[0];
+	if (Input.Dims.Num() != 4)
+	{
+		return Fail(FString::Printf(TEXT("input '%s' must be 4D (NCHW)"), *Input.Name));
+	}
+
+	for (const StyleTransferOnnx::FNode& Node : Graph.Nodes)
+	{
+		for (const FString& Name : Node.Inputs)
+		{
+			++ConsumerCounts.FindOrAdd(Name);
+		}
+	}
+	for (const StyleTransferOnnx::FValueInfo& Output : Graph.Outputs)
+	{
+		++ConsumerCounts.FindOrAdd(Output.Name);
+	}
+
+	Net.InputChannels = Input.Dims[1] > 0 ? static_cast<int32>(Input.Dims[1]) : 3;
+	if (Input.Dims[2] > 0 && Input.Dims[3] > 0)
+	{
+		Net.DeclaredResolution = FIntPoint(static_cast<int32>(Input.Dims[3]), static_cast<int32>(Input.Dims[2]));
+	}
+	Bind(Input.Name, AddValue(Net.InputChannels));
+
+	for (const StyleTransferOnnx::FNode& Node : Graph.Nodes)
+	{
+		if (!CompileNode(Node))
+		{
+			return false;
+		}
+	}
+
+	FValueRef OutputRef;
+	if (const FValueRef* Found = Values.Find(Graph.Outputs[0].Name))
+	{
+		OutputRef = *Found;
+	}
+	else
+	{
+		return Fail(FString::Printf(TEXT("output '%s' is not produced by a supported node"), *Graph.Outputs[0].Name));
+	}
+
+	StyleTransferOnnx::FNode OutputNode;
+	OutputNode.OpType = TEXT("graph output");
+	OutputNode.Name = Graph.Outputs[0].Name;
+	if (!Materialize(OutputNode, OutputRef))
+	{
+		return false;
+	}
+
+	if (Producers[OutputRef.Value] == INDEX_NONE)
+	{
+		return Fail(TEXT("the graph has no layers"));
+	}
+
+	// The first layers sample the scene texture themselves, which only a Conv does.
+	for (const FStyleTransferConvNetLayer& Layer : Net.Layers)
+	{
+		if ((Layer.Input == 0 && Layer.Op != EStyleTransferConvNetOp::Conv) || Layer.Residual == 0)
+		{
+			return Fail(TEXT("the network input may only feed Conv nodes"));
+		}
+	}
+
+	if (Net.InputChannels != 3)
+	{
+		return Fail(FString::Printf(TEXT("the input must have 3 channels, found %d"), Net.InputChannels));
+	}
+
+	Net.OutputValue = OutputRef.Value;
+	Net.OutputChannels = ValueChannels[OutputRef.Value];
+	PackGpuParameters();
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileNode(const StyleTransferOnnx::FNode& Node)
+{
+	const FString& Op = Node.OpType;
+	if (Node.Outputs.IsEmpty())
+	{
+		return Fail(FString::Printf(TEXT("%s node '%s' has no output"), *Op, *Node.Name));
+	}
+
+	if (Op == TEXT("Constant"))
+	{
+		return CompileConstant(Node);
+	}
+	if (Op == TEXT("Identity") || Op == TEXT("Dropout"))
+	{
+		if (const StyleTransferOnnx::FTensor* Constant = FindConstant(Node.Inputs[0]))
+		{
+			ConstantOutputs.Add(Node.Outputs[0], *Constant);
+			return true;
+		}
+
+		FValueRef Ref;
+		if (!GetValue(Node, 0, Ref))
+		{
+			return false;
+		}
+		BindAlias(Node.Outputs[0], Ref);
+		return true;
+	}
+	if (Op == TEXT("Conv"))
+	{
+		return CompileConv(Node);
+	}
+	if (Op == TEXT("BatchNormalization"))
+	{
+		return CompileBatchNormalization(Node);
+	}
+	if (Op == TEXT("InstanceNormalization"))
+	{
+		return CompileInstanceNormalization(Node);
+	}
+	if (Op == TEXT("Relu") || Op == TEXT("Sigmoid") || Op == TEXT("Tanh") || Op == TEXT("Clip"))
+	{
+		return CompileActivation(Node);
+	}
+	if (Op == TEXT("Add") || Op == TEXT("Sub") || Op == TEXT("Mul") || Op == TEXT("Div"))
+	{
+		return CompileArithmetic(Node);
+	}
+	if (Op == TEXT("Pad"))
+	{
+		return CompilePad(Node);
+	}
+	if (Op == TEXT("Upsample") || Op == TEXT("Resize"))
+	{
+		return CompileUpsample(Node);
+	}
+	if (Op == TEXT("ConvTranspose"))
+	{
+		return Fail(FString::Printf(TEXT("ConvTranspose node '%s' is not supported; export the decoder as nearest Upsample + Conv"), *Node.Name));
+	}
+	return Fail(FString::Printf(TEXT("operator '%s' (node '%s') is not supported"), *Op, *Node.Name));
+}
+
+bool FStyleTransferConvNetCompiler::CompileConstant(const StyleTransferOnnx::FNode& Node)
+{
+	if (const StyleTransferOnnx::FAttribute* Value = Node.Attributes.Find(TEXT("value")))
+	{
+		if (Value->T.IsSet())
+		{
+			ConstantOutputs.Add(Node.Outputs[0], Value->T.GetValue());
+			return true;
+		}
+	}
+
+	if (const StyleTransferOnnx::FAttribute* ValueFloat = Node.Attributes.Find(TEXT("value_float")))
+	{
+		StyleTransferOnnx::FTensor& Tensor = ConstantOutputs.Add(Node.Outputs[0]);
+		Tensor.Data.Add(ValueFloat->F);
+		return true;
+	}
+
+	return Fail(FString::Printf(TEXT("Constant node '%s' has no tensor value"), *Node.Name));
+}
+
+bool FStyleTransferConvNetCompiler::CompileConv(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input))
+	{
+		return false;
+	}
+
+	const StyleTransferOnnx::FTensor* Weights = Node.Inputs.IsValidIndex(1) ? FindConstant(Node.Inputs[1]) : nullptr;
+	if (!Weights || Weights->Dims.Num() != 4)
+	{
+		return Fail(FString::Printf(TEXT("Conv node '%s' needs constant 4D weights"), *Node.Name));
+	}
+
+	const int32 OutChannels = static_cast<int32>(Weights->Dims[0]);
+	const int32 InChannels = static_cast<int32>(Weights->Dims[1]);
+	const int32 KernelSize = static_cast<int32>(Weights->Dims[2]);
+	if (Weights->Dims[3] != KernelSize)
+	{
+		return Fail(FString::Printf(TEXT("Conv node '%s' has a non-square kernel"), *Node.Name));
+	}
+
+	if (InChannels != ValueChannels[Input.Value] || Node.GetInt(TEXT("group"), 1) != 1)
+	{
+		return Fail(FString::Printf(TEXT("Conv node '%s' is grouped or has %d input channels where %d are available"), *Node.Name, InChannels, ValueChannels[Input.Value]));
+	}
+
+	for (const int64 Dilation : Node.GetInts(TEXT("dilations")))
+	{
+		if (Dilation != 1)
+		{
+			return Fail(FString::Printf(TEXT("Conv node '%s' is dilated"), *Node.Name));
+		}
+	}
+
+	const TArray<int64> Strides = Node.GetInts(TEXT("strides"));
+	const int32 Stride = Strides.IsEmpty() ? 1 : static_cast<int32>(Strides[0]);
+	for (const int64 Value : Strides)
+	{
+		if (Value != Stride || Value < 1)
+		{
+			return Fail(FString::Printf(TEXT("Conv node '%s' has unequal strides"), *Node.Name));
+		}
+	}
+
+	const FString AutoPad = Node.GetString(TEXT("auto_pad"), TEXT("NOTSET"));
+	if (AutoPad != TEXT("NOTSET") && AutoPad != TEXT("VALID"))
+	{
+		return Fail(FString::Printf(TEXT("Conv node '%s' uses auto_pad %s; export with explicit pads"), *Node.Name, *AutoPad));
+	}
+
+	const TArray<int64> Pads = Node.GetInts(TEXT("pads"));
+	const int32 ConvPadding = Pads.IsEmpty() ? 0 : static_cast<int32>(Pads[0]);
+	for (const int64 Value : Pads)
+	{
+		if (Value != ConvPadding)
+		{
+			return Fail(FString::Printf(TEXT("Conv node '%s' has asymmetric padding"), *Node.Name));
+		}
+	}
+
+	// A preceding reflect Pad and the Conv's own zero padding can't be combined into one padding mode.
+	if (Input.Padding > 0 && ConvPadding > 0 && Input.PaddingMode != EStyleTransferConvNetPadding::Zero)
+	{
+		return Fail(FString::Printf(TEXT("Conv node '%s' pads an input that is already padded"), *Node.Name));
+	}
+
+	const StyleTransferOnnx::FTensor* Bias = nullptr;
+	if (Node.Inputs.IsValidIndex(2) && !Node.Inputs[2].IsEmpty())
+	{
+		Bias = FindConstant(Node.Inputs[2]);
+		if (!Bias || Bias->Data.Num() != OutChannels)
+		{
+			return Fail(FString::Printf(TEXT("Conv node '%s' needs a constant bias of %d values"), *Node.Name, OutChannels));
+		}
+	}
+
+	TArray<float> ZeroBias;
+	ZeroBias.SetNumZeroed(Bias ? 0 : OutChannels);
+
+	FStyleTransferConvNetLayer& Layer = AddLayer(EStyleTransferConvNetOp::Conv, Input.Value, InChannels, OutChannels);
+	Layer.KernelSize = KernelSize;
+	Layer.Stride = Stride;
+	Layer.Padding = Input.Padding + ConvPadding;
+	Layer.PaddingMode = Input.Padding > 0 ? Input.PaddingMode : EStyleTransferConvNetPadding::Zero;
+	Layer.InputUpsample = Input.Upsample;
+	Layer.WeightOffset = AddParameters(Weights->Data);
+	Layer.BiasOffset = AddParameters(Bias ? TConstArrayView<float>(Bias->Data) : TConstArrayView<float>(ZeroBias));
+	Bind(Node.Outputs[0], Layer.Output);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileBatchNormalization(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input))
+	{
+		return false;
+	}
+
+	FStyleTransferConvNetLayer* Conv = FindFusableProducer(Input);
+	if (!Conv || Conv->Op != EStyleTransferConvNetOp::Conv || !HasIdentityOutput(*Conv))
+	{
+		return Fail(FString::Printf(TEXT("BatchNormalization node '%s' must directly follow a Conv"), *Node.Name));
+	}
+
+	const StyleTransferOnnx::FTensor* Tensors[4] = {};
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		Tensors[Index] = Node.Inputs.IsValidIndex(Index + 1) ? FindConstant(Node.Inputs[Index + 1]) : nullptr;
+		if (!Tensors[Index] || Tensors[Index]->Data.Num() != Conv->OutChannels)
+		{
+			return Fail(FString::Printf(TEXT("BatchNormalization node '%s' needs constant scale, bias, mean and variance"), *Node.Name));
+		}
+	}
+
+	// Folded into the Conv: W' = W * s, b' = (b - mean) * s + beta, with s = gamma / sqrt(var + eps).
+	const float Epsilon = Node.GetFloat(TEXT("epsilon"), 1e-5f);
+	const int32 WeightsPerChannel = Conv->InChannels * Conv->KernelSize * Conv->KernelSize;
+	for (int32 Channel = 0; Channel < Conv->OutChannels; ++Channel)
+	{
+		const float Scale = Tensors[0]->Data[Channel] * FMath::InvSqrt(Tensors[3]->Data[Channel] + Epsilon);
+		float* Weights = Net.Parameters.GetData() + Conv->WeightOffset + Channel * WeightsPerChannel;
+		for (int32 Index = 0; Index < WeightsPerChannel; ++Index)
+		{
+			Weights[Index] *= Scale;
+		}
+
+		float& Bias = Net.Parameters[Conv->BiasOffset + Channel];
+		Bias = (Bias - Tensors[2]->Data[Channel]) * Scale + Tensors[1]->Data[Channel];
+	}
+
+	BindAlias(Node.Outputs[0], Input);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileInstanceNormalization(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input) || !Materialize(Node, Input))
+	{
+		return false;
+	}
+
+	const int32 Channels = ValueChannels[Input.Value];
+	const StyleTransferOnnx::FTensor* Scale = Node.Inputs.IsValidIndex(1) ? FindConstant(Node.Inputs[1]) : nullptr;
+	const StyleTransferOnnx::FTensor* Bias = Node.Inputs.IsValidIndex(2) ? FindConstant(Node.Inputs[2]) : nullptr;
+	if (!Scale || !Bias || Scale->Data.Num() != Channels || Bias->Data.Num() != Channels)
+	{
+		return Fail(FString::Printf(TEXT("InstanceNormalization node '%s' needs constant scale and bias of %d values"), *Node.Name, Channels));
+	}
+
+	FStyleTransferConvNetLayer& Layer = AddLayer(EStyleTransferConvNetOp::InstanceNorm, Input.Value, Channels, Channels);
+	Layer.WeightOffset = AddParameters(Scale->Data);
+	Layer.BiasOffset = AddParameters(Bias->Data);
+	Layer.Epsilon = Node.GetFloat(TEXT("epsilon"), 1e-5f);
+	Bind(Node.Outputs[0], Layer.Output);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileActivation(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input) || !Materialize(Node, Input))
+	{
+		return false;
+	}
+
+	EStyleTransferConvNetActivation Activation = EStyleTransferConvNetActivation::Relu;
+	float ClipMin = -MAX_flt;
+	float ClipMax = MAX_flt;
+	if (Node.OpType == TEXT("Sigmoid"))
+	{
+		Activation = EStyleTransferConvNetActivation::Sigmoid;
+	}
+	else if (Node.OpType == TEXT("Tanh"))
+	{
+		Activation = EStyleTransferConvNetActivation::Tanh;
+	}
+	else if (Node.OpType == TEXT("Clip"))
+	{
+		// Opset 11+ passes the bounds as optional inputs, older opsets as attributes.
+		Activation = EStyleTransferConvNetActivation::Clip;
+		ClipMin = Node.GetFloat(TEXT("min"), ClipMin);
+		ClipMax = Node.GetFloat(TEXT("max"), ClipMax);
+		if (Node.Inputs.IsValidIndex(1) && !Node.Inputs[1].IsEmpty() && !GetScalar(Node.Inputs[1], ClipMin))
+		{
+			return Fail(FString::Printf(TEXT("Clip node '%s' needs a constant minimum"), *Node.Name));
+		}
+		if (Node.Inputs.IsValidIndex(2) && !Node.Inputs[2].IsEmpty() && !GetScalar(Node.Inputs[2], ClipMax))
+		{
+			return Fail(FString::Printf(TEXT("Clip node '%s' needs a constant maximum"), *Node.Name));
+		}
+	}
+
+	FStyleTransferConvNetLayer* Layer = FindFusableProducer(Input);
+	if (!Layer || !HasIdentityOutput(*Layer))
+	{
+		Layer = &AddCopyLayer(Input);
+	}
+
+	Layer->Activation = Activation;
+	Layer->ClipMin = ClipMin;
+	Layer->ClipMax = ClipMax;
+
+	FValueRef Output;
+	Output.Value = Layer->Output;
+	Output.bExclusive = true;
+	BindAlias(Node.Outputs[0], Output);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileArithmetic(const StyleTransferOnnx::FNode& Node)
+{
+	if (Node.Inputs.Num() != 2)
+	{
+		return Fail(FString::Printf(TEXT("%s node '%s' must have two inputs"), *Node.OpType, *Node.Name));
+	}
+
+	float Constant = 0.0f;
+	const bool bFirstConstant = GetScalar(Node.Inputs[0], Constant);
+	const bool bSecondConstant = !bFirstConstant && GetScalar(Node.Inputs[1], Constant);
+
+	if (!bFirstConstant && !bSecondConstant)
+	{
+		if (Node.OpType != TEXT("Add"))
+		{
+			return Fail(FString::Printf(TEXT("%s node '%s' combines two tensors; only Add (residual) or scalar constants are supported"), *Node.OpType, *Node.Name));
+		}
+
+		FValueRef First;
+		FValueRef Second;
+		if (!GetValue(Node, 0, First) || !GetValue(Node, 1, Second) || !Materialize(Node, First) || !Materialize(Node, Second))
+		{
+			return false;
+		}
+
+		const int32 Channels = ValueChannels[First.Value];
+		if (ValueChannels[Second.Value] != Channels)
+		{
+			return Fail(FString::Printf(TEXT("Add node '%s' has mismatched channel counts"), *Node.Name));
+		}
+
+		FStyleTransferConvNetLayer& Layer = AddLayer(EStyleTransferConvNetOp::Add, First.Value, Channels, Channels);
+		Layer.Residual = Second.Value;
+		Bind(Node.Outputs[0], Layer.Output);
+		return true;
+	}
+
+	FValueRef Input;
+	if (!GetValue(Node, bFirstConstant ? 1 : 0, Input))
+	{
+		return false;
+	}
+
+	if (Node.OpType == TEXT("Add"))
+	{
+		return CompileAffine(Node, Input, 1.0f, Constant);
+	}
+	if (Node.OpType == TEXT("Mul"))
+	{
+		return CompileAffine(Node, Input, Constant, 0.0f);
+	}
+	if (Node.OpType == TEXT("Sub"))
+	{
+		return bFirstConstant ? CompileAffine(Node, Input, -1.0f, Constant) : CompileAffine(Node, Input, 1.0f, -Constant);
+	}
+	if (bFirstConstant || Constant == 0.0f)
+	{
+		return Fail(FString::Printf(TEXT("Div node '%s' must divide a tensor by a non-zero constant"), *Node.Name));
+	}
+	return CompileAffine(Node, Input, 1.0f / Constant, 0.0f);
+}
+
+bool FStyleTransferConvNetCompiler::CompileAffine(const StyleTransferOnnx::FNode& Node, FValueRef Ref, float Scale, float Bias)
+{
+	if (!Materialize(Node, Ref))
+	{
+		return false;
+	}
+
+	// Preprocessing of the network input (x * 255, x - 0.5, ...) folds into the encode.
+	if (Ref.Value == 0 && Ref.bExclusive)
+	{
+		Net.InputScale *= Scale;
+		Net.InputBias = Net.InputBias * Scale + Bias;
+		BindAlias(Node.Outputs[0], Ref);
+		return true;
+	}
+
+	FStyleTransferConvNetLayer* Layer = FindFusableProducer(Ref);
+	if (!Layer)
+	{
+		Layer = &AddCopyLayer(Ref);
+	}
+
+	if (HasIdentityOutput(*Layer) && (Layer->Op == EStyleTransferConvNetOp::Conv || Layer->Op == EStyleTransferConvNetOp::InstanceNorm))
+	{
+		// Before any activation, the affine folds into the layer's own weights and bias.
+		const int32 ScaledCount = Layer->Op == EStyleTransferConvNetOp::Conv
+			? Layer->OutChannels * Layer->InChannels * Layer->KernelSize * Layer->KernelSize
+			: Layer->OutChannels;
+		for (int32 Index = 0; Index < ScaledCount; ++Index)
+		{
+			Net.Parameters[Layer->WeightOffset + Index] *= Scale;
+		}
+		for (int32 Channel = 0; Channel < Layer->OutChannels; ++Channel)
+		{
+			float& LayerBias = Net.Parameters[Layer->BiasOffset + Channel];
+			LayerBias = LayerBias * Scale + Bias;
+		}
+	}
+	else
+	{
+		Layer->OutputScale *= Scale;
+		Layer->OutputBias = Layer->OutputBias * Scale + Bias;
+	}
+
+	FValueRef Output;
+	Output.Value = Layer->Output;
+	Output.bExclusive = true;
+	BindAlias(Node.Outputs[0], Output);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompilePad(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input))
+	{
+		return false;
+	}
+
+	if (Input.Padding != 0)
+	{
+		return Fail(FString::Printf(TEXT("Pad node '%s' pads an input that is already padded"), *Node.Name));
+	}
+
+	const FString Mode = Node.GetString(TEXT("mode"), TEXT("constant"));
+	if (Mode == TEXT("reflect"))
+	{
+		Input.PaddingMode = EStyleTransferConvNetPadding::Reflect;
+	}
+	else if (Mode == TEXT("edge"))
+	{
+		Input.PaddingMode = EStyleTransferConvNetPadding::Replicate;
+	}
+	else if (Mode == TEXT("constant"))
+	{
+		float Value = Node.GetFloat(TEXT("value"), 0.0f);
+		if (Node.Inputs.IsValidIndex(2) && !Node.Inputs[2].IsEmpty() && !GetScalar(Node.Inputs[2], Value))
+		{
+			Value = MAX_flt;
+		}
+		if (Value != 0.0f)
+		{
+			return Fail(FString::Printf(TEXT("Pad node '%s' pads with a non-zero constant"), *Node.Name));
+		}
+		Input.PaddingMode = EStyleTransferConvNetPadding::Zero;
+	}
+	else
+	{
+		return Fail(FString::Printf(TEXT("Pad node '%s' uses unsupported mode '%s'"), *Node.Name, *Mode));
+	}
+
+	// Opset 11+ passes pads as an input, older opsets as an attribute: [N, C, H, W] begins then ends.
+	TArray<int64> Pads = Node.GetInts(TEXT("pads"));
+	if (Node.Inputs.IsValidIndex(1) && !Node.Inputs[1].IsEmpty())
+	{
+		const StyleTransferOnnx::FTensor* PadsTensor = FindConstant(Node.Inputs[1]);
+		if (!PadsTensor)
+		{
+			return Fail(FString::Printf(TEXT("Pad node '%s' needs constant pads"), *Node.Name));
+		}
+
+		Pads.Reset();
+		for (const float Value : PadsTensor->Data)
+		{
+			Pads.Add(static_cast<int64>(Value));
+		}
+	}
+
+	if (Pads.Num() != 8 || Pads[0] != 0 || Pads[1] != 0 || Pads[4] != 0 || Pads[5] != 0
+		|| Pads[2] != Pads[3] || Pads[2] != Pads[6] || Pads[2] != Pads[7] || Pads[2] < 0)
+	{
+		return Fail(FString::Printf(TEXT("Pad node '%s' must pad both spatial dimensions equally"), *Node.Name));
+	}
+
+	Input.Padding = static_cast<int32>(Pads[2]);
+	BindAlias(Node.Outputs[0], Input);
+	return true;
+}
+
+bool FStyleTransferConvNetCompiler::CompileUpsample(const StyleTransferOnnx::FNode& Node)
+{
+	FValueRef Input;
+	if (!GetValue(Node, 0, Input))
+	{
+		return false;
+	}
+
+	if (Input.Padding != 0 || Node.GetString(TEXT("mode"), TEXT("nearest")) != TEXT("nearest"))
+	{
+		return Fail(FString::Printf(TEXT("%s node '%s' must be a nearest upsample of an unpadded tensor"), *Node.OpType, *Node.Name));
+	}
+
+	// Upsample-7 has a scales attribute; Upsample-9 and Resize-10 a scales input; Resize-11+ has roi before scales.
+	TArray<float> Scales = Node.Attributes.Contains(TEXT("scales")) ? Node.Attributes[TEXT("scales")].Floats : TArray<float>();
+	const int32 ScalesInput = Node.OpType == TEXT("Resize") && Node.Inputs.Num() > 2 ? 2 : 1;
+	if (Node.Inputs.IsValidIndex(ScalesInput) && !Node.Inputs[ScalesInput].IsEmpty())
+	{
+		if (const StyleTransferOnnx::FTensor* ScalesTensor = FindConstant(Node.Inputs[ScalesInput]))
+		{
+			Scales = ScalesTensor->Data;
+		}
+	}
+
+	const int32 Factor = Scales.Num() == 4 ? FMath::RoundToInt32(Scales[2]) : 0;
+	if (Scales.Num() != 4 || Scales[0] != 1.0f || Scales[1] != 1.0f || Scales[2] != Scales[3] || Factor < 1 || Scales[2] != static_cast<float>(Factor))
+	{
+		return Fail(FString::Printf(TEXT("%s node '%s' needs constant integer spatial scales (sizes are not supported)"), *Node.OpType, *Node.Name));
+	}
+
+	Input.Upsample *= Factor;
+	BindAlias(Node.Outputs[0], Input);
+	return true;
+}
+
+void FStyleTransferConvNetCompiler::PackGpuParameters()
+{
+	Net.GpuParameters = Net.Parameters;
+	Net.GpuParameters.SetNumZeroed(Align(Net.GpuParameters.Num(), 4));
+
+	for (FStyleTransferConvNetLayer& Layer : Net.Layers)
+	{
+		if (Layer.Op != EStyleTransferConvNetOp::Conv)
+		{
+			continue;
+		}
+
+		Layer.PackedWeightOffset = Net.GpuParameters.Num() / 4;
+		const int32 KernelArea = Layer.KernelSize * Layer.KernelSize;
+		for (int32 Block = 0; Block < FMath::DivideAndRoundUp(Layer.OutChannels, 4); ++Block)
+		{
+			for (int32 InChannel = 0; InChannel < Layer.InChannels; ++InChannel)
+			{
+				for (int32 Tap = 0; Tap < KernelArea; ++Tap)
+				{
+					for (int32 Lane = 0; Lane < 4; ++Lane)
+					{
+						const int32 OutChannel = Block * 4 + Lane;
+						Net.GpuParameters.Add(OutChannel < Layer.OutChannels
+							? Net.Parameters[Layer.WeightOffset + (OutChannel * Layer.InChannels + InChannel) * KernelArea + Tap]
+							: 0.0f);
+					}
+				}
+			}
+		}
+	}
+
+	Net.GpuParameterBytes = Net.GpuParameters.Num() * sizeof(float);
+}
+
+TSharedPtr<FStyleTransferConvNet, ESPMode::ThreadSafe> FStyleTransferConvNet::Create(const uint8* Data, int64 Size, const FString& ModelName)
+{
+	StyleTransferOnnx::FGraph Graph;
+	FString Error;
+	if (!StyleTransferOnnx::ReadGraph(Data, Size, Graph, Error))
+	{
+		UE_LOG(LogStyleTransferConvNet, Error, TEXT("Unable to read '%s': %s."), *ModelName, *Error);
+		return nullptr;
+	}
+
+	TSharedPtr<FStyleTransferConvNet, ESPMode::ThreadSafe> Net = MakeShared<FStyleTransferConvNet, ESPMode::ThreadSafe>();
+	FStyleTransferConvNetCompiler Compiler(*Net, Graph);
+	if (!Compiler.Compile())
+	{
+		UE_LOG(LogStyleTransferConvNet, Error, TEXT("'%s' can't run on the built-in executor: %s. Use an NNE runtime instead."), *ModelName, *Compiler.Error);
+		return nullptr;
+	}
+
+	UE_LOG(LogStyleTransferConvNet, Log, TEXT("Compiled '%s' into %d layer(s), %.2f MB of parameters."),
+		*ModelName,
+		Net->Layers.Num(),
+		Net->GetParameterBytes() / (1024.0 * 1024.0));
+	return Net;
+}
+
+TArray<FIntPoint> FStyleTransferConvNet::ResolveValueSizes(FIntPoint InputResolution) const
+{
+	TArray<FIntPoint> Sizes;
+	Sizes.Init(FIntPoint::ZeroValue, ValueCount);
+	Sizes[0] = InputResolution;
+
+	for (const FStyleTransferConvNetLayer& Layer : Layers)
+	{
+		const FIntPoint Input = Sizes[Layer.Input];
+		FIntPoint Output = Input;
+		if (Layer.Op == EStyleTransferConvNetOp::Conv)
+		{
+			const FIntPoint Upsampled = Input * Layer.InputUpsample;
+			if (Layer.PaddingMode == EStyleTransferConvNetPadding::Reflect && Layer.Padding >= FMath::Min(Upsampled.X, Upsampled.Y))
+			{
+				return TArray<FIntPoint>();
+			}
+
+			const FIntPoint Padded(Upsampled.X + 2 * Layer.Padding, Upsampled.Y + 2 * Layer.Padding);
+			Output = Padded.X >= Layer.KernelSize && Padded.Y >= Layer.KernelSize
+				? FIntPoint((Padded.X - Layer.KernelSize) / Layer.Stride + 1, (Padded.Y - Layer.KernelSize) / Layer.Stride + 1)
+				: FIntPoint::ZeroValue;
+		}
+		else if (Layer.Op == EStyleTransferConvNetOp::Upsample)
+		{
+			Output = Input * Layer.InputUpsample;
+		}
+		else if (Layer.Op == EStyleTransferConvNetOp::Add && Sizes[Layer.Residual] != Input)
+		{
+			return TArray<FIntPoint>();
+		}
+
+		if (Output.X <= 0 || Output.Y <= 0)
+		{
+			return TArray<FIntPoint>();
+		}
+		Sizes[Layer.Output] = Output;
+	}
+	return Sizes;
+}
+
+TArray<int32> FStyleTransferConvNet::GetValueChannels() const
+{
+	TArray<int32> Channels;
+	Channels.Init(InputChannels, ValueCount);
+	for (const FStyleTransferConvNetLayer& Layer : Layers)
+	{
+		Channels[Layer.Output] = Layer.OutChannels;
+	}
+	return Channels;
+}
+
+FIntPoint FStyleTransferConvNet::GetOutputResolution(FIntPoint InputResolution) const
+{
+	const TArray<FIntPoint> Sizes = ResolveValueSizes(InputResolution);
+	return Sizes.IsEmpty() ? FIntPoint::ZeroValue : Sizes[OutputValue];
+}
+
+int64 FStyleTransferConvNet::GetActivationBytes(FIntPoint InputResolution) const
+{
+	const TArray<FIntPoint> Sizes = ResolveValueSizes(InputResolution);
+	if (Sizes.IsEmpty())
+	{
+		return 0;
+	}
+
+	const TArray<int32> Channels = GetValueChannels();
+	// The encoded input, created when the area filter keeps the first convolution from sampling the scene.
+	int64 Bytes = static_cast<int64>(Channels[0]) * GetPlaneSize(InputResolution) * sizeof(float);
+	for (const FStyleTransferConvNetLayer& Layer : Layers)
+	{
+		Bytes += static_cast<int64>(Channels[Layer.Output]) * GetPlaneSize(Sizes[Layer.Output]) * sizeof(float);
+	}
+	return Bytes;
+}
+
+bool FStyleTransferConvNet::RunCPU(TConstArrayView<float> Input, FIntPoint InputResolution, TArray<float>& OutOutput, FIntPoint& OutResolution) const
+{
+	const TArray<FIntPoint> Sizes = ResolveValueSizes(InputResolution);
+	if (Sizes.IsEmpty() || Input.Num() != InputChannels * GetPlaneSize(InputResolution))
+	{
+		return false;
+	}
+
+	const TArray<int32> Channels = GetValueChannels();
+
+	// Activations are freed after their last reader to keep the peak footprint near two layers.
+	TArray<int32> LastUse;
+	LastUse.Init(INDEX_NONE, ValueCount);
+	for (int32 LayerIndex = 0; LayerIndex < Layers.Num(); ++LayerIndex)
+	{
+		LastUse[Layers[LayerIndex].Input] = LayerIndex;
+		if (Layers[LayerIndex].Residual != INDEX_NONE)
+		{
+			LastUse[Layers[LayerIndex].Residual] = LayerIndex;
+		}
+	}
+
+	TArray<TArray<float>> Values;
+	Values.SetNum(ValueCount);
+	Values[0].SetNumUninitialized(Input.Num());
+	for (int32 Index = 0; Index < Input.Num(); ++Index)
+	{
+		Values[0][Index] = Input[Index] * InputScale + InputBias;
+	}
+
+	for (int32 LayerIndex = 0; LayerIndex < Layers.Num(); ++LayerIndex)
+	{
+		const FStyleTransferConvNetLayer& Layer = Layers[LayerIndex];
+		const FIntPoint InputSize = Sizes[Layer.Input];
+		const FIntPoint OutputSize = Sizes[Layer.Output];
+		const float* LayerInput = Values[Layer.Input].GetData();
+		TArray<float>& LayerOutput = Values[Layer.Output];
+		LayerOutput.SetNumUninitialized(Channels[Layer.Output] * GetPlaneSize(OutputSize));
+
+		switch (Layer.Op)
+		{
+		case EStyleTransferConvNetOp::Conv:
+			RunConvCPU(Layer, Parameters.GetData(), LayerInput, InputSize, LayerOutput.GetData(), OutputSize);
+			break;
+		case EStyleTransferConvNetOp::InstanceNorm:
+			RunInstanceNormCPU(Layer, Parameters.GetData(), LayerInput, InputSize, LayerOutput.GetData());
+			break;
+		case EStyleTransferConvNetOp::Add:
+			for (int32 Index = 0; Index < LayerOutput.Num(); ++Index)
+			{
+				LayerOutput[Index] = ApplyLayerOutput(LayerInput[Index] + Values[Layer.Residual][Index], Layer);
+			}
+			break;
+		case EStyleTransferConvNetOp::Upsample:
+			for (int32 Channel = 0; Channel < Layer.OutChannels; ++Channel)
+			{
+				for (int32 Y = 0; Y < OutputSize.Y; ++Y)
+				{
+					for (int32 X = 0; X < OutputSize.X; ++X)
+					{
+						const float Value = LayerInput[Channel * GetPlaneSize(InputSize) + (Y / Layer.InputUpsample) * InputSize.X + X / Layer.InputUpsample];
+						LayerOutput[Channel * GetPlaneSize(OutputSize) + Y * OutputSize.X + X] = ApplyLayerOutput(Value, Layer);
+					}
+				}
+			}
+			break;
+		}
+
+		for (int32 Value = 0; Value < ValueCount; ++Value)
+		{
+			if (LastUse[Value] == LayerIndex && Value != OutputValue)
+			{
+				Values[Value].Empty();
+			}
+		}
+	}
+
+	OutOutput = MoveTemp(Values[OutputValue]);
+	OutResolution = Sizes[OutputValue];
+	return true;
+}
+
+FRDGTextureRef FStyleTransferConvNet::AddPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, const FIntRect& SourceRect, FIntPoint InputResolution) const
+{
+	check(IsInRenderingThread());
+
+	const TArray<FIntPoint> Sizes = ResolveValueSizes(InputResolution);
+	if (Sizes.IsEmpty())
+	{
+		UE_LOG(LogStyleTransferConvNet, Warning, TEXT("Input resolution %dx%d is too small for the network."), InputResolution.X, InputResolution.Y);
+		return nullptr;
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.ConvNet");
+	RDG_GPU_STAT_SCOPE(GraphBuilder, StyleTransferConvNet);
+
+	// The parameters are uploaded once and then live in a pooled buffer for as long as the network.
+	if (!GpuParameterBuffer.IsValid())
+	{
+		FRDGBufferRef Upload = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateBufferDesc(sizeof(float), GpuParameters.Num()),
+			TEXT("StyleTransfer.ConvNetParameters"));
+		GraphBuilder.QueueBufferUpload(Upload, GpuParameters.GetData(), GpuParameters.Num() * sizeof(float));
+		GpuParameterBuffer = GraphBuilder.ConvertToExternalBuffer(Upload);
+		GpuParameters.Empty();
+	}
+
+	FRDGBufferRef ParameterBuffer = GraphBuilder.RegisterExternalBuffer(GpuParameterBuffer);
+	FRDGBufferSRVRef ScalarParameters = CreateTensorSRV(GraphBuilder, ParameterBuffer);
+	FRDGBufferSRVRef PackedWeights = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(ParameterBuffer, PF_A32B32G32R32F));
+
+	const TArray<int32> Channels = GetValueChannels();
+	const FIntPoint OutputResolution = Sizes[OutputValue];
+	FRDGTextureRef StylizedTexture = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(OutputResolution, PF_FloatRGBA, FClearValueBinding::Transparent, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("StyleTransfer.StylizedLowRes"));
+
+	const FStyleTransferConvNetLayer* OutputLayer = Layers.FindByPredicate([this](const FStyleTransferConvNetLayer& Layer) { return Layer.Output == OutputValue; });
+	const bool bFusedDecode = OutputLayer->Op == EStyleTransferConvNetOp::Conv && OutputLayer->OutChannels <= 4;
+
+	TArray<FRDGBufferRef> Buffers;
+	Buffers.SetNumZeroed(ValueCount);
+
+	// The first convolution samples the scene itself, one bilinear tap per kernel tap. The area filter's footprint
+	// average would have to run for every tap, so while it applies the frame is encoded into a tensor first.
+	if (StyleTransferPasses::UseEncodeAreaFilter(SourceRect, InputResolution))
+	{
+		Buffers[0] = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateBufferDesc(sizeof(float), Channels[0] * GetPlaneSize(InputResolution)),
+			TEXT("StyleTransfer.ConvNetActivation"));
+		StyleTransferPasses::AddEncodePass(GraphBuilder, SourceTexture, SourceRect, InputResolution, Channels[0], InputScale, InputBias, Buffers[0]);
+	}
+
+	for (const FStyleTransferConvNetLayer& Layer : Layers)
+	{
+		const FIntPoint InputSize = Sizes[Layer.Input];
+		const FIntPoint OutputSize = Sizes[Layer.Output];
+		const bool bWritesTexture = bFusedDecode && Layer.Output == OutputValue;
+		if (!bWritesTexture)
+		{
+			Buffers[Layer.Output] = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateBufferDesc(sizeof(float), Channels[Layer.Output] * GetPlaneSize(OutputSize)),
+				TEXT("StyleTransfer.ConvNetActivation"));
+		}
+
+		if (Layer.Op == EStyleTransferConvNetOp::Conv)
+		{
+			const bool bReadsTexture = Layer.Input == 0 && Buffers[0] == nullptr;
+
+			auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FConvNetConvCS::FParameters>();
+			Parameters->InputResolution = InputSize;
+			Parameters->OutputResolution = OutputSize;
+			Parameters->InChannels = Layer.InChannels;
+			Parameters->OutChannels = Layer.OutChannels;
+			Parameters->KernelSize = Layer.KernelSize;
+			Parameters->Stride = Layer.Stride;
+			Parameters->Padding = Layer.Padding;
+			Parameters->PaddingMode = static_cast<uint32>(Layer.PaddingMode);
+			Parameters->InputUpsample = Layer.InputUpsample;
+			Parameters->BiasOffset = Layer.BiasOffset;
+			Parameters->PackedWeightOffset = Layer.PackedWeightOffset;
+			SetLayerOutputParameters(Parameters->LayerOutput, Layer);
+			Parameters->ScalarParameters = ScalarParameters;
+			Parameters->PackedWeights = PackedWeights;
+
+			if (bReadsTexture)
+			{
+				Parameters->ViewMin = FVector2f(SourceRect.Min.X, SourceRect.Min.Y);
+				Parameters->ViewSize = FVector2f(SourceRect.Width(), SourceRect.Height());
+				Parameters->SourceExtent = FVector2f(SourceTexture->Desc.Extent.X, SourceTexture->Desc.Extent.Y);
+				Parameters->EncodeScale = StyleTransferPasses::EncodeScale * InputScale;
+				Parameters->EncodeBias = InputBias;
+				Parameters->SourceTexture = SourceTexture;
+				Parameters->SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+			}
+			else
+			{
+				Parameters->InputTensor = CreateTensorSRV(GraphBuilder, Buffers[Layer.Input]);
+			}
+
+			if (bWritesTexture)
+			{
+				Parameters->DecodeScale = StyleTransferPasses::DecodeScale;
+				Parameters->DecodeBias = 0.0f;
+				Parameters->OutputTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(StylizedTexture));
+			}
+			else
+			{
+				Parameters->OutputTensor = CreateTensorUAV(GraphBuilder, Buffers[Layer.Output]);
+			}
+
+			FPStyleTransferShaders::FConvNetConvCS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FConvNetConvCS::FInputTextureDim>(bReadsTexture);
+			PermutationVector.Set<FPStyleTransferShaders::FConvNetConvCS::FOutputTextureDim>(bWritesTexture);
+			TShaderMapRef<FPStyleTransferShaders::FConvNetConvCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+			FIntVector GroupCount = StyleTransferPasses::MakeGroupCount(OutputSize);
+			GroupCount.Z = FMath::DivideAndRoundUp(Layer.OutChannels, 4);
+			FComputeShaderUtils::AddPass(
+				GraphBuilder,
+				RDG_EVENT_NAME("StyleTransfer.ConvNet.Conv %dx%d %d->%d", Layer.KernelSize, Layer.KernelSize, Layer.InChannels, Layer.OutChannels),
+				Shader,
+				Parameters,
+				GroupCount);
+		}
+		else if (Layer.Op == EStyleTransferConvNetOp::InstanceNorm)
+		{
+			FRDGBufferRef Stats = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateBufferDesc(sizeof(float), 2 * Layer.OutChannels),
+				TEXT("StyleTransfer.ConvNetInstanceNormStats"));
+
+			for (const bool bStats : { true, false })
+			{
+				auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FConvNetInstanceNormCS::FParameters>();
+				Parameters->Resolution = InputSize;
+				Parameters->Channels = Layer.OutChannels;
+				Parameters->ScaleOffset = Layer.WeightOffset;
+				Parameters->BiasOffset = Layer.BiasOffset;
+				Parameters->Epsilon = Layer.Epsilon;
+				SetLayerOutputParameters(Parameters->LayerOutput, Layer);
+				Parameters->ScalarParameters = ScalarParameters;
+				Parameters->InputTensor = CreateTensorSRV(GraphBuilder, Buffers[Layer.Input]);
+				if (bStats)
+				{
+					Parameters->StatsOutput = CreateTensorUAV(GraphBuilder, Stats);
+				}
+				else
+				{
+					Parameters->Stats = CreateTensorSRV(GraphBuilder, Stats);
+					Parameters->OutputTensor = CreateTensorUAV(GraphBuilder, Buffers[Layer.Output]);
+				}
+
+				FPStyleTransferShaders::FConvNetInstanceNormCS::FPermutationDomain PermutationVector;
+				PermutationVector.Set<FPStyleTransferShaders::FConvNetInstanceNormCS::FStatsDim>(bStats);
+				TShaderMapRef<FPStyleTransferShaders::FConvNetInstanceNormCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+				FIntVector GroupCount = StyleTransferPasses::MakeGroupCount(InputSize);
+				GroupCount.Z = Layer.OutChannels;
+				FComputeShaderUtils::AddPass(
+					GraphBuilder,
+					bStats ? RDG_EVENT_NAME("StyleTransfer.ConvNet.InstanceNormStats") : RDG_EVENT_NAME("StyleTransfer.ConvNet.InstanceNorm"),
+					Shader,
+					Parameters,
+					bStats ? FIntVector(Layer.OutChannels, 1, 1) : GroupCount);
+			}
+		}
+		else
+		{
+			const bool bAdd = Layer.Op == EStyleTransferConvNetOp::Add;
+			AddElementwisePass(
+				GraphBuilder,
+				bAdd ? FPStyleTransferShaders::EConvNetElementwiseOp::Add : FPStyleTransferShaders::EConvNetElementwiseOp::Upsample,
+				&Layer,
+				InputSize,
+				OutputSize,
+				Layer.OutChannels,
+				Buffers[Layer.Input],
+				bAdd ? Buffers[Layer.Residual] : nullptr,
+				Buffers[Layer.Output],
+				nullptr);
+		}
+	}
+
+	if (!bFusedDecode)
+	{
+		AddElementwisePass(
+			GraphBuilder,
+			FPStyleTransferShaders::EConvNetElementwiseOp::Decode,
+			nullptr,
+			OutputResolution,
+			OutputResolution,
+			OutputChannels,
+			Buffers[OutputValue],
+			nullptr,
+			nullptr,
+			StylizedTexture);
+	}
+
+	return StylizedTexture;
+}
+
+namespace RealtimeStyleTransfer
+{
+	/** Times the CPU executor against NNERuntimeORTCpu on the same random frame and checks they agree. */
+	static void BenchmarkConvNet(const TArray<FString>& Args)
+	{
+		if (Args.IsEmpty())
+		{
+			UE_LOG(LogStyleTransferConvNet, Display, TEXT("Usage: StyleTransfer.BenchmarkConvNet <NNEModelData asset path> [Iterations]"));
+			return;
+		}
+
+		UNNEModelData* ModelData = LoadObject<UNNEModelData>(nullptr, *Args[0]);
+		if (!ModelData)
+		{
+			UE_LOG(LogStyleTransferConvNet, Error, TEXT("Unable to load model data '%s'."), *Args[0]);
+			return;
+		}
+
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 10;
+		const TConstArrayView64<uint8> FileData = ModelData->GetFileData();
+		const FStyleTransferConvNetPtr Net = FStyleTransferConvNet::Create(FileData.GetData(), FileData.Num(), ModelData->GetName());
+		if (!Net.IsValid())
+		{
+			return;
+		}
+
+		const FIntPoint Declared = Net->GetDeclaredResolution();
+		const FIntPoint Resolution = Declared.X > 0 ? Declared : FIntPoint(256, 256);
+
+		FRandomStream Random(1234);
+		TArray<float> Input;
+		Input.SetNumUninitialized(Net->GetInputChannels() * Resolution.X * Resolution.Y);
+		for (float& Value : Input)
+		{
+			Value = Random.FRand() * StyleTransferPasses::EncodeScale;
+		}
+
+		TArray<float> Output;
+		FIntPoint OutputResolution;
+		Net->RunCPU(Input, Resolution, Output, OutputResolution);
+
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Net->RunCPU(Input, Resolution, Output, OutputResolution);
+		}
+		const double ConvNetMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0 / Iterations;
+
+		UE_LOG(LogStyleTransferConvNet, Display, TEXT("%s at %dx%d: built-in CPU executor %.2f ms (%d layers)."),
+			*ModelData->GetName(),
+			Resolution.X,
+			Resolution.Y,
+			ConvNetMs,
+			Net->GetLayerCount());
+
+		TWeakInterfacePtr<INNERuntimeCPU> Runtime = UE::NNE::GetRuntime<INNERuntimeCPU>(TEXT("NNERuntimeORTCpu"));
+		TSharedPtr<UE::NNE::IModelCPU> Model = Runtime.IsValid() ? Runtime->CreateModelCPU(ModelData) : nullptr;
+		TSharedPtr<UE::NNE::IModelInstanceCPU> Instance = Model.IsValid() ? Model->CreateModelInstanceCPU() : nullptr;
+		const TArray<uint32> InputDimensions = { 1u, static_cast<uint32>(Net->GetInputChannels()), static_cast<uint32>(Resolution.Y), static_cast<uint32>(Resolution.X) };
+		const TArray<UE::NNE::FTensorShape> InputShapes = { UE::NNE::FTensorShape::Make(InputDimensions) };
+		if (!Instance.IsValid() || Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceCPU::ESetInputTensorShapesStatus::Ok)
+		{
+			UE_LOG(LogStyleTransferConvNet, Warning, TEXT("NNERuntimeORTCpu is unavailable for '%s'; skipping the comparison."), *ModelData->GetName());
+			return;
+		}
+
+		TArray<float> Reference;
+		Reference.SetNumZeroed(Output.Num());
+		const UE::NNE::FTensorBindingCPU InputBinding{ Input.GetData(), static_cast<uint64>(Input.Num() * sizeof(float)) };
+		const UE::NNE::FTensorBindingCPU OutputBinding{ Reference.GetData(), static_cast<uint64>(Reference.Num() * sizeof(float)) };
+		Instance->RunSync(MakeArrayView(&InputBinding, 1), MakeArrayView(&OutputBinding, 1));
+
+		StartSeconds = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Instance->RunSync(MakeArrayView(&InputBinding, 1), MakeArrayView(&OutputBinding, 1));
+		}
+		const double RuntimeMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0 / Iterations;
+
+		float MaxDifference = 0.0f;
+		for (int32 Index = 0; Index < Output.Num(); ++Index)
+		{
+			MaxDifference = FMath::Max(MaxDifference, FMath::Abs(Output[Index] - Reference[Index]));
+		}
+
+		UE_LOG(LogStyleTransferConvNet, Display, TEXT("%s at %dx%d: NNERuntimeORTCpu %.2f ms, built-in %.2f ms (%.2fx), max abs difference %g."),
+			*ModelData->GetName(),
+			Resolution.X,
+			Resolution.Y,
+			RuntimeMs,
+			ConvNetMs,
+			RuntimeMs / FMath::Max(ConvNetMs, UE_SMALL_NUMBER),
+			MaxDifference);
+		UE_LOG(LogStyleTransferConvNet, Display, TEXT("For the GPU, compare the 'StyleTransfer ConvNet' and 'StyleTransfer NNE' rows of 'stat gpu' with the style set to each runtime."));
+	}
+
+	static FAutoConsoleCommand BenchmarkConvNetCommand(
+		TEXT("StyleTransfer.BenchmarkConvNet"),
+		TEXT("Times the built-in conv-net executor against NNERuntimeORTCpu on a random frame and reports the largest output difference.\n")
+		TEXT("Usage: StyleTransfer.BenchmarkConvNet <NNEModelData asset path> [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkConvNet));
+}
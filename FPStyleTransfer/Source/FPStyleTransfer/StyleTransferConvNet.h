@@ -0,0 +1,138 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphDefinitions.h"
+
+class FRDGPooledBuffer;
+
+enum class EStyleTransferConvNetOp : uint8
+{
+	Conv,
+	InstanceNorm,
+	Add,
+	Upsample,
+};
+
+/** Values match STYLE_TRANSFER_ACTIVATION_* in StyleTransferConvNet.usf. */
+enum class EStyleTransferConvNetActivation : uint8
+{
+	None,
+	Relu,
+	Sigmoid,
+	Tanh,
+	Clip,
+};
+
+/** How a convolution reads outside its input. Values match STYLE_TRANSFER_PAD_* in StyleTransferConvNet.usf. */
+enum class EStyleTransferConvNetPadding : uint8
+{
+	Zero,
+	Reflect,
+	Replicate,
+};
+
+/**
+ * One fused layer: Output = Activation(Op(Inputs)) * OutputScale + OutputBias.
+ * Values are indexed activations; value 0 is the network input.
+ */
+struct FStyleTransferConvNetLayer
+{
+	EStyleTransferConvNetOp Op = EStyleTransferConvNetOp::Conv;
+	int32 Input = 0;
+	/** Second operand of Add. */
+	int32 Residual = INDEX_NONE;
+	int32 Output = 0;
+	int32 InChannels = 0;
+	int32 OutChannels = 0;
+
+	/** Conv: square kernel, symmetric padding. A nearest upsample of the input is folded in as InputUpsample. */
+	int32 KernelSize = 1;
+	int32 Stride = 1;
+	int32 Padding = 0;
+	EStyleTransferConvNetPadding PaddingMode = EStyleTransferConvNetPadding::Zero;
+	int32 InputUpsample = 1;
+
+	/** Offsets into the parameter array: Conv weights (OC x IC x K x K) and bias, or InstanceNorm scale and bias. */
+	int32 WeightOffset = 0;
+	int32 BiasOffset = 0;
+	/** Offset of the GPU weight layout (OC/4 x IC x K x K x 4), in float4s. */
+	int32 PackedWeightOffset = 0;
+	float Epsilon = 1e-5f;
+
+	EStyleTransferConvNetActivation Activation = EStyleTransferConvNetActivation::None;
+	float ClipMin = 0.0f;
+	float ClipMax = 0.0f;
+	float OutputScale = 1.0f;
+	float OutputBias = 0.0f;
+};
+
+/**
+ * Executes small feed-forward style networks (Conv, InstanceNormalization, Relu, residual Add, nearest Upsample)
+ * without NNE, on the GPU as fused compute passes or on the CPU with ParallelFor. The first convolution samples the
+ * scene texture directly and the last one writes the stylized texture, so there is no separate encode/decode pass.
+ * While r.RealtimeStyleTransfer.Encode.AreaFilter applies, the frame is area filtered into a tensor first instead.
+ *
+ * Selected through the runtime name "StyleTransferConvNet". Graphs with any other operator fail to load, and the
+ * style should then use an NNE runtime instead.
+ */
+class FPSTYLETRANSFER_API FStyleTransferConvNet
+{
+public:
+	static constexpr const TCHAR* RuntimeName = TEXT("StyleTransferConvNet");
+
+	/** Compiles a serialized ONNX model. Returns null and logs the reason when the graph is not supported. */
+	static TSharedPtr<FStyleTransferConvNet, ESPMode::ThreadSafe> Create(const uint8* Data, int64 Size, const FString& ModelName);
+
+	int32 GetInputChannels() const { return InputChannels; }
+	int32 GetOutputChannels() const { return OutputChannels; }
+	/** Input resolution declared by the model, or zero when its spatial dimensions are symbolic. */
+	FIntPoint GetDeclaredResolution() const { return DeclaredResolution; }
+	int32 GetLayerCount() const { return Layers.Num(); }
+	int64 GetParameterBytes() const { return Parameters.Num() * sizeof(float); }
+	/** Size of the GPU parameter buffer (scalar parameters plus packed conv weights). */
+	int64 GetGpuParameterBytes() const { return GpuParameterBytes; }
+
+	/**
+	 * Upper bound of the StyleTransfer.ConvNetActivation buffers AddPasses creates at InputResolution, before RDG aliasing.
+	 * Includes the encoded input, which only exists while the encode area filter applies.
+	 */
+	int64 GetActivationBytes(FIntPoint InputResolution) const;
+
+	/** Output resolution for an input of InputResolution. */
+	FIntPoint GetOutputResolution(FIntPoint InputResolution) const;
+
+	/** Runs the network on a CHW float tensor. Returns false when the resolution is too small for the graph. */
+	bool RunCPU(TConstArrayView<float> Input, FIntPoint InputResolution, TArray<float>& OutOutput, FIntPoint& OutResolution) const;
+
+	/**
+	 * Samples SourceRect of SourceTexture at InputResolution, runs the network and returns a new texture at the output
+	 * resolution, or null when the graph could not be scheduled. Render thread only.
+	 */
+	FRDGTextureRef AddPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, const FIntRect& SourceRect, FIntPoint InputResolution) const;
+
+private:
+	friend struct FStyleTransferConvNetCompiler;
+
+	TArray<FIntPoint> ResolveValueSizes(FIntPoint InputResolution) const;
+	TArray<int32> GetValueChannels() const;
+
+	TArray<FStyleTransferConvNetLayer> Layers;
+	int32 ValueCount = 1;
+	int32 OutputValue = 0;
+	int32 InputChannels = 3;
+	int32 OutputChannels = 3;
+	FIntPoint DeclaredResolution = FIntPoint::ZeroValue;
+	/** Scale and bias of a scalar affine applied to the network input, folded into the encode. */
+	float InputScale = 1.0f;
+	float InputBias = 0.0f;
+
+	TArray<float> Parameters;
+	/** Parameters laid out for the GPU (packed conv weights follow the scalar parameters). Freed once uploaded. */
+	mutable TArray<float> GpuParameters;
+	mutable TRefCountPtr<FRDGPooledBuffer> GpuParameterBuffer;
+	int64 GpuParameterBytes = 0;
+};
+
+using FStyleTransferConvNetPtr = TSharedPtr<FStyleTransferConvNet, ESPMode::ThreadSafe>;
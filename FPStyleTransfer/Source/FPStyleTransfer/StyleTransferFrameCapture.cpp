@@ -0,0 +1,99 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferFrameCapture.h"
+
+#include "RHIGPUReadback.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "Tasks/Task.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferCapture, Log, All);
+
+std::atomic<uint64> FStyleTransferFrameCapture::LatestGeneration = 0;
+
+FStyleTransferFrameCapture::FStyleTransferFrameCapture(FOnStyleTransferFrameCaptured InCallback, int32 InRingDepth, EStyleTransferCaptureSource InSource)
+	: Callback(MakeShared<FOnStyleTransferFrameCaptured, ESPMode::ThreadSafe>(MoveTemp(InCallback)))
+	, Source(InSource)
+	, Generation(++LatestGeneration)
+{
+	Slots.SetNum(FMath::Clamp(InRingDepth, 1, 16));
+}
+
+void FStyleTransferFrameCapture::Enqueue(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, const FIntRect& Rect, uint64 FrameNumber)
+{
+	FSlot* Target = Slots.FindByPredicate([](const FSlot& Slot) { return !Slot.bPending; });
+	if (!Target)
+	{
+		// Skip the new frame: the slots' staging textures are still being written by the GPU, so none can be reused.
+		++DroppedFrames;
+		UE_LOG(LogStyleTransferCapture, Verbose, TEXT("Readback ring full, dropped frame %llu."), FrameNumber);
+		return;
+	}
+
+	if (!Target->Readback.IsValid())
+	{
+		Target->Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("StyleTransfer.CaptureReadback"));
+	}
+
+	Target->FrameNumber = FrameNumber;
+	Target->Size = Rect.Size();
+	Target->Format = Texture->Desc.Format;
+	Target->bPending = true;
+
+	AddEnqueueCopyPass(GraphBuilder, Target->Readback.Get(), Texture, FResolveRect(Rect));
+}
+
+void FStyleTransferFrameCapture::Poll()
+{
+	Slots.Sort([](const FSlot& A, const FSlot& B) { return A.FrameNumber < B.FrameNumber; });
+
+	for (FSlot& Slot : Slots)
+	{
+		if (!Slot.bPending || !Slot.Readback->IsReady())
+		{
+			continue;
+		}
+
+		const uint32 BytesPerPixel = GPixelFormats[Slot.Format].BlockBytes;
+		const uint32 RowBytes = Slot.Size.X * BytesPerPixel;
+
+		int32 RowPitchInPixels = 0;
+		const uint8* Source = static_cast<const uint8*>(Slot.Readback->Lock(RowPitchInPixels));
+
+		FStyleTransferCapturedFrame Frame;
+		Frame.FrameNumber = Slot.FrameNumber;
+		Frame.Size = Slot.Size;
+		Frame.Format = Slot.Format;
+		Frame.Data.SetNumUninitialized(RowBytes * Slot.Size.Y);
+
+		if (Source)
+		{
+			for (int32 Row = 0; Row < Slot.Size.Y; ++Row)
+			{
+				FMemory::Memcpy(Frame.Data.GetData() + Row * RowBytes, Source + Row * RowPitchInPixels * BytesPerPixel, RowBytes);
+			}
+		}
+
+		Slot.Readback->Unlock();
+		Slot.bPending = false;
+
+		if (!Source || Generation != LatestGeneration)
+		{
+			continue;
+		}
+
+		UE::Tasks::Launch(UE_SOURCE_LOCATION, [Callback = Callback, Frame = MoveTemp(Frame), Generation = Generation]() mutable
+		{
+			// The capture may have been stopped while the task was queued.
+			if (Generation == LatestGeneration)
+			{
+				(*Callback)(MoveTemp(Frame));
+			}
+		});
+	}
+}
+
+bool FStyleTransferFrameCapture::HasPendingReadbacks() const
+{
+	return Slots.ContainsByPredicate([](const FSlot& Slot) { return Slot.bPending; });
+}
@@ -0,0 +1,75 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphDefinitions.h"
+
+#include <atomic>
+
+class FRHIGPUTextureReadback;
+
+/** Which texture of the style transfer pipeline is read back. */
+enum class EStyleTransferCaptureSource : uint8
+{
+	/** Full resolution composited frame (StyleTransfer.Output), in the scene color format. */
+	Output,
+	/** Model resolution stylized frame (StyleTransfer.StylizedLowRes), always PF_FloatRGBA. */
+	StylizedLowRes,
+};
+
+struct FStyleTransferCapturedFrame
+{
+	uint64 FrameNumber = 0;
+	FIntPoint Size = FIntPoint::ZeroValue;
+	EPixelFormat Format = PF_Unknown;
+	/** Tightly packed rows of Size.X * GPixelFormats[Format].BlockBytes bytes. */
+	TArray<uint8> Data;
+};
+
+using FOnStyleTransferFrameCaptured = TFunction<void(FStyleTransferCapturedFrame&&)>;
+
+/**
+ * Ring of GPU readbacks of stylized frames. Owned by the render thread: frames are enqueued from the
+ * graph, polled without waiting on the GPU and handed to the callback on a worker thread. When every
+ * slot is still in flight the new frame is skipped so capture never stalls rendering; readbacks
+ * already in flight are left to retire. Each capture belongs to a generation, and frames of a
+ * capture that was stopped or replaced are read back but never delivered.
+ */
+class FStyleTransferFrameCapture
+{
+public:
+	/** Starts a new generation, which invalidates every capture created before. Game thread. */
+	FStyleTransferFrameCapture(FOnStyleTransferFrameCaptured InCallback, int32 InRingDepth, EStyleTransferCaptureSource InSource);
+
+	/** Invalidates every capture created so far. A callback that is already running still finishes. Any thread. */
+	static void InvalidateAll() { ++LatestGeneration; }
+
+	EStyleTransferCaptureSource GetSource() const { return Source; }
+
+	void Enqueue(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, const FIntRect& Rect, uint64 FrameNumber);
+	void Poll();
+
+	/** True while a readback is still in flight. A stopped capture is kept and polled until this is false. */
+	bool HasPendingReadbacks() const;
+
+	uint64 GetDroppedFrameCount() const { return DroppedFrames; }
+
+private:
+	struct FSlot
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		uint64 FrameNumber = 0;
+		FIntPoint Size = FIntPoint::ZeroValue;
+		EPixelFormat Format = PF_Unknown;
+		bool bPending = false;
+	};
+
+	TSharedRef<FOnStyleTransferFrameCaptured, ESPMode::ThreadSafe> Callback;
+	TArray<FSlot> Slots;
+	EStyleTransferCaptureSource Source;
+	uint64 Generation = 0;
+	uint64 DroppedFrames = 0;
+
+	static std::atomic<uint64> LatestGeneration;
+};
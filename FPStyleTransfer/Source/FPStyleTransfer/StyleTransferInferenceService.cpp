@@ -0,0 +1,632 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferInferenceService.h"
+
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "Math/RandomStream.h"
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntimeCPU.h"
+#include "StyleTransferMemory.h"
+#include "StyleTransferPasses.h"
+#include "Tasks/Task.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferInference, Log, All);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("CPU inference queue depth"), STAT_StyleTransfer_CpuQueueDepth, STATGROUP_StyleTransfer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("CPU inference active instances"), STAT_StyleTransfer_CpuActiveInstances, STATGROUP_StyleTransfer);
+DECLARE_CYCLE_STAT(TEXT("CPU inference batch"), STAT_StyleTransfer_CpuInferenceBatch, STATGROUP_StyleTransfer);
+
+namespace
+{
+	FCriticalSection ServiceLock;
+	TUniquePtr<FStyleTransferCpuInferenceService> ServiceInstance;
+
+	/** Symbolic spatial dims resolve to this when the caller passes no resolution, as in CreateProxy. */
+	constexpr int32 DefaultSymbolicResolution = 224;
+
+	void TrackCpuMemory(const TWeakPtr<const void, ESPMode::ThreadSafe>& Owner, EStyleTransferMemoryKind Kind, const FStyleTransferCpuModel& Model, const FString& RuntimeName, uint32 BatchSize, int64 CpuBytes)
+	{
+		FStyleTransferMemoryEntry Entry;
+		Entry.Kind = Kind;
+		Entry.StyleName = Model.GetName();
+		Entry.RuntimeName = RuntimeName;
+		Entry.Resolution = Model.GetResolution();
+		Entry.BatchSize = BatchSize;
+		Entry.CpuBytes = CpuBytes;
+		StyleTransferMemory::Track(Owner, Entry);
+	}
+
+	TFuture<FStyleTransferCpuInferenceResult> MakeFailedFuture()
+	{
+		TPromise<FStyleTransferCpuInferenceResult> Promise;
+		Promise.SetValue(FStyleTransferCpuInferenceResult());
+		return Promise.GetFuture();
+	}
+}
+
+FStyleTransferCpuInferenceStats FStyleTransferCpuModel::GetStats() const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	FStyleTransferCpuInferenceStats Stats;
+	Stats.QueueDepth = Pending.Num();
+	Stats.ActiveInstances = ActiveInstances;
+	Stats.PooledInstances = CreatedInstances;
+	Stats.Requests = StatRequests;
+	Stats.Batches = StatBatches;
+	if (StatBatches > 0)
+	{
+		Stats.AverageBatchSize = static_cast<double>(StatRequests) / StatBatches;
+		Stats.AverageInferenceMs = StatInferenceMsSum / StatBatches;
+	}
+	if (StatRequests > 0)
+	{
+		Stats.AverageLatencyMs = StatLatencyMsSum / StatRequests;
+	}
+	Stats.MaxLatencyMs = StatMaxLatencyMs;
+	return Stats;
+}
+
+void FStyleTransferCpuModel::ResetStats()
+{
+	FScopeLock ScopeLock(&Lock);
+	StatRequests = 0;
+	StatBatches = 0;
+	StatLatencyMsSum = 0.0;
+	StatMaxLatencyMs = 0.0;
+	StatInferenceMsSum = 0.0;
+}
+
+bool FStyleTransferCpuModel::AcquireInstance(int32 BatchSize, FPooledInstance& OutInstance)
+{
+	// Prefer an instance already shaped for this batch size; reshaping reallocates the runtime's buffers.
+	int32 FreeIndex = FreeInstances.IndexOfByPredicate([BatchSize](const FPooledInstance& Pooled) { return Pooled.BatchSize == BatchSize; });
+	if (FreeIndex == INDEX_NONE && !FreeInstances.IsEmpty())
+	{
+		FreeIndex = FreeInstances.Num() - 1;
+	}
+
+	if (FreeIndex != INDEX_NONE)
+	{
+		OutInstance = MoveTemp(FreeInstances[FreeIndex]);
+		FreeInstances.RemoveAtSwap(FreeIndex);
+		return true;
+	}
+
+	if (CreatedInstances < Settings.MaxInstances)
+	{
+		// The instance is created by the batch task so the dispatcher never blocks on the runtime.
+		++CreatedInstances;
+		OutInstance = FPooledInstance();
+		return true;
+	}
+
+	return false;
+}
+
+double FStyleTransferCpuModel::Dispatch(double NowSeconds, TArray<UE::Tasks::FTask>& OutLaunched)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	while (!Pending.IsEmpty())
+	{
+		const double DeadlineSeconds = Pending[0].SubmitSeconds + Settings.MaxBatchDelayMs / 1000.0;
+		if (Pending.Num() < Settings.MaxBatchSize && NowSeconds < DeadlineSeconds)
+		{
+			return DeadlineSeconds;
+		}
+
+		const int32 BatchSize = FMath::Min(Pending.Num(), Settings.MaxBatchSize);
+		FPooledInstance PooledInstance;
+		if (!AcquireInstance(BatchSize, PooledInstance))
+		{
+			// Every instance is busy; the batch that finishes first wakes the dispatcher again.
+			return 0.0;
+		}
+
+		TArray<FRequest> Batch;
+		Batch.Reserve(BatchSize);
+		for (int32 RequestIndex = 0; RequestIndex < BatchSize; ++RequestIndex)
+		{
+			Batch.Add(MoveTemp(Pending[RequestIndex]));
+		}
+		Pending.RemoveAt(0, BatchSize);
+		DEC_DWORD_STAT_BY(STAT_StyleTransfer_CpuQueueDepth, BatchSize);
+		INC_DWORD_STAT(STAT_StyleTransfer_CpuActiveInstances);
+		++ActiveInstances;
+
+		OutLaunched.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION,
+			[This = AsShared(), Batch = MoveTemp(Batch), PooledInstance = MoveTemp(PooledInstance)]() mutable
+			{
+				This->RunBatch(Batch, PooledInstance);
+
+				{
+					FScopeLock ScopeLock(&This->Lock);
+					This->FreeInstances.Add(MoveTemp(PooledInstance));
+					--This->ActiveInstances;
+				}
+				DEC_DWORD_STAT(STAT_StyleTransfer_CpuActiveInstances);
+				This->Service->Wake();
+			},
+			UE::Tasks::ETaskPriority::BackgroundNormal));
+	}
+
+	return 0.0;
+}
+
+void FStyleTransferCpuModel::RunBatch(TArray<FRequest>& Batch, FPooledInstance& PooledInstance)
+{
+	SCOPE_CYCLE_COUNTER(STAT_StyleTransfer_CpuInferenceBatch);
+
+	const int32 BatchSize = Batch.Num();
+	const int32 InputFrameSize = InputChannels * Resolution.X * Resolution.Y;
+	const int32 OutputFrameSize = OutputChannels * OutputResolution.X * OutputResolution.Y;
+
+	if (!PooledInstance.Instance.IsValid())
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+		const StyleTransferMemory::FCpuProbe Probe;
+		PooledInstance.Instance = Model->CreateModelInstanceCPU();
+		PooledInstance.BatchSize = 0;
+		if (PooledInstance.Instance.IsValid())
+		{
+			TrackCpuMemory(PooledInstance.Instance, EStyleTransferMemoryKind::CpuInstance, *this, RuntimeName, 1, Probe.GetBytes());
+		}
+	}
+
+	bool bSuccess = PooledInstance.Instance.IsValid();
+	if (bSuccess && PooledInstance.BatchSize != BatchSize)
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+		const TArray<uint32> InputDimensions = { static_cast<uint32>(BatchSize), static_cast<uint32>(InputChannels), static_cast<uint32>(Resolution.Y), static_cast<uint32>(Resolution.X) };
+		const TArray<UE::NNE::FTensorShape> InputShapes = { UE::NNE::FTensorShape::Make(InputDimensions) };
+		bSuccess = PooledInstance.Instance->SetInputTensorShapes(InputShapes) == UE::NNE::IModelInstanceCPU::ESetInputTensorShapesStatus::Ok;
+		bSuccess = bSuccess && PooledInstance.Instance->GetOutputTensorShapes()[0].Volume() == static_cast<uint64>(OutputFrameSize) * BatchSize;
+		PooledInstance.BatchSize = bSuccess ? BatchSize : 0;
+	}
+
+	TArray<float> BatchInput;
+	TArray<float> BatchOutput;
+	double InferenceMs = 0.0;
+	if (bSuccess)
+	{
+		// A single request binds its own buffer; batches are packed along N.
+		const TArray<float>* Input = &Batch[0].Input;
+		if (BatchSize > 1)
+		{
+			BatchInput.Reserve(InputFrameSize * BatchSize);
+			for (const FRequest& Request : Batch)
+			{
+				BatchInput.Append(Request.Input);
+			}
+			Input = &BatchInput;
+		}
+		BatchOutput.SetNumUninitialized(OutputFrameSize * BatchSize);
+
+		const UE::NNE::FTensorBindingCPU InputBinding{ const_cast<float*>(Input->GetData()), static_cast<uint64>(Input->Num() * sizeof(float)) };
+		const UE::NNE::FTensorBindingCPU OutputBinding{ BatchOutput.GetData(), static_cast<uint64>(BatchOutput.Num() * sizeof(float)) };
+
+		const double StartSeconds = FPlatformTime::Seconds();
+		bSuccess = PooledInstance.Instance->RunSync(MakeArrayView(&InputBinding, 1), MakeArrayView(&OutputBinding, 1)) == UE::NNE::IModelInstanceCPU::ERunSyncStatus::Ok;
+		InferenceMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+	}
+
+	if (!bSuccess)
+	{
+		UE_LOG(LogStyleTransferInference, Warning, TEXT("CPU inference of a batch of %d failed for '%s'."), BatchSize, *Name);
+	}
+
+	const double CompleteSeconds = FPlatformTime::Seconds();
+	double LatencyMsSum = 0.0;
+	double MaxLatencyMs = 0.0;
+	for (int32 RequestIndex = 0; RequestIndex < BatchSize; ++RequestIndex)
+	{
+		FStyleTransferCpuInferenceResult Result;
+		Result.bSuccess = bSuccess;
+		Result.BatchSize = BatchSize;
+		Result.LatencyMs = (CompleteSeconds - Batch[RequestIndex].SubmitSeconds) * 1000.0;
+		if (bSuccess)
+		{
+			Result.Output.Append(BatchOutput.GetData() + RequestIndex * OutputFrameSize, OutputFrameSize);
+		}
+
+		LatencyMsSum += Result.LatencyMs;
+		MaxLatencyMs = FMath::Max(MaxLatencyMs, Result.LatencyMs);
+		Batch[RequestIndex].Promise.SetValue(MoveTemp(Result));
+	}
+
+	FScopeLock ScopeLock(&Lock);
+	StatRequests += BatchSize;
+	++StatBatches;
+	StatLatencyMsSum += LatencyMsSum;
+	StatMaxLatencyMs = FMath::Max(StatMaxLatencyMs, MaxLatencyMs);
+	StatInferenceMsSum += InferenceMs;
+}
+
+void FStyleTransferCpuModel::FailPending()
+{
+	TArray<FRequest> Failed;
+	{
+		FScopeLock ScopeLock(&Lock);
+		Failed = MoveTemp(Pending);
+		Pending.Reset();
+	}
+
+	DEC_DWORD_STAT_BY(STAT_StyleTransfer_CpuQueueDepth, Failed.Num());
+	for (FRequest& Request : Failed)
+	{
+		Request.Promise.SetValue(FStyleTransferCpuInferenceResult());
+	}
+}
+
+FStyleTransferCpuInferenceService& FStyleTransferCpuInferenceService::Get()
+{
+	FScopeLock ScopeLock(&ServiceLock);
+	if (!ServiceInstance.IsValid())
+	{
+		ServiceInstance.Reset(new FStyleTransferCpuInferenceService());
+	}
+	return *ServiceInstance;
+}
+
+void FStyleTransferCpuInferenceService::Shutdown()
+{
+	FScopeLock ScopeLock(&ServiceLock);
+	ServiceInstance.Reset();
+}
+
+FStyleTransferCpuInferenceService::FStyleTransferCpuInferenceService()
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("StyleTransferInferenceDispatcher"), 0, TPri_AboveNormal);
+}
+
+FStyleTransferCpuInferenceService::~FStyleTransferCpuInferenceService()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	WaitForInFlight();
+	for (const FStyleTransferCpuModelHandle& Model : GetModels())
+	{
+		Model->FailPending();
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+FStyleTransferCpuModelHandle FStyleTransferCpuInferenceService::RegisterModel(
+	UNNEModelData* ModelData,
+	FIntPoint Resolution,
+	const FStyleTransferCpuInferenceSettings& Settings,
+	FName RuntimeName)
+{
+	if (!ModelData)
+	{
+		return nullptr;
+	}
+
+	TWeakInterfacePtr<INNERuntimeCPU> Runtime = UE::NNE::GetRuntime<INNERuntimeCPU>(RuntimeName.ToString());
+	if (!Runtime.IsValid())
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("Runtime '%s' is not available for CPU inference."), *RuntimeName.ToString());
+		return nullptr;
+	}
+
+	const StyleTransferMemory::FCpuProbe ModelProbe;
+	TSharedPtr<UE::NNE::IModelCPU> RuntimeModel;
+	{
+		LLM_SCOPE_BYTAG(StyleTransfer_Models);
+		RuntimeModel = Runtime->CreateModelCPU(ModelData);
+	}
+	const int64 ModelCpuBytes = ModelProbe.GetBytes();
+
+	const StyleTransferMemory::FCpuProbe InstanceProbe;
+	LLM_SCOPE_BYTAG(StyleTransfer_Instances);
+	TSharedPtr<UE::NNE::IModelInstanceCPU> Instance = RuntimeModel.IsValid() ? RuntimeModel->CreateModelInstanceCPU() : nullptr;
+	if (!Instance.IsValid())
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("%s could not create '%s'."), *RuntimeName.ToString(), *ModelData->GetName());
+		return nullptr;
+	}
+
+	const TConstArrayView<UE::NNE::FTensorDesc> InputDescs = Instance->GetInputTensorDescs();
+	if (InputDescs.Num() != 1 || InputDescs[0].GetShape().Rank() != 4 || InputDescs[0].GetDataType() != ENNETensorDataType::Float)
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("'%s' must take a single float NCHW image to be served on the CPU."), *ModelData->GetName());
+		return nullptr;
+	}
+
+	const TConstArrayView<int32> InputDims = InputDescs[0].GetShape().GetData();
+	if (InputDims[0] > 1)
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("'%s' has a fixed batch of %d; only batch 1 or symbolic batches are supported."), *ModelData->GetName(), InputDims[0]);
+		return nullptr;
+	}
+
+	FStyleTransferCpuModelHandle ServedModel = MakeShared<FStyleTransferCpuModel, ESPMode::ThreadSafe>();
+	ServedModel->Service = this;
+	ServedModel->Name = ModelData->GetName();
+	ServedModel->RuntimeName = RuntimeName.ToString();
+	ServedModel->Model = RuntimeModel;
+	ServedModel->bDynamicBatch = InputDims[0] < 0;
+	ServedModel->InputChannels = InputDims[1] > 0 ? InputDims[1] : 3;
+	ServedModel->Resolution.X = Resolution.X > 0 ? Resolution.X : (InputDims[3] > 0 ? InputDims[3] : DefaultSymbolicResolution);
+	ServedModel->Resolution.Y = Resolution.Y > 0 ? Resolution.Y : (InputDims[2] > 0 ? InputDims[2] : DefaultSymbolicResolution);
+
+	ServedModel->Settings = Settings;
+	ServedModel->Settings.MaxInstances = FMath::Max(Settings.MaxInstances, 1);
+	ServedModel->Settings.MaxBatchSize = ServedModel->bDynamicBatch ? FMath::Max(Settings.MaxBatchSize, 1) : 1;
+	ServedModel->Settings.MaxBatchDelayMs = FMath::Max(Settings.MaxBatchDelayMs, 0.0);
+
+	const TArray<uint32> InputDimensions = { 1u, static_cast<uint32>(ServedModel->InputChannels), static_cast<uint32>(ServedModel->Resolution.Y), static_cast<uint32>(ServedModel->Resolution.X) };
+	const TArray<UE::NNE::FTensorShape> InputShapes = { UE::NNE::FTensorShape::Make(InputDimensions) };
+	if (Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceCPU::ESetInputTensorShapesStatus::Ok)
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("Failed to set the input shape of '%s' to %dx%d."), *ModelData->GetName(), ServedModel->Resolution.X, ServedModel->Resolution.Y);
+		return nullptr;
+	}
+
+	const TConstArrayView<UE::NNE::FTensorShape> OutputShapes = Instance->GetOutputTensorShapes();
+	if (OutputShapes.IsEmpty() || OutputShapes[0].Rank() != 4 || Instance->GetOutputTensorDescs()[0].GetDataType() != ENNETensorDataType::Float)
+	{
+		UE_LOG(LogStyleTransferInference, Error, TEXT("'%s' must produce a float NCHW image."), *ModelData->GetName());
+		return nullptr;
+	}
+
+	ServedModel->OutputChannels = static_cast<int32>(OutputShapes[0].GetData()[1]);
+	ServedModel->OutputResolution = FIntPoint(static_cast<int32>(OutputShapes[0].GetData()[3]), static_cast<int32>(OutputShapes[0].GetData()[2]));
+	ServedModel->FreeInstances.Add({ Instance, 1 });
+	ServedModel->CreatedInstances = 1;
+	TrackCpuMemory(RuntimeModel, EStyleTransferMemoryKind::CpuModel, *ServedModel, ServedModel->RuntimeName, 1, ModelCpuBytes);
+	TrackCpuMemory(Instance, EStyleTransferMemoryKind::CpuInstance, *ServedModel, ServedModel->RuntimeName, 1, InstanceProbe.GetBytes());
+
+	{
+		FScopeLock ScopeLock(&ModelsLock);
+		Models.RemoveAll([](const TWeakPtr<FStyleTransferCpuModel, ESPMode::ThreadSafe>& Model) { return !Model.IsValid(); });
+		Models.Add(ServedModel);
+	}
+
+	UE_LOG(LogStyleTransferInference, Log, TEXT("Serving '%s' at %dx%d on %s (up to %d instances, batches of %d, %.1f ms deadline)."),
+		*ServedModel->Name,
+		ServedModel->Resolution.X,
+		ServedModel->Resolution.Y,
+		*RuntimeName.ToString(),
+		ServedModel->Settings.MaxInstances,
+		ServedModel->Settings.MaxBatchSize,
+		ServedModel->Settings.MaxBatchDelayMs);
+
+	return ServedModel;
+}
+
+TFuture<FStyleTransferCpuInferenceResult> FStyleTransferCpuInferenceService::Submit(const FStyleTransferCpuModelHandle& Model, TArray<float> Input)
+{
+	if (!Model.IsValid() || bStopping)
+	{
+		return MakeFailedFuture();
+	}
+
+	const int32 InputFrameSize = Model->InputChannels * Model->Resolution.X * Model->Resolution.Y;
+	if (Input.Num() != InputFrameSize)
+	{
+		UE_LOG(LogStyleTransferInference, Warning, TEXT("'%s' expects %d input values, got %d."), *Model->Name, InputFrameSize, Input.Num());
+		return MakeFailedFuture();
+	}
+
+	TFuture<FStyleTransferCpuInferenceResult> Future;
+	{
+		FScopeLock ScopeLock(&Model->Lock);
+		FStyleTransferCpuModel::FRequest& Request = Model->Pending.AddDefaulted_GetRef();
+		Request.Input = MoveTemp(Input);
+		Request.SubmitSeconds = FPlatformTime::Seconds();
+		Future = Request.Promise.GetFuture();
+	}
+	INC_DWORD_STAT(STAT_StyleTransfer_CpuQueueDepth);
+
+	Wake();
+	return Future;
+}
+
+TArray<FStyleTransferCpuModelHandle> FStyleTransferCpuInferenceService::GetModels() const
+{
+	FScopeLock ScopeLock(&ModelsLock);
+
+	TArray<FStyleTransferCpuModelHandle> LiveModels;
+	for (const TWeakPtr<FStyleTransferCpuModel, ESPMode::ThreadSafe>& Model : Models)
+	{
+		if (FStyleTransferCpuModelHandle Pinned = Model.Pin())
+		{
+			LiveModels.Add(MoveTemp(Pinned));
+		}
+	}
+	return LiveModels;
+}
+
+uint32 FStyleTransferCpuInferenceService::Run()
+{
+	while (!bStopping)
+	{
+		const double NowSeconds = FPlatformTime::Seconds();
+		double NextDeadlineSeconds = 0.0;
+		TArray<UE::Tasks::FTask> Launched;
+
+		for (const FStyleTransferCpuModelHandle& Model : GetModels())
+		{
+			const double DeadlineSeconds = Model->Dispatch(NowSeconds, Launched);
+			if (DeadlineSeconds > 0.0)
+			{
+				NextDeadlineSeconds = NextDeadlineSeconds > 0.0 ? FMath::Min(NextDeadlineSeconds, DeadlineSeconds) : DeadlineSeconds;
+			}
+		}
+
+		{
+			FScopeLock ScopeLock(&InFlightLock);
+			InFlight.RemoveAll([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); });
+			InFlight.Append(MoveTemp(Launched));
+		}
+
+		const uint32 WaitMs = NextDeadlineSeconds > 0.0
+			? static_cast<uint32>(FMath::Max(FMath::CeilToInt((NextDeadlineSeconds - NowSeconds) * 1000.0), 1))
+			: MAX_uint32;
+		WakeEvent->Wait(WaitMs);
+	}
+
+	return 0;
+}
+
+void FStyleTransferCpuInferenceService::Stop()
+{
+	bStopping = true;
+	Wake();
+}
+
+void FStyleTransferCpuInferenceService::Wake()
+{
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FStyleTransferCpuInferenceService::WaitForInFlight()
+{
+	TArray<UE::Tasks::FTask> Tasks;
+	{
+		FScopeLock ScopeLock(&InFlightLock);
+		Tasks = MoveTemp(InFlight);
+		InFlight.Reset();
+	}
+	UE::Tasks::Wait(Tasks);
+}
+
+namespace RealtimeStyleTransfer
+{
+	static void DumpCpuInferenceStats(const TArray<FString>& Args)
+	{
+		const TArray<FStyleTransferCpuModelHandle> Models = FStyleTransferCpuInferenceService::Get().GetModels();
+		if (Models.IsEmpty())
+		{
+			UE_LOG(LogStyleTransferInference, Display, TEXT("No models are being served on the CPU."));
+			return;
+		}
+
+		const bool bReset = Args.Contains(TEXT("reset"));
+		for (const FStyleTransferCpuModelHandle& Model : Models)
+		{
+			const FStyleTransferCpuInferenceStats Stats = Model->GetStats();
+			UE_LOG(LogStyleTransferInference, Display, TEXT("%s: queue %d, instances %d/%d busy, %lld requests in %lld batches (avg %.2f), latency avg %.2f ms max %.2f ms, inference avg %.2f ms per batch."),
+				*Model->GetName(),
+				Stats.QueueDepth,
+				Stats.ActiveInstances,
+				Stats.PooledInstances,
+				Stats.Requests,
+				Stats.Batches,
+				Stats.AverageBatchSize,
+				Stats.AverageLatencyMs,
+				Stats.MaxLatencyMs,
+				Stats.AverageInferenceMs);
+
+			if (bReset)
+			{
+				Model->ResetStats();
+			}
+		}
+	}
+
+	static FAutoConsoleCommand DumpCpuInferenceStatsCommand(
+		TEXT("StyleTransfer.CpuInferenceStats"),
+		TEXT("Logs queue depth, batch size and latency of every model served by the CPU inference service.\n")
+		TEXT("Usage: StyleTransfer.CpuInferenceStats [reset]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&DumpCpuInferenceStats));
+
+	/** Submits a burst of random frames to the service and reports throughput against one request at a time. */
+	static void BenchmarkCpuInference(const TArray<FString>& Args)
+	{
+		if (Args.IsEmpty())
+		{
+			UE_LOG(LogStyleTransferInference, Display, TEXT("Usage: StyleTransfer.BenchmarkCpuInference <NNEModelData asset path> [Requests] [MaxInstances] [MaxBatchSize] [MaxBatchDelayMs]"));
+			return;
+		}
+
+		UNNEModelData* ModelData = LoadObject<UNNEModelData>(nullptr, *Args[0]);
+		if (!ModelData)
+		{
+			UE_LOG(LogStyleTransferInference, Error, TEXT("Unable to load model data '%s'."), *Args[0]);
+			return;
+		}
+
+		const int32 Requests = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 32;
+		FStyleTransferCpuInferenceSettings Settings;
+		Settings.MaxInstances = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : Settings.MaxInstances;
+		Settings.MaxBatchSize = Args.Num() > 3 ? FCString::Atoi(*Args[3]) : Settings.MaxBatchSize;
+		Settings.MaxBatchDelayMs = Args.Num() > 4 ? FCString::Atod(*Args[4]) : Settings.MaxBatchDelayMs;
+
+		FStyleTransferCpuInferenceService& Service = FStyleTransferCpuInferenceService::Get();
+		const FStyleTransferCpuModelHandle Model = Service.RegisterModel(ModelData, FIntPoint::ZeroValue, Settings);
+		if (!Model.IsValid())
+		{
+			return;
+		}
+
+		FRandomStream Random(1234);
+		TArray<float> Frame;
+		Frame.SetNumUninitialized(Model->GetInputChannels() * Model->GetResolution().X * Model->GetResolution().Y);
+		for (float& Value : Frame)
+		{
+			Value = Random.FRand() * StyleTransferPasses::EncodeScale;
+		}
+
+		// Warm the first instance, then time the requests one after another and as a burst.
+		Service.Submit(Model, Frame).Get();
+		Model->ResetStats();
+
+		double StartSeconds = FPlatformTime::Seconds();
+		for (int32 RequestIndex = 0; RequestIndex < Requests; ++RequestIndex)
+		{
+			Service.Submit(Model, Frame).Get();
+		}
+		const double SerialMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+		Model->ResetStats();
+
+		TArray<TFuture<FStyleTransferCpuInferenceResult>> Futures;
+		StartSeconds = FPlatformTime::Seconds();
+		for (int32 RequestIndex = 0; RequestIndex < Requests; ++RequestIndex)
+		{
+			Futures.Add(Service.Submit(Model, Frame));
+		}
+		int32 Failed = 0;
+		for (TFuture<FStyleTransferCpuInferenceResult>& Future : Futures)
+		{
+			Failed += Future.Get().bSuccess ? 0 : 1;
+		}
+		const double BurstMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+
+		const FStyleTransferCpuInferenceStats Stats = Model->GetStats();
+		UE_LOG(LogStyleTransferInference, Display, TEXT("%s, %d requests: serial %.2f ms (%.1f/s), service %.2f ms (%.1f/s, %.2fx), avg batch %.2f, latency avg %.2f ms max %.2f ms, %d failed."),
+			*Model->GetName(),
+			Requests,
+			SerialMs,
+			Requests * 1000.0 / FMath::Max(SerialMs, UE_SMALL_NUMBER),
+			BurstMs,
+			Requests * 1000.0 / FMath::Max(BurstMs, UE_SMALL_NUMBER),
+			SerialMs / FMath::Max(BurstMs, UE_SMALL_NUMBER),
+			Stats.AverageBatchSize,
+			Stats.AverageLatencyMs,
+			Stats.MaxLatencyMs,
+			Failed);
+	}
+
+	static FAutoConsoleCommand BenchmarkCpuInferenceCommand(
+		TEXT("StyleTransfer.BenchmarkCpuInference"),
+		TEXT("Times a burst of requests through the CPU inference service against the same requests submitted one at a time.\n")
+		TEXT("Usage: StyleTransfer.BenchmarkCpuInference <NNEModelData asset path> [Requests] [MaxInstances] [MaxBatchSize] [MaxBatchDelayMs]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCpuInference));
+}
@@ -0,0 +1,167 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/Runnable.h"
+#include "Tasks/Task.h"
+
+class FRunnableThread;
+class UNNEModelData;
+namespace UE::NNE
+{
+	class IModelCPU;
+	class IModelInstanceCPU;
+}
+
+struct FStyleTransferCpuInferenceSettings
+{
+	/** Upper bound of concurrent inferences, each on its own pooled model instance. */
+	int32 MaxInstances = 2;
+	/** Requests combined into one inference. Only models with a symbolic batch dimension batch. */
+	int32 MaxBatchSize = 4;
+	/** How long a request may wait for others to fill its batch. */
+	double MaxBatchDelayMs = 2.0;
+};
+
+struct FStyleTransferCpuInferenceResult
+{
+	bool bSuccess = false;
+	/** CHW output of this request's frame. */
+	TArray<float> Output;
+	/** Time from Submit to completion. */
+	double LatencyMs = 0.0;
+	int32 BatchSize = 0;
+};
+
+struct FStyleTransferCpuInferenceStats
+{
+	int32 QueueDepth = 0;
+	int32 ActiveInstances = 0;
+	int32 PooledInstances = 0;
+	int64 Requests = 0;
+	int64 Batches = 0;
+	double AverageBatchSize = 0.0;
+	double AverageLatencyMs = 0.0;
+	double MaxLatencyMs = 0.0;
+	double AverageInferenceMs = 0.0;
+};
+
+/**
+ * One model served by FStyleTransferCpuInferenceService: the runtime model, a pool of instances and the queue of
+ * pending requests. Dropping the last handle unregisters it once in-flight batches have finished.
+ */
+class FPSTYLETRANSFER_API FStyleTransferCpuModel : public TSharedFromThis<FStyleTransferCpuModel, ESPMode::ThreadSafe>
+{
+public:
+	const FString& GetName() const { return Name; }
+	FIntPoint GetResolution() const { return Resolution; }
+	int32 GetInputChannels() const { return InputChannels; }
+	int32 GetOutputChannels() const { return OutputChannels; }
+	FIntPoint GetOutputResolution() const { return OutputResolution; }
+
+	FStyleTransferCpuInferenceStats GetStats() const;
+	void ResetStats();
+
+private:
+	friend class FStyleTransferCpuInferenceService;
+
+	struct FRequest
+	{
+		TArray<float> Input;
+		TPromise<FStyleTransferCpuInferenceResult> Promise;
+		double SubmitSeconds = 0.0;
+	};
+
+	struct FPooledInstance
+	{
+		TSharedPtr<UE::NNE::IModelInstanceCPU> Instance;
+		/** Batch size the instance's input shape is currently set to. */
+		int32 BatchSize = 0;
+	};
+
+	/** Starts every batch that is full or past its deadline while instances are free. Returns the next deadline, or zero. */
+	double Dispatch(double NowSeconds, TArray<UE::Tasks::FTask>& OutLaunched);
+	void RunBatch(TArray<FRequest>& Batch, FPooledInstance& PooledInstance);
+	bool AcquireInstance(int32 BatchSize, FPooledInstance& OutInstance);
+	void FailPending();
+
+	class FStyleTransferCpuInferenceService* Service = nullptr;
+	FString Name;
+	FString RuntimeName;
+	FStyleTransferCpuInferenceSettings Settings;
+	TSharedPtr<UE::NNE::IModelCPU> Model;
+	FIntPoint Resolution = FIntPoint::ZeroValue;
+	FIntPoint OutputResolution = FIntPoint::ZeroValue;
+	int32 InputChannels = 3;
+	int32 OutputChannels = 3;
+	bool bDynamicBatch = false;
+
+	mutable FCriticalSection Lock;
+	TArray<FRequest> Pending;
+	TArray<FPooledInstance> FreeInstances;
+	int32 ActiveInstances = 0;
+	int32 CreatedInstances = 0;
+
+	int64 StatRequests = 0;
+	int64 StatBatches = 0;
+	double StatLatencyMsSum = 0.0;
+	double StatMaxLatencyMs = 0.0;
+	double StatInferenceMsSum = 0.0;
+};
+
+using FStyleTransferCpuModelHandle = TSharedPtr<FStyleTransferCpuModel, ESPMode::ThreadSafe>;
+
+/**
+ * Runs style models on a CPU runtime for callers off the render path (offline tools, servers, render-target
+ * stylization). Requests for a model are queued, combined into batches of up to MaxBatchSize or until the oldest
+ * one has waited MaxBatchDelayMs, and run as UE::Tasks on a pool of up to MaxInstances model instances.
+ *
+ * A dispatcher thread forms the batches; inference itself runs on the task system's workers.
+ */
+class FPSTYLETRANSFER_API FStyleTransferCpuInferenceService : public FRunnable
+{
+public:
+	static FStyleTransferCpuInferenceService& Get();
+	/** Fails pending requests, waits for running batches and stops the dispatcher. Called on module shutdown. */
+	static void Shutdown();
+
+	virtual ~FStyleTransferCpuInferenceService() override;
+
+	/**
+	 * Creates the runtime model and its first instance at Resolution (or the model's own static resolution when zero).
+	 * Models must take a single float NCHW image. Returns null and logs the reason on failure. Game thread only.
+	 */
+	FStyleTransferCpuModelHandle RegisterModel(
+		UNNEModelData* ModelData,
+		FIntPoint Resolution = FIntPoint::ZeroValue,
+		const FStyleTransferCpuInferenceSettings& Settings = FStyleTransferCpuInferenceSettings(),
+		FName RuntimeName = TEXT("NNERuntimeORTCpu"));
+
+	/** Queues one CHW frame of Model's input size. Any thread. */
+	TFuture<FStyleTransferCpuInferenceResult> Submit(const FStyleTransferCpuModelHandle& Model, TArray<float> Input);
+
+	/** Registered models that are still referenced. */
+	TArray<FStyleTransferCpuModelHandle> GetModels() const;
+
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	FStyleTransferCpuInferenceService();
+
+	void Wake();
+	void WaitForInFlight();
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopping = false;
+
+	mutable FCriticalSection ModelsLock;
+	TArray<TWeakPtr<FStyleTransferCpuModel, ESPMode::ThreadSafe>> Models;
+
+	FCriticalSection InFlightLock;
+	TArray<UE::Tasks::FTask> InFlight;
+};
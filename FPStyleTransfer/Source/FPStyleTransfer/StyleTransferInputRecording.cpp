@@ -0,0 +1,381 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferInputRecording.h"
+#include "Dom/JsonObject.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "FPStyleTransferCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferInput, Log, All);
+
+namespace
+{
+	constexpr int32 AxisCount = static_cast<int32>(EStyleTransferInputAxis::Count);
+	constexpr int32 RecordingVersion = 1;
+
+	TArray<TSharedPtr<FJsonValue>> MakeVectorValue(double X, double Y, double Z)
+	{
+		return { MakeShared<FJsonValueNumber>(X), MakeShared<FJsonValueNumber>(Y), MakeShared<FJsonValueNumber>(Z) };
+	}
+
+	bool ReadVectorValue(const FJsonObject& Object, const FString& Field, double& OutX, double& OutY, double& OutZ)
+	{
+		const TArray<TSharedPtr<FJsonValue>>* Values = nullptr;
+		if (!Object.TryGetArrayField(Field, Values) || Values->Num() != 3)
+		{
+			return false;
+		}
+		OutX = (*Values)[0]->AsNumber();
+		OutY = (*Values)[1]->AsNumber();
+		OutZ = (*Values)[2]->AsNumber();
+		return true;
+	}
+}
+
+bool FStyleTransferInputRecording::SaveToFile(const FString& FilePath) const
+{
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("Version"), RecordingVersion);
+	Root->SetStringField(TEXT("Map"), MapName);
+	Root->SetNumberField(TEXT("FixedDeltaSeconds"), FixedDeltaSeconds);
+	Root->SetArrayField(TEXT("StartLocation"), MakeVectorValue(StartLocation.X, StartLocation.Y, StartLocation.Z));
+	Root->SetArrayField(TEXT("StartControlRotation"), MakeVectorValue(StartControlRotation.Pitch, StartControlRotation.Yaw, StartControlRotation.Roll));
+
+	// One [MoveForward, MoveRight, Turn, LookUp, Actions] row per frame keeps long paths compact.
+	TArray<TSharedPtr<FJsonValue>> FrameValues;
+	FrameValues.Reserve(Frames.Num());
+	for (const FStyleTransferInputFrame& Frame : Frames)
+	{
+		TArray<TSharedPtr<FJsonValue>> Row;
+		for (const float Value : Frame.Axes)
+		{
+			Row.Add(MakeShared<FJsonValueNumber>(Value));
+		}
+		Row.Add(MakeShared<FJsonValueNumber>(static_cast<uint8>(Frame.Actions)));
+		FrameValues.Add(MakeShared<FJsonValueArray>(Row));
+	}
+	Root->SetArrayField(TEXT("Frames"), FrameValues);
+
+	FString Text;
+	FJsonSerializer::Serialize(Root, TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Text));
+	return FFileHelper::SaveStringToFile(Text, *FilePath);
+}
+
+TSharedPtr<FStyleTransferInputRecording> FStyleTransferInputRecording::LoadFromFile(const FString& FilePath)
+{
+	FString Text;
+	TSharedPtr<FJsonObject> Root;
+	if (!FFileHelper::LoadFileToString(Text, *FilePath) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Root) || !Root.IsValid())
+	{
+		UE_LOG(LogStyleTransferInput, Error, TEXT("Unable to read the input recording '%s'."), *FilePath);
+		return nullptr;
+	}
+
+	int32 Version = 0;
+	if (!Root->TryGetNumberField(TEXT("Version"), Version) || Version != RecordingVersion)
+	{
+		UE_LOG(LogStyleTransferInput, Error, TEXT("'%s' is input recording version %d; version %d is supported."), *FilePath, Version, RecordingVersion);
+		return nullptr;
+	}
+
+	TSharedPtr<FStyleTransferInputRecording> Recording = MakeShared<FStyleTransferInputRecording>();
+	Root->TryGetStringField(TEXT("Map"), Recording->MapName);
+	Root->TryGetNumberField(TEXT("FixedDeltaSeconds"), Recording->FixedDeltaSeconds);
+
+	const TArray<TSharedPtr<FJsonValue>>* FrameValues = nullptr;
+	if (Recording->FixedDeltaSeconds <= 0.0
+		|| !ReadVectorValue(*Root, TEXT("StartLocation"), Recording->StartLocation.X, Recording->StartLocation.Y, Recording->StartLocation.Z)
+		|| !ReadVectorValue(*Root, TEXT("StartControlRotation"), Recording->StartControlRotation.Pitch, Recording->StartControlRotation.Yaw, Recording->StartControlRotation.Roll)
+		|| !Root->TryGetArrayField(TEXT("Frames"), FrameValues))
+	{
+		UE_LOG(LogStyleTransferInput, Error, TEXT("The input recording '%s' is incomplete."), *FilePath);
+		return nullptr;
+	}
+
+	Recording->Frames.Reserve(FrameValues->Num());
+	for (const TSharedPtr<FJsonValue>& FrameValue : *FrameValues)
+	{
+		const TArray<TSharedPtr<FJsonValue>>* Row = nullptr;
+		if (!FrameValue->TryGetArray(Row) || Row->Num() != AxisCount + 1)
+		{
+			UE_LOG(LogStyleTransferInput, Error, TEXT("Frame %d of the input recording '%s' is malformed."), Recording->Frames.Num(), *FilePath);
+			return nullptr;
+		}
+
+		FStyleTransferInputFrame& Frame = Recording->Frames.AddDefaulted_GetRef();
+		for (int32 AxisIndex = 0; AxisIndex < AxisCount; ++AxisIndex)
+		{
+			Frame.Axes[AxisIndex] = static_cast<float>((*Row)[AxisIndex]->AsNumber());
+		}
+		Frame.Actions = static_cast<EStyleTransferInputAction>(static_cast<uint8>((*Row)[AxisCount]->AsNumber()));
+	}
+	return Recording;
+}
+
+FString FStyleTransferInputRecording::GetRecordingPath(const FString& NameOrPath)
+{
+	if (FPaths::GetExtension(NameOrPath).IsEmpty())
+	{
+		return FPaths::Combine(FPaths::ProjectDir(), TEXT("Tests"), TEXT("InputRecordings"), NameOrPath + TEXT(".json"));
+	}
+	return FPaths::IsRelative(NameOrPath) ? FPaths::Combine(FPaths::ProjectDir(), NameOrPath) : NameOrPath;
+}
+
+FStyleTransferInputRecorder::~FStyleTransferInputRecorder()
+{
+	EndFixedTimeStep();
+}
+
+void FStyleTransferInputRecorder::StartRecording(const FVector& Location, const FRotator& ControlRotation, const FString& MapName, double FixedDeltaSeconds)
+{
+	StopPlayback();
+
+	Recording = MakeShared<FStyleTransferInputRecording>();
+	Recording->MapName = MapName;
+	Recording->FixedDeltaSeconds = FixedDeltaSeconds;
+	Recording->StartLocation = Location;
+	Recording->StartControlRotation = ControlRotation;
+	CurrentFrame = FStyleTransferInputFrame();
+	StartFrameCounter = GFrameCounter;
+
+	// A person drives the recording, so the world has to advance in real time.
+	BeginFixedTimeStep(FixedDeltaSeconds, true);
+}
+
+TSharedPtr<FStyleTransferInputRecording> FStyleTransferInputRecorder::StopRecording()
+{
+	EndFixedTimeStep();
+	return MoveTemp(Recording);
+}
+
+void FStyleTransferInputRecorder::StartPlayback(FStyleTransferInputRecordingPtr InPlayback)
+{
+	StopRecording();
+	StopPlayback();
+	if (!InPlayback.IsValid() || InPlayback->Frames.IsEmpty())
+	{
+		return;
+	}
+
+	Playback = MoveTemp(InPlayback);
+	FrameIndex = 0;
+	ConsumedAxes = 0;
+	StartFrameCounter = GFrameCounter;
+	BeginFixedTimeStep(Playback->FixedDeltaSeconds, false);
+}
+
+void FStyleTransferInputRecorder::StopPlayback()
+{
+	if (Playback.IsValid())
+	{
+		Playback.Reset();
+		EndFixedTimeStep();
+	}
+}
+
+float FStyleTransferInputRecorder::FilterAxis(EStyleTransferInputAxis Axis, float LiveValue)
+{
+	const int32 AxisIndex = static_cast<int32>(Axis);
+	if (Playback.IsValid())
+	{
+		const uint8 AxisBit = 1 << AxisIndex;
+		if (ConsumedAxes & AxisBit)
+		{
+			return 0.0f;
+		}
+		ConsumedAxes |= AxisBit;
+		return Playback->Frames[FrameIndex].Axes[AxisIndex];
+	}
+
+	if (Recording.IsValid())
+	{
+		CurrentFrame.Axes[AxisIndex] += LiveValue;
+	}
+	return LiveValue;
+}
+
+bool FStyleTransferInputRecorder::FilterAction(EStyleTransferInputAction Action)
+{
+	if (Playback.IsValid())
+	{
+		return false;
+	}
+
+	if (Recording.IsValid())
+	{
+		CurrentFrame.Actions |= Action;
+	}
+	return true;
+}
+
+EStyleTransferInputAction FStyleTransferInputRecorder::AdvanceFrame()
+{
+	if (GFrameCounter == StartFrameCounter)
+	{
+		CurrentFrame = FStyleTransferInputFrame();
+		ConsumedAxes = 0;
+		return EStyleTransferInputAction::None;
+	}
+
+	if (Recording.IsValid())
+	{
+		Recording->Frames.Add(CurrentFrame);
+		CurrentFrame = FStyleTransferInputFrame();
+		return EStyleTransferInputAction::None;
+	}
+
+	if (!Playback.IsValid())
+	{
+		return EStyleTransferInputAction::None;
+	}
+
+	const EStyleTransferInputAction Actions = Playback->Frames[FrameIndex].Actions;
+	ConsumedAxes = 0;
+	if (++FrameIndex >= Playback->Frames.Num())
+	{
+		StopPlayback();
+	}
+	return Actions;
+}
+
+void FStyleTransferInputRecorder::BeginFixedTimeStep(double FixedDeltaSeconds, bool bThrottle)
+{
+	EndFixedTimeStep();
+	if (!GEngine)
+	{
+		return;
+	}
+
+	bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+	PreviousFixedDeltaSeconds = FApp::GetFixedDeltaTime();
+	bPreviousUseFixedFrameRate = GEngine->bUseFixedFrameRate;
+	PreviousFixedFrameRate = GEngine->FixedFrameRate;
+
+	if (bThrottle)
+	{
+		GEngine->bUseFixedFrameRate = true;
+		GEngine->FixedFrameRate = static_cast<float>(1.0 / FixedDeltaSeconds);
+	}
+	else
+	{
+		// The engine does not wait between fixed time steps, so frame times stay those of the hardware.
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(FixedDeltaSeconds);
+	}
+	bFixedTimeStep = true;
+}
+
+void FStyleTransferInputRecorder::EndFixedTimeStep()
+{
+	if (!bFixedTimeStep)
+	{
+		return;
+	}
+
+	FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+	FApp::SetFixedDeltaTime(PreviousFixedDeltaSeconds);
+	if (GEngine)
+	{
+		GEngine->bUseFixedFrameRate = bPreviousUseFixedFrameRate;
+		GEngine->FixedFrameRate = PreviousFixedFrameRate;
+	}
+	bFixedTimeStep = false;
+}
+
+namespace RealtimeStyleTransfer
+{
+	static FString InputRecordingName;
+
+	static AFPStyleTransferCharacter* GetLocalCharacter(UWorld* World)
+	{
+		APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+		AFPStyleTransferCharacter* Character = PlayerController ? Cast<AFPStyleTransferCharacter>(PlayerController->GetPawn()) : nullptr;
+		if (!Character)
+		{
+			UE_LOG(LogStyleTransferInput, Warning, TEXT("No local AFPStyleTransferCharacter to record or replay."));
+		}
+		return Character;
+	}
+
+	static void RecordInput(const TArray<FString>& Args, UWorld* World)
+	{
+		AFPStyleTransferCharacter* Character = GetLocalCharacter(World);
+		if (!Character)
+		{
+			return;
+		}
+
+		InputRecordingName = Args.Num() > 0 ? Args[0] : TEXT("Flythrough");
+		const float FramesPerSecond = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 60.0f;
+		Character->StartInputRecording(FramesPerSecond);
+		UE_LOG(LogStyleTransferInput, Display, TEXT("Recording input to '%s' at %.0f fps; StyleTransfer.StopInput saves it."),
+			*FStyleTransferInputRecording::GetRecordingPath(InputRecordingName),
+			FramesPerSecond);
+	}
+
+	static void StopInput(const TArray<FString>& Args, UWorld* World)
+	{
+		AFPStyleTransferCharacter* Character = GetLocalCharacter(World);
+		if (!Character)
+		{
+			return;
+		}
+
+		Character->StopInputPlayback();
+		const TSharedPtr<FStyleTransferInputRecording> Recording = Character->StopInputRecording();
+		if (!Recording.IsValid())
+		{
+			return;
+		}
+
+		const FString FilePath = FStyleTransferInputRecording::GetRecordingPath(InputRecordingName);
+		if (Recording->SaveToFile(FilePath))
+		{
+			UE_LOG(LogStyleTransferInput, Display, TEXT("Saved %d frames (%.1f s) of input to '%s'."),
+				Recording->Frames.Num(),
+				Recording->Frames.Num() * Recording->FixedDeltaSeconds,
+				*FilePath);
+		}
+		else
+		{
+			UE_LOG(LogStyleTransferInput, Error, TEXT("Unable to write the input recording '%s'."), *FilePath);
+		}
+	}
+
+	static void PlayInput(const TArray<FString>& Args, UWorld* World)
+	{
+		AFPStyleTransferCharacter* Character = GetLocalCharacter(World);
+		const TSharedPtr<FStyleTransferInputRecording> Recording = Character
+			? FStyleTransferInputRecording::LoadFromFile(FStyleTransferInputRecording::GetRecordingPath(Args.Num() > 0 ? Args[0] : TEXT("Flythrough")))
+			: nullptr;
+		if (Recording.IsValid())
+		{
+			Character->StartInputPlayback(Recording);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs RecordInputCommand(
+		TEXT("StyleTransfer.RecordInput"),
+		TEXT("Records the local character's input from its current position at a fixed frame rate.\n")
+		TEXT("Usage: StyleTransfer.RecordInput [Name (default Flythrough)] [FramesPerSecond (default 60)]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RecordInput));
+
+	static FAutoConsoleCommandWithWorldAndArgs StopInputCommand(
+		TEXT("StyleTransfer.StopInput"),
+		TEXT("Stops input playback, or stops input recording and saves it to Tests/InputRecordings/<Name>.json."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StopInput));
+
+	static FAutoConsoleCommandWithWorldAndArgs PlayInputCommand(
+		TEXT("StyleTransfer.PlayInput"),
+		TEXT("Moves the local character to the start of an input recording and replays it at its fixed timestep.\n")
+		TEXT("Usage: StyleTransfer.PlayInput [Name or path (default Flythrough)]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PlayInput));
+}
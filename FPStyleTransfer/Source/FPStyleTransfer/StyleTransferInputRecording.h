@@ -0,0 +1,104 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Character axes kept in a recording. Values are what the character applied that frame, after rate scaling. */
+enum class EStyleTransferInputAxis : uint8
+{
+	MoveForward,
+	MoveRight,
+	/** Controller yaw input, mouse and gamepad combined. */
+	Turn,
+	/** Controller pitch input, mouse and gamepad combined. */
+	LookUp,
+	Count
+};
+
+enum class EStyleTransferInputAction : uint8
+{
+	None = 0,
+	JumpPressed = 1 << 0,
+	JumpReleased = 1 << 1,
+	PrimaryAction = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EStyleTransferInputAction);
+
+struct FStyleTransferInputFrame
+{
+	float Axes[static_cast<int32>(EStyleTransferInputAxis::Count)] = {};
+	EStyleTransferInputAction Actions = EStyleTransferInputAction::None;
+};
+
+/** A fixed-timestep input path: where the character starts and what it applied on every frame after that. */
+struct FStyleTransferInputRecording
+{
+	FString MapName;
+	double FixedDeltaSeconds = 1.0 / 60.0;
+	FVector StartLocation = FVector::ZeroVector;
+	FRotator StartControlRotation = FRotator::ZeroRotator;
+	TArray<FStyleTransferInputFrame> Frames;
+
+	bool SaveToFile(const FString& FilePath) const;
+	static TSharedPtr<FStyleTransferInputRecording> LoadFromFile(const FString& FilePath);
+
+	/** Resolves a recording name to Tests/InputRecordings/<Name>.json. Names with an extension are used as paths. */
+	static FString GetRecordingPath(const FString& NameOrPath);
+};
+
+using FStyleTransferInputRecordingPtr = TSharedPtr<const FStyleTransferInputRecording>;
+
+/**
+ * Records or replays the input of one character. The character passes every axis value and action through
+ * FilterAxis and FilterAction and calls AdvanceFrame once per tick. Recording runs the engine at a fixed frame
+ * rate and playback at an unthrottled fixed timestep, so both advance the world by the same delta every frame
+ * and a replay follows the recorded path at any frame rate.
+ */
+class FStyleTransferInputRecorder
+{
+public:
+	~FStyleTransferInputRecorder();
+
+	void StartRecording(const FVector& Location, const FRotator& ControlRotation, const FString& MapName, double FixedDeltaSeconds);
+	/** Stops recording and returns the recorded path, or null when not recording. */
+	TSharedPtr<FStyleTransferInputRecording> StopRecording();
+
+	void StartPlayback(FStyleTransferInputRecordingPtr InPlayback);
+	void StopPlayback();
+
+	bool IsRecording() const { return Recording.IsValid(); }
+	bool IsPlaying() const { return Playback.IsValid(); }
+	int32 GetFrameIndex() const { return FrameIndex; }
+
+	/**
+	 * Returns the value to apply for Axis this frame. Records and returns LiveValue while recording. During playback
+	 * the first call of a frame returns the recorded value and later calls return zero, so an axis bound to several
+	 * devices is applied once.
+	 */
+	float FilterAxis(EStyleTransferInputAxis Axis, float LiveValue);
+
+	/** Returns whether a live action should be applied. Records it while recording; live actions are dropped during playback. */
+	bool FilterAction(EStyleTransferInputAction Action);
+
+	/** Ends the frame. During playback returns the recorded actions of the frame, and stops after the last one. */
+	EStyleTransferInputAction AdvanceFrame();
+
+private:
+	void BeginFixedTimeStep(double FixedDeltaSeconds, bool bThrottle);
+	void EndFixedTimeStep();
+
+	TSharedPtr<FStyleTransferInputRecording> Recording;
+	FStyleTransferInputRecordingPtr Playback;
+	FStyleTransferInputFrame CurrentFrame;
+	int32 FrameIndex = 0;
+	uint8 ConsumedAxes = 0;
+	/** Frame the recording or playback started on. Its input was processed before the start, so it is not a frame of the path. */
+	uint64 StartFrameCounter = 0;
+
+	bool bFixedTimeStep = false;
+	bool bPreviousUseFixedTimeStep = false;
+	double PreviousFixedDeltaSeconds = 0.0;
+	bool bPreviousUseFixedFrameRate = false;
+	float PreviousFixedFrameRate = 0.0f;
+};
@@ -0,0 +1,133 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "Misc/AutomationTest.h"
+#include "StyleTransferModelLODSet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Drives a governor with a GPU time per frame and records the frames it switched on. */
+	struct FGovernorRun
+	{
+		FStyleTransferLODGovernorSettings Settings;
+		FStyleTransferLODGovernor Governor;
+		uint64 Frame = 1;
+		int32 ActiveLOD = 0;
+		int32 FirstAllowedLOD = 0;
+		int32 LastLOD = 2;
+		TArray<uint64> SwitchFrames;
+
+		FGovernorRun()
+		{
+			Settings.TargetGpuMs = 16.0;
+			Settings.UpThreshold = 0.8;
+			Settings.DownFrames = 10;
+			Settings.UpFrames = 20;
+			Governor.Reset(0);
+		}
+
+		void Run(int32 Frames, double GpuMs)
+		{
+			for (int32 Index = 0; Index < Frames; ++Index, ++Frame)
+			{
+				const int32 TargetLOD = Governor.Tick(Frame, GpuMs, ActiveLOD, FirstAllowedLOD, LastLOD, Settings);
+				if (TargetLOD != ActiveLOD)
+				{
+					ActiveLOD = TargetLOD;
+					SwitchFrames.Add(Frame);
+				}
+			}
+		}
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(
+	FStyleTransferLODGovernorTest,
+	"Project.FPStyleTransfer.LODGovernor",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FStyleTransferLODGovernorTest::RunTest(const FString& Parameters)
+{
+	// Run starts right after a (re)set, like the frames after a switch: the first ones are not sampled.
+	constexpr uint64 Latency = FStyleTransferLODGovernor::kGpuTimeLatencyFrames;
+	constexpr int32 Skipped = static_cast<int32>(Latency) - 1;
+
+	{
+		// Between UpThreshold and the target is the hysteresis band: the governor holds either way.
+		FGovernorRun Run;
+		Run.ActiveLOD = 1;
+		Run.Run(500, 14.0);
+		TestEqual(TEXT("Holds inside the hysteresis band"), Run.ActiveLOD, 1);
+	}
+
+	{
+		// Over budget steps down once per DownFrames samples, each after the new LOD's GPU time arrives.
+		FGovernorRun Run;
+		Run.Run(Skipped + Run.Settings.DownFrames - 1, 20.0);
+		TestEqual(TEXT("No step down before DownFrames samples"), Run.ActiveLOD, 0);
+		Run.Run(1, 20.0);
+		TestEqual(TEXT("Steps down after DownFrames samples"), Run.ActiveLOD, 1);
+		Run.Run(Skipped + Run.Settings.DownFrames, 20.0);
+		TestEqual(TEXT("Steps down again with fresh samples of the new LOD"), Run.ActiveLOD, 2);
+		Run.Run(100, 20.0);
+		TestEqual(TEXT("Stays at the last LOD"), Run.ActiveLOD, Run.LastLOD);
+	}
+
+	{
+		// A step up that has to be undone within UpFrames doubles the wait for the next one.
+		FGovernorRun Run;
+		Run.ActiveLOD = 1;
+		Run.Run(Skipped + Run.Settings.UpFrames, 8.0);
+		TestEqual(TEXT("Steps up after UpFrames samples"), Run.ActiveLOD, 0);
+		TestEqual(TEXT("No backoff before a failed step up"), Run.Governor.UpBackoff, 1);
+
+		Run.Run(Skipped + Run.Settings.DownFrames, 20.0);
+		TestEqual(TEXT("Undoes the step up"), Run.ActiveLOD, 1);
+		TestEqual(TEXT("Backoff doubles after an undone step up"), Run.Governor.UpBackoff, 2);
+
+		Run.Run(Skipped + Run.Settings.UpFrames, 8.0);
+		TestEqual(TEXT("Waits longer before the next step up"), Run.ActiveLOD, 1);
+		Run.Run(Run.Settings.UpFrames, 8.0);
+		TestEqual(TEXT("Steps up after twice UpFrames samples"), Run.ActiveLOD, 0);
+
+		Run.Run(Run.Settings.UpFrames, 8.0);
+		TestEqual(TEXT("A held step up clears the backoff"), Run.Governor.UpBackoff, 1);
+	}
+
+	{
+		// Undone step ups keep doubling the wait, up to kMaxUpBackoff.
+		FGovernorRun Run;
+		Run.ActiveLOD = 1;
+		for (int32 Attempt = 0; Attempt < 6; ++Attempt)
+		{
+			Run.Run(Skipped + Run.Settings.UpFrames * Run.Governor.UpBackoff, 8.0);
+			Run.Run(Skipped + Run.Settings.DownFrames, 20.0);
+		}
+		TestEqual(TEXT("Backoff is capped"), Run.Governor.UpBackoff, FStyleTransferLODGovernor::kMaxUpBackoff);
+	}
+
+	{
+		// A scalability drop leaves LODs it no longer allows at once, and the governor never steps back above it.
+		FGovernorRun Run;
+		Run.FirstAllowedLOD = 1;
+		Run.Run(1, 8.0);
+		TestEqual(TEXT("Leaves a disallowed LOD at once"), Run.ActiveLOD, 1);
+		Run.Run(500, 8.0);
+		TestEqual(TEXT("Never steps above the allowed LOD"), Run.ActiveLOD, 1);
+	}
+
+	{
+		// Frames without a GPU time, and those right after a switch, are not counted.
+		FGovernorRun Run;
+		Run.Run(100, 0.0);
+		TestEqual(TEXT("Ignores unknown GPU times"), Run.Governor.OverBudgetFrames + Run.Governor.UnderBudgetFrames, 0);
+		Run.Governor.Reset(Run.Frame);
+		Run.Run(static_cast<int32>(Latency), 20.0);
+		TestEqual(TEXT("Ignores the frames still measuring the previous LOD"), Run.Governor.OverBudgetFrames, 0);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
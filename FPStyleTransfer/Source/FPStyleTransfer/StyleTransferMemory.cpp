@@ -0,0 +1,224 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferMemory.h"
+
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "StyleTransferPasses.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferMemory, Log, All);
+
+LLM_DEFINE_TAG(StyleTransfer);
+LLM_DEFINE_TAG(StyleTransfer_Models);
+LLM_DEFINE_TAG(StyleTransfer_Instances);
+
+DECLARE_MEMORY_STAT(TEXT("Model weights (CPU)"), STAT_StyleTransfer_ModelCpuMemory, STATGROUP_StyleTransfer);
+DECLARE_MEMORY_STAT_POOL(TEXT("Model weights (GPU, est.)"), STAT_StyleTransfer_ModelGpuMemory, STATGROUP_StyleTransfer, FPlatformMemory::MCR_GPU);
+DECLARE_MEMORY_STAT(TEXT("Instance workspaces (CPU)"), STAT_StyleTransfer_InstanceCpuMemory, STATGROUP_StyleTransfer);
+DECLARE_MEMORY_STAT_POOL(TEXT("Frame RDG resources (GPU)"), STAT_StyleTransfer_FrameGpuMemory, STATGROUP_StyleTransfer, FPlatformMemory::MCR_GPU);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Cached model instances"), STAT_StyleTransfer_CachedInstances, STATGROUP_StyleTransfer);
+
+namespace RealtimeStyleTransfer
+{
+	static float MemoryBudgetMB = 0.0f;
+	static FAutoConsoleVariableRef CVarMemoryBudgetMB(
+		TEXT("r.RealtimeStyleTransfer.Memory.BudgetMB"),
+		MemoryBudgetMB,
+		TEXT("Warns when the CPU and persistent GPU memory of all loaded styles exceeds this many MB. Set per device profile.\n")
+		TEXT("=0: no budget (default)"));
+}
+
+namespace StyleTransferMemory
+{
+	namespace
+	{
+		struct FTrackedEntry
+		{
+			TWeakPtr<const void, ESPMode::ThreadSafe> Owner;
+			FStyleTransferMemoryEntry Entry;
+		};
+
+		FCriticalSection EntriesLock;
+		TArray<FTrackedEntry> Entries;
+		FTSTicker::FDelegateHandle RefreshHandle;
+		bool bOverBudget = false;
+
+		constexpr double BytesPerMB = 1024.0 * 1024.0;
+		constexpr float RefreshIntervalSeconds = 1.0f;
+
+		bool IsInstance(EStyleTransferMemoryKind Kind)
+		{
+			return Kind == EStyleTransferMemoryKind::Instance || Kind == EStyleTransferMemoryKind::CpuInstance;
+		}
+
+		const TCHAR* GetKindName(EStyleTransferMemoryKind Kind)
+		{
+			switch (Kind)
+			{
+			case EStyleTransferMemoryKind::Model: return TEXT("model");
+			case EStyleTransferMemoryKind::Instance: return TEXT("instance");
+			case EStyleTransferMemoryKind::CpuModel: return TEXT("CPU model");
+			case EStyleTransferMemoryKind::CpuInstance: return TEXT("CPU instance");
+			default: return TEXT("unknown");
+			}
+		}
+
+		/** Drops entries of destroyed owners and publishes the totals. Caller holds EntriesLock. */
+		void RefreshLocked()
+		{
+			Entries.RemoveAll([](const FTrackedEntry& Tracked) { return !Tracked.Owner.IsValid(); });
+
+			int64 ModelCpuBytes = 0;
+			int64 ModelGpuBytes = 0;
+			int64 InstanceCpuBytes = 0;
+			int32 InstanceCount = 0;
+			for (const FTrackedEntry& Tracked : Entries)
+			{
+				if (IsInstance(Tracked.Entry.Kind))
+				{
+					InstanceCpuBytes += Tracked.Entry.CpuBytes;
+					++InstanceCount;
+				}
+				else
+				{
+					ModelCpuBytes += Tracked.Entry.CpuBytes;
+				}
+				ModelGpuBytes += Tracked.Entry.GpuBytes;
+			}
+
+			SET_MEMORY_STAT(STAT_StyleTransfer_ModelCpuMemory, ModelCpuBytes);
+			SET_MEMORY_STAT(STAT_StyleTransfer_ModelGpuMemory, ModelGpuBytes);
+			SET_MEMORY_STAT(STAT_StyleTransfer_InstanceCpuMemory, InstanceCpuBytes);
+			SET_DWORD_STAT(STAT_StyleTransfer_CachedInstances, InstanceCount);
+
+			const double TotalMB = (ModelCpuBytes + ModelGpuBytes + InstanceCpuBytes) / BytesPerMB;
+			const bool bNowOverBudget = RealtimeStyleTransfer::MemoryBudgetMB > 0.0f && TotalMB > RealtimeStyleTransfer::MemoryBudgetMB;
+			if (bNowOverBudget && !bOverBudget)
+			{
+				UE_LOG(LogStyleTransferMemory, Warning, TEXT("Loaded styles use %.1f MB, over the %.1f MB budget (r.RealtimeStyleTransfer.Memory.BudgetMB). See StyleTransfer.ListStyleMemory."),
+					TotalMB,
+					RealtimeStyleTransfer::MemoryBudgetMB);
+			}
+			bOverBudget = bNowOverBudget;
+		}
+
+		bool TickRefresh(float DeltaTime)
+		{
+			FScopeLock ScopeLock(&EntriesLock);
+			RefreshLocked();
+			return true;
+		}
+	}
+
+	void Track(const TWeakPtr<const void, ESPMode::ThreadSafe>& Owner, const FStyleTransferMemoryEntry& Entry)
+	{
+		FScopeLock ScopeLock(&EntriesLock);
+		Entries.Add({ Owner, Entry });
+		RefreshLocked();
+	}
+
+	TArray<FStyleTransferMemoryEntry> GetLiveEntries()
+	{
+		FScopeLock ScopeLock(&EntriesLock);
+		RefreshLocked();
+
+		TArray<FStyleTransferMemoryEntry> LiveEntries;
+		LiveEntries.Reserve(Entries.Num());
+		for (const FTrackedEntry& Tracked : Entries)
+		{
+			LiveEntries.Add(Tracked.Entry);
+		}
+		return LiveEntries;
+	}
+
+	void SetFrameResourceBytes(int64 Bytes)
+	{
+		SET_MEMORY_STAT(STAT_StyleTransfer_FrameGpuMemory, Bytes);
+	}
+
+	void Startup()
+	{
+		RefreshHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickRefresh), RefreshIntervalSeconds);
+	}
+
+	void Shutdown()
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(RefreshHandle);
+		RefreshHandle.Reset();
+	}
+}
+
+namespace RealtimeStyleTransfer
+{
+	/** Lists every loaded style with the CPU and GPU memory of its models and instances. */
+	static void ListStyleMemory(const TArray<FString>& Args)
+	{
+		const bool bVerbose = Args.Contains(TEXT("verbose"));
+		const TArray<FStyleTransferMemoryEntry> Entries = StyleTransferMemory::GetLiveEntries();
+		if (Entries.IsEmpty())
+		{
+			UE_LOG(LogStyleTransferMemory, Display, TEXT("No style models are loaded."));
+			return;
+		}
+
+		TMap<FString, TArray<const FStyleTransferMemoryEntry*>> EntriesByStyle;
+		for (const FStyleTransferMemoryEntry& Entry : Entries)
+		{
+			EntriesByStyle.FindOrAdd(Entry.StyleName).Add(&Entry);
+		}
+		EntriesByStyle.KeySort(TLess<FString>());
+
+		int64 TotalCpuBytes = 0;
+		int64 TotalGpuBytes = 0;
+		for (const TPair<FString, TArray<const FStyleTransferMemoryEntry*>>& Style : EntriesByStyle)
+		{
+			int64 CpuBytes = 0;
+			int64 GpuBytes = 0;
+			int64 FrameGpuBytes = 0;
+			int32 InstanceCount = 0;
+			for (const FStyleTransferMemoryEntry* Entry : Style.Value)
+			{
+				CpuBytes += Entry->CpuBytes;
+				GpuBytes += Entry->GpuBytes;
+				FrameGpuBytes = FMath::Max(FrameGpuBytes, Entry->FrameGpuBytes);
+				InstanceCount += StyleTransferMemory::IsInstance(Entry->Kind) ? 1 : 0;
+			}
+			TotalCpuBytes += CpuBytes;
+			TotalGpuBytes += GpuBytes;
+
+			UE_LOG(LogStyleTransferMemory, Display, TEXT("%s: CPU %.2f MB, GPU %.2f MB persistent + %.2f MB per frame, %d instance(s)."),
+				*Style.Key,
+				CpuBytes / StyleTransferMemory::BytesPerMB,
+				GpuBytes / StyleTransferMemory::BytesPerMB,
+				FrameGpuBytes / StyleTransferMemory::BytesPerMB,
+				InstanceCount);
+
+			if (bVerbose)
+			{
+				for (const FStyleTransferMemoryEntry* Entry : Style.Value)
+				{
+					UE_LOG(LogStyleTransferMemory, Display, TEXT("    %s (%s, %dx%d, batch %u): CPU %.2f MB, GPU %.2f MB, frame %.2f MB"),
+						StyleTransferMemory::GetKindName(Entry->Kind),
+						*Entry->RuntimeName,
+						Entry->Resolution.X,
+						Entry->Resolution.Y,
+						Entry->BatchSize,
+						Entry->CpuBytes / StyleTransferMemory::BytesPerMB,
+						Entry->GpuBytes / StyleTransferMemory::BytesPerMB,
+						Entry->FrameGpuBytes / StyleTransferMemory::BytesPerMB);
+				}
+			}
+		}
+
+		UE_LOG(LogStyleTransferMemory, Display, TEXT("Total: CPU %.2f MB, GPU %.2f MB persistent%s."),
+			TotalCpuBytes / StyleTransferMemory::BytesPerMB,
+			TotalGpuBytes / StyleTransferMemory::BytesPerMB,
+			MemoryBudgetMB > 0.0f ? *FString::Printf(TEXT(" (budget %.1f MB)"), MemoryBudgetMB) : TEXT(""));
+	}
+
+	static FAutoConsoleCommand ListStyleMemoryCommand(
+		TEXT("StyleTransfer.ListStyleMemory"),
+		TEXT("Lists every loaded style with the CPU and GPU memory of its models, instances and per-frame RDG resources.\n")
+		TEXT("Usage: StyleTransfer.ListStyleMemory [verbose]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&ListStyleMemory));
+}
@@ -0,0 +1,70 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/** LLM tags for CPU allocations made while building style models (weights) and their instances (runtime workspaces). */
+LLM_DECLARE_TAG_API(StyleTransfer, FPSTYLETRANSFER_API);
+LLM_DECLARE_TAG_API(StyleTransfer_Models, FPSTYLETRANSFER_API);
+LLM_DECLARE_TAG_API(StyleTransfer_Instances, FPSTYLETRANSFER_API);
+
+enum class EStyleTransferMemoryKind : uint8
+{
+	/** Runtime model holding the weights, shared by all of a style's instances. */
+	Model,
+	/** RDG model instance: the style's own, a resized foveation instance or a batched render target instance. */
+	Instance,
+	/** CPU runtime model served by FStyleTransferCpuInferenceService. */
+	CpuModel,
+	/** Pooled CPU model instance of FStyleTransferCpuInferenceService. */
+	CpuInstance,
+};
+
+/** Memory one runtime object of a style holds, recorded when it is created. */
+struct FStyleTransferMemoryEntry
+{
+	EStyleTransferMemoryKind Kind = EStyleTransferMemoryKind::Model;
+	FString StyleName;
+	FString RuntimeName;
+	FIntPoint Resolution = FIntPoint::ZeroValue;
+	uint32 BatchSize = 1;
+	/** Physical memory the creation added, sampled around it, so concurrent loads can skew it; LLM has the exact split. */
+	int64 CpuBytes = 0;
+	/** Persistent GPU memory: weights uploaded by RDG runtimes (estimated from the model size) or the conv-net parameter buffer. */
+	int64 GpuBytes = 0;
+	/** Transient StyleTransfer.* RDG buffers and textures one inference of the instance creates. */
+	int64 FrameGpuBytes = 0;
+};
+
+/**
+ * Accounting of style model memory for budgets: every runtime model and instance is tracked while its owner is alive,
+ * summed into the StyleTransfer stat group and listed per style by StyleTransfer.ListStyleMemory.
+ */
+namespace StyleTransferMemory
+{
+	/** Samples physical memory around the creation of a tracked object. */
+	struct FCpuProbe
+	{
+		uint64 BaselineBytes = FPlatformMemory::GetStats().UsedPhysical;
+
+		int64 GetBytes() const
+		{
+			return FMath::Max<int64>(static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(BaselineBytes), 0);
+		}
+	};
+
+	/** Records Entry until Owner is destroyed. Any thread. */
+	FPSTYLETRANSFER_API void Track(const TWeakPtr<const void, ESPMode::ThreadSafe>& Owner, const FStyleTransferMemoryEntry& Entry);
+
+	/** Entries whose owner is still alive. */
+	FPSTYLETRANSFER_API TArray<FStyleTransferMemoryEntry> GetLiveEntries();
+
+	/** Bytes of StyleTransfer.* RDG resources the view extension created this frame. Render thread only. */
+	FPSTYLETRANSFER_API void SetFrameResourceBytes(int64 Bytes);
+
+	/** Starts and stops the periodic refresh of the memory stats. Called by the module. */
+	void Startup();
+	void Shutdown();
+}
@@ -0,0 +1,87 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferModelLODSet.h"
+
+int32 UStyleTransferModelLODSet::GetFirstAllowedLOD(int32 PostProcessQuality) const
+{
+	const int32 LODIndex = LODs.IndexOfByPredicate([PostProcessQuality](const FStyleTransferModelLOD& LOD)
+	{
+		return LOD.MinPostProcessQuality <= PostProcessQuality;
+	});
+	return LODIndex != INDEX_NONE ? LODIndex : LODs.Num() - 1;
+}
+
+void FStyleTransferLODGovernor::Reset(uint64 Frame)
+{
+	*this = FStyleTransferLODGovernor();
+	LastSwitchFrame = Frame;
+}
+
+int32 FStyleTransferLODGovernor::Tick(uint64 Frame, double GpuMs, int32 ActiveLOD, int32 FirstAllowedLOD, int32 LastLOD, const FStyleTransferLODGovernorSettings& Settings)
+{
+	constexpr double GpuMsSmoothing = 0.1;
+
+	const uint64 FramesSinceSwitch = Frame - LastSwitchFrame;
+	const int32 UpFrames = FMath::Max(Settings.UpFrames, 1);
+
+	// A step up that held for a full UpFrames window clears the backoff of earlier failed attempts.
+	if (bLastSwitchUp && FramesSinceSwitch >= static_cast<uint64>(UpFrames))
+	{
+		UpBackoff = 1;
+		bLastSwitchUp = false;
+	}
+
+	if (GpuMs > 0.0 && FramesSinceSwitch >= kGpuTimeLatencyFrames)
+	{
+		SmoothedGpuMs = SmoothedGpuMs > 0.0 ? FMath::Lerp(SmoothedGpuMs, GpuMs, GpuMsSmoothing) : GpuMs;
+
+		if (SmoothedGpuMs > Settings.TargetGpuMs)
+		{
+			++OverBudgetFrames;
+			UnderBudgetFrames = 0;
+		}
+		else if (SmoothedGpuMs < Settings.TargetGpuMs * Settings.UpThreshold)
+		{
+			++UnderBudgetFrames;
+			OverBudgetFrames = 0;
+		}
+		else
+		{
+			OverBudgetFrames = 0;
+			UnderBudgetFrames = 0;
+		}
+	}
+
+	int32 TargetLOD = ActiveLOD;
+	if (ActiveLOD < FirstAllowedLOD)
+	{
+		TargetLOD = FirstAllowedLOD;
+	}
+	else if (OverBudgetFrames >= FMath::Max(Settings.DownFrames, 1) && ActiveLOD < LastLOD)
+	{
+		TargetLOD = ActiveLOD + 1;
+	}
+	else if (UnderBudgetFrames >= UpFrames * UpBackoff && ActiveLOD > FirstAllowedLOD)
+	{
+		TargetLOD = ActiveLOD - 1;
+	}
+
+	if (TargetLOD == ActiveLOD)
+	{
+		return ActiveLOD;
+	}
+
+	// Undoing a step up within its window means the headroom was not there; wait longer before the next attempt.
+	if (TargetLOD > ActiveLOD && bLastSwitchUp && FramesSinceSwitch < static_cast<uint64>(UpFrames))
+	{
+		UpBackoff = FMath::Min(UpBackoff * 2, kMaxUpBackoff);
+	}
+
+	// The new LOD's cost starts from scratch: the smoothed time and the counters only described the old one.
+	bLastSwitchUp = TargetLOD < ActiveLOD;
+	LastSwitchFrame = Frame;
+	SmoothedGpuMs = 0.0;
+	OverBudgetFrames = 0;
+	UnderBudgetFrames = 0;
+	return TargetLOD;
+}
@@ -0,0 +1,83 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "NNEModelData.h"
+#include "StyleTransferModelLODSet.generated.h"
+
+/** One architecture variant of a style. */
+USTRUCT(BlueprintType)
+struct FPSTYLETRANSFER_API FStyleTransferModelLOD
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	TObjectPtr<UNNEModelData> ModelData;
+
+	/** Optional NNE runtime name; None uses the default runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	FName RuntimeName;
+
+	/** Lowest post-process scalability level (sg.PostProcessQuality) the governor may pick this variant at. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer", meta = (ClampMin = "0", ClampMax = "4"))
+	int32 MinPostProcessQuality = 0;
+};
+
+/**
+ * Variants of one style in decreasing cost, e.g. full, slim and tiny networks trained on the same style. Activated with
+ * FRealtimeStyleTransferViewExtension::SetStyleLODSet, which loads them all and lets a governor pick one each frame.
+ */
+UCLASS(BlueprintType)
+class FPSTYLETRANSFER_API UStyleTransferModelLODSet : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** LOD 0 is the most expensive variant; each following one should be cheaper. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	TArray<FStyleTransferModelLOD> LODs;
+
+	/** Most expensive LOD allowed at PostProcessQuality: the first one whose MinPostProcessQuality it meets, else the last. */
+	int32 GetFirstAllowedLOD(int32 PostProcessQuality) const;
+};
+
+/** Thresholds of FStyleTransferLODGovernor; the game reads them from the r.RealtimeStyleTransfer.LOD.* cvars. */
+struct FStyleTransferLODGovernorSettings
+{
+	double TargetGpuMs = 16.6;
+	/** Fraction of TargetGpuMs the smoothed GPU time must stay under before stepping up. */
+	double UpThreshold = 0.8;
+	int32 DownFrames = 30;
+	int32 UpFrames = 180;
+};
+
+/**
+ * Picks the LOD of a LOD set each frame from the GPU frame time. It steps down after DownFrames frames over budget
+ * and up after UpFrames frames under UpThreshold of it, leaving a band in between where it holds. A step up that
+ * has to be undone within UpFrames doubles the frames the next one waits, up to kMaxUpBackoff times. Holds no
+ * engine state, so it runs the same in the view extension and in tests.
+ */
+struct FStyleTransferLODGovernor
+{
+	static constexpr int32 kMaxUpBackoff = 8;
+	/** Frames, counting the switch frame, whose GPU time still measures the previous LOD because it is reported late. */
+	static constexpr uint64 kGpuTimeLatencyFrames = 3;
+
+	double SmoothedGpuMs = 0.0;
+	int32 OverBudgetFrames = 0;
+	int32 UnderBudgetFrames = 0;
+	int32 UpBackoff = 1;
+	uint64 LastSwitchFrame = 0;
+	bool bLastSwitchUp = false;
+
+	/** Forgets all history, e.g. when a LOD set is activated at Frame. */
+	void Reset(uint64 Frame);
+
+	/**
+	 * Takes the GPU time of Frame (0 when unknown) and returns the LOD to run, which is ActiveLOD or one step from it.
+	 * LODs below FirstAllowedLOD, the scalability limit, are left at once. A returned switch restarts the smoothing.
+	 */
+	int32 Tick(uint64 Frame, double GpuMs, int32 ActiveLOD, int32 FirstAllowedLOD, int32 LastLOD, const FStyleTransferLODGovernorSettings& Settings);
+};
@@ -0,0 +1,506 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferOnnx.h"
+
+namespace StyleTransferOnnx
+{
+	namespace
+	{
+		// onnx.proto field numbers used below.
+		constexpr uint64 ModelGraphField = 7;
+		constexpr uint64 ModelMetadataPropsField = 14;
+		constexpr uint64 GraphNodeField = 1;
+		constexpr uint64 GraphInitializerField = 5;
+		constexpr uint64 GraphInputField = 11;
+		constexpr uint64 GraphOutputField = 12;
+
+		enum class ETensorDataType : int64
+		{
+			Float = 1,
+			UInt8 = 2,
+			Int8 = 3,
+			Int32 = 6,
+			Int64 = 7,
+			Bool = 9,
+			Float16 = 10,
+			Double = 11,
+		};
+
+		struct FField
+		{
+			uint64 Number = 0;
+			uint64 WireType = 0;
+			uint64 Varint = 0;
+			const uint8* Data = nullptr;
+			uint64 Length = 0;
+		};
+
+		bool ReadVarint(const uint8*& Cursor, const uint8* End, uint64& OutValue)
+		{
+			OutValue = 0;
+			for (int32 Shift = 0; Cursor < End && Shift < 64; Shift += 7)
+			{
+				const uint8 Byte = *Cursor++;
+				OutValue |= static_cast<uint64>(Byte & 0x7F) << Shift;
+				if ((Byte & 0x80) == 0)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/** Calls Visitor(const FField&) for every field in [Cursor, End). Stops and returns false on malformed data or when Visitor returns false. */
+		template <typename VisitorType>
+		bool VisitFields(const uint8* Cursor, const uint8* End, VisitorType&& Visitor)
+		{
+			while (Cursor < End)
+			{
+				uint64 Key = 0;
+				if (!ReadVarint(Cursor, End, Key))
+				{
+					return false;
+				}
+
+				FField Field;
+				Field.Number = Key >> 3;
+				Field.WireType = Key & 0x7;
+				if (Field.WireType == 0)
+				{
+					if (!ReadVarint(Cursor, End, Field.Varint))
+					{
+						return false;
+					}
+				}
+				else if (Field.WireType == 1)
+				{
+					Field.Length = 8;
+				}
+				else if (Field.WireType == 5)
+				{
+					Field.Length = 4;
+				}
+				else if (Field.WireType != 2 || !ReadVarint(Cursor, End, Field.Length))
+				{
+					return false;
+				}
+
+				if (Field.Length > static_cast<uint64>(End - Cursor))
+				{
+					return false;
+				}
+
+				Field.Data = Cursor;
+				Cursor += Field.Length;
+				if (!Visitor(Field))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		FString ToString(const FField& Field)
+		{
+			const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Field.Data), static_cast<int32>(Field.Length));
+			return FString(Converted.Length(), Converted.Get());
+		}
+
+		float ToFloat(const FField& Field)
+		{
+			float Value = 0.0f;
+			if (Field.WireType == 5)
+			{
+				FMemory::Memcpy(&Value, Field.Data, sizeof(float));
+			}
+			return Value;
+		}
+
+		/** Repeated integers may be packed (one length-delimited field) or not (one varint per element). */
+		bool AppendInts(const FField& Field, TArray<int64>& OutValues)
+		{
+			if (Field.WireType == 0)
+			{
+				OutValues.Add(static_cast<int64>(Field.Varint));
+				return true;
+			}
+
+			const uint8* Cursor = Field.Data;
+			const uint8* End = Field.Data + Field.Length;
+			while (Cursor < End)
+			{
+				uint64 Value = 0;
+				if (!ReadVarint(Cursor, End, Value))
+				{
+					return false;
+				}
+				OutValues.Add(static_cast<int64>(Value));
+			}
+			return true;
+		}
+
+		bool AppendFloats(const FField& Field, TArray<float>& OutValues)
+		{
+			if (Field.WireType == 5)
+			{
+				OutValues.Add(ToFloat(Field));
+				return true;
+			}
+
+			if (Field.WireType != 2 || Field.Length % sizeof(float) != 0)
+			{
+				return false;
+			}
+
+			const int32 Start = OutValues.AddUninitialized(static_cast<int32>(Field.Length / sizeof(float)));
+			FMemory::Memcpy(OutValues.GetData() + Start, Field.Data, Field.Length);
+			return true;
+		}
+
+		bool AppendDoubles(const FField& Field, TArray<float>& OutValues)
+		{
+			for (uint64 Offset = 0; Offset + sizeof(double) <= Field.Length; Offset += sizeof(double))
+			{
+				double Value = 0.0;
+				FMemory::Memcpy(&Value, Field.Data + Offset, sizeof(double));
+				OutValues.Add(static_cast<float>(Value));
+			}
+			return true;
+		}
+
+		template <typename ElementType>
+		void ConvertRaw(const uint8* Raw, uint64 RawLength, TArray<float>& OutValues)
+		{
+			const int32 Count = static_cast<int32>(RawLength / sizeof(ElementType));
+			OutValues.Reserve(Count);
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				ElementType Value;
+				FMemory::Memcpy(&Value, Raw + Index * sizeof(ElementType), sizeof(ElementType));
+				OutValues.Add(static_cast<float>(Value));
+			}
+		}
+
+		bool ReadTensor(const FField& TensorField, FTensor& OutTensor, FString& OutError)
+		{
+			int64 DataType = 0;
+			const uint8* Raw = nullptr;
+			uint64 RawLength = 0;
+			bool bExternal = false;
+			TArray<int64> IntData;
+
+			const bool bParsed = VisitFields(TensorField.Data, TensorField.Data + TensorField.Length, [&](const FField& Field)
+			{
+				switch (Field.Number)
+				{
+				case 1: return AppendInts(Field, OutTensor.Dims);
+				case 2: DataType = static_cast<int64>(Field.Varint); return true;
+				case 4: return AppendFloats(Field, OutTensor.Data);
+				case 5: return AppendInts(Field, IntData);
+				case 7: return AppendInts(Field, IntData);
+				case 8: OutTensor.Name = ToString(Field); return true;
+				case 9: Raw = Field.Data; RawLength = Field.Length; return true;
+				case 10: return AppendDoubles(Field, OutTensor.Data);
+				case 14: bExternal = Field.Varint == 1; return true;
+				default: return true;
+				}
+			});
+
+			if (!bParsed)
+			{
+				OutError = TEXT("malformed tensor");
+				return false;
+			}
+
+			if (bExternal)
+			{
+				OutError = FString::Printf(TEXT("tensor '%s' uses external data"), *OutTensor.Name);
+				return false;
+			}
+
+			if (Raw)
+			{
+				switch (static_cast<ETensorDataType>(DataType))
+				{
+				case ETensorDataType::Float: ConvertRaw<float>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Double: ConvertRaw<double>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::UInt8: ConvertRaw<uint8>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Bool: ConvertRaw<uint8>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Int8: ConvertRaw<int8>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Int32: ConvertRaw<int32>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Int64: ConvertRaw<int64>(Raw, RawLength, OutTensor.Data); break;
+				case ETensorDataType::Float16:
+					for (uint64 Offset = 0; Offset + sizeof(uint16) <= RawLength; Offset += sizeof(uint16))
+					{
+						FFloat16 Half;
+						FMemory::Memcpy(&Half.Encoded, Raw + Offset, sizeof(uint16));
+						OutTensor.Data.Add(Half.GetFloat());
+					}
+					break;
+				default:
+					OutError = FString::Printf(TEXT("tensor '%s' has unsupported data type %lld"), *OutTensor.Name, DataType);
+					return false;
+				}
+			}
+			else if (static_cast<ETensorDataType>(DataType) == ETensorDataType::Float16)
+			{
+				// float16_data stores the raw half bits in int32_data.
+				for (const int64 Bits : IntData)
+				{
+					FFloat16 Half;
+					Half.Encoded = static_cast<uint16>(Bits);
+					OutTensor.Data.Add(Half.GetFloat());
+				}
+			}
+			else
+			{
+				for (const int64 Value : IntData)
+				{
+					OutTensor.Data.Add(static_cast<float>(Value));
+				}
+			}
+
+			if (OutTensor.Data.Num() != OutTensor.Num())
+			{
+				OutError = FString::Printf(TEXT("tensor '%s' has %d elements, expected %lld"), *OutTensor.Name, OutTensor.Data.Num(), OutTensor.Num());
+				return false;
+			}
+			return true;
+		}
+
+		bool ReadAttribute(const FField& AttributeField, FNode& OutNode, FString& OutError)
+		{
+			FString Name;
+			FAttribute Attribute;
+			bool bTensorValid = true;
+
+			const bool bParsed = VisitFields(AttributeField.Data, AttributeField.Data + AttributeField.Length, [&](const FField& Field)
+			{
+				switch (Field.Number)
+				{
+				case 1: Name = ToString(Field); return true;
+				case 2: Attribute.F = ToFloat(Field); return true;
+				case 3: Attribute.I = static_cast<int64>(Field.Varint); return true;
+				case 4: Attribute.S = ToString(Field); return true;
+				case 5: bTensorValid = ReadTensor(Field, Attribute.T.Emplace(), OutError); return bTensorValid;
+				case 7: return AppendFloats(Field, Attribute.Floats);
+				case 8: return AppendInts(Field, Attribute.Ints);
+				default: return true;
+				}
+			});
+
+			if (!bParsed)
+			{
+				if (bTensorValid)
+				{
+					OutError = FString::Printf(TEXT("malformed attribute in node '%s'"), *OutNode.Name);
+				}
+				return false;
+			}
+
+			OutNode.Attributes.Add(MoveTemp(Name), MoveTemp(Attribute));
+			return true;
+		}
+
+		bool ReadNode(const FField& NodeField, FNode& OutNode, FString& OutError)
+		{
+			bool bAttributesValid = true;
+			const bool bParsed = VisitFields(NodeField.Data, NodeField.Data + NodeField.Length, [&](const FField& Field)
+			{
+				switch (Field.Number)
+				{
+				case 1: OutNode.Inputs.Add(ToString(Field)); return true;
+				case 2: OutNode.Outputs.Add(ToString(Field)); return true;
+				case 3: OutNode.Name = ToString(Field); return true;
+				case 4: OutNode.OpType = ToString(Field); return true;
+				case 5: bAttributesValid = ReadAttribute(Field, OutNode, OutError); return bAttributesValid;
+				default: return true;
+				}
+			});
+
+			if (!bParsed && bAttributesValid)
+			{
+				OutError = TEXT("malformed node");
+			}
+			return bParsed;
+		}
+
+		bool ReadValueInfo(const FField& ValueInfoField, FValueInfo& OutValueInfo)
+		{
+			// ValueInfoProto.type -> TypeProto.tensor_type -> Tensor.shape -> TensorShapeProto.dim -> Dimension.dim_value
+			auto ReadDimension = [&OutValueInfo](const FField& DimensionField)
+			{
+				int64 Value = -1;
+				const bool bParsed = VisitFields(DimensionField.Data, DimensionField.Data + DimensionField.Length, [&Value](const FField& Field)
+				{
+					if (Field.Number == 1 && Field.WireType == 0)
+					{
+						Value = static_cast<int64>(Field.Varint);
+					}
+					return true;
+				});
+				OutValueInfo.Dims.Add(Value > 0 ? Value : -1);
+				return bParsed;
+			};
+
+			auto ReadShape = [&ReadDimension](const FField& ShapeField)
+			{
+				return VisitFields(ShapeField.Data, ShapeField.Data + ShapeField.Length, [&ReadDimension](const FField& Field)
+				{
+					return Field.Number == 1 ? ReadDimension(Field) : true;
+				});
+			};
+
+			auto ReadTensorType = [&ReadShape](const FField& TensorTypeField)
+			{
+				return VisitFields(TensorTypeField.Data, TensorTypeField.Data + TensorTypeField.Length, [&ReadShape](const FField& Field)
+				{
+					return Field.Number == 2 ? ReadShape(Field) : true;
+				});
+			};
+
+			auto ReadType = [&ReadTensorType](const FField& TypeField)
+			{
+				return VisitFields(TypeField.Data, TypeField.Data + TypeField.Length, [&ReadTensorType](const FField& Field)
+				{
+					return Field.Number == 1 ? ReadTensorType(Field) : true;
+				});
+			};
+
+			return VisitFields(ValueInfoField.Data, ValueInfoField.Data + ValueInfoField.Length, [&](const FField& Field)
+			{
+				if (Field.Number == 1)
+				{
+					OutValueInfo.Name = ToString(Field);
+					return true;
+				}
+				return Field.Number == 2 ? ReadType(Field) : true;
+			});
+		}
+	}
+
+	int64 FTensor::Num() const
+	{
+		int64 Count = 1;
+		for (const int64 Dim : Dims)
+		{
+			Count *= Dim;
+		}
+		return Count;
+	}
+
+	int64 FNode::GetInt(const TCHAR* AttributeName, int64 Default) const
+	{
+		const FAttribute* Attribute = Attributes.Find(AttributeName);
+		return Attribute ? Attribute->I : Default;
+	}
+
+	float FNode::GetFloat(const TCHAR* AttributeName, float Default) const
+	{
+		const FAttribute* Attribute = Attributes.Find(AttributeName);
+		return Attribute ? Attribute->F : Default;
+	}
+
+	FString FNode::GetString(const TCHAR* AttributeName, const FString& Default) const
+	{
+		const FAttribute* Attribute = Attributes.Find(AttributeName);
+		return Attribute ? Attribute->S : Default;
+	}
+
+	TArray<int64> FNode::GetInts(const TCHAR* AttributeName) const
+	{
+		const FAttribute* Attribute = Attributes.Find(AttributeName);
+		return Attribute ? Attribute->Ints : TArray<int64>();
+	}
+
+	TMap<FString, FString> ReadMetadata(const uint8* Data, int64 Size)
+	{
+		constexpr uint64 EntryKeyField = 1;
+		constexpr uint64 EntryValueField = 2;
+
+		TMap<FString, FString> Metadata;
+		VisitFields(Data, Data + Size, [&Metadata](const FField& ModelField)
+		{
+			if (ModelField.Number != ModelMetadataPropsField || ModelField.WireType != 2)
+			{
+				return true;
+			}
+
+			FString Key;
+			FString Value;
+			VisitFields(ModelField.Data, ModelField.Data + ModelField.Length, [&Key, &Value](const FField& Field)
+			{
+				if (Field.Number == EntryKeyField)
+				{
+					Key = ToString(Field);
+				}
+				else if (Field.Number == EntryValueField)
+				{
+					Value = ToString(Field);
+				}
+				return true;
+			});
+
+			if (!Key.IsEmpty())
+			{
+				Metadata.Add(MoveTemp(Key), MoveTemp(Value));
+			}
+			return true;
+		});
+		return Metadata;
+	}
+
+	bool ReadGraph(const uint8* Data, int64 Size, FGraph& OutGraph, FString& OutError)
+	{
+		bool bFoundGraph = false;
+		const bool bParsed = VisitFields(Data, Data + Size, [&](const FField& ModelField)
+		{
+			if (ModelField.Number != ModelGraphField || ModelField.WireType != 2)
+			{
+				return true;
+			}
+
+			bFoundGraph = true;
+			return VisitFields(ModelField.Data, ModelField.Data + ModelField.Length, [&](const FField& Field)
+			{
+				switch (Field.Number)
+				{
+				case GraphNodeField:
+					return ReadNode(Field, OutGraph.Nodes.AddDefaulted_GetRef(), OutError);
+				case GraphInitializerField:
+				{
+					FTensor Tensor;
+					if (!ReadTensor(Field, Tensor, OutError))
+					{
+						return false;
+					}
+					OutGraph.Initializers.Add(Tensor.Name, MoveTemp(Tensor));
+					return true;
+				}
+				case GraphInputField:
+					return ReadValueInfo(Field, OutGraph.Inputs.AddDefaulted_GetRef());
+				case GraphOutputField:
+					return ReadValueInfo(Field, OutGraph.Outputs.AddDefaulted_GetRef());
+				default:
+					return true;
+				}
+			});
+		});
+
+		if (!bParsed || !bFoundGraph)
+		{
+			if (OutError.IsEmpty())
+			{
+				OutError = bFoundGraph ? TEXT("malformed graph") : TEXT("no graph found");
+			}
+			return false;
+		}
+
+		// Older exporters list initializers as graph inputs too.
+		OutGraph.Inputs.RemoveAll([&OutGraph](const FValueInfo& Input)
+		{
+			return OutGraph.Initializers.Contains(Input.Name);
+		});
+		return true;
+	}
+}
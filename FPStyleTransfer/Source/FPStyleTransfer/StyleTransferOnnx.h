@@ -0,0 +1,67 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Minimal reader for serialized ONNX models (protobuf wire format), enough for the engine to inspect model metadata
+ * and load small feed-forward graphs without a protobuf dependency. Float, half and integer tensors are decoded to float.
+ */
+namespace StyleTransferOnnx
+{
+	struct FTensor
+	{
+		FString Name;
+		TArray<int64> Dims;
+		/** Element data converted to float, for float, double and integer tensors. */
+		TArray<float> Data;
+
+		int64 Num() const;
+	};
+
+	struct FAttribute
+	{
+		float F = 0.0f;
+		int64 I = 0;
+		FString S;
+		TArray<float> Floats;
+		TArray<int64> Ints;
+		TOptional<FTensor> T;
+	};
+
+	struct FNode
+	{
+		FString OpType;
+		FString Name;
+		TArray<FString> Inputs;
+		TArray<FString> Outputs;
+		TMap<FString, FAttribute> Attributes;
+
+		int64 GetInt(const TCHAR* AttributeName, int64 Default) const;
+		float GetFloat(const TCHAR* AttributeName, float Default) const;
+		FString GetString(const TCHAR* AttributeName, const FString& Default) const;
+		TArray<int64> GetInts(const TCHAR* AttributeName) const;
+	};
+
+	struct FValueInfo
+	{
+		FString Name;
+		/** Static dims; symbolic dims are -1. */
+		TArray<int64> Dims;
+	};
+
+	struct FGraph
+	{
+		TArray<FNode> Nodes;
+		TMap<FString, FTensor> Initializers;
+		TArray<FValueInfo> Inputs;
+		TArray<FValueInfo> Outputs;
+	};
+
+	/** Reads ModelProto.metadata_props. The graph itself is skipped, not parsed. */
+	TMap<FString, FString> ReadMetadata(const uint8* Data, int64 Size);
+
+	/** Parses ModelProto.graph. Returns false and fills OutError for malformed data or unsupported tensor types. */
+	bool ReadGraph(const uint8* Data, int64 Size, FGraph& OutGraph, FString& OutError);
+}
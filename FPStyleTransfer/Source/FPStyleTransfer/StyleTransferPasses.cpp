@@ -0,0 +1,1214 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferPasses.h"
+
+#include "CommonRenderResources.h"
+#include "DynamicRHI.h"
+#include "HAL/IConsoleManager.h"
+#include "PipelineStateCache.h"
+#include "PixelShaderUtils.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "StyleTransferShaders.h"
+#include "SystemTextures.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogRealtimeStyleTransfer, Log, All);
+
+DECLARE_GPU_STAT_NAMED(StyleTransferNNE, TEXT("StyleTransfer NNE"));
+DECLARE_CYCLE_STAT(TEXT("Create dispatch plan"), STAT_StyleTransfer_CreateDispatchPlan, STATGROUP_StyleTransfer);
+
+namespace RealtimeStyleTransfer
+{
+	static int32 EncodeAreaFilter = 1;
+	static FAutoConsoleVariableRef CVarEncodeAreaFilter(
+		TEXT("r.RealtimeStyleTransfer.Encode.AreaFilter"),
+		EncodeAreaFilter,
+		TEXT("Encodes each tensor element from the area average of its source footprint, which avoids aliasing when the view is much\n")
+		TEXT("larger than the model input. Only used when the view is downsampled along at least one axis; an upsampled axis then gets\n")
+		TEXT("bilinear weights, and a view upsampled along both axes uses one bilinear tap. Conv-net styles encode into a tensor\n")
+		TEXT("before their first convolution instead of sampling the scene in it while the filter applies.\n")
+		TEXT("=0: bilinear, 1: area filter (default)"),
+		ECVF_RenderThreadSafe);
+
+	static int32 UpscaleGuided = 0;
+	static FAutoConsoleVariableRef CVarUpscaleGuided(
+		TEXT("r.RealtimeStyleTransfer.Upscale.Guided"),
+		UpscaleGuided,
+		TEXT("Upscales the stylized image with a joint bilateral filter guided by the full-resolution frame, which keeps edges sharp at low model resolutions.\n")
+		TEXT("Experimental. It costs 10 guide samples and 9 loads per output pixel instead of one bilinear sample; StyleTransfer.BenchmarkComposite\n")
+		TEXT("times it against bilinear. Check that and CompositeGpuMs in the benchmark before enabling it.\n")
+		TEXT("=0: bilinear (default), 1: guided"),
+		ECVF_RenderThreadSafe);
+
+	static float UpscaleSpatialSigma = 1.0f;
+	static FAutoConsoleVariableRef CVarUpscaleSpatialSigma(
+		TEXT("r.RealtimeStyleTransfer.Upscale.SpatialSigma"),
+		UpscaleSpatialSigma,
+		TEXT("Spatial standard deviation of the guided upscale, in model resolution texels (default 1)."),
+		ECVF_RenderThreadSafe);
+
+	static float UpscaleRangeSigma = 0.1f;
+	static FAutoConsoleVariableRef CVarUpscaleRangeSigma(
+		TEXT("r.RealtimeStyleTransfer.Upscale.RangeSigma"),
+		UpscaleRangeSigma,
+		TEXT("Color standard deviation of the guided upscale. Lower values preserve more edges but let model resolution aliasing through (default 0.1)."),
+		ECVF_RenderThreadSafe);
+
+	static int32 CompositeRaster = 0;
+	static FAutoConsoleVariableRef CVarCompositeRaster(
+		TEXT("r.RealtimeStyleTransfer.Composite.Raster"),
+		CompositeRaster,
+		TEXT("Writes the upscaled frame with a full-screen pixel shader draw instead of compute UAV writes. UAV writes disable render target\n")
+		TEXT("compression (DCC) on many GPUs and force a decompress. Set it per platform in its Engine.ini from the line StyleTransfer.BenchmarkComposite prints.\n")
+		TEXT("=0: compute (default), 1: raster"),
+		ECVF_RenderThreadSafe);
+
+	static int32 MaskStencilBits = 1;
+	static FAutoConsoleVariableRef CVarMaskStencilBits(
+		TEXT("r.RealtimeStyleTransfer.Mask.Stencil"),
+		MaskStencilBits,
+		TEXT("Custom stencil bits that keep pixels unstylized under r.RealtimeStyleTransfer.Mask (the first-person mesh writes 1).\n")
+		TEXT("Requires r.CustomDepth=3 (set in DefaultEngine.ini). 0 ignores the stencil (default 1)."),
+		ECVF_RenderThreadSafe);
+
+	static float MaskSkyDistance = 0.0f;
+	static FAutoConsoleVariableRef CVarMaskSkyDistance(
+		TEXT("r.RealtimeStyleTransfer.Mask.SkyDistance"),
+		MaskSkyDistance,
+		TEXT("Scene depth in cm from which pixels count as sky and stay unstylized under r.RealtimeStyleTransfer.Mask. 0 disables (default)."),
+		ECVF_RenderThreadSafe);
+}
+
+namespace StyleTransferPasses
+{
+	namespace
+	{
+		/** Id-conditioned models get the dominant style index. */
+		int64 GetDominantStyle(TConstArrayView<float> StyleWeights)
+		{
+			int64 StyleIndex = 0;
+			for (int32 Index = 1; Index < StyleWeights.Num(); ++Index)
+			{
+				StyleIndex = StyleWeights[Index] > StyleWeights[StyleIndex] ? Index : StyleIndex;
+			}
+			return StyleIndex;
+		}
+
+		/** Per-frame condition inputs get one slice per entry of SliceWeights; shared ones take the first entry. */
+		FRDGBufferRef CreateConditioningTensor(FRDGBuilder& GraphBuilder, const FStyleTransferConditioningInput& Conditioning, TConstArrayView<TArray<float>> SliceWeights)
+		{
+			const uint32 SliceElementCount = FMath::Max<uint32>(static_cast<uint32>(Conditioning.Shape.Volume()), 1u);
+			const int32 SliceCount = Conditioning.bPerFrame ? SliceWeights.Num() : 1;
+			const uint32 ElementCount = SliceElementCount * SliceCount;
+			FRDGBufferRef Buffer = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateBufferDesc(Conditioning.ElementByteSize, ElementCount),
+				TEXT("StyleTransfer.StyleCondition"));
+
+			if (Conditioning.DataType == ENNETensorDataType::Float)
+			{
+				TArray<float> Values;
+				Values.SetNumZeroed(ElementCount);
+				for (int32 Slice = 0; Slice < SliceCount; ++Slice)
+				{
+					const TArray<float>& StyleWeights = SliceWeights[Slice];
+					FMemory::Memcpy(&Values[Slice * SliceElementCount], StyleWeights.GetData(), FMath::Min<int32>(StyleWeights.Num(), SliceElementCount) * sizeof(float));
+				}
+				GraphBuilder.QueueBufferUpload(Buffer, Values.GetData(), Values.Num() * sizeof(float));
+				return Buffer;
+			}
+
+			if (Conditioning.DataType == ENNETensorDataType::Int64)
+			{
+				TArray<int64> Values;
+				Values.Reserve(ElementCount);
+				for (int32 Slice = 0; Slice < SliceCount; ++Slice)
+				{
+					const int64 StyleIndex = GetDominantStyle(SliceWeights[Slice]);
+					for (uint32 Element = 0; Element < SliceElementCount; ++Element)
+					{
+						Values.Add(StyleIndex);
+					}
+				}
+				GraphBuilder.QueueBufferUpload(Buffer, Values.GetData(), Values.Num() * sizeof(int64));
+			}
+			else
+			{
+				TArray<int32> Values;
+				Values.Reserve(ElementCount);
+				for (int32 Slice = 0; Slice < SliceCount; ++Slice)
+				{
+					const int32 StyleIndex = static_cast<int32>(GetDominantStyle(SliceWeights[Slice]));
+					for (uint32 Element = 0; Element < SliceElementCount; ++Element)
+					{
+						Values.Add(StyleIndex);
+					}
+				}
+				GraphBuilder.QueueBufferUpload(Buffer, Values.GetData(), Values.Num() * sizeof(int32));
+			}
+			return Buffer;
+		}
+
+		/** Mask parameters of MaskInputs; a default FMaskInputs masks nothing. */
+		void SetupMask(FRDGBuilder& GraphBuilder, const FMaskInputs& MaskInputs, FPStyleTransferShaders::FMaskParameters& OutMask)
+		{
+			const int32 RectCount = FMath::Min(MaskInputs.Rects.Num(), FPStyleTransferShaders::kMaxMaskRects);
+			for (int32 RectIndex = 0; RectIndex < RectCount; ++RectIndex)
+			{
+				OutMask.MaskRects[RectIndex] = MaskInputs.Rects[RectIndex];
+			}
+			OutMask.MaskRectCount = static_cast<uint32>(RectCount);
+			OutMask.MaskInvDeviceZToWorldZ = MaskInputs.InvDeviceZToWorldZ;
+			OutMask.MaskSceneViewMin = FVector2f(MaskInputs.SceneViewRect.Min.X, MaskInputs.SceneViewRect.Min.Y);
+			OutMask.MaskSceneViewSize = FVector2f(MaskInputs.SceneViewRect.Width(), MaskInputs.SceneViewRect.Height());
+			OutMask.MaskStencilBits = MaskInputs.CustomStencil ? static_cast<uint32>(FMath::Max(RealtimeStyleTransfer::MaskStencilBits, 0)) : 0u;
+			OutMask.MaskSkyDistance = MaskInputs.SceneDepth ? FMath::Max(RealtimeStyleTransfer::MaskSkyDistance, 0.0f) : 0.0f;
+			OutMask.MaskStencilTexture = MaskInputs.CustomStencil
+				? MaskInputs.CustomStencil
+				: GraphBuilder.CreateSRV(FRDGTextureSRVDesc(GSystemTextures.GetZeroUIntDummy(GraphBuilder)));
+			OutMask.MaskDepthTexture = MaskInputs.SceneDepth ? MaskInputs.SceneDepth : GSystemTextures.GetBlackDummy(GraphBuilder);
+		}
+
+		uint32 GetTensorSliceSize(FIntPoint Resolution, int32 Channels)
+		{
+			return Resolution.X * Resolution.Y * static_cast<uint32>(FMath::Max(Channels, 1));
+		}
+
+		uint32 GetInputSliceSize(const FStyleTransferProxy& Proxy)
+		{
+			return GetTensorSliceSize(Proxy.InputResolution, Proxy.InputChannels);
+		}
+
+		/** Super-resolution stages output more elements than they take in. */
+		uint32 GetOutputSliceSize(const FStyleTransferProxy& Proxy)
+		{
+			return GetTensorSliceSize(Proxy.OutputResolution, Proxy.OutputChannels);
+		}
+
+		/** Typed view format for an image tensor. Half tensors read and write as float through an R16F view. */
+		EPixelFormat GetTensorFormat(ENNETensorDataType DataType)
+		{
+			switch (DataType)
+			{
+			case ENNETensorDataType::Half:
+				return PF_R16F;
+			case ENNETensorDataType::UInt8:
+				return PF_R8_UINT;
+			case ENNETensorDataType::Int8:
+				return PF_R8_SINT;
+			default:
+				return PF_R32_FLOAT;
+			}
+		}
+
+		FPStyleTransferShaders::ETensorType GetTensorType(ENNETensorDataType DataType)
+		{
+			switch (DataType)
+			{
+			case ENNETensorDataType::UInt8:
+				return FPStyleTransferShaders::ETensorType::Unsigned8;
+			case ENNETensorDataType::Int8:
+				return FPStyleTransferShaders::ETensorType::Signed8;
+			default:
+				return FPStyleTransferShaders::ETensorType::Float;
+			}
+		}
+
+		FRDGBufferRef CreateImageTensor(FRDGBuilder& GraphBuilder, uint32 SliceSize, uint32 ElementByteSize, uint32 BatchSize, const TCHAR* Name)
+		{
+			return GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateBufferDesc(ElementByteSize, SliceSize * FMath::Max(BatchSize, 1u)),
+				Name);
+		}
+
+		FRDGTextureDesc MakeStylizedDesc(const FStyleTransferProxy& Proxy)
+		{
+			return FRDGTextureDesc::Create2D(
+				Proxy.OutputResolution,
+				PF_FloatRGBA,
+				FClearValueBinding::Transparent,
+				TexCreate_ShaderResource | TexCreate_UAV);
+		}
+
+		/** Fills every encode parameter except the texture and tensor bindings and returns the shader to run. */
+		TShaderRef<FPStyleTransferShaders::FEncodeCS> SetupEncode(
+			const FStyleTransferProxy& Proxy,
+			const FIntRect& ViewRect,
+			FIntPoint SourceExtent,
+			uint32 BatchIndex,
+			FPStyleTransferShaders::FEncodeCS::FParameters& OutParameters)
+		{
+			const FIntPoint ModelResolution = Proxy.InputResolution;
+			OutParameters.ModelResolution = ModelResolution;
+			OutParameters.ViewMin = FVector2f(ViewRect.Min.X, ViewRect.Min.Y);
+			OutParameters.ViewSize = FVector2f(ViewRect.Width(), ViewRect.Height());
+			OutParameters.SourceExtent = FVector2f(SourceExtent.X, SourceExtent.Y);
+			OutParameters.EncodeScale = Proxy.InputValueScale;
+			OutParameters.EncodeBias = 0.0f;
+			OutParameters.ChannelCount = static_cast<uint32>(FMath::Max(Proxy.InputChannels, 1));
+			OutParameters.TensorOffset = BatchIndex * GetInputSliceSize(Proxy);
+			OutParameters.QuantizationScale = Proxy.InputQuantization.Scale;
+			OutParameters.QuantizationZeroPoint = Proxy.InputQuantization.ZeroPoint;
+			OutParameters.SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+
+			const bool bAreaFilter = UseEncodeAreaFilter(ViewRect, ModelResolution);
+
+			FPStyleTransferShaders::FEncodeCS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FTensorTypeDim>(GetTensorType(Proxy.InputDataType));
+			PermutationVector.Set<FPStyleTransferShaders::FEncodeCS::FAreaFilterDim>(bAreaFilter);
+			return TShaderMapRef<FPStyleTransferShaders::FEncodeCS>(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		}
+
+		/** Fills every decode parameter except the tensor and texture bindings and returns the shader to run. */
+		TShaderRef<FPStyleTransferShaders::FDecodeCS> SetupDecode(
+			const FStyleTransferProxy& Proxy,
+			uint32 BatchIndex,
+			FPStyleTransferShaders::FDecodeCS::FParameters& OutParameters)
+		{
+			OutParameters.ModelResolution = Proxy.OutputResolution;
+			OutParameters.DecodeScale = Proxy.OutputValueScale;
+			OutParameters.DecodeBias = 0.0f;
+			OutParameters.ChannelCount = static_cast<uint32>(FMath::Max(Proxy.OutputChannels, 1));
+			OutParameters.TensorOffset = BatchIndex * GetOutputSliceSize(Proxy);
+			OutParameters.QuantizationScale = Proxy.OutputQuantization.Scale;
+			OutParameters.QuantizationZeroPoint = Proxy.OutputQuantization.ZeroPoint;
+
+			FPStyleTransferShaders::FDecodeCS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FTensorTypeDim>(GetTensorType(Proxy.OutputDataType));
+			return TShaderMapRef<FPStyleTransferShaders::FDecodeCS>(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		}
+
+		TShaderRef<FPStyleTransferShaders::FUpscaleCS> GetUpscaleShader(bool bGuided, bool bTiled)
+		{
+			FPStyleTransferShaders::FUpscaleCS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FUpscaleCS::FGuidedDim>(bGuided);
+			PermutationVector.Set<FPStyleTransferShaders::FUpscaleCS::FTiledDim>(bTiled);
+			return TShaderMapRef<FPStyleTransferShaders::FUpscaleCS>(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		}
+
+		TShaderRef<FPStyleTransferShaders::FUpscalePS> GetRasterUpscaleShader(bool bGuided)
+		{
+			FPStyleTransferShaders::FUpscalePS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FUpscaleCS::FGuidedDim>(bGuided);
+			return TShaderMapRef<FPStyleTransferShaders::FUpscalePS>(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		}
+
+		/** Draws the upscale over TargetRect; a target fully covered by the rect is not loaded first. */
+		void AddRasterUpscaleDraw(
+			FRDGBuilder& GraphBuilder,
+			const TShaderRef<FPStyleTransferShaders::FUpscalePS>& Shader,
+			FPStyleTransferShaders::FUpscalePS::FParameters* Parameters,
+			FRDGTextureRef TargetTexture,
+			const FIntRect& TargetRect)
+		{
+			const bool bCoversTarget = TargetRect == FIntRect(FIntPoint::ZeroValue, TargetTexture->Desc.Extent);
+			Parameters->RenderTargets[0] = FRenderTargetBinding(TargetTexture, bCoversTarget ? ERenderTargetLoadAction::ENoAction : ERenderTargetLoadAction::ELoad);
+
+			FPixelShaderUtils::AddFullscreenPass(
+				GraphBuilder,
+				GetGlobalShaderMap(GMaxRHIFeatureLevel),
+				RDG_EVENT_NAME("StyleTransfer.UpScale (raster)"),
+				Shader,
+				Parameters,
+				TargetRect);
+		}
+
+		/**
+		 * Fills the guide parameters except the texture and returns true when the upscale is guided: GuideRect is not empty
+		 * and Filter is Guided, or Default with r.RealtimeStyleTransfer.Upscale.Guided set. The guide sampler is only bound
+		 * in that case.
+		 */
+		bool SetupGuide(const FIntRect& GuideRect, FIntPoint GuideExtent, FPStyleTransferShaders::FGuideParameters& OutParameters, EUpscaleFilter Filter = EUpscaleFilter::Default)
+		{
+			const bool bGuided = Filter == EUpscaleFilter::Default ? RealtimeStyleTransfer::UpscaleGuided > 0 : Filter == EUpscaleFilter::Guided;
+			if (GuideRect.Area() <= 0 || !bGuided)
+			{
+				return false;
+			}
+
+			const float SpatialSigma = FMath::Max(RealtimeStyleTransfer::UpscaleSpatialSigma, 0.1f);
+			const float RangeSigma = FMath::Max(RealtimeStyleTransfer::UpscaleRangeSigma, 0.001f);
+			OutParameters.GuideViewMin = FVector2f(GuideRect.Min.X, GuideRect.Min.Y);
+			OutParameters.GuideViewSize = FVector2f(GuideRect.Width(), GuideRect.Height());
+			OutParameters.GuideExtentInverse = FVector2f(1.0f / GuideExtent.X, 1.0f / GuideExtent.Y);
+			OutParameters.SpatialFalloff = 1.0f / (2.0f * SpatialSigma * SpatialSigma);
+			OutParameters.RangeFalloff = 1.0f / (2.0f * RangeSigma * RangeSigma);
+			OutParameters.GuideSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+			return true;
+		}
+
+		/**
+		 * Fills every upscale parameter except the source resolution and the texture bindings and returns the shader to run.
+		 * The upscale is guided as SetupGuide decides, reported in bOutGuided.
+		 */
+		TShaderRef<FPStyleTransferShaders::FUpscaleCS> SetupUpscale(
+			const FIntRect& TargetRect,
+			const FIntRect& GuideRect,
+			FIntPoint GuideExtent,
+			FPStyleTransferShaders::FUpscaleCS::FParameters& OutParameters,
+			bool& bOutGuided,
+			EUpscaleFilter Filter = EUpscaleFilter::Default)
+		{
+			OutParameters.TargetResolution = TargetRect.Size();
+			OutParameters.TargetOffset = TargetRect.Min;
+			OutParameters.SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+
+			bOutGuided = SetupGuide(GuideRect, GuideExtent, OutParameters.Guide, Filter);
+			return GetUpscaleShader(bOutGuided, false);
+		}
+
+		/** Plans handing Previous's output tensor to Next, which only needs a remap when value range or element type differ. */
+		FChainStagePlan SetupChainStage(const FStyleTransferProxy& Previous, const FStyleTransferProxyPtr& Next)
+		{
+			FChainStagePlan Stage;
+			Stage.Proxy = Next;
+			Stage.SourceTensorFormat = GetTensorFormat(Previous.OutputDataType);
+			Stage.InputTensorFormat = GetTensorFormat(Next->InputDataType);
+
+			const float RemapScale = Previous.OutputValueScale * Next->InputValueScale;
+			const bool bSameType = Previous.OutputDataType == Next->InputDataType;
+			const bool bSameQuantization = Previous.OutputQuantization.Scale == Next->InputQuantization.Scale
+				&& Previous.OutputQuantization.ZeroPoint == Next->InputQuantization.ZeroPoint;
+			const bool bQuantized = GetTensorType(Next->InputDataType) != FPStyleTransferShaders::ETensorType::Float;
+			if (bSameType && (!bQuantized || bSameQuantization) && FMath::IsNearlyEqual(RemapScale, 1.0f))
+			{
+				return Stage;
+			}
+
+			Stage.RemapParameters.Resolution = Next->InputResolution;
+			Stage.RemapParameters.ChannelCount = static_cast<uint32>(FMath::Max(Next->InputChannels, 1));
+			Stage.RemapParameters.RemapScale = RemapScale;
+			Stage.RemapParameters.SourceQuantizationScale = Previous.OutputQuantization.Scale;
+			Stage.RemapParameters.SourceQuantizationZeroPoint = Previous.OutputQuantization.ZeroPoint;
+			Stage.RemapParameters.TargetQuantizationScale = Next->InputQuantization.Scale;
+			Stage.RemapParameters.TargetQuantizationZeroPoint = Next->InputQuantization.ZeroPoint;
+			Stage.RemapGroupCount = MakeGroupCount(Next->InputResolution);
+
+			FPStyleTransferShaders::FTensorRemapCS::FPermutationDomain PermutationVector;
+			PermutationVector.Set<FPStyleTransferShaders::FTensorRemapCS::FSourceTensorTypeDim>(GetTensorType(Previous.OutputDataType));
+			PermutationVector.Set<FPStyleTransferShaders::FTensorRemapCS::FTargetTensorTypeDim>(GetTensorType(Next->InputDataType));
+			Stage.RemapShader = TShaderMapRef<FPStyleTransferShaders::FTensorRemapCS>(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+			return Stage;
+		}
+
+		FDispatchPlanSettings GetCurrentPlanSettings()
+		{
+			FDispatchPlanSettings Settings;
+			Settings.EncodeAreaFilter = RealtimeStyleTransfer::EncodeAreaFilter;
+			Settings.UpscaleGuided = RealtimeStyleTransfer::UpscaleGuided;
+			Settings.UpscaleSpatialSigma = RealtimeStyleTransfer::UpscaleSpatialSigma;
+			Settings.UpscaleRangeSigma = RealtimeStyleTransfer::UpscaleRangeSigma;
+			return Settings;
+		}
+	}
+
+	FIntVector MakeGroupCount(FIntPoint Resolution)
+	{
+		const int32 GroupSize = FPStyleTransferShaders::kThreadGroupSize;
+		return FIntVector(
+			FMath::DivideAndRoundUp(Resolution.X, GroupSize),
+			FMath::DivideAndRoundUp(Resolution.Y, GroupSize),
+			1);
+	}
+
+	bool UseEncodeAreaFilter(const FIntRect& ViewRect, FIntPoint ModelResolution)
+	{
+		return RealtimeStyleTransfer::EncodeAreaFilter > 0 && (ViewRect.Width() > ModelResolution.X || ViewRect.Height() > ModelResolution.Y);
+	}
+
+	FRDGBufferRef CreateInputTensor(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, uint32 BatchSize)
+	{
+		return CreateImageTensor(GraphBuilder, GetInputSliceSize(Proxy), Proxy.InputElementByteSize, BatchSize, TEXT("StyleTransfer.InputTensor"));
+	}
+
+	FRDGBufferRef CreateOutputTensor(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, uint32 BatchSize)
+	{
+		return CreateImageTensor(GraphBuilder, GetOutputSliceSize(Proxy), Proxy.OutputElementByteSize, BatchSize, TEXT("StyleTransfer.OutputTensor"));
+	}
+
+	int64 GetFrameResourceBytes(const FStyleTransferProxy& Proxy, uint32 BatchSize)
+	{
+		const int64 Batch = FMath::Max(BatchSize, 1u);
+		const int64 TexelBytes = GPixelFormats[PF_FloatRGBA].BlockBytes;
+
+		if (Proxy.ConvNet.IsValid())
+		{
+			return Proxy.ConvNet->GetActivationBytes(Proxy.InputResolution) + static_cast<int64>(Proxy.OutputResolution.X) * Proxy.OutputResolution.Y * TexelBytes;
+		}
+
+		int64 Bytes = static_cast<int64>(GetInputSliceSize(Proxy)) * Batch * Proxy.InputElementByteSize;
+		Bytes += static_cast<int64>(GetOutputSliceSize(Proxy)) * Batch * Proxy.OutputElementByteSize;
+		Bytes += static_cast<int64>(Proxy.OutputResolution.X) * Proxy.OutputResolution.Y * TexelBytes * Batch;
+		for (const FStyleTransferConditioningInput& Conditioning : Proxy.ConditioningInputs)
+		{
+			Bytes += FMath::Max<int64>(Conditioning.Shape.Volume(), 1) * Conditioning.ElementByteSize;
+		}
+		for (const uint64 AuxiliaryBytes : Proxy.AuxiliaryOutputBytes)
+		{
+			Bytes += static_cast<int64>(Align(AuxiliaryBytes, sizeof(uint32)));
+		}
+		return Bytes;
+	}
+
+	void AddEncodePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FRDGBufferRef InputTensor, uint32 BatchIndex)
+	{
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling encode pass: ModelResolution=%dx%d, ViewSize=%dx%d, BatchIndex=%u."),
+			Proxy.InputResolution.X,
+			Proxy.InputResolution.Y,
+			ViewRect.Width(),
+			ViewRect.Height(),
+			BatchIndex);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FEncodeCS::FParameters>();
+		const TShaderRef<FPStyleTransferShaders::FEncodeCS> Shader = SetupEncode(Proxy, ViewRect, SourceTexture->Desc.Extent, BatchIndex, *Parameters);
+		Parameters->SourceTexture = SourceTexture;
+		Parameters->OutputTensor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(InputTensor, GetTensorFormat(Proxy.InputDataType)));
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.Encode"),
+			Shader,
+			Parameters,
+			MakeGroupCount(Proxy.InputResolution));
+	}
+
+	void AddEncodePass(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FIntPoint Resolution, int32 Channels, float Scale, float Bias, FRDGBufferRef Tensor)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FEncodeCS::FParameters>();
+		Parameters->ModelResolution = Resolution;
+		Parameters->ViewMin = FVector2f(ViewRect.Min.X, ViewRect.Min.Y);
+		Parameters->ViewSize = FVector2f(ViewRect.Width(), ViewRect.Height());
+		Parameters->SourceExtent = FVector2f(SourceTexture->Desc.Extent.X, SourceTexture->Desc.Extent.Y);
+		Parameters->EncodeScale = EncodeScale * Scale;
+		Parameters->EncodeBias = Bias;
+		Parameters->ChannelCount = static_cast<uint32>(FMath::Max(Channels, 1));
+		Parameters->TensorOffset = 0;
+		Parameters->QuantizationScale = 1.0f;
+		Parameters->QuantizationZeroPoint = 0;
+		Parameters->SourceTexture = SourceTexture;
+		Parameters->SourceSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		Parameters->OutputTensor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Tensor, PF_R32_FLOAT));
+
+		FPStyleTransferShaders::FEncodeCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FPStyleTransferShaders::FTensorTypeDim>(FPStyleTransferShaders::ETensorType::Float);
+		PermutationVector.Set<FPStyleTransferShaders::FEncodeCS::FAreaFilterDim>(UseEncodeAreaFilter(ViewRect, Resolution));
+		TShaderMapRef<FPStyleTransferShaders::FEncodeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.Encode"),
+			Shader,
+			Parameters,
+			MakeGroupCount(Resolution));
+	}
+
+	bool SharesInput(const FStyleTransferProxy& A, const FStyleTransferProxy& B)
+	{
+		return !A.ConvNet.IsValid()
+			&& !B.ConvNet.IsValid()
+			&& A.InputResolution == B.InputResolution
+			&& A.InputChannels == B.InputChannels
+			&& A.InputDataType == B.InputDataType
+			&& A.InputQuantization.Scale == B.InputQuantization.Scale
+			&& A.InputQuantization.ZeroPoint == B.InputQuantization.ZeroPoint
+			&& A.InputValueScale == B.InputValueScale;
+	}
+
+	void AddCopyInputSlicePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGBufferRef SourceTensor, FRDGBufferRef TargetTensor, uint32 TargetBatchIndex)
+	{
+		const uint64 SliceBytes = static_cast<uint64>(GetInputSliceSize(Proxy)) * Proxy.InputElementByteSize;
+		AddCopyBufferPass(GraphBuilder, TargetTensor, SliceBytes * TargetBatchIndex, SourceTensor, 0, SliceBytes);
+	}
+
+	bool AddInferencePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, UE::NNE::IModelInstanceRDG& Instance, FRDGBufferRef InputTensor, FRDGBufferRef OutputTensor)
+	{
+		return AddInferencePass(GraphBuilder, Proxy, Instance, InputTensor, OutputTensor, MakeArrayView(&Proxy.StyleWeights, 1));
+	}
+
+	bool AddInferencePass(
+		FRDGBuilder& GraphBuilder,
+		const FStyleTransferProxy& Proxy,
+		UE::NNE::IModelInstanceRDG& Instance,
+		FRDGBufferRef InputTensor,
+		FRDGBufferRef OutputTensor,
+		TConstArrayView<TArray<float>> SliceWeights)
+	{
+		check(!SliceWeights.IsEmpty());
+
+		TArray<UE::NNE::FTensorBindingRDG> InputBindings;
+		TArray<UE::NNE::FTensorBindingRDG> OutputBindings;
+		InputBindings.Emplace_GetRef().Buffer = InputTensor;
+		OutputBindings.Emplace_GetRef().Buffer = OutputTensor;
+
+		for (const FStyleTransferConditioningInput& Conditioning : Proxy.ConditioningInputs)
+		{
+			InputBindings.Emplace_GetRef().Buffer = CreateConditioningTensor(GraphBuilder, Conditioning, SliceWeights);
+		}
+
+		for (const uint64 AuxiliaryBytes : Proxy.AuxiliaryOutputBytes)
+		{
+			OutputBindings.Emplace_GetRef().Buffer = GraphBuilder.CreateBuffer(
+				FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), FMath::DivideAndRoundUp<uint64>(AuxiliaryBytes, sizeof(uint32))),
+				TEXT("StyleTransfer.AuxiliaryOutput"));
+		}
+
+		RDG_GPU_STAT_SCOPE(GraphBuilder, StyleTransferNNE);
+		const UE::NNE::IModelInstanceRDG::EEnqueueRDGStatus Status = Instance.EnqueueRDG(GraphBuilder, InputBindings, OutputBindings);
+		if (Status != UE::NNE::IModelInstanceRDG::EEnqueueRDGStatus::Ok)
+		{
+			UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("Failed to enqueue NNE inference, status=%d"), static_cast<int32>(Status));
+			return false;
+		}
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("NNE inference enqueued successfully."));
+		return true;
+	}
+
+	FRDGTextureRef AddDecodePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGBufferRef OutputTensor, uint32 BatchIndex)
+	{
+		FRDGTextureRef StylizedTexture = GraphBuilder.CreateTexture(MakeStylizedDesc(Proxy), TEXT("StyleTransfer.StylizedLowRes"));
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling decode pass to texture %p."),
+			static_cast<const void*>(StylizedTexture));
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FDecodeCS::FParameters>();
+		const TShaderRef<FPStyleTransferShaders::FDecodeCS> Shader = SetupDecode(Proxy, BatchIndex, *Parameters);
+		Parameters->InputTensor = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(OutputTensor, GetTensorFormat(Proxy.OutputDataType)));
+		Parameters->StylizedOutput = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(StylizedTexture));
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.Decode"),
+			Shader,
+			Parameters,
+			MakeGroupCount(Proxy.OutputResolution));
+
+		return StylizedTexture;
+	}
+
+	void AddUpscalePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef StylizedTexture,
+		const FIntRect& TargetRect,
+		FRDGTextureRef TargetTexture,
+		FRDGTextureRef GuideTexture,
+		const FIntRect& GuideRect,
+		EUpscaleFilter Filter)
+	{
+		const bool bHasGuide = GuideTexture != nullptr && GuideRect.Area() > 0;
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscaleCS::FParameters>();
+		bool bGuided = false;
+		const TShaderRef<FPStyleTransferShaders::FUpscaleCS> Shader = SetupUpscale(
+			TargetRect,
+			bHasGuide ? GuideRect : FIntRect(),
+			bHasGuide ? GuideTexture->Desc.Extent : FIntPoint::ZeroValue,
+			*Parameters,
+			bGuided,
+			Filter);
+		Parameters->SourceResolution = StylizedTexture->Desc.Extent;
+		Parameters->SourceTexture = StylizedTexture;
+		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(TargetTexture));
+		if (bGuided)
+		{
+			Parameters->Guide.GuideTexture = GuideTexture;
+		}
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling %s upscale pass: %dx%d -> %dx%d."),
+			bGuided ? TEXT("guided") : TEXT("bilinear"),
+			Parameters->SourceResolution.X,
+			Parameters->SourceResolution.Y,
+			TargetRect.Width(),
+			TargetRect.Height());
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.UpScale"),
+			Shader,
+			Parameters,
+			MakeGroupCount(TargetRect.Size()));
+	}
+
+	void AddRasterUpscalePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef StylizedTexture,
+		const FIntRect& TargetRect,
+		FRDGTextureRef TargetTexture,
+		FRDGTextureRef GuideTexture,
+		const FIntRect& GuideRect,
+		EUpscaleFilter Filter)
+	{
+		const bool bHasGuide = GuideTexture != nullptr && GuideRect.Area() > 0;
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscalePS::FParameters>();
+		bool bGuided = false;
+		SetupUpscale(
+			TargetRect,
+			bHasGuide ? GuideRect : FIntRect(),
+			bHasGuide ? GuideTexture->Desc.Extent : FIntPoint::ZeroValue,
+			Parameters->Upscale,
+			bGuided,
+			Filter);
+		Parameters->Upscale.SourceResolution = StylizedTexture->Desc.Extent;
+		Parameters->Upscale.SourceTexture = StylizedTexture;
+		if (bGuided)
+		{
+			Parameters->Upscale.Guide.GuideTexture = GuideTexture;
+		}
+
+		AddRasterUpscaleDraw(GraphBuilder, GetRasterUpscaleShader(bGuided), Parameters, TargetTexture, TargetRect);
+	}
+
+	void AddFoveatedCompositePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef BackgroundTexture,
+		FRDGTextureRef FoveaTexture,
+		const FIntRect& ViewRect,
+		const FIntRect& FoveaRect,
+		float FeatherWidth,
+		FRDGTextureRef TargetTexture)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FFoveatedCompositeCS::FParameters>();
+		Parameters->TargetResolution = ViewRect.Size();
+		Parameters->TargetOffset = ViewRect.Min;
+		Parameters->FoveaMin = FVector2f(FoveaRect.Min.X, FoveaRect.Min.Y);
+		Parameters->FoveaSize = FVector2f(FoveaRect.Width(), FoveaRect.Height());
+		Parameters->FeatherWidth = FMath::Max(FeatherWidth, 1.0f);
+		Parameters->BackgroundTexture = BackgroundTexture;
+		Parameters->FoveaTexture = FoveaTexture;
+		Parameters->FoveaSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(TargetTexture));
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling foveated composite: fovea (%d,%d)-(%d,%d), feather %.1f px."),
+			FoveaRect.Min.X,
+			FoveaRect.Min.Y,
+			FoveaRect.Max.X,
+			FoveaRect.Max.Y,
+			FeatherWidth);
+
+		TShaderMapRef<FPStyleTransferShaders::FFoveatedCompositeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.FoveatedComposite"),
+			Shader,
+			Parameters,
+			MakeGroupCount(ViewRect.Size()));
+	}
+
+	bool FDispatchPlanSettings::operator==(const FDispatchPlanSettings& Other) const
+	{
+		return EncodeAreaFilter == Other.EncodeAreaFilter
+			&& UpscaleGuided == Other.UpscaleGuided
+			&& UpscaleSpatialSigma == Other.UpscaleSpatialSigma
+			&& UpscaleRangeSigma == Other.UpscaleRangeSigma;
+	}
+
+	bool CanChain(const FStyleTransferProxy& Previous, const FStyleTransferProxy& Next)
+	{
+		return !Previous.ConvNet.IsValid()
+			&& !Next.ConvNet.IsValid()
+			&& Next.ModelInstance.IsValid()
+			&& Previous.OutputChannels == Next.InputChannels
+			&& Previous.OutputResolution == Next.InputResolution;
+	}
+
+	TSharedRef<const FDispatchPlan> CreateDispatchPlan(const FStyleTransferProxyPtr& Proxy, const FIntRect& Rect, FIntPoint SourceExtent, TConstArrayView<FStyleTransferProxyPtr> Stages)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_StyleTransfer_CreateDispatchPlan);
+		check(Proxy.IsValid());
+
+		TSharedRef<FDispatchPlan> Plan = MakeShared<FDispatchPlan>();
+		Plan->Proxy = Proxy;
+		Plan->Rect = Rect;
+		Plan->SourceExtent = SourceExtent;
+		Plan->Settings = GetCurrentPlanSettings();
+
+		// The built-in executor schedules its own layers; only the upscale is planned for it.
+		const FStyleTransferProxy* DecodedProxy = Proxy.Get();
+		if (!Proxy->ConvNet.IsValid())
+		{
+			for (const FStyleTransferProxyPtr& Stage : Stages)
+			{
+				check(Stage.IsValid() && CanChain(*DecodedProxy, *Stage));
+				Plan->Stages.Add(SetupChainStage(*DecodedProxy, Stage));
+				DecodedProxy = Stage.Get();
+			}
+
+			Plan->EncodeShader = SetupEncode(*Proxy, Rect, SourceExtent, 0, Plan->EncodeParameters);
+			Plan->DecodeShader = SetupDecode(*DecodedProxy, 0, Plan->DecodeParameters);
+			Plan->StylizedDesc = MakeStylizedDesc(*DecodedProxy);
+			Plan->ModelGroupCount = MakeGroupCount(Proxy->InputResolution);
+			Plan->DecodeGroupCount = MakeGroupCount(DecodedProxy->OutputResolution);
+			Plan->InputTensorFormat = GetTensorFormat(Proxy->InputDataType);
+			Plan->OutputTensorFormat = GetTensorFormat(DecodedProxy->OutputDataType);
+		}
+
+		// A stylized image that already has the rect's size (e.g. from a super-resolution stage) is copied, not filtered.
+		const bool bFullResolution = DecodedProxy->OutputResolution == Rect.Size();
+		Plan->UpscaleShader = SetupUpscale(Rect, bFullResolution ? FIntRect() : Rect, SourceExtent, Plan->UpscaleParameters, Plan->bGuided);
+		Plan->TiledUpscaleShader = GetUpscaleShader(Plan->bGuided, true);
+		Plan->RasterUpscaleShader = GetRasterUpscaleShader(Plan->bGuided);
+		Plan->UpscaleGroupCount = MakeGroupCount(Rect.Size());
+
+		UE_LOG(LogRealtimeStyleTransfer, Verbose, TEXT("Created dispatch plan: model %dx%d, %d chain stage(s) to %dx%d, rect (%d,%d)-(%d,%d), source %dx%d."),
+			Proxy->InputResolution.X,
+			Proxy->InputResolution.Y,
+			Plan->Stages.Num(),
+			DecodedProxy->OutputResolution.X,
+			DecodedProxy->OutputResolution.Y,
+			Rect.Min.X,
+			Rect.Min.Y,
+			Rect.Max.X,
+			Rect.Max.Y,
+			SourceExtent.X,
+			SourceExtent.Y);
+
+		return Plan;
+	}
+
+	bool FDispatchPlan::IsCurrent(const FStyleTransferProxyPtr& InProxy, const FIntRect& InRect, FIntPoint InSourceExtent, TConstArrayView<FStyleTransferProxyPtr> InStages) const
+	{
+		if (Stages.Num() != (InProxy.IsValid() && InProxy->ConvNet.IsValid() ? 0 : InStages.Num()))
+		{
+			return false;
+		}
+		for (int32 StageIndex = 0; StageIndex < Stages.Num(); ++StageIndex)
+		{
+			if (!Stages[StageIndex].Proxy.HasSameObject(InStages[StageIndex].Get()))
+			{
+				return false;
+			}
+		}
+
+		return InProxy.IsValid()
+			&& Proxy.HasSameObject(InProxy.Get())
+			&& Rect == InRect
+			&& SourceExtent == InSourceExtent
+			&& Settings == GetCurrentPlanSettings();
+	}
+
+	void AddEncodePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef SourceTexture, FRDGBufferRef InputTensor)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FEncodeCS::FParameters>();
+		*Parameters = Plan.EncodeParameters;
+		Parameters->SourceTexture = SourceTexture;
+		Parameters->OutputTensor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(InputTensor, Plan.InputTensorFormat));
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("StyleTransfer.Encode"), Plan.EncodeShader, Parameters, Plan.ModelGroupCount);
+	}
+
+	FRDGTextureRef AddDecodePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGBufferRef OutputTensor)
+	{
+		FRDGTextureRef StylizedTexture = GraphBuilder.CreateTexture(Plan.StylizedDesc, TEXT("StyleTransfer.StylizedLowRes"));
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FDecodeCS::FParameters>();
+		*Parameters = Plan.DecodeParameters;
+		Parameters->InputTensor = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(OutputTensor, Plan.OutputTensorFormat));
+		Parameters->StylizedOutput = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(StylizedTexture));
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("StyleTransfer.Decode"), Plan.DecodeShader, Parameters, Plan.DecodeGroupCount);
+		return StylizedTexture;
+	}
+
+	FRDGBufferRef AddChainPasses(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGBufferRef OutputTensor)
+	{
+		FRDGBufferRef StageOutput = OutputTensor;
+		for (int32 StageIndex = 0; StageIndex < Plan.Stages.Num(); ++StageIndex)
+		{
+			const FChainStagePlan& Stage = Plan.Stages[StageIndex];
+			const FStyleTransferProxyPtr Proxy = Stage.Proxy.Pin();
+			if (!Proxy.IsValid())
+			{
+				return nullptr;
+			}
+
+			RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.ChainStage %d (%s)", StageIndex, *Proxy->ModelName);
+
+			FRDGBufferRef StageInput = StageOutput;
+			if (Stage.RemapShader.IsValid())
+			{
+				StageInput = CreateInputTensor(GraphBuilder, *Proxy, 1);
+
+				auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FTensorRemapCS::FParameters>();
+				*Parameters = Stage.RemapParameters;
+				Parameters->SourceTensor = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(StageOutput, Stage.SourceTensorFormat));
+				Parameters->TargetTensor = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(StageInput, Stage.InputTensorFormat));
+
+				FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("StyleTransfer.TensorRemap"), Stage.RemapShader, Parameters, Stage.RemapGroupCount);
+			}
+
+			StageOutput = CreateOutputTensor(GraphBuilder, *Proxy, 1);
+			if (!AddInferencePass(GraphBuilder, *Proxy, *Proxy->ModelInstance, StageInput, StageOutput))
+			{
+				return nullptr;
+			}
+		}
+		return StageOutput;
+	}
+
+	void AddUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscaleCS::FParameters>();
+		*Parameters = Plan.UpscaleParameters;
+		Parameters->SourceResolution = StylizedTexture->Desc.Extent;
+		Parameters->SourceTexture = StylizedTexture;
+		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(TargetTexture));
+		if (Plan.bGuided)
+		{
+			Parameters->Guide.GuideTexture = GuideTexture;
+		}
+
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("StyleTransfer.UpScale"), Plan.UpscaleShader, Parameters, Plan.UpscaleGroupCount);
+	}
+
+	void AddRasterUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture)
+	{
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscalePS::FParameters>();
+		Parameters->Upscale = Plan.UpscaleParameters;
+		Parameters->Upscale.SourceResolution = StylizedTexture->Desc.Extent;
+		Parameters->Upscale.SourceTexture = StylizedTexture;
+		if (Plan.bGuided)
+		{
+			Parameters->Upscale.Guide.GuideTexture = GuideTexture;
+		}
+
+		AddRasterUpscaleDraw(GraphBuilder, Plan.RasterUpscaleShader, Parameters, TargetTexture, Plan.Rect);
+	}
+
+	bool UseRasterComposite()
+	{
+		return RealtimeStyleTransfer::CompositeRaster > 0;
+	}
+
+	FTileClassification AddTileClassificationPass(FRDGBuilder& GraphBuilder, const FIntRect& Rect, const FMaskInputs& MaskInputs)
+	{
+		const FIntVector GroupCount = MakeGroupCount(Rect.Size());
+
+		FTileClassification Tiles;
+		Tiles.Rect = Rect;
+		Tiles.IndirectArgs = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateIndirectDesc(FPStyleTransferShaders::kTileIndirectArgsCount),
+			TEXT("StyleTransfer.TileIndirectArgs"));
+		Tiles.TileList = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), FMath::Max(GroupCount.X * GroupCount.Y, 1)),
+			TEXT("StyleTransfer.TileList"));
+
+		SetupMask(GraphBuilder, MaskInputs, Tiles.Mask);
+		const FPStyleTransferShaders::FMaskParameters& Mask = Tiles.Mask;
+		const int32 RectCount = static_cast<int32>(Mask.MaskRectCount);
+
+		FRDGBufferUAVRef IndirectArgsUAV = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Tiles.IndirectArgs, PF_R32_UINT));
+		AddClearUAVPass(GraphBuilder, IndirectArgsUAV, 0u);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FTileClassifyCS::FParameters>();
+		Parameters->TargetResolution = Rect.Size();
+		Parameters->Mask = Mask;
+		Parameters->TileIndirectArgs = IndirectArgsUAV;
+		Parameters->TileListOutput = GraphBuilder.CreateUAV(FRDGBufferUAVDesc(Tiles.TileList, PF_R32_UINT));
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling tile classification: %dx%d tiles, %d rect(s), stencil 0x%x, sky %.0f cm."),
+			GroupCount.X,
+			GroupCount.Y,
+			RectCount,
+			Mask.MaskStencilBits,
+			Mask.MaskSkyDistance);
+
+		TShaderMapRef<FPStyleTransferShaders::FTileClassifyCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("StyleTransfer.TileClassify"), Shader, Parameters, GroupCount);
+		return Tiles;
+	}
+
+	void AddTiledUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, const FTileClassification& Tiles, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture)
+	{
+		check(Tiles.Rect == Plan.Rect);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FUpscaleCS::FParameters>();
+		*Parameters = Plan.UpscaleParameters;
+		Parameters->SourceResolution = StylizedTexture->Desc.Extent;
+		Parameters->SourceTexture = StylizedTexture;
+		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(TargetTexture));
+		if (Plan.bGuided)
+		{
+			Parameters->Guide.GuideTexture = GuideTexture;
+		}
+		Parameters->Mask = Tiles.Mask;
+		Parameters->TileList = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Tiles.TileList, PF_R32_UINT));
+		Parameters->OriginalTexture = GuideTexture;
+		Parameters->TileIndirectArgs = Tiles.IndirectArgs;
+
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.UpScale (tiled)"),
+			Plan.TiledUpscaleShader,
+			Parameters,
+			Tiles.IndirectArgs,
+			FPStyleTransferShaders::kTileDispatchArgsOffset);
+	}
+
+	void AddTileCopyPass(FRDGBuilder& GraphBuilder, const FTileClassification& Tiles, FRDGTextureRef SourceTexture, FRDGTextureRef TargetTexture)
+	{
+		const FIntPoint TargetExtent = TargetTexture->Desc.Extent;
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FTileCopyParameters>();
+		Parameters->TargetResolution = Tiles.Rect.Size();
+		Parameters->TargetOffset = Tiles.Rect.Min;
+		Parameters->TargetExtentInverse = FVector2f(1.0f / TargetExtent.X, 1.0f / TargetExtent.Y);
+		Parameters->TileList = GraphBuilder.CreateSRV(FRDGBufferSRVDesc(Tiles.TileList, PF_R32_UINT));
+		Parameters->CopySourceTexture = SourceTexture;
+		Parameters->TileIndirectArgs = Tiles.IndirectArgs;
+		Parameters->RenderTargets[0] = FRenderTargetBinding(TargetTexture, ERenderTargetLoadAction::ELoad);
+
+		const TShaderMapRef<FPStyleTransferShaders::FTileCopyVS> VertexShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+		const TShaderMapRef<FPStyleTransferShaders::FTileCopyPS> PixelShader(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+
+		// Unlisted tiles are left alone, so masked regions of TargetTexture cost no bandwidth.
+		GraphBuilder.AddPass(
+			RDG_EVENT_NAME("StyleTransfer.TileCopy"),
+			Parameters,
+			ERDGPassFlags::Raster,
+			[Parameters, VertexShader, PixelShader, TargetExtent](FRHICommandList& RHICmdList)
+			{
+				RHICmdList.SetViewport(0.0f, 0.0f, 0.0f, TargetExtent.X, TargetExtent.Y, 1.0f);
+
+				FGraphicsPipelineStateInitializer GraphicsPSOInit;
+				RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
+				GraphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
+				GraphicsPSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+				GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+				GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+				GraphicsPSOInit.BoundShaderState.VertexShaderRHI = VertexShader.GetVertexShader();
+				GraphicsPSOInit.BoundShaderState.PixelShaderRHI = PixelShader.GetPixelShader();
+				GraphicsPSOInit.PrimitiveType = PT_TriangleList;
+				SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit, 0);
+
+				SetShaderParameters(RHICmdList, VertexShader, VertexShader.GetVertexShader(), *Parameters);
+				SetShaderParameters(RHICmdList, PixelShader, PixelShader.GetPixelShader(), *Parameters);
+
+				Parameters->TileIndirectArgs->MarkResourceAsUsed();
+				RHICmdList.DrawPrimitiveIndirect(Parameters->TileIndirectArgs->GetIndirectRHICallBuffer(), FPStyleTransferShaders::kTileDrawArgsOffset);
+			});
+	}
+
+	void AddStencilCompositePass(
+		FRDGBuilder& GraphBuilder,
+		const FIntRect& ViewRect,
+		const FMaskInputs& MaskInputs,
+		bool bApplyMask,
+		TConstArrayView<uint8> StencilLayers,
+		TConstArrayView<FRDGTextureRef> LayerTextures,
+		FRDGTextureRef OriginalTexture,
+		FRDGTextureRef TargetTexture)
+	{
+		check(MaskInputs.CustomStencil);
+		check(StencilLayers.Num() == 256 && LayerTextures.Num() <= FPStyleTransferShaders::kMaxStencilStyles);
+
+		auto* Parameters = GraphBuilder.AllocParameters<FPStyleTransferShaders::FStencilCompositeCS::FParameters>();
+		Parameters->TargetResolution = ViewRect.Size();
+		Parameters->TargetOffset = ViewRect.Min;
+		Parameters->StencilViewMin = FVector2f(MaskInputs.SceneViewRect.Min.X, MaskInputs.SceneViewRect.Min.Y);
+		Parameters->StencilViewSize = FVector2f(MaskInputs.SceneViewRect.Width(), MaskInputs.SceneViewRect.Height());
+		uint32 Packed[64] = {};
+		for (int32 Stencil = 0; Stencil < StencilLayers.Num(); ++Stencil)
+		{
+			Packed[Stencil >> 2] |= static_cast<uint32>(StencilLayers[Stencil]) << ((Stencil & 3) * 8);
+		}
+		for (int32 Index = 0; Index < 16; ++Index)
+		{
+			Parameters->StencilLayers[Index] = FUintVector4(Packed[Index * 4], Packed[Index * 4 + 1], Packed[Index * 4 + 2], Packed[Index * 4 + 3]);
+		}
+		SetupMask(GraphBuilder, bApplyMask ? MaskInputs : FMaskInputs(), Parameters->Mask);
+		Parameters->StencilTexture = MaskInputs.CustomStencil;
+
+		// Unused slots are never sampled; they only need a valid binding.
+		FRDGTextureRef* const Slots[] = { &Parameters->LayerTexture0, &Parameters->LayerTexture1, &Parameters->LayerTexture2, &Parameters->LayerTexture3 };
+		static_assert(UE_ARRAY_COUNT(Slots) == FPStyleTransferShaders::kMaxStencilStyles);
+		for (int32 Slot = 0; Slot < UE_ARRAY_COUNT(Slots); ++Slot)
+		{
+			*Slots[Slot] = LayerTextures.IsValidIndex(Slot) ? LayerTextures[Slot] : GSystemTextures.GetBlackDummy(GraphBuilder);
+		}
+		Parameters->LayerSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+		Parameters->OriginalTexture = OriginalTexture;
+		Parameters->TargetTexture = GraphBuilder.CreateUAV(FRDGTextureUAVDesc(TargetTexture));
+
+		// The layers were encoded from ViewRect of the original frame, which guides them as the active style is guided.
+		const bool bGuided = SetupGuide(ViewRect, OriginalTexture->Desc.Extent, Parameters->Guide);
+		if (bGuided)
+		{
+			Parameters->Guide.GuideTexture = OriginalTexture;
+		}
+
+		UE_LOG(LogRealtimeStyleTransfer, VeryVerbose, TEXT("Scheduling stencil composite: %d stencil style texture(s), %s."),
+			LayerTextures.Num(),
+			bGuided ? TEXT("guided") : TEXT("bilinear"));
+
+		FPStyleTransferShaders::FStencilCompositeCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FPStyleTransferShaders::FUpscaleCS::FGuidedDim>(bGuided);
+		TShaderMapRef<FPStyleTransferShaders::FStencilCompositeCS> Shader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+		FComputeShaderUtils::AddPass(
+			GraphBuilder,
+			RDG_EVENT_NAME("StyleTransfer.StencilComposite"),
+			Shader,
+			Parameters,
+			MakeGroupCount(ViewRect.Size()));
+	}
+}
+
+namespace RealtimeStyleTransfer
+{
+	/**
+	 * Times the compute and raster composites at 1080p, 1440p and 4K as the view extension runs them, with the bilinear
+	 * and the guided upscale: compute writes a UAV output and copies it back into scene color, raster draws a render
+	 * target that replaces scene color.
+	 */
+	static void BenchmarkComposite(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 20;
+
+		ENQUEUE_RENDER_COMMAND(BenchmarkStyleTransferComposite)(
+			[Iterations](FRHICommandListImmediate& RHICmdList)
+			{
+				const FIntPoint Resolutions[] = { FIntPoint(1920, 1080), FIntPoint(2560, 1440), FIntPoint(3840, 2160) };
+				FRenderQueryPoolRHIRef QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+
+				// Runs Iterations composites of one path and filter in a graph of their own and returns the average GPU time.
+				auto TimeComposite = [&RHICmdList, &QueryPool, Iterations](FIntPoint Resolution, bool bRaster, StyleTransferPasses::EUpscaleFilter Filter)
+				{
+					FRHIPooledRenderQuery StartQuery = QueryPool->AllocateQuery();
+					FRHIPooledRenderQuery EndQuery = QueryPool->AllocateQuery();
+					TArray<TRefCountPtr<IPooledRenderTarget>> ExtractedOutputs;
+					ExtractedOutputs.SetNum(Iterations);
+					{
+						FRDGBuilder GraphBuilder(RHICmdList);
+						const FIntRect ViewRect(FIntPoint::ZeroValue, Resolution);
+
+						FRDGTextureRef SceneColor = GraphBuilder.CreateTexture(
+							FRDGTextureDesc::Create2D(Resolution, PF_B8G8R8A8, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_RenderTargetable),
+							TEXT("StyleTransfer.BenchmarkSceneColor"));
+						FRDGTextureRef StylizedTexture = GraphBuilder.CreateTexture(
+							FRDGTextureDesc::Create2D(Resolution / 2, PF_FloatRGBA, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_RenderTargetable),
+							TEXT("StyleTransfer.BenchmarkStylized"));
+						AddClearRenderTargetPass(GraphBuilder, SceneColor, FLinearColor(0.2f, 0.4f, 0.6f));
+						AddClearRenderTargetPass(GraphBuilder, StylizedTexture, FLinearColor(0.6f, 0.4f, 0.2f));
+
+						GraphBuilder.AddPass(RDG_EVENT_NAME("StyleTransfer.BenchmarkStart"), ERDGPassFlags::NeverCull,
+							[Query = StartQuery.GetQuery()](FRHICommandListImmediate& InRHICmdList)
+							{
+								InRHICmdList.EndRenderQuery(Query);
+							});
+
+						FRDGTextureDesc OutputDesc = SceneColor->Desc;
+						if (bRaster)
+						{
+							OutputDesc.Flags &= ~TexCreate_UAV;
+						}
+						else
+						{
+							OutputDesc.Flags |= TexCreate_UAV;
+						}
+
+						FRDGTextureRef OutputTexture = nullptr;
+						for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+						{
+							OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("StyleTransfer.Output"));
+							if (bRaster)
+							{
+								StyleTransferPasses::AddRasterUpscalePass(GraphBuilder, StylizedTexture, ViewRect, OutputTexture, SceneColor, ViewRect, Filter);
+							}
+							else
+							{
+								StyleTransferPasses::AddUpscalePass(GraphBuilder, StylizedTexture, ViewRect, OutputTexture, SceneColor, ViewRect, Filter);
+								AddCopyTexturePass(GraphBuilder, OutputTexture, SceneColor);
+								OutputTexture = SceneColor;
+							}
+							// Keeps every iteration's output alive so none of the passes is culled.
+							GraphBuilder.QueueTextureExtraction(OutputTexture, &ExtractedOutputs[Iteration]);
+						}
+
+						GraphBuilder.AddPass(RDG_EVENT_NAME("StyleTransfer.BenchmarkEnd"), ERDGPassFlags::NeverCull,
+							[Query = EndQuery.GetQuery()](FRHICommandListImmediate& InRHICmdList)
+							{
+								InRHICmdList.EndRenderQuery(Query);
+							});
+
+						GraphBuilder.Execute();
+					}
+
+					RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThreadFlushResources);
+
+					uint64 StartMicroseconds = 0;
+					uint64 EndMicroseconds = 0;
+					if (!RHIGetRenderQueryResult(StartQuery.GetQuery(), StartMicroseconds, true)
+						|| !RHIGetRenderQueryResult(EndQuery.GetQuery(), EndMicroseconds, true))
+					{
+						return -1.0;
+					}
+					return (EndMicroseconds - StartMicroseconds) / 1000.0 / Iterations;
+				};
+
+				UE_LOG(LogRealtimeStyleTransfer, Display, TEXT("Composite benchmark (upscale from half resolution, %d iterations, r.RealtimeStyleTransfer.Composite.Raster currently picks %s, Upscale.Guided %s):"),
+					Iterations,
+					StyleTransferPasses::UseRasterComposite() ? TEXT("raster") : TEXT("compute"),
+					UpscaleGuided > 0 ? TEXT("on") : TEXT("off"));
+
+				using StyleTransferPasses::EUpscaleFilter;
+				const EUpscaleFilter Filters[] = { EUpscaleFilter::Bilinear, EUpscaleFilter::Guided };
+				// Summed over the resolutions, indexed by [raster][guided].
+				double TotalMs[2][2] = {};
+				for (const FIntPoint& Resolution : Resolutions)
+				{
+					double Ms[2][2] = {};
+					for (int32 FilterIndex = 0; FilterIndex < 2; ++FilterIndex)
+					{
+						// The first run of each path warms up shaders and the render target pool.
+						TimeComposite(Resolution, false, Filters[FilterIndex]);
+						TimeComposite(Resolution, true, Filters[FilterIndex]);
+
+						Ms[0][FilterIndex] = TimeComposite(Resolution, false, Filters[FilterIndex]);
+						Ms[1][FilterIndex] = TimeComposite(Resolution, true, Filters[FilterIndex]);
+						if (Ms[0][FilterIndex] < 0.0 || Ms[1][FilterIndex] < 0.0)
+						{
+							UE_LOG(LogRealtimeStyleTransfer, Warning, TEXT("GPU timestamps are unavailable on this RHI; composite benchmark aborted."));
+							return;
+						}
+
+						UE_LOG(LogRealtimeStyleTransfer, Display, TEXT("  %dx%d %s: compute + copy %.3f ms, raster %.3f ms (%.2fx)."),
+							Resolution.X,
+							Resolution.Y,
+							FilterIndex ? TEXT("guided") : TEXT("bilinear"),
+							Ms[0][FilterIndex],
+							Ms[1][FilterIndex],
+							Ms[0][FilterIndex] / FMath::Max(Ms[1][FilterIndex], UE_SMALL_NUMBER));
+					}
+
+					for (int32 Path = 0; Path < 2; ++Path)
+					{
+						TotalMs[Path][0] += Ms[Path][0];
+						TotalMs[Path][1] += Ms[Path][1];
+					}
+				}
+
+				// The path is picked for the filter the project runs now; the guided cost is only recorded, the filter stays
+				// the project's choice.
+				const int32 Guided = UpscaleGuided > 0 ? 1 : 0;
+				const int32 Raster = TotalMs[1][Guided] < TotalMs[0][Guided] ? 1 : 0;
+
+				// Ready to paste into the platform's config, so every committed value comes with the numbers it was picked from.
+				UE_LOG(LogRealtimeStyleTransfer, Display, TEXT("For Config/%s/%sEngine.ini on %s (%s):\n[SystemSettings]\n; StyleTransfer.BenchmarkComposite: compute + copy %.3f ms, raster %.3f ms summed over 1080p, 1440p and 4K (%s upscale)\n; guided upscale %.3f ms, bilinear %.3f ms on the picked path\nr.RealtimeStyleTransfer.Composite.Raster=%d"),
+					FPlatformProperties::IniPlatformName(),
+					FPlatformProperties::IniPlatformName(),
+					*GRHIAdapterName,
+					GDynamicRHI ? GDynamicRHI->GetName() : TEXT("Unknown"),
+					TotalMs[0][Guided],
+					TotalMs[1][Guided],
+					Guided ? TEXT("guided") : TEXT("bilinear"),
+					TotalMs[Raster][1],
+					TotalMs[Raster][0],
+					Raster);
+			});
+	}
+
+	static FAutoConsoleCommand BenchmarkCompositeCommand(
+		TEXT("StyleTransfer.BenchmarkComposite"),
+		TEXT("Times the compute (UAV) and raster (pixel shader) composites, bilinear and guided, at 1080p, 1440p and 4K on the GPU.\n")
+		TEXT("Usage: StyleTransfer.BenchmarkComposite [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkComposite));
+}
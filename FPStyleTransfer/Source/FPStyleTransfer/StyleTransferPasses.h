@@ -0,0 +1,250 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphDefinitions.h"
+#include "Stats/Stats.h"
+#include "MyNeuralNetwork.h"
+#include "StyleTransferShaders.h"
+
+DECLARE_STATS_GROUP(TEXT("StyleTransfer"), STATGROUP_StyleTransfer, STATCAT_Advanced);
+
+/** RDG building blocks shared by the view extension and the render target service. */
+namespace StyleTransferPasses
+{
+	/** Scene color (0..1) to model input, and model output to scene color. Models are trained on 0..255 outputs. */
+	constexpr float EncodeScale = 1.0f;
+	constexpr float DecodeScale = 1.0f / 255.0f;
+
+	FIntVector MakeGroupCount(FIntPoint Resolution);
+
+	/** True when r.RealtimeStyleTransfer.Encode.AreaFilter is on and ViewRect is larger than ModelResolution along either axis. */
+	bool UseEncodeAreaFilter(const FIntRect& ViewRect, FIntPoint ModelResolution);
+
+	/** Filter of the upscale passes; Default follows r.RealtimeStyleTransfer.Upscale.Guided. Guided still needs a guide. */
+	enum class EUpscaleFilter : uint8
+	{
+		Default,
+		Bilinear,
+		Guided,
+	};
+
+	/** Render cvars a dispatch plan was built with. */
+	struct FDispatchPlanSettings
+	{
+		int32 EncodeAreaFilter = 0;
+		int32 UpscaleGuided = 0;
+		float UpscaleSpatialSigma = 0.0f;
+		float UpscaleRangeSigma = 0.0f;
+
+		bool operator==(const FDispatchPlanSettings& Other) const;
+	};
+
+	/** How AddChainPasses hands the previous stage's output tensor to one chain stage. */
+	struct FChainStagePlan
+	{
+		TWeakPtr<FStyleTransferProxy, ESPMode::ThreadSafe> Proxy;
+		/** Set when the previous output needs rescaling or another element type; otherwise it is bound as the stage's input directly. */
+		TShaderRef<FPStyleTransferShaders::FTensorRemapCS> RemapShader;
+		FPStyleTransferShaders::FTensorRemapCS::FParameters RemapParameters;
+		FIntVector RemapGroupCount = FIntVector::ZeroValue;
+		EPixelFormat SourceTensorFormat = PF_R32_FLOAT;
+		EPixelFormat InputTensorFormat = PF_R32_FLOAT;
+	};
+
+	/**
+	 * Everything the encode, decode and upscale passes of one proxy need that only changes with the style, the stylized
+	 * rect or the render cvars: shaders, constant parameters, group counts and formats. Immutable once built; each
+	 * frame only binds textures and buffers. Conv-net proxies only get the upscale part. With chain stages, the decode
+	 * reads the last stage's output.
+	 */
+	struct FDispatchPlan
+	{
+		TWeakPtr<FStyleTransferProxy, ESPMode::ThreadSafe> Proxy;
+		FIntRect Rect;
+		FIntPoint SourceExtent = FIntPoint::ZeroValue;
+		FDispatchPlanSettings Settings;
+
+		TShaderRef<FPStyleTransferShaders::FEncodeCS> EncodeShader;
+		FPStyleTransferShaders::FEncodeCS::FParameters EncodeParameters;
+		TShaderRef<FPStyleTransferShaders::FDecodeCS> DecodeShader;
+		FPStyleTransferShaders::FDecodeCS::FParameters DecodeParameters;
+		FRDGTextureDesc StylizedDesc;
+		FIntVector ModelGroupCount = FIntVector::ZeroValue;
+		FIntVector DecodeGroupCount = FIntVector::ZeroValue;
+		EPixelFormat InputTensorFormat = PF_R32_FLOAT;
+		EPixelFormat OutputTensorFormat = PF_R32_FLOAT;
+
+		TShaderRef<FPStyleTransferShaders::FUpscaleCS> UpscaleShader;
+		/** UpscaleShader's tiled permutation, used with a tile classification. */
+		TShaderRef<FPStyleTransferShaders::FUpscaleCS> TiledUpscaleShader;
+		/** UpscaleShader as a pixel shader, used when UseRasterComposite. */
+		TShaderRef<FPStyleTransferShaders::FUpscalePS> RasterUpscaleShader;
+		FPStyleTransferShaders::FUpscaleCS::FParameters UpscaleParameters;
+		FIntVector UpscaleGroupCount = FIntVector::ZeroValue;
+		/** True when the upscale shaders are the guided permutations, which bind the frame as the guide texture. */
+		bool bGuided = false;
+
+		/** Models run on the output tensor, in order, before the decode. */
+		TArray<FChainStagePlan> Stages;
+
+		/** True while the plan still matches the proxy and chain, the rect of SourceExtent being stylized and the current cvars. */
+		bool IsCurrent(const FStyleTransferProxyPtr& InProxy, const FIntRect& InRect, FIntPoint InSourceExtent, TConstArrayView<FStyleTransferProxyPtr> InStages = {}) const;
+	};
+
+	/**
+	 * Builds the plan for stylizing Rect of a SourceExtent texture with Proxy and upscaling back into the same rect.
+	 * Stages must each take the previous model's output shape (see CanChain). Render thread only.
+	 */
+	TSharedRef<const FDispatchPlan> CreateDispatchPlan(const FStyleTransferProxyPtr& Proxy, const FIntRect& Rect, FIntPoint SourceExtent, TConstArrayView<FStyleTransferProxyPtr> Stages = {});
+
+	/** True when Next's image input takes Previous's image output as is: same channels and resolution, and neither is a conv net. */
+	bool CanChain(const FStyleTransferProxy& Previous, const FStyleTransferProxy& Next);
+
+	/** AddEncodePass, AddDecodePass and AddUpscalePass for the plan's proxy and rect (batch slice 0, guided by SourceTexture). */
+	void AddEncodePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef SourceTexture, FRDGBufferRef InputTensor);
+	FRDGTextureRef AddDecodePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGBufferRef OutputTensor);
+
+	/**
+	 * Runs the plan's chain stages on the style model's OutputTensor, remapping between stages where their value ranges or
+	 * element types differ. Returns the last stage's output tensor (OutputTensor without stages), or null if a stage failed.
+	 */
+	FRDGBufferRef AddChainPasses(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGBufferRef OutputTensor);
+	void AddUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture);
+
+	/** Scene textures and HUD rects r.RealtimeStyleTransfer.Mask is built from. */
+	struct FMaskInputs
+	{
+		/** Custom stencil and depth of the view; null when the renderer has none, which disables their part of the mask. */
+		FRDGTextureSRVRef CustomStencil = nullptr;
+		FRDGTextureRef SceneDepth = nullptr;
+		/** The view in the scene textures. They stay at render resolution when the stylized view has been upscaled. */
+		FIntRect SceneViewRect;
+		FVector4f InvDeviceZToWorldZ = FVector4f::Zero();
+		/** Normalized view rects (min x, min y, max x, max y) that keep the original frame, e.g. under opaque HUD. */
+		TArray<FVector4f, TInlineAllocator<FPStyleTransferShaders::kMaxMaskRects>> Rects;
+	};
+
+	/** The tiles of Rect with at least one unmasked pixel and the indirect arguments that process only those. */
+	struct FTileClassification
+	{
+		FIntRect Rect;
+		FRDGBufferRef IndirectArgs = nullptr;
+		FRDGBufferRef TileList = nullptr;
+		FPStyleTransferShaders::FMaskParameters Mask;
+	};
+
+	/** Classifies the kThreadGroupSize tiles of Rect against the mask of MaskInputs and r.RealtimeStyleTransfer.Mask.* cvars. */
+	FTileClassification AddTileClassificationPass(FRDGBuilder& GraphBuilder, const FIntRect& Rect, const FMaskInputs& MaskInputs);
+
+	/**
+	 * AddUpscalePass limited to the classified tiles, which must cover the plan's rect. Masked pixels of those tiles get
+	 * GuideTexture unchanged; TargetTexture keeps whatever it held under fully masked tiles.
+	 */
+	void AddTiledUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, const FTileClassification& Tiles, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture);
+
+	/** Copies the classified tiles of SourceTexture into TargetTexture, which only has to be renderable. */
+	void AddTileCopyPass(FRDGBuilder& GraphBuilder, const FTileClassification& Tiles, FRDGTextureRef SourceTexture, FRDGTextureRef TargetTexture);
+
+	/**
+	 * Replaces the pixels of ViewRect of TargetTexture whose custom stencil selects another style. StencilLayers maps each
+	 * of the 256 stencil values to 0 (keep TargetTexture), 1 + an index into LayerTextures (stylized textures encoded from
+	 * ViewRect, upscaled bilinearly) or kStencilLayerOriginal (OriginalTexture). With bApplyMask, pixels masked by
+	 * r.RealtimeStyleTransfer.Mask are left alone. Requires MaskInputs.CustomStencil; TargetTexture must allow UAV writes.
+	 */
+	void AddStencilCompositePass(
+		FRDGBuilder& GraphBuilder,
+		const FIntRect& ViewRect,
+		const FMaskInputs& MaskInputs,
+		bool bApplyMask,
+		TConstArrayView<uint8> StencilLayers,
+		TConstArrayView<FRDGTextureRef> LayerTextures,
+		FRDGTextureRef OriginalTexture,
+		FRDGTextureRef TargetTexture);
+
+	/** r.RealtimeStyleTransfer.Composite.Raster resolved for the running GPU. Render thread. */
+	bool UseRasterComposite();
+
+	/** AddUpscalePass drawn by a pixel shader into the plan's rect of TargetTexture, which must be renderable and differ from GuideTexture. */
+	void AddRasterUpscalePass(FRDGBuilder& GraphBuilder, const FDispatchPlan& Plan, FRDGTextureRef StylizedTexture, FRDGTextureRef TargetTexture, FRDGTextureRef GuideTexture);
+
+	/** Creates the model's CHW input tensor buffer holding BatchSize frames, typed to the model's input element type. */
+	FRDGBufferRef CreateInputTensor(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, uint32 BatchSize);
+
+	/** Creates the model's CHW output tensor buffer holding BatchSize frames, typed to the model's output element type. */
+	FRDGBufferRef CreateOutputTensor(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, uint32 BatchSize);
+
+	/**
+	 * Bytes of the StyleTransfer.* RDG buffers and textures one inference of Proxy over BatchSize frames creates:
+	 * image, condition and auxiliary tensors plus the model resolution stylized textures (or conv-net activations).
+	 */
+	int64 GetFrameResourceBytes(const FStyleTransferProxy& Proxy, uint32 BatchSize);
+
+	/** Encodes ViewRect of SourceTexture into batch slice BatchIndex of InputTensor. */
+	void AddEncodePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FRDGBufferRef InputTensor, uint32 BatchIndex);
+
+	/** Encodes ViewRect of SourceTexture into a float CHW Tensor of Channels planes at Resolution, as value * EncodeScale * Scale + Bias. */
+	void AddEncodePass(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, const FIntRect& ViewRect, FIntPoint Resolution, int32 Channels, float Scale, float Bias, FRDGBufferRef Tensor);
+
+	/** Binds the image tensors plus the proxy's condition and auxiliary tensors and enqueues Instance. */
+	bool AddInferencePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, UE::NNE::IModelInstanceRDG& Instance, FRDGBufferRef InputTensor, FRDGBufferRef OutputTensor);
+
+	/**
+	 * AddInferencePass with the style weights of each batch slice instead of the proxy's. Per-frame condition inputs of
+	 * an instance created with bPerFrameConditioning get one slice per entry; shared ones take the first entry.
+	 */
+	bool AddInferencePass(
+		FRDGBuilder& GraphBuilder,
+		const FStyleTransferProxy& Proxy,
+		UE::NNE::IModelInstanceRDG& Instance,
+		FRDGBufferRef InputTensor,
+		FRDGBufferRef OutputTensor,
+		TConstArrayView<TArray<float>> SliceWeights);
+
+	/** True when A and B encode a rect into the same input tensor, so one encode can feed both. */
+	bool SharesInput(const FStyleTransferProxy& A, const FStyleTransferProxy& B);
+
+	/** Copies batch slice 0 of SourceTensor into slice TargetBatchIndex of TargetTensor, both input tensors of Proxy's layout. */
+	void AddCopyInputSlicePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGBufferRef SourceTensor, FRDGBufferRef TargetTensor, uint32 TargetBatchIndex);
+
+	/** Decodes batch slice BatchIndex of OutputTensor into a new model resolution texture. */
+	FRDGTextureRef AddDecodePass(FRDGBuilder& GraphBuilder, const FStyleTransferProxy& Proxy, FRDGBufferRef OutputTensor, uint32 BatchIndex);
+
+	/**
+	 * Resamples StylizedTexture into TargetRect of TargetTexture, which must allow UAV writes.
+	 * With a GuideTexture (the full-resolution frame that was encoded from GuideRect), the upscale is edge-aware
+	 * when r.RealtimeStyleTransfer.Upscale.Guided is 1, or Filter asks for it; otherwise it is bilinear.
+	 */
+	void AddUpscalePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef StylizedTexture,
+		const FIntRect& TargetRect,
+		FRDGTextureRef TargetTexture,
+		FRDGTextureRef GuideTexture = nullptr,
+		const FIntRect& GuideRect = FIntRect(),
+		EUpscaleFilter Filter = EUpscaleFilter::Default);
+
+	/** AddUpscalePass as a full-screen pixel shader draw; TargetTexture must be renderable and differ from GuideTexture. */
+	void AddRasterUpscalePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef StylizedTexture,
+		const FIntRect& TargetRect,
+		FRDGTextureRef TargetTexture,
+		FRDGTextureRef GuideTexture = nullptr,
+		const FIntRect& GuideRect = FIntRect(),
+		EUpscaleFilter Filter = EUpscaleFilter::Default);
+
+	/**
+	 * Writes ViewRect of TargetTexture: FoveaTexture stretched over FoveaRect, faded over FeatherWidth pixels into
+	 * BackgroundTexture, which has the same layout as TargetTexture.
+	 */
+	void AddFoveatedCompositePass(
+		FRDGBuilder& GraphBuilder,
+		FRDGTextureRef BackgroundTexture,
+		FRDGTextureRef FoveaTexture,
+		const FIntRect& ViewRect,
+		const FIntRect& FoveaRect,
+		float FeatherWidth,
+		FRDGTextureRef TargetTexture);
+}
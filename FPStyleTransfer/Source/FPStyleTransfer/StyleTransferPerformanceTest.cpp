@@ -0,0 +1,828 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "AssetRegistry/IAssetRegistry.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "MyNeuralNetwork.h"
+#include "NNE.h"
+#include "NNEModelData.h"
+#include "NNERuntimeCPU.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "RHI.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "StyleTransferPasses.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace RealtimeStyleTransfer
+{
+	static int32 PerfTestFrames = 30;
+	static FAutoConsoleVariableRef CVarPerfTestFrames(
+		TEXT("r.RealtimeStyleTransfer.PerfTest.Frames"),
+		PerfTestFrames,
+		TEXT("Frames measured per run by the Project.FPStyleTransfer.Performance automation test, after a short warm-up (default 30)."));
+
+	static int32 PerfTestRuns = 3;
+	static FAutoConsoleVariableRef CVarPerfTestRuns(
+		TEXT("r.RealtimeStyleTransfer.PerfTest.Runs"),
+		PerfTestRuns,
+		TEXT("Runs of PerfTest.Frames frames per model. Each metric is the median of the per-run medians; the spread between\n")
+		TEXT("the fastest and slowest run is stored with updated baselines and widens their limit (default 3)."));
+
+	static float PerfTestTolerance = 0.25f;
+	static FAutoConsoleVariableRef CVarPerfTestTolerance(
+		TEXT("r.RealtimeStyleTransfer.PerfTest.Tolerance"),
+		PerfTestTolerance,
+		TEXT("Fraction by which a metric may exceed its baseline before the performance test fails (default 0.25). The limit also\n")
+		TEXT("allows the larger of a small absolute slack and the run-to-run spread recorded with the baseline."));
+
+	static int32 PerfTestUpdateBaseline = 0;
+	static FAutoConsoleVariableRef CVarPerfTestUpdateBaseline(
+		TEXT("r.RealtimeStyleTransfer.PerfTest.UpdateBaseline"),
+		PerfTestUpdateBaseline,
+		TEXT("Writes the measured metrics as the new baselines instead of comparing against them.\n")
+		TEXT("=0: compare (default), 1: update"));
+
+	static int32 PerfTestMode = 0;
+	static FAutoConsoleVariableRef CVarPerfTestMode(
+		TEXT("r.RealtimeStyleTransfer.PerfTest.Mode"),
+		PerfTestMode,
+		TEXT("How the performance test runs each model.\n")
+		TEXT("=0: CPU under -nullrhi, rendered otherwise (default), 1: CPU (NNERuntimeORTCpu), 2: rendered through SetStyle"));
+}
+
+namespace
+{
+	constexpr int32 WarmupFrames = 3;
+	constexpr double FrameTimeoutSeconds = 30.0;
+	const FIntPoint CpuFrameResolution(1280, 720);
+	const TCHAR* LooseModelPrefix = TEXT("File:");
+
+	/** A metric's median over the runs, and the spread between its fastest and slowest run. */
+	struct FStyleTransferMetric
+	{
+		FString Name;
+		double Value = 0.0;
+		double Spread = 0.0;
+	};
+
+	using FStyleTransferMetrics = TArray<FStyleTransferMetric>;
+
+	/** Per-frame samples of each metric of one run, in the order the metrics were first added. */
+	struct FRunSamples
+	{
+		TArray<TPair<FString, TArray<double>>> Metrics;
+
+		void Add(const TCHAR* Name, double Value)
+		{
+			if (TArray<double>* Samples = Find(Name))
+			{
+				Samples->Add(Value);
+			}
+			else
+			{
+				Metrics.Emplace(Name, TArray<double>{ Value });
+			}
+		}
+
+		TArray<double>* Find(const TCHAR* Name)
+		{
+			TPair<FString, TArray<double>>* Metric = Metrics.FindByPredicate([Name](const TPair<FString, TArray<double>>& Entry) { return Entry.Key == Name; });
+			return Metric ? &Metric->Value : nullptr;
+		}
+
+		const TArray<double>* Find(const TCHAR* Name) const
+		{
+			return const_cast<FRunSamples*>(this)->Find(Name);
+		}
+
+		int32 Num(const TCHAR* Name) const
+		{
+			const TArray<double>* Samples = Find(Name);
+			return Samples ? Samples->Num() : 0;
+		}
+	};
+
+	double Median(TArray<double> Samples)
+	{
+		if (Samples.IsEmpty())
+		{
+			return 0.0;
+		}
+		Samples.Sort();
+		return Samples[Samples.Num() / 2];
+	}
+
+	double ToMegabytes(int64 Bytes)
+	{
+		return Bytes / (1024.0 * 1024.0);
+	}
+
+	int32 GetRunCount()
+	{
+		return FMath::Max(RealtimeStyleTransfer::PerfTestRuns, 1);
+	}
+
+	/** Adds every metric of Runs as the median of its per-run medians. */
+	void AddRunMetrics(TConstArrayView<FRunSamples> Runs, FStyleTransferMetrics& Metrics)
+	{
+		if (Runs.IsEmpty())
+		{
+			return;
+		}
+
+		for (const TPair<FString, TArray<double>>& Metric : Runs[0].Metrics)
+		{
+			TArray<double> RunMedians;
+			for (const FRunSamples& Run : Runs)
+			{
+				if (const TArray<double>* Samples = Run.Find(*Metric.Key))
+				{
+					RunMedians.Add(Median(*Samples));
+				}
+			}
+			RunMedians.Sort();
+			Metrics.Add({ Metric.Key, Median(RunMedians), RunMedians.Last() - RunMedians[0] });
+		}
+	}
+
+	/** Absolute slack added to the tolerance, so metrics near zero do not fail on timer or allocator noise. */
+	double GetMetricSlack(const FString& Metric)
+	{
+		return Metric.EndsWith(TEXT("MB")) ? 4.0 : 0.1;
+	}
+
+	FString GetBaselinePath()
+	{
+		return FPaths::Combine(FPaths::ProjectDir(), TEXT("Tests"), TEXT("StyleTransferPerformanceBaselines.json"));
+	}
+
+	TSharedPtr<FJsonObject> LoadBaselines()
+	{
+		FString Text;
+		TSharedPtr<FJsonObject> Baselines;
+		if (FFileHelper::LoadFileToString(Text, *GetBaselinePath()))
+		{
+			FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Text), Baselines);
+		}
+		return Baselines.IsValid() ? Baselines : MakeShared<FJsonObject>();
+	}
+
+	/**
+	 * Compares Metrics with the baseline stored under Key, or replaces it when r.RealtimeStyleTransfer.PerfTest.UpdateBaseline
+	 * is set. A metric fails above Baseline * (1 + Tolerance) plus the larger of its slack and its recorded run-to-run spread;
+	 * a missing baseline fails too, so a test that was never calibrated cannot pass.
+	 */
+	void CheckBaseline(FAutomationTestBase& Test, const FString& Key, const FStyleTransferMetrics& Metrics)
+	{
+		FString Summary;
+		for (const FStyleTransferMetric& Metric : Metrics)
+		{
+			Summary += FString::Printf(TEXT(" %s=%.2f (spread %.2f)"), *Metric.Name, Metric.Value, Metric.Spread);
+		}
+		Test.AddInfo(FString::Printf(TEXT("%s:%s"), *Key, *Summary));
+
+		const TSharedPtr<FJsonObject> Baselines = LoadBaselines();
+		if (RealtimeStyleTransfer::PerfTestUpdateBaseline > 0)
+		{
+			TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+			for (const FStyleTransferMetric& Metric : Metrics)
+			{
+				Entry->SetNumberField(Metric.Name, Metric.Value);
+				Entry->SetNumberField(Metric.Name + TEXT("Spread"), Metric.Spread);
+			}
+			Baselines->SetObjectField(Key, Entry);
+
+			FString Text;
+			FJsonSerializer::Serialize(Baselines.ToSharedRef(), TJsonWriterFactory<>::Create(&Text));
+			if (!FFileHelper::SaveStringToFile(Text, *GetBaselinePath()))
+			{
+				Test.AddError(FString::Printf(TEXT("Unable to write baselines to '%s'."), *GetBaselinePath()));
+			}
+			return;
+		}
+
+		const TSharedPtr<FJsonObject>* Entry = nullptr;
+		if (!Baselines->TryGetObjectField(Key, Entry))
+		{
+			Test.AddError(FString::Printf(TEXT("No baseline for '%s' in '%s'. Record one on this machine with r.RealtimeStyleTransfer.PerfTest.UpdateBaseline=1 and commit the file."),
+				*Key,
+				*GetBaselinePath()));
+			return;
+		}
+
+		const double Tolerance = FMath::Max(RealtimeStyleTransfer::PerfTestTolerance, 0.0f);
+		for (const FStyleTransferMetric& Metric : Metrics)
+		{
+			double Baseline = 0.0;
+			if (!(*Entry)->TryGetNumberField(Metric.Name, Baseline))
+			{
+				Test.AddError(FString::Printf(TEXT("%s has no baseline for %s; record the baseline again."), *Key, *Metric.Name));
+				continue;
+			}
+
+			double BaselineSpread = 0.0;
+			(*Entry)->TryGetNumberField(Metric.Name + TEXT("Spread"), BaselineSpread);
+
+			const double Limit = Baseline * (1.0 + Tolerance) + FMath::Max(GetMetricSlack(Metric.Name), BaselineSpread);
+			if (Metric.Value > Limit)
+			{
+				Test.AddError(FString::Printf(TEXT("%s regressed: %s is %.2f, baseline %.2f (limit %.2f)."),
+					*Key,
+					*Metric.Name,
+					Metric.Value,
+					Baseline,
+					Limit));
+			}
+		}
+	}
+
+	/** A deterministic test frame with gradients and a pattern that moves with FrameIndex, in linear 0..1 RGB. */
+	TArray<FLinearColor> MakeTestFrame(FIntPoint Resolution, int32 FrameIndex)
+	{
+		TArray<FLinearColor> Frame;
+		Frame.SetNumUninitialized(Resolution.X * Resolution.Y);
+		for (int32 Y = 0; Y < Resolution.Y; ++Y)
+		{
+			for (int32 X = 0; X < Resolution.X; ++X)
+			{
+				const float Wave = 0.5f + 0.5f * FMath::Sin((X + Y + FrameIndex * 16) * 0.02f);
+				Frame[Y * Resolution.X + X] = FLinearColor(static_cast<float>(X) / Resolution.X, static_cast<float>(Y) / Resolution.Y, Wave);
+			}
+		}
+		return Frame;
+	}
+
+	FLinearColor SampleBilinear(TConstArrayView<FLinearColor> Image, FIntPoint Resolution, FVector2f UV)
+	{
+		const float X = FMath::Clamp(UV.X * Resolution.X - 0.5f, 0.0f, Resolution.X - 1.0f);
+		const float Y = FMath::Clamp(UV.Y * Resolution.Y - 0.5f, 0.0f, Resolution.Y - 1.0f);
+		const int32 X0 = FMath::FloorToInt32(X);
+		const int32 Y0 = FMath::FloorToInt32(Y);
+		const int32 X1 = FMath::Min(X0 + 1, Resolution.X - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Resolution.Y - 1);
+		const float FracX = X - X0;
+		const float FracY = Y - Y0;
+
+		const FLinearColor Top = FMath::Lerp(Image[Y0 * Resolution.X + X0], Image[Y0 * Resolution.X + X1], FracX);
+		const FLinearColor Bottom = FMath::Lerp(Image[Y1 * Resolution.X + X0], Image[Y1 * Resolution.X + X1], FracX);
+		return FMath::Lerp(Top, Bottom, FracY);
+	}
+
+	/**
+	 * Source texels and normalized coverage weights of each output pixel along one axis, as the area-filtered encode
+	 * weighs them: the footprint is at least one texel wide, so an upsampled axis gets bilinear weights.
+	 */
+	TArray<TArray<TPair<int32, float>>> GetAreaFootprints(int32 SourceSize, int32 TargetSize)
+	{
+		const float Ratio = static_cast<float>(SourceSize) / TargetSize;
+		const float Width = FMath::Max(Ratio, 1.0f);
+		TArray<TArray<TPair<int32, float>>> Footprints;
+		Footprints.SetNum(TargetSize);
+		for (int32 Index = 0; Index < TargetSize; ++Index)
+		{
+			const float Begin = (Index + 0.5f) * Ratio - 0.5f * Width;
+			const float End = Begin + Width;
+			for (int32 Texel = FMath::FloorToInt32(Begin); Texel < FMath::CeilToInt32(End); ++Texel)
+			{
+				const float Coverage = FMath::Min(End, Texel + 1.0f) - FMath::Max(Begin, static_cast<float>(Texel));
+				Footprints[Index].Emplace(FMath::Clamp(Texel, 0, SourceSize - 1), Coverage / Width);
+			}
+		}
+		return Footprints;
+	}
+
+	/** Image tensor layout of a model as the encode and decode passes see it. */
+	struct FImageTensorFormat
+	{
+		ENNETensorDataType DataType = ENNETensorDataType::Float;
+		FStyleTransferTensorQuantization Quantization;
+		int32 Channels = 3;
+		FIntPoint Resolution = FIntPoint::ZeroValue;
+	};
+
+	bool IsSupportedImageType(ENNETensorDataType DataType)
+	{
+		return DataType == ENNETensorDataType::Float
+			|| DataType == ENNETensorDataType::Half
+			|| DataType == ENNETensorDataType::UInt8
+			|| DataType == ENNETensorDataType::Int8;
+	}
+
+	/** Writes element Index of an image tensor, quantized like the encode pass for 8-bit tensors. */
+	void WriteTensorValue(TArray<uint8>& Tensor, const FImageTensorFormat& Format, int32 Index, float Value)
+	{
+		switch (Format.DataType)
+		{
+		case ENNETensorDataType::Half:
+			reinterpret_cast<FFloat16*>(Tensor.GetData())[Index] = FFloat16(Value);
+			break;
+		case ENNETensorDataType::UInt8:
+			Tensor[Index] = static_cast<uint8>(FMath::Clamp(FMath::RoundToInt32(Value / Format.Quantization.Scale) + Format.Quantization.ZeroPoint, 0, 255));
+			break;
+		case ENNETensorDataType::Int8:
+			reinterpret_cast<int8*>(Tensor.GetData())[Index] = static_cast<int8>(FMath::Clamp(FMath::RoundToInt32(Value / Format.Quantization.Scale) + Format.Quantization.ZeroPoint, -128, 127));
+			break;
+		default:
+			reinterpret_cast<float*>(Tensor.GetData())[Index] = Value;
+			break;
+		}
+	}
+
+	/** Reads element Index of an image tensor, dequantized like the decode pass for 8-bit tensors. */
+	float ReadTensorValue(TConstArrayView<uint8> Tensor, const FImageTensorFormat& Format, int32 Index)
+	{
+		switch (Format.DataType)
+		{
+		case ENNETensorDataType::Half:
+			return reinterpret_cast<const FFloat16*>(Tensor.GetData())[Index].GetFloat();
+		case ENNETensorDataType::UInt8:
+			return (Tensor[Index] - Format.Quantization.ZeroPoint) * Format.Quantization.Scale;
+		case ENNETensorDataType::Int8:
+			return (reinterpret_cast<const int8*>(Tensor.GetData())[Index] - Format.Quantization.ZeroPoint) * Format.Quantization.Scale;
+		default:
+			return reinterpret_cast<const float*>(Tensor.GetData())[Index];
+		}
+	}
+
+	/**
+	 * CPU counterpart of the encode pass: resample to the model resolution, with the area filter when
+	 * r.RealtimeStyleTransfer.Encode.AreaFilter is on and the frame is downsampled along either axis, into a BGR CHW tensor.
+	 */
+	void EncodeFrame(TConstArrayView<FLinearColor> Frame, FIntPoint FrameResolution, const FImageTensorFormat& Format, TArray<uint8>& OutTensor)
+	{
+		const FIntPoint ModelResolution = Format.Resolution;
+		const int32 PlaneSize = ModelResolution.X * ModelResolution.Y;
+		const IConsoleVariable* AreaFilterVar = IConsoleManager::Get().FindConsoleVariable(TEXT("r.RealtimeStyleTransfer.Encode.AreaFilter"));
+		const bool bAreaFilter = AreaFilterVar && AreaFilterVar->GetInt() > 0
+			&& (FrameResolution.X > ModelResolution.X || FrameResolution.Y > ModelResolution.Y);
+		const TArray<TArray<TPair<int32, float>>> ColumnFootprints = bAreaFilter ? GetAreaFootprints(FrameResolution.X, ModelResolution.X) : TArray<TArray<TPair<int32, float>>>();
+		const TArray<TArray<TPair<int32, float>>> RowFootprints = bAreaFilter ? GetAreaFootprints(FrameResolution.Y, ModelResolution.Y) : TArray<TArray<TPair<int32, float>>>();
+
+		for (int32 Y = 0; Y < ModelResolution.Y; ++Y)
+		{
+			for (int32 X = 0; X < ModelResolution.X; ++X)
+			{
+				FLinearColor Color = FLinearColor::Transparent;
+				if (bAreaFilter)
+				{
+					for (const TPair<int32, float>& Row : RowFootprints[Y])
+					{
+						for (const TPair<int32, float>& Column : ColumnFootprints[X])
+						{
+							Color += Frame[Row.Key * FrameResolution.X + Column.Key] * (Row.Value * Column.Value);
+						}
+					}
+				}
+				else
+				{
+					Color = SampleBilinear(Frame, FrameResolution, FVector2f((X + 0.5f) / ModelResolution.X, (Y + 0.5f) / ModelResolution.Y));
+				}
+
+				const int32 PixelIndex = Y * ModelResolution.X + X;
+				const float Channels[3] = { Color.B, Color.G, Color.R };
+				for (int32 Channel = 0; Channel < FMath::Min(Format.Channels, 3); ++Channel)
+				{
+					WriteTensorValue(OutTensor, Format, PixelIndex + Channel * PlaneSize, FMath::Clamp(Channels[Channel], 0.0f, 1.0f) * StyleTransferPasses::EncodeScale);
+				}
+			}
+		}
+	}
+
+	/** CPU counterpart of the decode pass. */
+	void DecodeTensor(TConstArrayView<uint8> Tensor, const FImageTensorFormat& Format, TArray<FLinearColor>& OutImage)
+	{
+		const int32 PlaneSize = Format.Resolution.X * Format.Resolution.Y;
+		OutImage.SetNumUninitialized(PlaneSize);
+		for (int32 PixelIndex = 0; PixelIndex < PlaneSize; ++PixelIndex)
+		{
+			const float B = ReadTensorValue(Tensor, Format, PixelIndex) * StyleTransferPasses::DecodeScale;
+			const float G = Format.Channels >= 2 ? ReadTensorValue(Tensor, Format, PixelIndex + PlaneSize) * StyleTransferPasses::DecodeScale : B;
+			const float R = Format.Channels >= 3 ? ReadTensorValue(Tensor, Format, PixelIndex + 2 * PlaneSize) * StyleTransferPasses::DecodeScale : G;
+			OutImage[PixelIndex] = FLinearColor(FMath::Clamp(R, 0.0f, 1.0f), FMath::Clamp(G, 0.0f, 1.0f), FMath::Clamp(B, 0.0f, 1.0f));
+		}
+	}
+
+	/** CPU counterpart of the bilinear upscale pass. */
+	void UpscaleImage(TConstArrayView<FLinearColor> Image, FIntPoint Resolution, FIntPoint TargetResolution, TArray<FLinearColor>& OutImage)
+	{
+		OutImage.SetNumUninitialized(TargetResolution.X * TargetResolution.Y);
+		for (int32 Y = 0; Y < TargetResolution.Y; ++Y)
+		{
+			for (int32 X = 0; X < TargetResolution.X; ++X)
+			{
+				const FVector2f UV((X + 0.5f) / TargetResolution.X, (Y + 0.5f) / TargetResolution.Y);
+				OutImage[Y * TargetResolution.X + X] = SampleBilinear(Image, Resolution, UV);
+			}
+		}
+	}
+
+	uint64 GetTensorVolume(const UE::NNE::FTensorShape& Shape)
+	{
+		uint64 Volume = 1;
+		for (const uint32 Dim : Shape.GetData())
+		{
+			Volume *= Dim;
+		}
+		return Volume;
+	}
+
+	/** Loads an asset, or memory-maps a loose model into transient model data the way SetStyleFromFile does. */
+	UNNEModelData* LoadTestModel(const FString& Parameters)
+	{
+		if (!Parameters.StartsWith(LooseModelPrefix))
+		{
+			return LoadObject<UNNEModelData>(nullptr, *Parameters);
+		}
+
+		const FString FilePath = FPaths::Combine(FPaths::ProjectContentDir(), Parameters.RightChop(FCString::Strlen(LooseModelPrefix)));
+		return UMyNeuralNetwork::CreateTransientModelData(FilePath);
+	}
+
+	/**
+	 * Headless measurement: builds an NNERuntimeORTCpu instance and runs the encode, inference, decode and upscale
+	 * stages of ExecuteStyleTransfer on the CPU for a fixed sequence of frames, PerfTest.Runs times.
+	 */
+	bool RunCpuBenchmark(FAutomationTestBase& Test, const FString& Parameters, const FString& Key)
+	{
+		TWeakInterfacePtr<INNERuntimeCPU> Runtime = UE::NNE::GetRuntime<INNERuntimeCPU>(TEXT("NNERuntimeORTCpu"));
+		if (!Runtime.IsValid())
+		{
+			Test.AddError(TEXT("NNERuntimeORTCpu is not available."));
+			return false;
+		}
+
+		// Memory is sampled process-wide, so nothing else may be loading while the model is created.
+		FlushAsyncLoading();
+		const uint64 BaselineBytes = FPlatformMemory::GetStats().UsedPhysical;
+		uint64 PeakBytes = BaselineBytes;
+		const auto SamplePeak = [&PeakBytes]() { PeakBytes = FMath::Max<uint64>(PeakBytes, FPlatformMemory::GetStats().UsedPhysical); };
+		const double CreateStartSeconds = FPlatformTime::Seconds();
+
+		UNNEModelData* ModelData = LoadTestModel(Parameters);
+		if (!ModelData)
+		{
+			Test.AddError(FString::Printf(TEXT("Unable to load '%s'."), *Parameters));
+			return false;
+		}
+		SamplePeak();
+
+		TSharedPtr<UE::NNE::IModelCPU> Model = Runtime->CreateModelCPU(ModelData);
+		SamplePeak();
+		TSharedPtr<UE::NNE::IModelInstanceCPU> Instance = Model.IsValid() ? Model->CreateModelInstanceCPU() : nullptr;
+		if (!Instance.IsValid())
+		{
+			Test.AddError(FString::Printf(TEXT("NNERuntimeORTCpu could not create '%s'."), *ModelData->GetName()));
+			return false;
+		}
+
+		// Symbolic dims resolve like CreateProxy: batch 1, spatial 224. Conditioning inputs select the first style.
+		const TConstArrayView<UE::NNE::FTensorDesc> InputDescs = Instance->GetInputTensorDescs();
+		if (InputDescs.IsEmpty() || InputDescs[0].GetShape().Rank() != 4 || !IsSupportedImageType(InputDescs[0].GetDataType()))
+		{
+			Test.AddError(FString::Printf(TEXT("'%s' has no NCHW image input of a type the encode pass writes."), *ModelData->GetName()));
+			return false;
+		}
+
+		TArray<UE::NNE::FTensorShape> InputShapes;
+		for (const UE::NNE::FTensorDesc& Desc : InputDescs)
+		{
+			const UE::NNE::FSymbolicTensorShape SymbolicShape = Desc.GetShape();
+			TArray<uint32> Dimensions;
+			for (int32 DimIndex = 0; DimIndex < SymbolicShape.Rank(); ++DimIndex)
+			{
+				const int64 DimValue = SymbolicShape.GetData()[DimIndex];
+				const bool bSpatial = InputShapes.IsEmpty() && DimIndex >= 2;
+				Dimensions.Add(DimValue > 0 ? static_cast<uint32>(DimValue) : (bSpatial ? 224u : 1u));
+			}
+			InputShapes.Add(UE::NNE::FTensorShape::Make(Dimensions));
+		}
+
+		if (Instance->SetInputTensorShapes(InputShapes) != UE::NNE::IModelInstanceCPU::ESetInputTensorShapesStatus::Ok)
+		{
+			Test.AddError(FString::Printf(TEXT("Failed to set the input shapes of '%s'."), *ModelData->GetName()));
+			return false;
+		}
+
+		const TConstArrayView<UE::NNE::FTensorShape> OutputShapes = Instance->GetOutputTensorShapes();
+		const TConstArrayView<UE::NNE::FTensorDesc> OutputDescs = Instance->GetOutputTensorDescs();
+		if (OutputShapes.IsEmpty() || OutputShapes[0].Rank() != 4 || !IsSupportedImageType(OutputDescs[0].GetDataType()))
+		{
+			Test.AddError(FString::Printf(TEXT("'%s' must produce an NCHW image of a type the decode pass reads."), *ModelData->GetName()));
+			return false;
+		}
+
+		FImageTensorFormat InputFormat;
+		InputFormat.DataType = InputDescs[0].GetDataType();
+		InputFormat.Channels = static_cast<int32>(InputShapes[0].GetData()[1]);
+		InputFormat.Resolution = FIntPoint(static_cast<int32>(InputShapes[0].GetData()[3]), static_cast<int32>(InputShapes[0].GetData()[2]));
+
+		FImageTensorFormat OutputFormat;
+		OutputFormat.DataType = OutputDescs[0].GetDataType();
+		OutputFormat.Channels = static_cast<int32>(OutputShapes[0].GetData()[1]);
+		OutputFormat.Resolution = FIntPoint(static_cast<int32>(OutputShapes[0].GetData()[3]), static_cast<int32>(OutputShapes[0].GetData()[2]));
+
+		// 8-bit image tensors use the scale and zero point the GPU passes get from the proxy.
+		if (InputFormat.DataType == ENNETensorDataType::UInt8 || InputFormat.DataType == ENNETensorDataType::Int8)
+		{
+			InputFormat.Quantization = UMyNeuralNetwork::ResolveImageQuantization(ModelData, InputFormat.DataType, true);
+		}
+		if (OutputFormat.DataType == ENNETensorDataType::UInt8 || OutputFormat.DataType == ENNETensorDataType::Int8)
+		{
+			OutputFormat.Quantization = UMyNeuralNetwork::ResolveImageQuantization(ModelData, OutputFormat.DataType, false);
+		}
+
+		// A loose model's file data is released once the runtime has built its model, as SetStyleFromFile does.
+		if (Parameters.StartsWith(LooseModelPrefix))
+		{
+			UMyNeuralNetwork::ReleaseTransientModelData(ModelData);
+		}
+
+		SamplePeak();
+		const double CreateMs = (FPlatformTime::Seconds() - CreateStartSeconds) * 1000.0;
+		const int64 CreateBytes = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(BaselineBytes);
+		const int64 CreatePeakBytes = static_cast<int64>(PeakBytes - BaselineBytes);
+		if (IsAsyncLoading())
+		{
+			Test.AddError(TEXT("Packages started streaming while the model was created, so its memory figures are not isolated."));
+			return false;
+		}
+
+		TArray<TArray<uint8>> InputBuffers;
+		InputBuffers.SetNum(InputShapes.Num());
+		for (int32 InputIndex = 0; InputIndex < InputShapes.Num(); ++InputIndex)
+		{
+			InputBuffers[InputIndex].SetNumZeroed(GetTensorVolume(InputShapes[InputIndex]) * InputDescs[InputIndex].GetElementByteSize());
+			if (InputIndex > 0 && InputDescs[InputIndex].GetDataType() == ENNETensorDataType::Float && InputBuffers[InputIndex].Num() >= static_cast<int32>(sizeof(float)))
+			{
+				*reinterpret_cast<float*>(InputBuffers[InputIndex].GetData()) = 1.0f;
+			}
+		}
+
+		TArray<UE::NNE::FTensorBindingCPU> InputBindings;
+		for (TArray<uint8>& Buffer : InputBuffers)
+		{
+			InputBindings.Add({ Buffer.GetData(), static_cast<uint64>(Buffer.Num()) });
+		}
+
+		TArray<TArray<uint8>> OutputBuffers;
+		TArray<UE::NNE::FTensorBindingCPU> OutputBindings;
+		OutputBuffers.SetNum(OutputShapes.Num());
+		for (int32 OutputIndex = 0; OutputIndex < OutputShapes.Num(); ++OutputIndex)
+		{
+			OutputBuffers[OutputIndex].SetNumUninitialized(GetTensorVolume(OutputShapes[OutputIndex]) * OutputDescs[OutputIndex].GetElementByteSize());
+			OutputBindings.Add({ OutputBuffers[OutputIndex].GetData(), static_cast<uint64>(OutputBuffers[OutputIndex].Num()) });
+		}
+
+		TArray<FLinearColor> Stylized;
+		TArray<FLinearColor> Composited;
+		TArray<FRunSamples> Runs;
+		Runs.SetNum(GetRunCount());
+		const int32 MeasuredFrames = FMath::Max(RealtimeStyleTransfer::PerfTestFrames, 1);
+		for (int32 FrameIndex = 0; FrameIndex < WarmupFrames + Runs.Num() * MeasuredFrames; ++FrameIndex)
+		{
+			const TArray<FLinearColor> Frame = MakeTestFrame(CpuFrameResolution, FrameIndex);
+			FStyleTransferStageTimings Timings;
+			const uint64 FrameStartCycles = FPlatformTime::Cycles64();
+
+			uint64 StageStartCycles = FrameStartCycles;
+			auto EndStage = [&StageStartCycles](double& OutMs)
+			{
+				const uint64 NowCycles = FPlatformTime::Cycles64();
+				OutMs = FPlatformTime::ToMilliseconds64(NowCycles - StageStartCycles);
+				StageStartCycles = NowCycles;
+			};
+
+			EncodeFrame(Frame, CpuFrameResolution, InputFormat, InputBuffers[0]);
+			EndStage(Timings.EncodeMs);
+
+			if (Instance->RunSync(InputBindings, OutputBindings) != UE::NNE::IModelInstanceCPU::ERunSyncStatus::Ok)
+			{
+				Test.AddError(FString::Printf(TEXT("Inference failed for '%s' on frame %d."), *ModelData->GetName(), FrameIndex));
+				return false;
+			}
+			EndStage(Timings.InferenceMs);
+
+			DecodeTensor(OutputBuffers[0], OutputFormat, Stylized);
+			EndStage(Timings.DecodeMs);
+
+			UpscaleImage(Stylized, OutputFormat.Resolution, CpuFrameResolution, Composited);
+			EndStage(Timings.CompositeMs);
+
+			if (FrameIndex >= WarmupFrames)
+			{
+				FRunSamples& Run = Runs[(FrameIndex - WarmupFrames) / MeasuredFrames];
+				Run.Add(TEXT("EncodeMs"), Timings.EncodeMs);
+				Run.Add(TEXT("InferenceMs"), Timings.InferenceMs);
+				Run.Add(TEXT("DecodeMs"), Timings.DecodeMs);
+				Run.Add(TEXT("CompositeMs"), Timings.CompositeMs);
+				Run.Add(TEXT("TotalMs"), FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - FrameStartCycles));
+			}
+		}
+
+		FStyleTransferMetrics Metrics;
+		Metrics.Add({ TEXT("CreateMs"), CreateMs });
+		Metrics.Add({ TEXT("CreateMB"), ToMegabytes(CreateBytes) });
+		Metrics.Add({ TEXT("CreatePeakMB"), ToMegabytes(CreatePeakBytes) });
+		AddRunMetrics(Runs, Metrics);
+		CheckBaseline(Test, Key, Metrics);
+		return true;
+	}
+
+	/**
+	 * Collects the per-stage GPU times, render thread recording time and GPU frame time of rendered frames over
+	 * PerfTest.Runs runs, then checks them against the baseline.
+	 */
+	class FStyleTransferSampleFramesCommand : public IAutomationLatentCommand
+	{
+	public:
+		FStyleTransferSampleFramesCommand(FAutomationTestBase& InTest, FString InKey, FStyleTransferMetrics InMetrics)
+			: Test(InTest)
+			, Key(MoveTemp(InKey))
+			, Metrics(MoveTemp(InMetrics))
+		{
+			Runs.AddDefaulted();
+			// Stage timestamps are off by default; the test turns them on while it samples.
+			FRealtimeStyleTransferViewExtension::AddStageGpuTimingsRequest();
+		}
+
+		virtual ~FStyleTransferSampleFramesCommand() override
+		{
+			FRealtimeStyleTransferViewExtension::RemoveStageGpuTimingsRequest();
+		}
+
+		virtual bool Update() override
+		{
+			const FStyleTransferStageTimings Timings = FRealtimeStyleTransferViewExtension::GetLastStageTimings();
+			const bool bNewFrame = Timings.Frame != LastFrame;
+			const bool bNewGpuFrame = bGpuStages && Timings.GpuFrame != LastGpuFrame;
+			if (!bNewFrame && !bNewGpuFrame)
+			{
+				if (GetCurrentRunTime() > FrameTimeoutSeconds)
+				{
+					Test.AddError(FString::Printf(TEXT("%s: no stylized frame in %.0f s. Rendering requires a viewport and a D3D RHI."), *Key, FrameTimeoutSeconds));
+					return Finish(false);
+				}
+				return false;
+			}
+
+			const int32 MeasuredFrames = FMath::Max(RealtimeStyleTransfer::PerfTestFrames, 1);
+			FRunSamples& Run = Runs.Last();
+			if (bNewFrame)
+			{
+				LastFrame = Timings.Frame;
+				if (++SeenFrames > WarmupFrames && Run.Num(TEXT("RecordMs")) < MeasuredFrames)
+				{
+					Run.Add(TEXT("RecordMs"), Timings.TotalMs);
+					Run.Add(TEXT("GpuFrameMs"), FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+				}
+			}
+
+			// GPU times arrive a few frames late, so they only count once the warm-up frames have been read back.
+			if (bNewGpuFrame)
+			{
+				LastGpuFrame = Timings.GpuFrame;
+				if (++SeenGpuFrames > WarmupFrames && Run.Num(TEXT("StyleGpuMs")) < MeasuredFrames)
+				{
+					Run.Add(TEXT("EncodeGpuMs"), Timings.EncodeGpuMs);
+					Run.Add(TEXT("InferenceGpuMs"), Timings.InferenceGpuMs);
+					Run.Add(TEXT("DecodeGpuMs"), Timings.DecodeGpuMs);
+					Run.Add(TEXT("CompositeGpuMs"), Timings.CompositeGpuMs);
+					Run.Add(TEXT("StyleGpuMs"), Timings.TotalGpuMs);
+				}
+			}
+
+			if (Run.Num(TEXT("RecordMs")) < MeasuredFrames || (bGpuStages && Run.Num(TEXT("StyleGpuMs")) < MeasuredFrames))
+			{
+				return false;
+			}
+			if (Runs.Num() < GetRunCount())
+			{
+				Runs.AddDefaulted();
+				return false;
+			}
+			return Finish(true);
+		}
+
+	private:
+		bool Finish(bool bCheck)
+		{
+			if (bCheck)
+			{
+				if (!bGpuStages)
+				{
+					Test.AddWarning(FString::Printf(TEXT("%s: no stage timestamps (timestamp queries unsupported); only frame totals are checked."), *Key));
+				}
+				AddRunMetrics(Runs, Metrics);
+				CheckBaseline(Test, Key, Metrics);
+			}
+			FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+			return true;
+		}
+
+		FAutomationTestBase& Test;
+		FString Key;
+		FStyleTransferMetrics Metrics;
+		TArray<FRunSamples> Runs;
+		const bool bGpuStages = GSupportsTimestampRenderQueries;
+		uint64 LastFrame = FRealtimeStyleTransferViewExtension::GetLastStageTimings().Frame;
+		uint64 LastGpuFrame = FRealtimeStyleTransferViewExtension::GetLastStageTimings().GpuFrame;
+		int32 SeenFrames = 0;
+		int32 SeenGpuFrames = 0;
+	};
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(
+	FStyleTransferPerformanceTest,
+	"Project.FPStyleTransfer.Performance",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+void FStyleTransferPerformanceTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	// Every NNE model asset in the project, plus the loose models staged from Content/StyleModels.
+	IAssetRegistry& AssetRegistry = IAssetRegistry::GetChecked();
+	AssetRegistry.SearchAllAssets(true);
+
+	FARFilter Filter;
+	Filter.ClassPaths.Add(UNNEModelData::StaticClass()->GetClassPathName());
+	Filter.PackagePaths.Add(TEXT("/Game"));
+	Filter.bRecursivePaths = true;
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+	for (const FAssetData& Asset : Assets)
+	{
+		OutBeautifiedNames.Add(Asset.AssetName.ToString());
+		OutTestCommands.Add(Asset.GetObjectPathString());
+	}
+
+	TArray<FString> LooseModels;
+	IFileManager::Get().FindFiles(LooseModels, *FPaths::Combine(FPaths::ProjectContentDir(), TEXT("StyleModels"), TEXT("*.onnx")), true, false);
+	for (const FString& FileName : LooseModels)
+	{
+		OutBeautifiedNames.Add(FPaths::GetBaseFilename(FileName));
+		OutTestCommands.Add(FString(LooseModelPrefix) + TEXT("StyleModels/") + FileName);
+	}
+}
+
+bool FStyleTransferPerformanceTest::RunTest(const FString& Parameters)
+{
+	const bool bCpu = RealtimeStyleTransfer::PerfTestMode == 1 || (RealtimeStyleTransfer::PerfTestMode == 0 && GUsingNullRHI);
+	const FString ModelName = FPaths::GetBaseFilename(Parameters);
+	// Baselines are per platform and per backend, since the same model runs at very different speeds on each.
+	const FString Key = FString::Printf(TEXT("%s/%s/%s"),
+		FPlatformProperties::IniPlatformName(),
+		bCpu ? TEXT("CPU") : (GDynamicRHI ? GDynamicRHI->GetName() : TEXT("Unknown")),
+		*ModelName);
+
+	if (bCpu)
+	{
+		return RunCpuBenchmark(*this, Parameters, Key);
+	}
+
+	FlushAsyncLoading();
+	const uint64 BaselineBytes = FPlatformMemory::GetStats().UsedPhysical;
+	const double CreateStartSeconds = FPlatformTime::Seconds();
+	if (Parameters.StartsWith(LooseModelPrefix))
+	{
+		FRealtimeStyleTransferViewExtension::SetStyleFromFile(Parameters.RightChop(FCString::Strlen(LooseModelPrefix)), NAME_None);
+	}
+	else
+	{
+		UNNEModelData* ModelData = LoadObject<UNNEModelData>(nullptr, *Parameters);
+		if (!ModelData)
+		{
+			AddError(FString::Printf(TEXT("Unable to load '%s'."), *Parameters));
+			return false;
+		}
+		FRealtimeStyleTransferViewExtension::SetStyle(ModelData, NAME_None);
+	}
+
+	const FStyleTransferProxyPtr ActiveProxy = FRealtimeStyleTransferViewExtension::GetActiveProxy();
+	if (!ActiveProxy.IsValid())
+	{
+		AddError(FString::Printf(TEXT("SetStyle failed for '%s'."), *Parameters));
+		return false;
+	}
+	if (ActiveProxy->LoadPeakBytes == INDEX_NONE)
+	{
+		AddError(FString::Printf(TEXT("Packages were streaming while '%s' loaded, so its memory figures are not isolated."), *Parameters));
+		return false;
+	}
+
+	FStyleTransferMetrics Metrics;
+	Metrics.Add({ TEXT("CreateMs"), (FPlatformTime::Seconds() - CreateStartSeconds) * 1000.0 });
+	Metrics.Add({ TEXT("CreateMB"), ToMegabytes(static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(BaselineBytes)) });
+	// Sampled by the load itself, between copying the model data and releasing it, with no packages streaming.
+	Metrics.Add({ TEXT("CreatePeakMB"), ToMegabytes(ActiveProxy->LoadPeakBytes) });
+
+	ADD_LATENT_AUTOMATION_COMMAND(FStyleTransferSampleFramesCommand(*this, Key, MoveTemp(Metrics)));
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
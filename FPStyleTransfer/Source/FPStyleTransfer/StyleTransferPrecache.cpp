@@ -0,0 +1,290 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferPrecache.h"
+
+#include "Containers/Ticker.h"
+#include "GlobalShader.h"
+#include "HAL/IConsoleManager.h"
+#include "NNERuntimeRDG.h"
+#include "PipelineStateCache.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/MiscTrace.h"
+#include "RenderGraphBuilder.h"
+#include "RenderingThread.h"
+#include "StyleTransferConvNet.h"
+#include "StyleTransferPasses.h"
+#include "StyleTransferShaders.h"
+#include "SystemTextures.h"
+#if WITH_EDITOR
+#include "ShaderCompiler.h"
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferPrecache, Log, All);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Precached compute PSOs"), STAT_StyleTransfer_PrecachedPSOs, STATGROUP_StyleTransfer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Plan compute PSOs created late"), STAT_StyleTransfer_RuntimePSOs, STATGROUP_StyleTransfer);
+
+namespace RealtimeStyleTransfer
+{
+	static int32 PrecacheShaders = 1;
+	static FAutoConsoleVariableRef CVarPrecacheShaders(
+		TEXT("r.RealtimeStyleTransfer.PrecacheShaders"),
+		PrecacheShaders,
+		TEXT("Creates the compute PSOs of all style transfer shader permutations when the view extension registers.\n")
+		TEXT("0: create them on first use\n")
+		TEXT("1: precache at startup (default)"),
+		ECVF_RenderThreadSafe);
+
+	static int32 WarmUp = 1;
+	static FAutoConsoleVariableRef CVarWarmUp(
+		TEXT("r.RealtimeStyleTransfer.WarmUp"),
+		WarmUp,
+		TEXT("Runs each style model once over a black frame when it loads, so the runtime creates its kernels' pipelines\n")
+		TEXT("before the first stylized frame.\n")
+		TEXT("0: off\n")
+		TEXT("1: on (default)"),
+		ECVF_RenderThreadSafe);
+}
+
+namespace StyleTransferPrecache
+{
+	namespace
+	{
+		/** Compute shaders whose PSO exists. Render thread only. */
+		TSet<FRHIComputeShader*> PrecachedShaders;
+		/** Style whose first plan EnsurePipelines last reported. Render thread only. */
+		TWeakPtr<FStyleTransferProxy, ESPMode::ThreadSafe> LastReportedProxy;
+		/** Retries PrecacheShaders once the editor's shader compiler is idle. Game thread only. */
+		FTSTicker::FDelegateHandle DeferredPrecacheHandle;
+
+		void CreatePipeline(FRHICommandListImmediate& RHICmdList, FRHIComputeShader* ComputeShader)
+		{
+			PipelineStateCache::GetAndOrCreateComputePipelineState(RHICmdList, ComputeShader, false);
+			PrecachedShaders.Add(ComputeShader);
+		}
+
+		/** Creates the PSO of every permutation of ShaderType in ShaderMap and returns the number of permutations it lacks. */
+		template<typename ShaderType>
+		int32 PrecacheShaderType(FRHICommandListImmediate& RHICmdList, const FGlobalShaderMap& ShaderMap)
+		{
+			// Permutations the platform does not compile come back invalid.
+			int32 Missing = 0;
+			for (int32 PermutationId = 0; PermutationId < ShaderType::FPermutationDomain::PermutationCount; ++PermutationId)
+			{
+				const TShaderRef<FShader> Shader = ShaderMap.GetShader(&ShaderType::GetStaticType(), PermutationId);
+				if (Shader.IsValid())
+				{
+					CreatePipeline(RHICmdList, Shader.GetComputeShader());
+				}
+				else
+				{
+					++Missing;
+				}
+			}
+			return Missing;
+		}
+	}
+
+	void PrecacheShaders()
+	{
+		check(IsInGameThread());
+
+		if (!RealtimeStyleTransfer::PrecacheShaders || DeferredPrecacheHandle.IsValid())
+		{
+			return;
+		}
+
+#if WITH_EDITOR
+		// Global shaders that are still compiling are missing from the shader map, so precaching now would skip them.
+		if (GShaderCompilingManager && GShaderCompilingManager->IsCompiling())
+		{
+			UE_LOG(LogStyleTransferPrecache, Log, TEXT("Deferring the style transfer PSO precache until shader compilation finishes."));
+			DeferredPrecacheHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([](float)
+			{
+				if (GShaderCompilingManager && GShaderCompilingManager->IsCompiling())
+				{
+					return true;
+				}
+				DeferredPrecacheHandle.Reset();
+				PrecacheShaders();
+				return false;
+			}), 0.5f);
+			return;
+		}
+#endif
+
+		ENQUEUE_RENDER_COMMAND(PrecacheStyleTransferShaders)(
+			[](FRHICommandListImmediate& RHICmdList)
+			{
+				using namespace FPStyleTransferShaders;
+
+				const double StartSeconds = FPlatformTime::Seconds();
+				const FGlobalShaderMap& ShaderMap = *GetGlobalShaderMap(GMaxRHIFeatureLevel);
+				int32 Missing = 0;
+				Missing += PrecacheShaderType<FEncodeCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FDecodeCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FUpscaleCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FFoveatedCompositeCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FStencilCompositeCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FTileClassifyCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FTensorRemapCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FConvNetConvCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FConvNetInstanceNormCS>(RHICmdList, ShaderMap);
+				Missing += PrecacheShaderType<FConvNetElementwiseCS>(RHICmdList, ShaderMap);
+
+				SET_DWORD_STAT(STAT_StyleTransfer_PrecachedPSOs, PrecachedShaders.Num());
+				UE_LOG(LogStyleTransferPrecache, Log, TEXT("Precached %d style transfer compute PSOs in %.1f ms; %d permutation(s) have no compiled shader for this platform and were skipped."),
+					PrecachedShaders.Num(),
+					(FPlatformTime::Seconds() - StartSeconds) * 1000.0,
+					Missing);
+			});
+	}
+
+	void Shutdown()
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(DeferredPrecacheHandle);
+		DeferredPrecacheHandle.Reset();
+	}
+
+	void WarmUp(const FStyleTransferProxyPtr& Proxy, const TSharedPtr<UE::NNE::IModelInstanceRDG>& Instance, TArray<TArray<float>> SliceWeights)
+	{
+		check(IsInGameThread());
+
+		if (!RealtimeStyleTransfer::WarmUp || !Proxy.IsValid())
+		{
+			return;
+		}
+
+		ENQUEUE_RENDER_COMMAND(WarmUpStyleTransferModel)(
+			[Proxy, Instance, SliceWeights = MoveTemp(SliceWeights)](FRHICommandListImmediate& RHICmdList) mutable
+			{
+				// Batched instances are created for one configuration and always run; a proxy's own instance runs once.
+				const bool bOwnInstance = !Instance.IsValid();
+				if (bOwnInstance && Proxy->bWarmedUp)
+				{
+					return;
+				}
+
+				const double StartSeconds = FPlatformTime::Seconds();
+				FRDGBuilder GraphBuilder(RHICmdList, RDG_EVENT_NAME("StyleTransferWarmUp"));
+				FRDGTextureRef SourceTexture = GSystemTextures.GetBlackDummy(GraphBuilder);
+				const FIntRect SourceRect(0, 0, 1, 1);
+
+				FRDGTextureRef StylizedTexture = nullptr;
+				uint32 BatchSize = 1;
+				if (Proxy->ConvNet.IsValid())
+				{
+					StylizedTexture = Proxy->ConvNet->AddPasses(GraphBuilder, SourceTexture, SourceRect, Proxy->InputResolution);
+				}
+				else if (UE::NNE::IModelInstanceRDG* ModelInstance = bOwnInstance ? Proxy->ModelInstance.Get() : Instance.Get())
+				{
+					if (SliceWeights.IsEmpty())
+					{
+						SliceWeights.Add(Proxy->StyleWeights);
+					}
+
+					BatchSize = SliceWeights.Num();
+					FRDGBufferRef InputTensor = StyleTransferPasses::CreateInputTensor(GraphBuilder, *Proxy, BatchSize);
+					FRDGBufferRef OutputTensor = StyleTransferPasses::CreateOutputTensor(GraphBuilder, *Proxy, BatchSize);
+					for (uint32 BatchIndex = 0; BatchIndex < BatchSize; ++BatchIndex)
+					{
+						StyleTransferPasses::AddEncodePass(GraphBuilder, *Proxy, SourceTexture, SourceRect, InputTensor, BatchIndex);
+					}
+
+					if (StyleTransferPasses::AddInferencePass(GraphBuilder, *Proxy, *ModelInstance, InputTensor, OutputTensor, SliceWeights))
+					{
+						StylizedTexture = StyleTransferPasses::AddDecodePass(GraphBuilder, *Proxy, OutputTensor, 0);
+					}
+				}
+
+				// Extracting the result keeps RDG from culling the passes.
+				TRefCountPtr<IPooledRenderTarget> ExtractedTexture;
+				if (StylizedTexture)
+				{
+					GraphBuilder.QueueTextureExtraction(StylizedTexture, &ExtractedTexture);
+				}
+				GraphBuilder.Execute();
+
+				if (!StylizedTexture)
+				{
+					UE_LOG(LogStyleTransferPrecache, Warning, TEXT("Warm-up of '%s' failed; its first stylized frame may hitch."), *Proxy->ModelName);
+					return;
+				}
+
+				if (bOwnInstance)
+				{
+					Proxy->bWarmedUp = true;
+				}
+
+				UE_LOG(LogStyleTransferPrecache, Log, TEXT("Warmed up '%s' (%dx%d, %u frame(s)) in %.1f ms."),
+					*Proxy->ModelName,
+					Proxy->InputResolution.X,
+					Proxy->InputResolution.Y,
+					BatchSize,
+					(FPlatformTime::Seconds() - StartSeconds) * 1000.0);
+			});
+	}
+
+	void EnsurePipelines(const StyleTransferPasses::FDispatchPlan& Plan)
+	{
+		check(IsInRenderingThread());
+
+		TArray<FRHIComputeShader*, TInlineAllocator<8>> ComputeShaders;
+		auto AddShader = [&ComputeShaders](const auto& Shader)
+		{
+			if (Shader.IsValid())
+			{
+				ComputeShaders.Add(Shader.GetComputeShader());
+			}
+		};
+
+		AddShader(Plan.EncodeShader);
+		AddShader(Plan.DecodeShader);
+		AddShader(Plan.UpscaleShader);
+		AddShader(Plan.TiledUpscaleShader);
+		for (const StyleTransferPasses::FChainStagePlan& Stage : Plan.Stages)
+		{
+			AddShader(Stage.RemapShader);
+		}
+
+		int32 RuntimeCreations = 0;
+		for (FRHIComputeShader* ComputeShader : ComputeShaders)
+		{
+			if (!PrecachedShaders.Contains(ComputeShader))
+			{
+				CreatePipeline(FRHICommandListExecutor::GetImmediateCommandList(), ComputeShader);
+				++RuntimeCreations;
+			}
+		}
+		INC_DWORD_STAT_BY(STAT_StyleTransfer_RuntimePSOs, RuntimeCreations);
+
+		const FStyleTransferProxyPtr Proxy = Plan.Proxy.Pin();
+		if (!Proxy.IsValid())
+		{
+			return;
+		}
+
+		if (RuntimeCreations > 0)
+		{
+			UE_LOG(LogStyleTransferPrecache, Warning, TEXT("Created %d of %d compute PSOs for '%s' at runtime; r.RealtimeStyleTransfer.PrecacheShaders missed them."),
+				RuntimeCreations,
+				ComputeShaders.Num(),
+				*Proxy->ModelName);
+		}
+
+		// The plan's own shaders are all this function sees. The NNE runtime's kernels, the raster composite and tile copy
+		// (graphics PSOs) and the mask and stencil passes only show up in the engine's PSO stats, so the first frame of each
+		// style is marked where those stats are recorded.
+		if (!LastReportedProxy.HasSameObject(Proxy.Get()))
+		{
+			CSV_EVENT_GLOBAL(TEXT("StyleTransfer.FirstFrame %s"), *Proxy->ModelName);
+			TRACE_BOOKMARK(TEXT("StyleTransfer.FirstFrame %s"), *Proxy->ModelName);
+			UE_LOG(LogStyleTransferPrecache, Log, TEXT("First stylized frame of '%s' (model %s): %d of the plan's %d compute PSOs were not precached. Check the engine's PSO stats at the StyleTransfer.FirstFrame CSV event or trace bookmark for pipelines created outside the plan."),
+				*Proxy->ModelName,
+				Proxy->bWarmedUp ? TEXT("warmed up") : TEXT("not warmed up"),
+				RuntimeCreations,
+				ComputeShaders.Num());
+		}
+		LastReportedProxy = Proxy;
+	}
+}
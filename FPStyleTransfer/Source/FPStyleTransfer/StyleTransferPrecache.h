@@ -0,0 +1,47 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MyNeuralNetwork.h"
+
+namespace UE::NNE
+{
+	class IModelInstanceRDG;
+}
+
+namespace StyleTransferPasses
+{
+	struct FDispatchPlan;
+}
+
+/**
+ * Keeps pipeline creation off the first stylized frame: the compute PSOs of every style transfer shader permutation
+ * are created when the module registers its view extension, and each model is run once on a dummy frame when its
+ * style loads so the runtime creates its own kernels' pipelines then.
+ */
+namespace StyleTransferPrecache
+{
+	/**
+	 * Creates the compute PSOs of all style transfer global shader permutations. In the editor it waits for shader
+	 * compilation to finish first. Game thread; the work runs on the render thread.
+	 */
+	void PrecacheShaders();
+
+	/** Cancels a precache still waiting for the shader compiler. Game thread. */
+	void Shutdown();
+
+	/**
+	 * Runs Instance (the proxy's own when null) once over a black frame, one batch slice per SliceWeights entry (the
+	 * proxy's style weights when empty). Conv-net proxies run their passes instead. Game thread; no-op when
+	 * r.RealtimeStyleTransfer.WarmUp is 0 or the proxy's own instance already ran.
+	 */
+	void WarmUp(const FStyleTransferProxyPtr& Proxy, const TSharedPtr<UE::NNE::IModelInstanceRDG>& Instance = nullptr, TArray<TArray<float>> SliceWeights = {});
+
+	/**
+	 * Creates any compute PSO of Plan that PrecacheShaders missed and counts it in stat StyleTransfer. The first plan of
+	 * each style is built on its first stylized frame, which is logged and marked with a CSV event and trace bookmark
+	 * so the engine's PSO stats of that frame can be checked. Render thread only.
+	 */
+	void EnsurePipelines(const StyleTransferPasses::FDispatchPlan& Plan);
+}
@@ -0,0 +1,404 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferRenderTargetSubsystem.h"
+
+#include "Engine/TextureRenderTarget2D.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "SceneView.h"
+#include "SceneViewExtension.h"
+#include "StyleTransferComponent.h"
+#include "StyleTransferPasses.h"
+#include "TextureResource.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferRenderTargets, Log, All);
+
+namespace RealtimeStyleTransfer
+{
+	static int32 RenderTargetsMaxPerFrame = 4;
+	static FAutoConsoleVariableRef CVarRenderTargetsMaxPerFrame(
+		TEXT("r.RealtimeStyleTransfer.RenderTargets.MaxPerFrame"),
+		RenderTargetsMaxPerFrame,
+		TEXT("Maximum number of render targets stylized per frame. Lower priority targets that are due are deferred to later frames."),
+		ECVF_RenderThreadSafe);
+
+	static int32 RenderTargetsMaxBatch = 4;
+	static FAutoConsoleVariableRef CVarRenderTargetsMaxBatch(
+		TEXT("r.RealtimeStyleTransfer.RenderTargets.MaxBatch"),
+		RenderTargetsMaxBatch,
+		TEXT("Largest batch (N) used when several render targets share a model. Requires a model with a symbolic batch dimension."),
+		ECVF_Default);
+}
+
+/** Model instances of one proxy, indexed by batch size - 1. Immutable once handed to the render thread. */
+struct FStyleTransferBatchInstances
+{
+	TWeakPtr<FStyleTransferProxy, ESPMode::ThreadSafe> Proxy;
+	TArray<TSharedPtr<UE::NNE::IModelInstanceRDG>> ByBatchSize;
+};
+
+struct FStyleTransferRenderTargetRequest
+{
+	FObjectKey Key;
+	FTextureRenderTargetResource* Resource = nullptr;
+	FStyleTransferProxyPtr Proxy;
+	TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe> Instances;
+	double RefreshInterval = 0.0;
+	int32 Priority = 0;
+};
+
+/**
+ * Render thread side of the service: keeps per-target due times and builds the batched graph. Scene captures render
+ * before the main view family of their frame, so the requests run from its pre-render hook once per frame.
+ */
+class FStyleTransferRenderTargetScheduler : public FWorldSceneViewExtension
+{
+public:
+	FStyleTransferRenderTargetScheduler(const FAutoRegister& AutoRegister, UWorld* InWorld)
+		: FWorldSceneViewExtension(AutoRegister, InWorld)
+	{
+	}
+
+	/** Replaces the requests the next main view family serves. Render thread only. */
+	void SetRequests_RenderThread(TArray<FStyleTransferRenderTargetRequest> Requests)
+	{
+		PendingRequests_RenderThread = MoveTemp(Requests);
+	}
+
+	//~ ISceneViewExtension interface
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override;
+
+private:
+	void Execute_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FStyleTransferRenderTargetRequest> Requests);
+	void AddBatch(FRDGBuilder& GraphBuilder, TConstArrayView<const FStyleTransferRenderTargetRequest*> Batch);
+	void AddUpscaleToTarget(FRDGBuilder& GraphBuilder, FRDGTextureRef StylizedTexture, FRDGTextureRef Target);
+
+	TMap<FObjectKey, double> NextDueTime;
+	TArray<FStyleTransferRenderTargetRequest> PendingRequests_RenderThread;
+	uint32 LastExecutedFrame = MAX_uint32;
+};
+
+void FStyleTransferRenderTargetScheduler::PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily)
+{
+	// Scene capture families render before the main one; split screen renders several main families per frame.
+	const bool bSceneCapture = !InViewFamily.Views.IsEmpty() && InViewFamily.Views[0]->bIsSceneCapture;
+	if (bSceneCapture || InViewFamily.FrameNumber == LastExecutedFrame)
+	{
+		return;
+	}
+	LastExecutedFrame = InViewFamily.FrameNumber;
+
+	Execute_RenderThread(RHICmdList, MoveTemp(PendingRequests_RenderThread));
+	PendingRequests_RenderThread.Reset();
+}
+
+void FStyleTransferRenderTargetScheduler::Execute_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FStyleTransferRenderTargetRequest> Requests)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	TArray<const FStyleTransferRenderTargetRequest*> Due;
+	for (const FStyleTransferRenderTargetRequest& Request : Requests)
+	{
+		const double* NextDue = NextDueTime.Find(Request.Key);
+		if (!NextDue || *NextDue <= Now)
+		{
+			Due.Add(&Request);
+		}
+	}
+
+	if (Due.IsEmpty())
+	{
+		return;
+	}
+
+	// Highest priority first, then the target that has waited longest.
+	Due.Sort([this](const FStyleTransferRenderTargetRequest& A, const FStyleTransferRenderTargetRequest& B)
+	{
+		if (A.Priority != B.Priority)
+		{
+			return A.Priority > B.Priority;
+		}
+		return NextDueTime.FindRef(A.Key) < NextDueTime.FindRef(B.Key);
+	});
+
+	const int32 Budget = FMath::Max(RealtimeStyleTransfer::RenderTargetsMaxPerFrame, 1);
+	if (Due.Num() > Budget)
+	{
+		UE_LOG(LogStyleTransferRenderTargets, VeryVerbose, TEXT("Deferring %d render target(s) to later frames."), Due.Num() - Budget);
+		Due.SetNum(Budget);
+	}
+
+	// Stable sort keeps the priority order inside each model's group.
+	Due.StableSort([](const FStyleTransferRenderTargetRequest& A, const FStyleTransferRenderTargetRequest& B)
+	{
+		return A.Proxy.Get() < B.Proxy.Get();
+	});
+
+	FRDGBuilder GraphBuilder(RHICmdList, RDG_EVENT_NAME("StyleTransfer.RenderTargets"));
+
+	int32 GroupStart = 0;
+	while (GroupStart < Due.Num())
+	{
+		const FStyleTransferRenderTargetRequest& First = *Due[GroupStart];
+		const int32 MaxBatch = FMath::Max(First.Instances->ByBatchSize.Num(), 1);
+
+		int32 GroupEnd = GroupStart + 1;
+		while (GroupEnd < Due.Num() && Due[GroupEnd]->Proxy == First.Proxy && GroupEnd - GroupStart < MaxBatch)
+		{
+			++GroupEnd;
+		}
+
+		AddBatch(GraphBuilder, MakeArrayView(Due.GetData() + GroupStart, GroupEnd - GroupStart));
+		GroupStart = GroupEnd;
+	}
+
+	GraphBuilder.Execute();
+
+	for (const FStyleTransferRenderTargetRequest* Request : Due)
+	{
+		NextDueTime.Add(Request->Key, Now + Request->RefreshInterval);
+	}
+
+	// Forget targets that are no longer registered.
+	for (auto It = NextDueTime.CreateIterator(); It; ++It)
+	{
+		if (!Requests.ContainsByPredicate([&It](const FStyleTransferRenderTargetRequest& Request) { return Request.Key == It.Key(); }))
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FStyleTransferRenderTargetScheduler::AddBatch(FRDGBuilder& GraphBuilder, TConstArrayView<const FStyleTransferRenderTargetRequest*> Batch)
+{
+	const FStyleTransferProxy& Proxy = *Batch[0]->Proxy;
+	const uint32 BatchSize = Batch.Num();
+
+	// The built-in executor has no batched instances; each target runs on its own.
+	if (Proxy.ConvNet.IsValid())
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.RenderTargetConvNet (N=%u)", BatchSize);
+		for (const FStyleTransferRenderTargetRequest* Request : Batch)
+		{
+			FRDGTextureRef Target = GraphBuilder.RegisterExternalTexture(
+				CreateRenderTarget(Request->Resource->GetRenderTargetTexture(), TEXT("StyleTransfer.RenderTarget")));
+			const FIntRect TargetRect(FIntPoint::ZeroValue, Target->Desc.Extent);
+			if (FRDGTextureRef StylizedTexture = Proxy.ConvNet->AddPasses(GraphBuilder, Target, TargetRect, Proxy.InputResolution))
+			{
+				AddUpscaleToTarget(GraphBuilder, StylizedTexture, Target);
+			}
+		}
+		return;
+	}
+
+	const TArray<TSharedPtr<UE::NNE::IModelInstanceRDG>>& Instances = Batch[0]->Instances->ByBatchSize;
+	if (!Instances.IsValidIndex(BatchSize - 1) || !Instances[BatchSize - 1].IsValid())
+	{
+		return;
+	}
+	const TSharedPtr<UE::NNE::IModelInstanceRDG>& Instance = Instances[BatchSize - 1];
+
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer.RenderTargetBatch (N=%u)", BatchSize);
+
+	FRDGBufferRef InputTensor = StyleTransferPasses::CreateInputTensor(GraphBuilder, Proxy, BatchSize);
+	FRDGBufferRef OutputTensor = StyleTransferPasses::CreateOutputTensor(GraphBuilder, Proxy, BatchSize);
+
+	TArray<FRDGTextureRef, TInlineAllocator<8>> Targets;
+	for (uint32 BatchIndex = 0; BatchIndex < BatchSize; ++BatchIndex)
+	{
+		FRDGTextureRef Target = GraphBuilder.RegisterExternalTexture(
+			CreateRenderTarget(Batch[BatchIndex]->Resource->GetRenderTargetTexture(), TEXT("StyleTransfer.RenderTarget")));
+		Targets.Add(Target);
+
+		StyleTransferPasses::AddEncodePass(GraphBuilder, Proxy, Target, FIntRect(FIntPoint::ZeroValue, Target->Desc.Extent), InputTensor, BatchIndex);
+	}
+
+	if (!StyleTransferPasses::AddInferencePass(GraphBuilder, Proxy, *Instance, InputTensor, OutputTensor))
+	{
+		return;
+	}
+
+	for (uint32 BatchIndex = 0; BatchIndex < BatchSize; ++BatchIndex)
+	{
+		FRDGTextureRef StylizedTexture = StyleTransferPasses::AddDecodePass(GraphBuilder, Proxy, OutputTensor, BatchIndex);
+		AddUpscaleToTarget(GraphBuilder, StylizedTexture, Targets[BatchIndex]);
+	}
+}
+
+void FStyleTransferRenderTargetScheduler::AddUpscaleToTarget(FRDGBuilder& GraphBuilder, FRDGTextureRef StylizedTexture, FRDGTextureRef Target)
+{
+	const bool bRaster = StyleTransferPasses::UseRasterComposite();
+
+	FRDGTextureDesc OutputDesc = Target->Desc;
+	if (bRaster)
+	{
+		OutputDesc.Flags |= TexCreate_ShaderResource | TexCreate_RenderTargetable;
+		OutputDesc.Flags &= ~TexCreate_UAV;
+	}
+	else
+	{
+		OutputDesc.Flags |= TexCreate_ShaderResource | TexCreate_UAV;
+	}
+	FRDGTextureRef OutputTexture = GraphBuilder.CreateTexture(OutputDesc, TEXT("StyleTransfer.RenderTargetOutput"));
+
+	const FIntRect TargetRect(FIntPoint::ZeroValue, OutputDesc.Extent);
+	if (bRaster)
+	{
+		StyleTransferPasses::AddRasterUpscalePass(GraphBuilder, StylizedTexture, TargetRect, OutputTexture, Target, TargetRect);
+	}
+	else
+	{
+		StyleTransferPasses::AddUpscalePass(GraphBuilder, StylizedTexture, TargetRect, OutputTexture, Target, TargetRect);
+	}
+	AddCopyTexturePass(GraphBuilder, OutputTexture, Target);
+}
+
+void UStyleTransferRenderTargetSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Scheduler = FSceneViewExtensions::NewExtension<FStyleTransferRenderTargetScheduler>(GetWorld());
+}
+
+void UStyleTransferRenderTargetSubsystem::Deinitialize()
+{
+	Components.Empty();
+	ComponentModels.Empty();
+	BatchInstances.Empty();
+
+	// The render thread may still reference the scheduler; it is released by the last queued command.
+	Scheduler.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UStyleTransferRenderTargetSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UStyleTransferRenderTargetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UStyleTransferRenderTargetSubsystem, STATGROUP_Tickables);
+}
+
+void UStyleTransferRenderTargetSubsystem::RegisterComponent(UStyleTransferComponent* Component)
+{
+	Components.AddUnique(Component);
+}
+
+void UStyleTransferRenderTargetSubsystem::UnregisterComponent(UStyleTransferComponent* Component)
+{
+	Components.Remove(Component);
+}
+
+FStyleTransferProxyPtr UStyleTransferRenderTargetSubsystem::ResolveProxy(const UStyleTransferComponent& Component)
+{
+	if (!Component.ModelData)
+	{
+		return FRealtimeStyleTransferViewExtension::GetActiveProxy();
+	}
+
+	const TPair<TObjectKey<UNNEModelData>, FName> ModelKey(Component.ModelData.Get(), Component.RuntimeName);
+	if (const TStrongObjectPtr<UMyNeuralNetwork>* Existing = ComponentModels.Find(ModelKey))
+	{
+		return (*Existing)->GetProxy();
+	}
+
+	UMyNeuralNetwork* Network = NewObject<UMyNeuralNetwork>();
+	if (!Network->Initialize(Component.ModelData, Component.RuntimeName))
+	{
+		UE_LOG(LogStyleTransferRenderTargets, Error, TEXT("Failed to initialize model '%s' for '%s'."),
+			*Component.ModelData->GetName(),
+			*Component.GetPathName());
+	}
+
+	// Failed models are cached too so initialization is not retried every frame.
+	ComponentModels.Add(ModelKey, TStrongObjectPtr<UMyNeuralNetwork>(Network));
+	return Network->GetProxy();
+}
+
+TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe> UStyleTransferRenderTargetSubsystem::GetBatchInstances(const FStyleTransferProxyPtr& Proxy)
+{
+	if (TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe>* Existing = BatchInstances.Find(Proxy.Get()))
+	{
+		if ((*Existing)->Proxy.Pin() == Proxy)
+		{
+			return *Existing;
+		}
+	}
+
+	TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe> Instances = MakeShared<FStyleTransferBatchInstances, ESPMode::ThreadSafe>();
+	Instances->Proxy = Proxy;
+
+	const int32 MaxBatch = Proxy->bDynamicBatch ? FMath::Max(RealtimeStyleTransfer::RenderTargetsMaxBatch, 1) : 1;
+	for (int32 BatchSize = 1; BatchSize <= MaxBatch; ++BatchSize)
+	{
+		TSharedPtr<UE::NNE::IModelInstanceRDG> Instance = UMyNeuralNetwork::CreateBatchedInstance(*Proxy, BatchSize);
+		if (!Instance.IsValid())
+		{
+			break;
+		}
+		Instances->ByBatchSize.Add(Instance);
+	}
+
+	UE_LOG(LogStyleTransferRenderTargets, Log, TEXT("Created %d batched model instance(s) for render target stylization."), Instances->ByBatchSize.Num());
+
+	BatchInstances.Add(Proxy.Get(), Instances);
+	return Instances;
+}
+
+void UStyleTransferRenderTargetSubsystem::Tick(float DeltaTime)
+{
+	for (auto It = BatchInstances.CreateIterator(); It; ++It)
+	{
+		if (!It.Value()->Proxy.IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	TArray<FStyleTransferRenderTargetRequest> Requests;
+
+	Components.RemoveAll([](const TWeakObjectPtr<UStyleTransferComponent>& Component) { return !Component.IsValid(); });
+	for (const TWeakObjectPtr<UStyleTransferComponent>& WeakComponent : Components)
+	{
+		UStyleTransferComponent* Component = WeakComponent.Get();
+		FTextureRenderTargetResource* Resource = Component->RenderTarget ? Component->RenderTarget->GameThread_GetRenderTargetResource() : nullptr;
+		if (!Resource || !Component->IsActive())
+		{
+			continue;
+		}
+
+		FStyleTransferProxyPtr Proxy = ResolveProxy(*Component);
+		if (!Proxy.IsValid())
+		{
+			continue;
+		}
+
+		TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe> Instances = GetBatchInstances(Proxy);
+		if (Instances->ByBatchSize.IsEmpty())
+		{
+			continue;
+		}
+
+		FStyleTransferRenderTargetRequest& Request = Requests.AddDefaulted_GetRef();
+		Request.Key = FObjectKey(Component);
+		Request.Resource = Resource;
+		Request.Proxy = MoveTemp(Proxy);
+		Request.Instances = MoveTemp(Instances);
+		Request.RefreshInterval = Component->RefreshRate > 0.0f ? 1.0 / Component->RefreshRate : 0.0;
+		Request.Priority = Component->Priority;
+	}
+
+	// Sent even when empty, so targets that stopped being due are not served from an older frame's requests.
+	ENQUEUE_RENDER_COMMAND(StyleTransferRenderTargets)(
+		[Scheduler = Scheduler, Requests = MoveTemp(Requests)](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			Scheduler->SetRequests_RenderThread(MoveTemp(Requests));
+		});
+}
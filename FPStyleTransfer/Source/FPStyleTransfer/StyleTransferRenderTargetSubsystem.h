@@ -0,0 +1,50 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/StrongObjectPtr.h"
+#include "MyNeuralNetwork.h"
+#include "StyleTransferRenderTargetSubsystem.generated.h"
+
+class UStyleTransferComponent;
+class FStyleTransferRenderTargetScheduler;
+struct FStyleTransferBatchInstances;
+
+/**
+ * Collects the render targets of UStyleTransferComponents each frame and hands them to a render-thread
+ * scheduler that picks the due requests within budget and stylizes them with batched inferences. The scheduler is a
+ * scene view extension of the world and runs when the frame's main view family starts rendering, after that frame's
+ * scene captures, so targets are stylized after they were rendered and before the main view samples them.
+ */
+UCLASS()
+class FPSTYLETRANSFER_API UStyleTransferRenderTargetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	//~ USubsystem interface
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//~ FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterComponent(UStyleTransferComponent* Component);
+	void UnregisterComponent(UStyleTransferComponent* Component);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FStyleTransferProxyPtr ResolveProxy(const UStyleTransferComponent& Component);
+	TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe> GetBatchInstances(const FStyleTransferProxyPtr& Proxy);
+
+	TArray<TWeakObjectPtr<UStyleTransferComponent>> Components;
+	/** Models of components that set their own, by model and runtime. */
+	TMap<TPair<TObjectKey<UNNEModelData>, FName>, TStrongObjectPtr<UMyNeuralNetwork>> ComponentModels;
+	TMap<const FStyleTransferProxy*, TSharedPtr<FStyleTransferBatchInstances, ESPMode::ThreadSafe>> BatchInstances;
+	TSharedPtr<FStyleTransferRenderTargetScheduler, ESPMode::ThreadSafe> Scheduler;
+};
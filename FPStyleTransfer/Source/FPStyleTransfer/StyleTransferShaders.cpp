@@ -17,6 +17,7 @@ namespace FPStyleTransferShaders
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_ENCODE"), 1);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_DECODE"), 0);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_UPSCALE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_COMPOSITE"), 0);
 	}
 
 	IMPLEMENT_GLOBAL_SHADER(FEncodeCS, "/FPStyleTransfer/StyleTransfer.usf", "StyleTransferEncodeCS", SF_Compute);
@@ -33,6 +34,7 @@ namespace FPStyleTransferShaders
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_ENCODE"), 0);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_DECODE"), 1);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_UPSCALE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_COMPOSITE"), 0);
 	}
 
 	IMPLEMENT_GLOBAL_SHADER(FDecodeCS, "/FPStyleTransfer/StyleTransfer.usf", "StyleTransferDecodeCS", SF_Compute);
@@ -49,7 +51,169 @@ namespace FPStyleTransferShaders
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_ENCODE"), 0);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_DECODE"), 0);
 		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_UPSCALE"), 1);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_COMPOSITE"), 0);
 	}
 
 	IMPLEMENT_GLOBAL_SHADER(FUpscaleCS, "/FPStyleTransfer/StyleTransfer.usf", "StyleTransferUpscaleCS", SF_Compute);
+
+	bool FUpscalePS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FUpscalePS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_ENCODE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_DECODE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_UPSCALE"), 1);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_COMPOSITE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_RASTER_UPSCALE"), 1);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FUpscalePS, "/FPStyleTransfer/StyleTransfer.usf", "StyleTransferUpscalePS", SF_Pixel);
+
+	bool FFoveatedCompositeCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FFoveatedCompositeCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_ENCODE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_DECODE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_UPSCALE"), 0);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_VARIANT_COMPOSITE"), 1);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FFoveatedCompositeCS, "/FPStyleTransfer/StyleTransfer.usf", "StyleTransferFoveatedCompositeCS", SF_Compute);
+
+	bool FStencilCompositeCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FStencilCompositeCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FStencilCompositeCS, "/FPStyleTransfer/StyleTransferStencil.usf", "StyleTransferStencilCompositeCS", SF_Compute);
+
+	namespace
+	{
+		void SetTileDefines(FShaderCompilerEnvironment& OutEnvironment, int32 Classify, int32 Copy)
+		{
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_TILES_VARIANT_CLASSIFY"), Classify);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_TILES_VARIANT_COPY"), Copy);
+		}
+	}
+
+	bool FTileClassifyCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FTileClassifyCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetTileDefines(OutEnvironment, 1, 0);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FTileClassifyCS, "/FPStyleTransfer/StyleTransferTiles.usf", "StyleTransferTileClassifyCS", SF_Compute);
+
+	bool FTileCopyVS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FTileCopyVS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetTileDefines(OutEnvironment, 0, 1);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FTileCopyVS, "/FPStyleTransfer/StyleTransferTiles.usf", "StyleTransferTileCopyVS", SF_Vertex);
+
+	bool FTileCopyPS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FTileCopyPS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetTileDefines(OutEnvironment, 0, 1);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FTileCopyPS, "/FPStyleTransfer/StyleTransferTiles.usf", "StyleTransferTileCopyPS", SF_Pixel);
+
+	bool FTensorRemapCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FTensorRemapCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FTensorRemapCS, "/FPStyleTransfer/StyleTransferChain.usf", "StyleTransferTensorRemapCS", SF_Compute);
+
+	namespace
+	{
+		void SetConvNetDefines(FShaderCompilerEnvironment& OutEnvironment, int32 Conv, int32 InstanceNorm, int32 Elementwise)
+		{
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_THREADGROUP_SIZE"), kThreadGroupSize);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_CONVNET_REDUCTION_SIZE"), FConvNetInstanceNormCS::kReductionGroupSize);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_CONVNET_VARIANT_CONV"), Conv);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_CONVNET_VARIANT_INSTANCE_NORM"), InstanceNorm);
+			OutEnvironment.SetDefine(TEXT("STYLE_TRANSFER_CONVNET_VARIANT_ELEMENTWISE"), Elementwise);
+		}
+	}
+
+	bool FConvNetConvCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FConvNetConvCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetConvNetDefines(OutEnvironment, 1, 0, 0);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FConvNetConvCS, "/FPStyleTransfer/StyleTransferConvNet.usf", "StyleTransferConvNetConvCS", SF_Compute);
+
+	bool FConvNetInstanceNormCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FConvNetInstanceNormCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetConvNetDefines(OutEnvironment, 0, 1, 0);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FConvNetInstanceNormCS, "/FPStyleTransfer/StyleTransferConvNet.usf", "StyleTransferConvNetInstanceNormCS", SF_Compute);
+
+	bool FConvNetElementwiseCS::ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return true;
+	}
+
+	void FConvNetElementwiseCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		SetConvNetDefines(OutEnvironment, 0, 0, 1);
+	}
+
+	IMPLEMENT_GLOBAL_SHADER(FConvNetElementwiseCS, "/FPStyleTransfer/StyleTransferConvNet.usf", "StyleTransferConvNetElementwiseCS", SF_Compute);
 }
@@ -13,12 +13,64 @@ namespace FPStyleTransferShaders
 {
 	static constexpr int32 kThreadGroupSize = 8;
 
+	/** Element type of the tensor the encode/decode passes touch. Values match STYLE_TRANSFER_TENSOR_* in StyleTransfer.usf. */
+	enum class ETensorType : int32
+	{
+		Float,
+		Unsigned8,
+		Signed8,
+		MAX
+	};
+
+	class FTensorTypeDim : SHADER_PERMUTATION_ENUM_CLASS("STYLE_TRANSFER_TENSOR_TYPE", ETensorType);
+
+	/** HUD rects r.RealtimeStyleTransfer.Mask accepts. Must match STYLE_TRANSFER_MAX_MASK_RECTS in StyleTransferMask.ush. */
+	static constexpr int32 kMaxMaskRects = 8;
+
+	/** Indirect arguments of a tile classification: dispatch arguments, then draw arguments. Must match StyleTransferTiles.usf. */
+	static constexpr uint32 kTileDispatchArgsOffset = 0;
+	static constexpr uint32 kTileDrawArgsOffset = 4 * sizeof(uint32);
+	static constexpr uint32 kTileIndirectArgsCount = 8;
+
+	/** Stylized textures one stencil composite selects between. Must match the LayerTexture* of StyleTransferStencil.usf. */
+	static constexpr int32 kMaxStencilStyles = 4;
+	/** Stencil layer of custom stencil values that keep the original frame. Must match STYLE_TRANSFER_STENCIL_LAYER_ORIGINAL. */
+	static constexpr uint8 kStencilLayerOriginal = 0xFF;
+
+	/** Pixels r.RealtimeStyleTransfer.Mask keeps unstylized, tested by IsStyleTransferMasked in StyleTransferMask.ush. */
+	BEGIN_SHADER_PARAMETER_STRUCT(FMaskParameters, )
+		SHADER_PARAMETER_ARRAY(FVector4f, MaskRects, [kMaxMaskRects])
+		SHADER_PARAMETER(FVector4f, MaskInvDeviceZToWorldZ)
+		SHADER_PARAMETER(FVector2f, MaskSceneViewMin)
+		SHADER_PARAMETER(FVector2f, MaskSceneViewSize)
+		SHADER_PARAMETER(uint32, MaskRectCount)
+		SHADER_PARAMETER(uint32, MaskStencilBits)
+		SHADER_PARAMETER(float, MaskSkyDistance)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<uint2>, MaskStencilTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float>, MaskDepthTexture)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/** Guide of the joint bilateral upscale in StyleTransferUpscale.ush; only bound with STYLE_TRANSFER_GUIDED_UPSCALE. */
+	BEGIN_SHADER_PARAMETER_STRUCT(FGuideParameters, )
+		SHADER_PARAMETER(FVector2f, GuideViewMin)
+		SHADER_PARAMETER(FVector2f, GuideViewSize)
+		SHADER_PARAMETER(FVector2f, GuideExtentInverse)
+		SHADER_PARAMETER(float, SpatialFalloff)
+		SHADER_PARAMETER(float, RangeFalloff)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, GuideTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, GuideSampler)
+	END_SHADER_PARAMETER_STRUCT()
+
 	class FEncodeCS : public FGlobalShader
 	{
 	public:
 		DECLARE_GLOBAL_SHADER(FEncodeCS);
 		SHADER_USE_PARAMETER_STRUCT(FEncodeCS, FGlobalShader);
 
+		/** Averages each tensor element's whole source footprint through a groupshared tile instead of taking one bilinear tap. */
+		class FAreaFilterDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_AREA_FILTER");
+		using FPermutationDomain = TShaderPermutationDomain<FTensorTypeDim, FAreaFilterDim>;
+
 		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 			SHADER_PARAMETER(FIntPoint, ModelResolution)
 			SHADER_PARAMETER(FVector2f, ViewMin)
@@ -27,6 +79,9 @@ namespace FPStyleTransferShaders
 			SHADER_PARAMETER(float, EncodeScale)
 			SHADER_PARAMETER(float, EncodeBias)
 			SHADER_PARAMETER(uint32, ChannelCount)
+			SHADER_PARAMETER(uint32, TensorOffset)
+			SHADER_PARAMETER(float, QuantizationScale)
+			SHADER_PARAMETER(int32, QuantizationZeroPoint)
 			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, SourceTexture)
 			SHADER_PARAMETER_SAMPLER(SamplerState, SourceSampler)
 			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputTensor)
@@ -42,11 +97,16 @@ namespace FPStyleTransferShaders
 		DECLARE_GLOBAL_SHADER(FDecodeCS);
 		SHADER_USE_PARAMETER_STRUCT(FDecodeCS, FGlobalShader);
 
+		using FPermutationDomain = TShaderPermutationDomain<FTensorTypeDim>;
+
 		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 			SHADER_PARAMETER(FIntPoint, ModelResolution)
 			SHADER_PARAMETER(float, DecodeScale)
 			SHADER_PARAMETER(float, DecodeBias)
 			SHADER_PARAMETER(uint32, ChannelCount)
+			SHADER_PARAMETER(uint32, TensorOffset)
+			SHADER_PARAMETER(float, QuantizationScale)
+			SHADER_PARAMETER(int32, QuantizationZeroPoint)
 			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputTensor)
 			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, StylizedOutput)
 		END_SHADER_PARAMETER_STRUCT()
@@ -61,16 +121,311 @@ namespace FPStyleTransferShaders
 		DECLARE_GLOBAL_SHADER(FUpscaleCS);
 		SHADER_USE_PARAMETER_STRUCT(FUpscaleCS, FGlobalShader);
 
+		/** Joint bilateral upsampling: low-res texels are weighted by how well their guide color matches the full-res guide. */
+		class FGuidedDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_GUIDED_UPSCALE");
+		/** One group per classified tile, dispatched indirectly; masked pixels keep OriginalTexture. */
+		class FTiledDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_TILED_UPSCALE");
+		using FPermutationDomain = TShaderPermutationDomain<FGuidedDim, FTiledDim>;
+
 		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 			SHADER_PARAMETER(FIntPoint, SourceResolution)
 			SHADER_PARAMETER(FIntPoint, TargetResolution)
 			SHADER_PARAMETER(FIntPoint, TargetOffset)
 			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, SourceTexture)
 			SHADER_PARAMETER_SAMPLER(SamplerState, SourceSampler)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FGuideParameters, Guide)
+			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, TargetTexture)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FMaskParameters, Mask)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, TileList)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, OriginalTexture)
+			RDG_BUFFER_ACCESS(TileIndirectArgs, ERHIAccess::IndirectArgs)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/** FUpscaleCS as a full-screen pixel shader draw, which leaves render target compression on the target intact. */
+	class FUpscalePS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FUpscalePS);
+		SHADER_USE_PARAMETER_STRUCT(FUpscalePS, FGlobalShader);
+
+		using FPermutationDomain = TShaderPermutationDomain<FUpscaleCS::FGuidedDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER_STRUCT_INCLUDE(FUpscaleCS::FParameters, Upscale)
+			RENDER_TARGET_BINDING_SLOTS()
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/** Blends a stylized fovea into the background (stylized periphery or the original frame) with a feathered edge. */
+	class FFoveatedCompositeCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FFoveatedCompositeCS);
+		SHADER_USE_PARAMETER_STRUCT(FFoveatedCompositeCS, FGlobalShader);
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, TargetResolution)
+			SHADER_PARAMETER(FIntPoint, TargetOffset)
+			SHADER_PARAMETER(FVector2f, FoveaMin)
+			SHADER_PARAMETER(FVector2f, FoveaSize)
+			SHADER_PARAMETER(float, FeatherWidth)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, BackgroundTexture)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, FoveaTexture)
+			SHADER_PARAMETER_SAMPLER(SamplerState, FoveaSampler)
 			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, TargetTexture)
 		END_SHADER_PARAMETER_STRUCT()
 
 		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
 		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
 	};
+
+	/**
+	 * Replaces the pixels whose custom stencil selects a stencil style with that style's stylized texture (upscaled like
+	 * the active style, guided by the original frame when FGuidedDim is set) or the original frame, skipping pixels of
+	 * the active style and pixels masked by r.RealtimeStyleTransfer.Mask.
+	 */
+	class FStencilCompositeCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FStencilCompositeCS);
+		SHADER_USE_PARAMETER_STRUCT(FStencilCompositeCS, FGlobalShader);
+
+		using FPermutationDomain = TShaderPermutationDomain<FUpscaleCS::FGuidedDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, TargetResolution)
+			SHADER_PARAMETER(FIntPoint, TargetOffset)
+			SHADER_PARAMETER(FVector2f, StencilViewMin)
+			SHADER_PARAMETER(FVector2f, StencilViewSize)
+			SHADER_PARAMETER_ARRAY(FUintVector4, StencilLayers, [16])
+			SHADER_PARAMETER_STRUCT_INCLUDE(FMaskParameters, Mask)
+			SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<uint2>, StencilTexture)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, LayerTexture0)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, LayerTexture1)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, LayerTexture2)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, LayerTexture3)
+			SHADER_PARAMETER_SAMPLER(SamplerState, LayerSampler)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FGuideParameters, Guide)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, OriginalTexture)
+			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, TargetTexture)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/**
+	 * Lists the kThreadGroupSize tiles of the view with at least one unmasked pixel and counts them into the dispatch
+	 * and draw arguments of TileIndirectArgs, whose counts must be cleared first.
+	 */
+	class FTileClassifyCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FTileClassifyCS);
+		SHADER_USE_PARAMETER_STRUCT(FTileClassifyCS, FGlobalShader);
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, TargetResolution)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FMaskParameters, Mask)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, TileIndirectArgs)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, TileListOutput)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/** Shared by the tile copy shaders: one instanced quad per classified tile, drawn indirectly into a render target. */
+	BEGIN_SHADER_PARAMETER_STRUCT(FTileCopyParameters, )
+		SHADER_PARAMETER(FIntPoint, TargetResolution)
+		SHADER_PARAMETER(FIntPoint, TargetOffset)
+		SHADER_PARAMETER(FVector2f, TargetExtentInverse)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, TileList)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, CopySourceTexture)
+		RDG_BUFFER_ACCESS(TileIndirectArgs, ERHIAccess::IndirectArgs)
+		RENDER_TARGET_BINDING_SLOTS()
+	END_SHADER_PARAMETER_STRUCT()
+
+	class FTileCopyVS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FTileCopyVS);
+		SHADER_USE_PARAMETER_STRUCT(FTileCopyVS, FGlobalShader);
+		using FParameters = FTileCopyParameters;
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	class FTileCopyPS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FTileCopyPS);
+		SHADER_USE_PARAMETER_STRUCT(FTileCopyPS, FGlobalShader);
+		using FParameters = FTileCopyParameters;
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/**
+	 * Hands one chain stage's CHW output tensor to the next stage: dequantizes, rescales to the next model's value range
+	 * and requantizes element by element, without a round trip through a texture.
+	 */
+	class FTensorRemapCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FTensorRemapCS);
+		SHADER_USE_PARAMETER_STRUCT(FTensorRemapCS, FGlobalShader);
+
+		class FSourceTensorTypeDim : SHADER_PERMUTATION_ENUM_CLASS("STYLE_TRANSFER_REMAP_SOURCE_TYPE", ETensorType);
+		class FTargetTensorTypeDim : SHADER_PERMUTATION_ENUM_CLASS("STYLE_TRANSFER_REMAP_TARGET_TYPE", ETensorType);
+		using FPermutationDomain = TShaderPermutationDomain<FSourceTensorTypeDim, FTargetTensorTypeDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, Resolution)
+			SHADER_PARAMETER(uint32, ChannelCount)
+			SHADER_PARAMETER(float, RemapScale)
+			SHADER_PARAMETER(float, SourceQuantizationScale)
+			SHADER_PARAMETER(int32, SourceQuantizationZeroPoint)
+			SHADER_PARAMETER(float, TargetQuantizationScale)
+			SHADER_PARAMETER(int32, TargetQuantizationZeroPoint)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, SourceTensor)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, TargetTensor)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/** Element operations of the built-in conv-net executor. Values match STYLE_TRANSFER_CONVNET_OP_* in StyleTransferConvNet.usf. */
+	enum class EConvNetElementwiseOp : int32
+	{
+		Add,
+		Upsample,
+		Decode,
+		MAX
+	};
+
+	/** Activation and output affine applied at the end of every conv-net layer. */
+	BEGIN_SHADER_PARAMETER_STRUCT(FConvNetLayerOutputParameters, )
+		SHADER_PARAMETER(uint32, ActivationType)
+		SHADER_PARAMETER(float, ClipMin)
+		SHADER_PARAMETER(float, ClipMax)
+		SHADER_PARAMETER(float, OutputScale)
+		SHADER_PARAMETER(float, OutputBias)
+	END_SHADER_PARAMETER_STRUCT()
+
+	/**
+	 * Direct convolution, four output channels per thread. The first layer samples the scene texture (fused encode) and
+	 * the last layer can write the stylized texture (fused decode).
+	 */
+	class FConvNetConvCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FConvNetConvCS);
+		SHADER_USE_PARAMETER_STRUCT(FConvNetConvCS, FGlobalShader);
+
+		class FInputTextureDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_CONVNET_INPUT_TEXTURE");
+		class FOutputTextureDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_CONVNET_OUTPUT_TEXTURE");
+		using FPermutationDomain = TShaderPermutationDomain<FInputTextureDim, FOutputTextureDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, InputResolution)
+			SHADER_PARAMETER(FIntPoint, OutputResolution)
+			SHADER_PARAMETER(uint32, InChannels)
+			SHADER_PARAMETER(uint32, OutChannels)
+			SHADER_PARAMETER(int32, KernelSize)
+			SHADER_PARAMETER(int32, Stride)
+			SHADER_PARAMETER(int32, Padding)
+			SHADER_PARAMETER(uint32, PaddingMode)
+			SHADER_PARAMETER(int32, InputUpsample)
+			SHADER_PARAMETER(uint32, BiasOffset)
+			SHADER_PARAMETER(uint32, PackedWeightOffset)
+			SHADER_PARAMETER(FVector2f, ViewMin)
+			SHADER_PARAMETER(FVector2f, ViewSize)
+			SHADER_PARAMETER(FVector2f, SourceExtent)
+			SHADER_PARAMETER(float, EncodeScale)
+			SHADER_PARAMETER(float, EncodeBias)
+			SHADER_PARAMETER(float, DecodeScale)
+			SHADER_PARAMETER(float, DecodeBias)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FConvNetLayerOutputParameters, LayerOutput)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, ScalarParameters)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float4>, PackedWeights)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputTensor)
+			SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float4>, SourceTexture)
+			SHADER_PARAMETER_SAMPLER(SamplerState, SourceSampler)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputTensor)
+			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	/** Instance normalization: a per-channel mean/variance reduction (stats permutation), then a per-pixel apply. */
+	class FConvNetInstanceNormCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FConvNetInstanceNormCS);
+		SHADER_USE_PARAMETER_STRUCT(FConvNetInstanceNormCS, FGlobalShader);
+
+		static constexpr int32 kReductionGroupSize = 256;
+
+		class FStatsDim : SHADER_PERMUTATION_BOOL("STYLE_TRANSFER_CONVNET_INSTANCE_NORM_STATS");
+		using FPermutationDomain = TShaderPermutationDomain<FStatsDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, Resolution)
+			SHADER_PARAMETER(uint32, Channels)
+			SHADER_PARAMETER(uint32, ScaleOffset)
+			SHADER_PARAMETER(uint32, BiasOffset)
+			SHADER_PARAMETER(float, Epsilon)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FConvNetLayerOutputParameters, LayerOutput)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, ScalarParameters)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputTensor)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, Stats)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, StatsOutput)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputTensor)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
+
+	class FConvNetElementwiseOpDim : SHADER_PERMUTATION_ENUM_CLASS("STYLE_TRANSFER_CONVNET_ELEMENTWISE_OP", EConvNetElementwiseOp);
+
+	/** Residual add, standalone nearest upsample (also used as a copy that carries an activation) and unfused decode. */
+	class FConvNetElementwiseCS : public FGlobalShader
+	{
+	public:
+		DECLARE_GLOBAL_SHADER(FConvNetElementwiseCS);
+		SHADER_USE_PARAMETER_STRUCT(FConvNetElementwiseCS, FGlobalShader);
+
+		using FPermutationDomain = TShaderPermutationDomain<FConvNetElementwiseOpDim>;
+
+		BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+			SHADER_PARAMETER(FIntPoint, InputResolution)
+			SHADER_PARAMETER(FIntPoint, OutputResolution)
+			SHADER_PARAMETER(uint32, Channels)
+			SHADER_PARAMETER(int32, UpsampleFactor)
+			SHADER_PARAMETER(float, DecodeScale)
+			SHADER_PARAMETER(float, DecodeBias)
+			SHADER_PARAMETER_STRUCT_INCLUDE(FConvNetLayerOutputParameters, LayerOutput)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputTensor)
+			SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, ResidualTensor)
+			SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputTensor)
+			SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		END_SHADER_PARAMETER_STRUCT()
+
+		static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters);
+		static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	};
 }
@@ -0,0 +1,511 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferSoakGameMode.h"
+#include "Algo/Accumulate.h"
+#include "Engine/World.h"
+#include "FPStyleTransferCharacter.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "RenderCore.h"
+#include "RHI.h"
+#include "StyleTransferBenchmarkUtils.h"
+#include "StyleTransferMemory.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferSoak, Log, All);
+
+namespace
+{
+	using namespace StyleTransferBenchmarkUtils;
+
+	constexpr double BytesPerMB = 1024.0 * 1024.0;
+	constexpr double SecondsPerHour = 3600.0;
+
+	double GetDoubleOption(const FString& Options, const TCHAR* Key, double DefaultValue)
+	{
+		return UGameplayStatics::HasOption(Options, Key) ? FCString::Atod(*UGameplayStatics::ParseOption(Options, Key)) : DefaultValue;
+	}
+}
+
+AStyleTransferSoakGameMode::AStyleTransferSoakGameMode()
+	: Super()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = true;
+}
+
+void AStyleTransferSoakGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// Without a recording the player (or nobody) plays; with one, it loops for the whole run.
+	if (UGameplayStatics::HasOption(Options, TEXT("Recording")))
+	{
+		const FString RecordingName = UGameplayStatics::ParseOption(Options, TEXT("Recording"));
+		Recording = FStyleTransferInputRecording::LoadFromFile(FStyleTransferInputRecording::GetRecordingPath(RecordingName));
+		if (!Recording.IsValid())
+		{
+			UE_LOG(LogStyleTransferSoak, Error, TEXT("Unable to load the input recording '%s'; record one with StyleTransfer.RecordInput."), *RecordingName);
+		}
+	}
+
+	Styles.Reset();
+	if (UGameplayStatics::HasOption(Options, TEXT("Styles")))
+	{
+		UGameplayStatics::ParseOption(Options, TEXT("Styles")).ParseIntoArray(Styles, TEXT("+"));
+	}
+	else
+	{
+		Styles = FindProjectStyles();
+	}
+
+	DurationSeconds = FMath::Max(GetDoubleOption(Options, TEXT("Hours"), DurationSeconds / SecondsPerHour), 0.0) * SecondsPerHour;
+	SwitchSeconds = FMath::Max(GetDoubleOption(Options, TEXT("SwitchSeconds"), SwitchSeconds), 0.1);
+	MemorySampleSeconds = FMath::Max(GetDoubleOption(Options, TEXT("MemorySampleSeconds"), MemorySampleSeconds), 1.0);
+	WindowFrames = FMath::Max(UGameplayStatics::GetIntOption(Options, TEXT("WindowFrames"), WindowFrames), 1);
+	HitchMs = FMath::Max(GetDoubleOption(Options, TEXT("HitchMs"), HitchMs), 1.0);
+	LeakSeconds = FMath::Max(GetDoubleOption(Options, TEXT("LeakSeconds"), LeakSeconds), 1.0);
+	MaxGrowthMBPerHour = FMath::Max(GetDoubleOption(Options, TEXT("MaxGrowthMBPerHour"), MaxGrowthMBPerHour), 0.0);
+
+	CsvPath = UGameplayStatics::ParseOption(Options, TEXT("Csv"));
+	if (CsvPath.IsEmpty())
+	{
+		CsvPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), FString::Printf(TEXT("StyleTransferSoak-%s.csv"), *FDateTime::Now().ToString()));
+	}
+	else if (FPaths::IsRelative(CsvPath))
+	{
+		CsvPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), CsvPath);
+	}
+}
+
+void AStyleTransferSoakGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	const double NowSeconds = FPlatformTime::Seconds();
+	switch (Phase)
+	{
+	case EPhase::Starting:
+		if (Styles.IsEmpty() || (!Recording.IsValid() && UGameplayStatics::HasOption(OptionsString, TEXT("Recording"))))
+		{
+			UE_LOG(LogStyleTransferSoak, Error, TEXT("Nothing to soak: no styles, or the input recording did not load."));
+			Finish(false);
+		}
+		else if (!Recording.IsValid() || GetSoakCharacter())
+		{
+			UE_LOG(LogStyleTransferSoak, Display, TEXT("Cycling %d style(s) every %.1f s for %.2f h%s."),
+				Styles.Num(),
+				SwitchSeconds,
+				DurationSeconds / SecondsPerHour,
+				Recording.IsValid() ? TEXT(" while looping the input recording") : TEXT(""));
+
+			Phase = EPhase::Running;
+			StartSeconds = NowSeconds;
+			LastFrameSeconds = NowSeconds;
+			NextSwitchSeconds = NowSeconds;
+			NextMemorySampleSeconds = NowSeconds;
+		}
+		break;
+
+	case EPhase::Running:
+		SampleFrame();
+		UpdateRetiringStyles(NowSeconds);
+		if (NowSeconds >= NextMemorySampleSeconds)
+		{
+			SampleMemory(NowSeconds);
+			NextMemorySampleSeconds += MemorySampleSeconds;
+		}
+		KeepPlaying();
+
+		if (NowSeconds - StartSeconds >= DurationSeconds)
+		{
+			Finish(true);
+		}
+		else if (NowSeconds >= NextSwitchSeconds)
+		{
+			SwitchStyle();
+			// A switch that took longer than the interval is not made up for.
+			NextSwitchSeconds = FMath::Max(NextSwitchSeconds + SwitchSeconds, FPlatformTime::Seconds());
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void AStyleTransferSoakGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Phase == EPhase::Running)
+	{
+		UE_LOG(LogStyleTransferSoak, Warning, TEXT("The soak ended after %.2f of %.2f h; writing the results so far."),
+			(FPlatformTime::Seconds() - StartSeconds) / SecondsPerHour,
+			DurationSeconds / SecondsPerHour);
+		Finish(false);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
+void AStyleTransferSoakGameMode::SwitchStyle()
+{
+	// Only weak references to the outgoing style survive this function.
+	FRetiringStyle Retiring;
+	if (const FStyleTransferProxyPtr OldProxy = FRealtimeStyleTransferViewExtension::GetActiveProxy())
+	{
+		Retiring.Style = OldProxy->ModelName;
+		Retiring.Proxy = OldProxy;
+		Retiring.Instance = OldProxy->ModelInstance;
+		Retiring.bHasInstance = OldProxy->ModelInstance.IsValid();
+	}
+	Retiring.Owner = FRealtimeStyleTransferViewExtension::GetActiveModelOwner();
+	Retiring.bHasOwner = Retiring.Owner.IsValid();
+
+	// Styles that fail to activate are skipped, but still count as the style that was attempted this switch.
+	FSwitchSample& Switch = Switches.AddDefaulted_GetRef();
+	const double SwitchStartSeconds = FPlatformTime::Seconds();
+	bool bActivated = false;
+	for (int32 Attempt = 0; Attempt < Styles.Num() && !bActivated; ++Attempt)
+	{
+		const FString& Style = Styles[StyleIndex];
+		StyleIndex = (StyleIndex + 1) % Styles.Num();
+		Switch.Style = FPaths::GetBaseFilename(Style);
+		bActivated = ActivateStyle(Style);
+		if (!bActivated)
+		{
+			UE_LOG(LogStyleTransferSoak, Error, TEXT("Unable to activate '%s'; skipping it."), *Style);
+		}
+	}
+	const double NowSeconds = FPlatformTime::Seconds();
+
+	Switch.ElapsedSeconds = NowSeconds - StartSeconds;
+	Switch.SetStyleMs = (NowSeconds - SwitchStartSeconds) * 1000.0;
+	WindowFramesLeft = WindowFrames;
+
+	// When no style activated the outgoing one is still active, so there is nothing to watch.
+	const bool bStillActive = Retiring.Proxy.IsValid() && Retiring.Proxy.Pin() == FRealtimeStyleTransferViewExtension::GetActiveProxy();
+	if (!bStillActive && (Retiring.Proxy.IsValid() || Retiring.bHasOwner))
+	{
+		Retiring.SwitchIndex = Switches.Num() - 1;
+		Retiring.RetiredSeconds = NowSeconds;
+		RetiringStyles.Add(MoveTemp(Retiring));
+	}
+
+	if (!bActivated)
+	{
+		UE_LOG(LogStyleTransferSoak, Error, TEXT("No style could be activated; stopping the soak."));
+		Finish(false);
+	}
+}
+
+void AStyleTransferSoakGameMode::SampleFrame()
+{
+	// Wall time between game ticks; the first frame of a window is the one that ran SetStyle.
+	const double NowSeconds = FPlatformTime::Seconds();
+	const double FrameMs = (NowSeconds - LastFrameSeconds) * 1000.0;
+	LastFrameSeconds = NowSeconds;
+	const bool bHitch = FrameMs > HitchMs;
+
+	if (WindowFramesLeft <= 0 || Switches.IsEmpty())
+	{
+		++FramesOutsideWindows;
+		HitchesOutsideWindows += bHitch ? 1 : 0;
+		return;
+	}
+
+	--WindowFramesLeft;
+	FSwitchSample& Switch = Switches.Last();
+	++Switch.WindowFrames;
+	Switch.Hitches += bHitch ? 1 : 0;
+	Switch.MaxFrameMs = FMath::Max(Switch.MaxFrameMs, FrameMs);
+	Switch.MaxGameThreadMs = FMath::Max(Switch.MaxGameThreadMs, FPlatformTime::ToMilliseconds(GGameThreadTime));
+	Switch.MaxRenderThreadMs = FMath::Max(Switch.MaxRenderThreadMs, FPlatformTime::ToMilliseconds(GRenderThreadTime));
+	Switch.MaxGpuMs = FMath::Max(Switch.MaxGpuMs, FPlatformTime::ToMilliseconds(RHIGetGPUFrameCycles()));
+}
+
+void AStyleTransferSoakGameMode::UpdateRetiringStyles(double NowSeconds)
+{
+	for (int32 Index = RetiringStyles.Num() - 1; Index >= 0; --Index)
+	{
+		FRetiringStyle& Retiring = RetiringStyles[Index];
+		FSwitchSample& Switch = Switches[Retiring.SwitchIndex];
+		const double AgeMs = (NowSeconds - Retiring.RetiredSeconds) * 1000.0;
+
+		// The proxy goes once the render thread drops it; the owner only at the next garbage collection.
+		if (Switch.ProxyFreedMs < 0.0 && !Retiring.Proxy.IsValid())
+		{
+			Switch.ProxyFreedMs = AgeMs;
+		}
+		if (Retiring.bHasInstance && Switch.InstanceFreedMs < 0.0 && !Retiring.Instance.IsValid())
+		{
+			Switch.InstanceFreedMs = AgeMs;
+		}
+		if (Retiring.bHasOwner && Switch.OwnerFreedMs < 0.0 && !Retiring.Owner.IsValid())
+		{
+			Switch.OwnerFreedMs = AgeMs;
+		}
+
+		const bool bProxyAlive = Switch.ProxyFreedMs < 0.0;
+		const bool bInstanceAlive = Retiring.bHasInstance && Switch.InstanceFreedMs < 0.0;
+		const bool bOwnerAlive = Retiring.bHasOwner && Switch.OwnerFreedMs < 0.0;
+		if (!bProxyAlive && !bInstanceAlive && !bOwnerAlive)
+		{
+			RetiringStyles.RemoveAtSwap(Index, EAllowShrinking::No);
+		}
+		else if (!Retiring.bReportedLeak && AgeMs > LeakSeconds * 1000.0)
+		{
+			Retiring.bReportedLeak = true;
+			++LeakedStyles;
+			UE_LOG(LogStyleTransferSoak, Warning, TEXT("'%s' was replaced %.0f s ago and still has its%s%s%s alive."),
+				*Retiring.Style,
+				AgeMs / 1000.0,
+				bProxyAlive ? TEXT(" proxy") : TEXT(""),
+				bInstanceAlive ? TEXT(" model instance") : TEXT(""),
+				bOwnerAlive ? TEXT(" owner") : TEXT(""));
+		}
+	}
+}
+
+void AStyleTransferSoakGameMode::SampleMemory(double NowSeconds)
+{
+	FMemorySample& Sample = MemorySamples.AddDefaulted_GetRef();
+	Sample.ElapsedSeconds = NowSeconds - StartSeconds;
+	Sample.UsedPhysicalBytes = FPlatformMemory::GetStats().UsedPhysical;
+	Sample.RetiringStyles = RetiringStyles.Num();
+
+	for (const FStyleTransferMemoryEntry& Entry : StyleTransferMemory::GetLiveEntries())
+	{
+		++Sample.TrackedEntries;
+		Sample.TrackedCpuBytes += Entry.CpuBytes;
+		Sample.TrackedGpuBytes += Entry.GpuBytes;
+	}
+
+	FTextureMemoryStats TextureStats;
+	RHIGetTextureMemoryStats(TextureStats);
+	Sample.RhiTextureBytes = TextureStats.StreamingMemorySize + TextureStats.NonStreamingMemorySize;
+}
+
+void AStyleTransferSoakGameMode::KeepPlaying()
+{
+	if (!Recording.IsValid())
+	{
+		return;
+	}
+
+	AFPStyleTransferCharacter* Character = GetSoakCharacter();
+	if (Character && !Character->IsPlayingInput())
+	{
+		Character->TeleportToInputStart(*Recording);
+		Character->StartInputPlayback(Recording);
+	}
+}
+
+void AStyleTransferSoakGameMode::Finish(bool bSucceeded)
+{
+	if (Phase == EPhase::Done)
+	{
+		return;
+	}
+	const bool bRan = Phase == EPhase::Running;
+	Phase = EPhase::Done;
+
+	if (AFPStyleTransferCharacter* Character = GetSoakCharacter())
+	{
+		Character->StopInputPlayback();
+	}
+	FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+
+	if (bRan && !Switches.IsEmpty())
+	{
+		const TArray<FTrend> Trends = ComputeTrends();
+		UE_LOG(LogStyleTransferSoak, Display, TEXT("%d switches in %.2f h; %d of %d frames after a switch and %d of %d other frames hitched (> %.0f ms)."),
+			Switches.Num(),
+			(FPlatformTime::Seconds() - StartSeconds) / SecondsPerHour,
+			Algo::TransformAccumulate(Switches, &FSwitchSample::Hitches, 0),
+			Algo::TransformAccumulate(Switches, &FSwitchSample::WindowFrames, 0),
+			HitchesOutsideWindows,
+			FramesOutsideWindows,
+			HitchMs);
+		for (const FTrend& Trend : Trends)
+		{
+			UE_LOG(LogStyleTransferSoak, Display, TEXT("%-22s first quarter %10.2f, last quarter %10.2f, %+10.2f per hour (%d samples)."),
+				*Trend.Name,
+				Trend.FirstQuarter,
+				Trend.LastQuarter,
+				Trend.PerHour,
+				Trend.Samples);
+		}
+
+		if (LeakedStyles > 0)
+		{
+			UE_LOG(LogStyleTransferSoak, Error, TEXT("%d replaced style(s) were still alive %.0f s after their switch."), LeakedStyles, LeakSeconds);
+			bSucceeded = false;
+		}
+
+		const FTrend* ResidentTrend = Trends.FindByPredicate([](const FTrend& Trend) { return Trend.Name == TEXT("UsedPhysicalMB"); });
+		if (MaxGrowthMBPerHour > 0.0 && ResidentTrend && ResidentTrend->PerHour > MaxGrowthMBPerHour)
+		{
+			UE_LOG(LogStyleTransferSoak, Error, TEXT("Resident memory grew %.1f MB per hour, over MaxGrowthMBPerHour %.1f."), ResidentTrend->PerHour, MaxGrowthMBPerHour);
+			bSucceeded = false;
+		}
+
+		if (!WriteCsv(Trends))
+		{
+			bSucceeded = false;
+		}
+	}
+
+	if (FApp::IsUnattended() || FParse::Param(FCommandLine::Get(), TEXT("ExitAfterBenchmark")))
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bSucceeded ? 0 : 1);
+	}
+}
+
+TArray<AStyleTransferSoakGameMode::FTrend> AStyleTransferSoakGameMode::ComputeTrends() const
+{
+	TArray<FTrend> Trends;
+
+	// Times are compared by their p95, memory by its mean.
+	auto AddTrend = [&Trends](const TCHAR* Name, const TArray<double>& Seconds, const TArray<double>& Values, bool bTail)
+	{
+		FTrend& Trend = Trends.AddDefaulted_GetRef();
+		Trend.Name = Name;
+		Trend.Samples = Values.Num();
+		if (Values.IsEmpty())
+		{
+			return;
+		}
+
+		const int32 QuarterCount = FMath::Max(Values.Num() / 4, 1);
+		const TArray<double> First(Values.GetData(), QuarterCount);
+		const TArray<double> Last(Values.GetData() + Values.Num() - QuarterCount, QuarterCount);
+		Trend.FirstQuarter = bTail ? Percentile(First, 0.95) : Mean(First);
+		Trend.LastQuarter = bTail ? Percentile(Last, 0.95) : Mean(Last);
+
+		const double MeanSeconds = Mean(Seconds);
+		const double MeanValue = Mean(Values);
+		double Covariance = 0.0;
+		double Variance = 0.0;
+		for (int32 Index = 0; Index < Values.Num(); ++Index)
+		{
+			Covariance += (Seconds[Index] - MeanSeconds) * (Values[Index] - MeanValue);
+			Variance += FMath::Square(Seconds[Index] - MeanSeconds);
+		}
+		Trend.PerHour = Variance > 0.0 ? Covariance / Variance * SecondsPerHour : 0.0;
+	};
+
+	TArray<double> Seconds;
+	TArray<double> Values;
+	auto AddMemoryTrend = [&](const TCHAR* Name, TFunctionRef<double(const FMemorySample&)> GetValue)
+	{
+		Seconds.Reset();
+		Values.Reset();
+		for (const FMemorySample& Sample : MemorySamples)
+		{
+			Seconds.Add(Sample.ElapsedSeconds);
+			Values.Add(GetValue(Sample));
+		}
+		AddTrend(Name, Seconds, Values, false);
+	};
+	AddMemoryTrend(TEXT("UsedPhysicalMB"), [](const FMemorySample& Sample) { return Sample.UsedPhysicalBytes / BytesPerMB; });
+	AddMemoryTrend(TEXT("TrackedCpuMB"), [](const FMemorySample& Sample) { return Sample.TrackedCpuBytes / BytesPerMB; });
+	AddMemoryTrend(TEXT("TrackedGpuMB"), [](const FMemorySample& Sample) { return Sample.TrackedGpuBytes / BytesPerMB; });
+	AddMemoryTrend(TEXT("RhiTextureMB"), [](const FMemorySample& Sample) { return Sample.RhiTextureBytes / BytesPerMB; });
+	AddMemoryTrend(TEXT("TrackedEntries"), [](const FMemorySample& Sample) { return static_cast<double>(Sample.TrackedEntries); });
+	AddMemoryTrend(TEXT("RetiringStyles"), [](const FMemorySample& Sample) { return static_cast<double>(Sample.RetiringStyles); });
+
+	// Retirement latencies only count styles that were freed; the rest are in LeakedStyles.
+	auto AddSwitchTrend = [&](const TCHAR* Name, TFunctionRef<double(const FSwitchSample&)> GetValue)
+	{
+		Seconds.Reset();
+		Values.Reset();
+		for (const FSwitchSample& Switch : Switches)
+		{
+			const double Value = GetValue(Switch);
+			if (Value >= 0.0)
+			{
+				Seconds.Add(Switch.ElapsedSeconds);
+				Values.Add(Value);
+			}
+		}
+		AddTrend(Name, Seconds, Values, true);
+	};
+	AddSwitchTrend(TEXT("SetStyleMsP95"), [](const FSwitchSample& Switch) { return Switch.SetStyleMs; });
+	AddSwitchTrend(TEXT("SwitchFrameMsP95"), [](const FSwitchSample& Switch) { return Switch.MaxFrameMs; });
+	AddSwitchTrend(TEXT("SwitchGameThreadMsP95"), [](const FSwitchSample& Switch) { return Switch.MaxGameThreadMs; });
+	AddSwitchTrend(TEXT("SwitchRenderThreadMsP95"), [](const FSwitchSample& Switch) { return Switch.MaxRenderThreadMs; });
+	AddSwitchTrend(TEXT("SwitchGpuMsP95"), [](const FSwitchSample& Switch) { return Switch.MaxGpuMs; });
+	AddSwitchTrend(TEXT("SwitchHitchesP95"), [](const FSwitchSample& Switch) { return static_cast<double>(Switch.Hitches); });
+	AddSwitchTrend(TEXT("ProxyFreedMsP95"), [](const FSwitchSample& Switch) { return Switch.ProxyFreedMs; });
+	AddSwitchTrend(TEXT("InstanceFreedMsP95"), [](const FSwitchSample& Switch) { return Switch.InstanceFreedMs; });
+	AddSwitchTrend(TEXT("OwnerFreedMsP95"), [](const FSwitchSample& Switch) { return Switch.OwnerFreedMs; });
+
+	return Trends;
+}
+
+bool AStyleTransferSoakGameMode::WriteCsv(const TArray<FTrend>& Trends) const
+{
+	FString Summary = TEXT("Metric,Samples,FirstQuarter,LastQuarter,PerHour\n");
+	for (const FTrend& Trend : Trends)
+	{
+		Summary += FString::Printf(TEXT("%s,%d,%.3f,%.3f,%.3f\n"), *Trend.Name, Trend.Samples, Trend.FirstQuarter, Trend.LastQuarter, Trend.PerHour);
+	}
+
+	FString SwitchRows = TEXT("Switch,ElapsedSeconds,Style,SetStyleMs,WindowFrames,MaxFrameMs,MaxGameThreadMs,MaxRenderThreadMs,MaxGpuMs,Hitches,ProxyFreedMs,InstanceFreedMs,OwnerFreedMs\n");
+	for (int32 SwitchIndex = 0; SwitchIndex < Switches.Num(); ++SwitchIndex)
+	{
+		const FSwitchSample& Switch = Switches[SwitchIndex];
+		SwitchRows += FString::Printf(TEXT("%d,%.3f,%s,%.3f,%d,%.3f,%.3f,%.3f,%.3f,%d,%.3f,%.3f,%.3f\n"),
+			SwitchIndex,
+			Switch.ElapsedSeconds,
+			*Switch.Style,
+			Switch.SetStyleMs,
+			Switch.WindowFrames,
+			Switch.MaxFrameMs,
+			Switch.MaxGameThreadMs,
+			Switch.MaxRenderThreadMs,
+			Switch.MaxGpuMs,
+			Switch.Hitches,
+			Switch.ProxyFreedMs,
+			Switch.InstanceFreedMs,
+			Switch.OwnerFreedMs);
+	}
+
+	FString MemoryRows = TEXT("ElapsedSeconds,UsedPhysicalMB,TrackedEntries,TrackedCpuMB,TrackedGpuMB,RhiTextureMB,RetiringStyles\n");
+	for (const FMemorySample& Sample : MemorySamples)
+	{
+		MemoryRows += FString::Printf(TEXT("%.3f,%.3f,%d,%.3f,%.3f,%.3f,%d\n"),
+			Sample.ElapsedSeconds,
+			Sample.UsedPhysicalBytes / BytesPerMB,
+			Sample.TrackedEntries,
+			Sample.TrackedCpuBytes / BytesPerMB,
+			Sample.TrackedGpuBytes / BytesPerMB,
+			Sample.RhiTextureBytes / BytesPerMB,
+			Sample.RetiringStyles);
+	}
+
+	const FString BasePath = FPaths::Combine(FPaths::GetPath(CsvPath), FPaths::GetBaseFilename(CsvPath));
+	const FString SwitchesPath = BasePath + TEXT("_switches.csv");
+	const FString MemoryPath = BasePath + TEXT("_memory.csv");
+	if (!FFileHelper::SaveStringToFile(Summary, *CsvPath)
+		|| !FFileHelper::SaveStringToFile(SwitchRows, *SwitchesPath)
+		|| !FFileHelper::SaveStringToFile(MemoryRows, *MemoryPath))
+	{
+		UE_LOG(LogStyleTransferSoak, Error, TEXT("Unable to write the soak results to '%s'."), *CsvPath);
+		return false;
+	}
+
+	UE_LOG(LogStyleTransferSoak, Display, TEXT("Wrote the soak trends to '%s', switches to '%s' and memory samples to '%s'."), *CsvPath, *SwitchesPath, *MemoryPath);
+	return true;
+}
+
+AFPStyleTransferCharacter* AStyleTransferSoakGameMode::GetSoakCharacter() const
+{
+	const UWorld* World = GetWorld();
+	const APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	return PlayerController ? Cast<AFPStyleTransferCharacter>(PlayerController->GetPawn()) : nullptr;
+}
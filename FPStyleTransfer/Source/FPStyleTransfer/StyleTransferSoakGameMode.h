@@ -0,0 +1,135 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FPStyleTransferGameMode.h"
+#include "MyNeuralNetwork.h"
+#include "StyleTransferInputRecording.h"
+#include "StyleTransferSoakGameMode.generated.h"
+
+class AFPStyleTransferCharacter;
+
+/**
+ * Cycles through every style at a fixed rate for hours while the game keeps running, to catch memory creep, switch
+ * hitches and styles that are never freed. Each switch records the SetStyle call time and the worst game thread,
+ * render thread and GPU times of the frames after it; memory is sampled at a fixed interval; and every replaced style
+ * is watched until its proxy, model instance and model owner are freed. Results go to CSV with first/last quarter and
+ * per-hour trends. Options come from the map URL, e.g.
+ * FirstPersonMap?game=/Script/FPStyleTransfer.StyleTransferSoakGameMode?Hours=4?SwitchSeconds=5?Recording=Flythrough
+ */
+UCLASS(minimalapi)
+class AStyleTransferSoakGameMode : public AFPStyleTransferGameMode
+{
+	GENERATED_BODY()
+
+public:
+	AStyleTransferSoakGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void Tick(float DeltaSeconds) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** One SetStyle call and the frames after it, in milliseconds. */
+	struct FSwitchSample
+	{
+		FString Style;
+		double ElapsedSeconds = 0.0;
+		double SetStyleMs = 0.0;
+		int32 WindowFrames = 0;
+		double MaxFrameMs = 0.0;
+		double MaxGameThreadMs = 0.0;
+		double MaxRenderThreadMs = 0.0;
+		double MaxGpuMs = 0.0;
+		int32 Hitches = 0;
+		/** Time until the replaced style's objects were freed, -1 while (or if never) alive. */
+		double ProxyFreedMs = -1.0;
+		double InstanceFreedMs = -1.0;
+		double OwnerFreedMs = -1.0;
+	};
+
+	/** Objects of a replaced style, watched until they are freed. */
+	struct FRetiringStyle
+	{
+		int32 SwitchIndex = INDEX_NONE;
+		double RetiredSeconds = 0.0;
+		FString Style;
+		TWeakPtr<FStyleTransferProxy, ESPMode::ThreadSafe> Proxy;
+		TWeakPtr<UE::NNE::IModelInstanceRDG> Instance;
+		TWeakObjectPtr<UMyNeuralNetwork> Owner;
+		/** Conv-net styles have no model instance, and styles activated with a proxy have no owner. */
+		bool bHasInstance = false;
+		bool bHasOwner = false;
+		bool bReportedLeak = false;
+	};
+
+	struct FMemorySample
+	{
+		double ElapsedSeconds = 0.0;
+		int64 UsedPhysicalBytes = 0;
+		/** Style models and instances alive per StyleTransferMemory, and their recorded CPU and GPU memory. */
+		int32 TrackedEntries = 0;
+		int64 TrackedCpuBytes = 0;
+		int64 TrackedGpuBytes = 0;
+		/** Texture memory the RHI reports; NNE tensors are buffers, so only the tracked estimate covers them. */
+		int64 RhiTextureBytes = 0;
+		int32 RetiringStyles = 0;
+	};
+
+	/** A metric over the run: the first and last quarter of its samples, and its least-squares slope per hour. */
+	struct FTrend
+	{
+		FString Name;
+		int32 Samples = 0;
+		double FirstQuarter = 0.0;
+		double LastQuarter = 0.0;
+		double PerHour = 0.0;
+	};
+
+	enum class EPhase : uint8
+	{
+		Starting,
+		Running,
+		Done,
+	};
+
+	void SwitchStyle();
+	void SampleFrame();
+	void UpdateRetiringStyles(double NowSeconds);
+	void SampleMemory(double NowSeconds);
+	void KeepPlaying();
+	void Finish(bool bSucceeded);
+	TArray<FTrend> ComputeTrends() const;
+	bool WriteCsv(const TArray<FTrend>& Trends) const;
+
+	AFPStyleTransferCharacter* GetSoakCharacter() const;
+
+	FStyleTransferInputRecordingPtr Recording;
+	TArray<FString> Styles;
+	FString CsvPath;
+	double DurationSeconds = 2.0 * 3600.0;
+	double SwitchSeconds = 10.0;
+	double MemorySampleSeconds = 10.0;
+	int32 WindowFrames = 30;
+	double HitchMs = 50.0;
+	double LeakSeconds = 120.0;
+	/** Fails the run when resident memory grows faster than this; 0 only reports the trend. */
+	double MaxGrowthMBPerHour = 0.0;
+
+	EPhase Phase = EPhase::Starting;
+	double StartSeconds = 0.0;
+	double LastFrameSeconds = 0.0;
+	double NextSwitchSeconds = 0.0;
+	double NextMemorySampleSeconds = 0.0;
+	int32 StyleIndex = 0;
+	/** Frames of the current switch window still to sample. */
+	int32 WindowFramesLeft = 0;
+	int32 FramesOutsideWindows = 0;
+	int32 HitchesOutsideWindows = 0;
+
+	TArray<FSwitchSample> Switches;
+	TArray<FRetiringStyle> RetiringStyles;
+	TArray<FMemorySample> MemorySamples;
+	int32 LeakedStyles = 0;
+};
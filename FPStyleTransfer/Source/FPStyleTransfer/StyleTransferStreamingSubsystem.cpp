@@ -0,0 +1,345 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferStreamingSubsystem.h"
+
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "NNEModelData.h"
+#include "RealtimeStyleTransferViewExtension.h"
+#include "StyleTransferPrecache.h"
+#include "StyleTransferVolume.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferStreaming, Log, All);
+
+namespace RealtimeStyleTransfer
+{
+	static float StreamingLookaheadSeconds = 1.5f;
+	static FAutoConsoleVariableRef CVarStreamingLookaheadSeconds(
+		TEXT("r.RealtimeStyleTransfer.Streaming.LookaheadSeconds"),
+		StreamingLookaheadSeconds,
+		TEXT("How far ahead (in seconds) the player position is extrapolated from its velocity when choosing style volumes to prefetch."),
+		ECVF_Default);
+
+	static int32 StreamingMemoryBudgetMB = 256;
+	static FAutoConsoleVariableRef CVarStreamingMemoryBudgetMB(
+		TEXT("r.RealtimeStyleTransfer.Streaming.MemoryBudgetMB"),
+		StreamingMemoryBudgetMB,
+		TEXT("Estimated memory cap for prefetched style models. Distant models are evicted above it."),
+		ECVF_Default);
+
+	static int32 StreamingMaxConcurrentLoads = 1;
+	static FAutoConsoleVariableRef CVarStreamingMaxConcurrentLoads(
+		TEXT("r.RealtimeStyleTransfer.Streaming.MaxConcurrentLoads"),
+		StreamingMaxConcurrentLoads,
+		TEXT("Maximum number of style models created in the background at the same time."),
+		ECVF_Default);
+}
+
+void UStyleTransferStreamingSubsystem::Deinitialize()
+{
+	for (TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		if (Pair.Value.PendingTask.IsValid())
+		{
+			Pair.Value.PendingTask.Wait();
+		}
+	}
+
+	Cache.Empty();
+	Volumes.Empty();
+	PreVolumeProxy.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UStyleTransferStreamingSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UStyleTransferStreamingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UStyleTransferStreamingSubsystem, STATGROUP_Tickables);
+}
+
+void UStyleTransferStreamingSubsystem::RegisterVolume(AStyleTransferVolume* Volume)
+{
+	Volumes.AddUnique(Volume);
+}
+
+void UStyleTransferStreamingSubsystem::UnregisterVolume(AStyleTransferVolume* Volume)
+{
+	Volumes.Remove(Volume);
+}
+
+int64 UStyleTransferStreamingSubsystem::GetCachedBytes() const
+{
+	int64 Total = 0;
+	for (const TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		Total += Pair.Value.EstimatedBytes;
+	}
+	return Total;
+}
+
+int64 UStyleTransferStreamingSubsystem::EstimateModelBytes(const UNNEModelData* ModelData, const FStyleTransferProxyPtr& Proxy)
+{
+	if (Proxy.IsValid())
+	{
+		const int64 InputBytes = static_cast<int64>(Proxy->InputTensorShape.Volume()) * Proxy->InputElementByteSize;
+		const int64 OutputBytes = static_cast<int64>(Proxy->OutputTensorShape.Volume()) * Proxy->OutputElementByteSize;
+		return Proxy->ModelSizeBytes + InputBytes + OutputBytes;
+	}
+
+	// Before the model exists we only know the serialized size; the runtime keeps its own copy of the weights.
+	return ModelData ? ModelData->GetFileData().Num() : 0;
+}
+
+void UStyleTransferStreamingSubsystem::Tick(float DeltaTime)
+{
+	PollPendingLoads();
+
+	const UWorld* World = GetWorld();
+	const APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	if (!Pawn)
+	{
+		return;
+	}
+
+	const FVector Location = Pawn->GetActorLocation();
+	const FVector PredictedLocation = Location + Pawn->GetVelocity() * RealtimeStyleTransfer::StreamingLookaheadSeconds;
+
+	for (TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		Pair.Value.SquaredDistance = TNumericLimits<float>::Max();
+	}
+
+	struct FWantedModel
+	{
+		UNNEModelData* ModelData;
+		FName RuntimeName;
+		float SquaredDistance;
+	};
+	TArray<FWantedModel, TInlineAllocator<8>> Wanted;
+	const AStyleTransferVolume* EnclosingVolume = nullptr;
+
+	Volumes.RemoveAll([](const TWeakObjectPtr<AStyleTransferVolume>& Volume) { return !Volume.IsValid(); });
+	for (const TWeakObjectPtr<AStyleTransferVolume>& WeakVolume : Volumes)
+	{
+		const AStyleTransferVolume* Volume = WeakVolume.Get();
+		if (!Volume->ModelData)
+		{
+			continue;
+		}
+
+		const float CurrentDistance = Volume->GetSquaredDistanceToPoint(Location);
+		const float SquaredDistance = FMath::Min(CurrentDistance, Volume->GetSquaredDistanceToPoint(PredictedLocation));
+
+		if (CurrentDistance <= 0.0f && (!EnclosingVolume || Volume->Priority > EnclosingVolume->Priority))
+		{
+			EnclosingVolume = Volume;
+		}
+
+		if (FCachedModel* Entry = Cache.Find(Volume->ModelData.Get()))
+		{
+			Entry->SquaredDistance = FMath::Min(Entry->SquaredDistance, SquaredDistance);
+		}
+
+		if (SquaredDistance <= FMath::Square(Volume->PrefetchDistance))
+		{
+			Wanted.Add({ Volume->ModelData.Get(), Volume->RuntimeName, SquaredDistance });
+		}
+	}
+
+	Wanted.Sort([](const FWantedModel& A, const FWantedModel& B) { return A.SquaredDistance < B.SquaredDistance; });
+	for (const FWantedModel& Model : Wanted)
+	{
+		if (!Cache.Contains(Model.ModelData))
+		{
+			StartPrefetch(Model.ModelData, Model.RuntimeName, Model.SquaredDistance);
+		}
+	}
+
+	if (EnclosingVolume && EnclosingVolume->ModelData.Get() != CurrentVolumeModel.Get())
+	{
+		SwitchToVolume(EnclosingVolume);
+	}
+	else if (!EnclosingVolume && bInsideVolume)
+	{
+		RestorePreVolumeStyle();
+	}
+}
+
+void UStyleTransferStreamingSubsystem::PollPendingLoads()
+{
+	for (TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		FCachedModel& Entry = Pair.Value;
+		if (!Entry.PendingTask.IsValid() || !Entry.PendingTask.IsCompleted())
+		{
+			continue;
+		}
+
+		Entry.Proxy = Entry.PendingTask.GetResult();
+		Entry.PendingTask = {};
+		Entry.bFailed = !Entry.Proxy.IsValid();
+		Entry.EstimatedBytes = EstimateModelBytes(Entry.ModelData.Get(), Entry.Proxy);
+
+		// Warm the model up now so switching to its volume does not create its pipelines.
+		StyleTransferPrecache::WarmUp(Entry.Proxy);
+
+		UE_LOG(LogStyleTransferStreaming, Log, TEXT("Prefetch of '%s' %s (%.1f MB estimated)."),
+			*Entry.ModelData->GetName(),
+			Entry.bFailed ? TEXT("failed") : TEXT("completed"),
+			Entry.EstimatedBytes / (1024.0 * 1024.0));
+	}
+}
+
+void UStyleTransferStreamingSubsystem::StartPrefetch(UNNEModelData* ModelData, FName RuntimeName, float SquaredDistance)
+{
+	int32 LoadsInFlight = 0;
+	for (const TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		LoadsInFlight += Pair.Value.IsLoading() ? 1 : 0;
+	}
+
+	if (LoadsInFlight >= FMath::Max(RealtimeStyleTransfer::StreamingMaxConcurrentLoads, 1))
+	{
+		return;
+	}
+
+	const int64 BudgetBytes = static_cast<int64>(RealtimeStyleTransfer::StreamingMemoryBudgetMB) * 1024 * 1024;
+	const int64 EstimatedBytes = EstimateModelBytes(ModelData, nullptr);
+
+	EvictToBudget(BudgetBytes - EstimatedBytes, FRealtimeStyleTransferViewExtension::GetActiveModelData());
+	if (GetCachedBytes() + EstimatedBytes > BudgetBytes)
+	{
+		UE_LOG(LogStyleTransferStreaming, Verbose, TEXT("Not prefetching '%s': memory budget exhausted."), *ModelData->GetName());
+		return;
+	}
+
+	FCachedModel& Entry = Cache.Add(ModelData);
+	Entry.ModelData.Reset(ModelData);
+	Entry.RuntimeName = RuntimeName;
+	Entry.EstimatedBytes = EstimatedBytes;
+	Entry.SquaredDistance = SquaredDistance;
+
+	// The entry keeps the model data alive until the task has been polled, so the raw pointer is safe here.
+	Entry.PendingTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [ModelData, RuntimeName]()
+	{
+		return UMyNeuralNetwork::CreateProxy(ModelData, RuntimeName);
+	}, UE::Tasks::ETaskPriority::BackgroundNormal);
+
+	UE_LOG(LogStyleTransferStreaming, Log, TEXT("Prefetching style model '%s' (distance %.0f)."),
+		*ModelData->GetName(),
+		FMath::Sqrt(SquaredDistance));
+}
+
+void UStyleTransferStreamingSubsystem::EvictToBudget(int64 BudgetBytes, const UNNEModelData* Protected)
+{
+	int64 CachedBytes = GetCachedBytes();
+	if (CachedBytes <= BudgetBytes)
+	{
+		return;
+	}
+
+	TArray<TObjectKey<UNNEModelData>, TInlineAllocator<8>> Candidates;
+	for (const TPair<TObjectKey<UNNEModelData>, FCachedModel>& Pair : Cache)
+	{
+		if (!Pair.Value.IsLoading() && Pair.Value.ModelData.Get() != Protected)
+		{
+			Candidates.Add(Pair.Key);
+		}
+	}
+
+	Candidates.Sort([this](const TObjectKey<UNNEModelData>& A, const TObjectKey<UNNEModelData>& B)
+	{
+		return Cache[A].SquaredDistance > Cache[B].SquaredDistance;
+	});
+
+	for (const TObjectKey<UNNEModelData>& Key : Candidates)
+	{
+		if (CachedBytes <= BudgetBytes)
+		{
+			break;
+		}
+
+		FCachedModel Evicted;
+		Cache.RemoveAndCopyValue(Key, Evicted);
+		CachedBytes -= Evicted.EstimatedBytes;
+
+		UE_LOG(LogStyleTransferStreaming, Log, TEXT("Evicted style model '%s' (%.1f MB)."),
+			*Evicted.ModelData->GetName(),
+			Evicted.EstimatedBytes / (1024.0 * 1024.0));
+	}
+}
+
+void UStyleTransferStreamingSubsystem::SwitchToVolume(const AStyleTransferVolume* Volume)
+{
+	UNNEModelData* ModelData = Volume->ModelData.Get();
+	FCachedModel* Entry = Cache.Find(ModelData);
+
+	if (Entry && Entry->IsLoading())
+	{
+		// Keep the current style for a few more frames instead of blocking on the load.
+		return;
+	}
+
+	if (!bInsideVolume)
+	{
+		PreVolumeProxy = FRealtimeStyleTransferViewExtension::GetActiveProxy();
+		PreVolumeModelData = FRealtimeStyleTransferViewExtension::GetActiveModelData();
+		bInsideVolume = true;
+	}
+	CurrentVolumeModel = ModelData;
+
+	if (Entry && Entry->Proxy.IsValid())
+	{
+		UE_LOG(LogStyleTransferStreaming, Log, TEXT("Entered style volume '%s', switching to prefetched model '%s'."),
+			*Volume->GetName(),
+			*ModelData->GetName());
+		FRealtimeStyleTransferViewExtension::SetStyleWithProxy(ModelData, Volume->RuntimeName, Entry->Proxy);
+		return;
+	}
+
+	if (Entry && Entry->bFailed)
+	{
+		return;
+	}
+
+	UE_LOG(LogStyleTransferStreaming, Warning, TEXT("Entered style volume '%s' before '%s' was prefetched; loading synchronously."),
+		*Volume->GetName(),
+		*ModelData->GetName());
+	FRealtimeStyleTransferViewExtension::SetStyle(ModelData, Volume->RuntimeName);
+}
+
+void UStyleTransferStreamingSubsystem::RestorePreVolumeStyle()
+{
+	const bool bVolumeStyleActive = CurrentVolumeModel.IsValid() && FRealtimeStyleTransferViewExtension::GetActiveModelData() == CurrentVolumeModel.Get();
+	FStyleTransferProxyPtr Proxy = MoveTemp(PreVolumeProxy);
+	UNNEModelData* ModelData = PreVolumeModelData.Get();
+	PreVolumeModelData.Reset();
+	CurrentVolumeModel.Reset();
+	bInsideVolume = false;
+
+	// A style set by the game while inside the volumes (or a volume model that failed to load) is left alone.
+	if (!bVolumeStyleActive)
+	{
+		UE_LOG(LogStyleTransferStreaming, Log, TEXT("Left the last style volume; keeping the current style, which no volume set."));
+		return;
+	}
+
+	if (!Proxy.IsValid())
+	{
+		UE_LOG(LogStyleTransferStreaming, Log, TEXT("Left the last style volume; no style was active before it."));
+		FRealtimeStyleTransferViewExtension::SetStyle(nullptr, NAME_None);
+		return;
+	}
+
+	UE_LOG(LogStyleTransferStreaming, Log, TEXT("Left the last style volume, restoring '%s'."), ModelData ? *ModelData->GetName() : TEXT("the previous style"));
+	const FName RuntimeName = Proxy->RuntimeName.IsEmpty() ? NAME_None : FName(*Proxy->RuntimeName);
+	FRealtimeStyleTransferViewExtension::SetStyleWithProxy(ModelData, RuntimeName, MoveTemp(Proxy));
+}
@@ -0,0 +1,73 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tasks/Task.h"
+#include "UObject/StrongObjectPtr.h"
+#include "MyNeuralNetwork.h"
+#include "StyleTransferStreamingSubsystem.generated.h"
+
+class AStyleTransferVolume;
+class UNNEModelData;
+
+/**
+ * Prefetches the models of style volumes near the player on worker threads and switches style when the
+ * player enters a volume. Models of distant volumes are evicted once the cache exceeds its memory budget.
+ * Leaving the last volume restores the style that was active before the first one was entered, unless the
+ * style was changed in the meantime by something other than a volume.
+ */
+UCLASS()
+class FPSTYLETRANSFER_API UStyleTransferStreamingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	//~ USubsystem interface
+	virtual void Deinitialize() override;
+
+	//~ FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RegisterVolume(AStyleTransferVolume* Volume);
+	void UnregisterVolume(AStyleTransferVolume* Volume);
+
+	/** Estimated bytes held by cached and in-flight models. */
+	int64 GetCachedBytes() const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FCachedModel
+	{
+		TStrongObjectPtr<UNNEModelData> ModelData;
+		FName RuntimeName;
+		UE::Tasks::TTask<FStyleTransferProxyPtr> PendingTask;
+		FStyleTransferProxyPtr Proxy;
+		int64 EstimatedBytes = 0;
+		float SquaredDistance = TNumericLimits<float>::Max();
+		bool bFailed = false;
+
+		bool IsLoading() const { return PendingTask.IsValid() && !PendingTask.IsCompleted(); }
+	};
+
+	void PollPendingLoads();
+	void StartPrefetch(UNNEModelData* ModelData, FName RuntimeName, float SquaredDistance);
+	void EvictToBudget(int64 BudgetBytes, const UNNEModelData* Protected);
+	void SwitchToVolume(const AStyleTransferVolume* Volume);
+	void RestorePreVolumeStyle();
+
+	static int64 EstimateModelBytes(const UNNEModelData* ModelData, const FStyleTransferProxyPtr& Proxy);
+
+	TArray<TWeakObjectPtr<AStyleTransferVolume>> Volumes;
+	TMap<TObjectKey<UNNEModelData>, FCachedModel> Cache;
+	TWeakObjectPtr<UNNEModelData> CurrentVolumeModel;
+
+	/** Style active before the player entered the first volume; its proxy stays alive while the player is inside volumes. */
+	FStyleTransferProxyPtr PreVolumeProxy;
+	TWeakObjectPtr<UNNEModelData> PreVolumeModelData;
+	bool bInsideVolume = false;
+};
@@ -0,0 +1,45 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferVolume.h"
+
+#include "Components/BrushComponent.h"
+#include "Engine/World.h"
+#include "StyleTransferStreamingSubsystem.h"
+
+AStyleTransferVolume::AStyleTransferVolume(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	GetBrushComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	bColored = true;
+	BrushColor = FColor(200, 100, 255, 255);
+}
+
+float AStyleTransferVolume::GetSquaredDistanceToPoint(const FVector& Point) const
+{
+	if (EncompassesPoint(Point))
+	{
+		return 0.0f;
+	}
+
+	return static_cast<float>(GetBrushComponent()->Bounds.GetBox().ComputeSquaredDistanceToPoint(Point));
+}
+
+void AStyleTransferVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UStyleTransferStreamingSubsystem* Subsystem = UWorld::GetSubsystem<UStyleTransferStreamingSubsystem>(GetWorld()))
+	{
+		Subsystem->RegisterVolume(this);
+	}
+}
+
+void AStyleTransferVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UStyleTransferStreamingSubsystem* Subsystem = UWorld::GetSubsystem<UStyleTransferStreamingSubsystem>(GetWorld()))
+	{
+		Subsystem->UnregisterVolume(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,44 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Volume.h"
+#include "NNEModelData.h"
+#include "StyleTransferVolume.generated.h"
+
+/**
+ * Maps a region of the level to a style model. The streaming subsystem prefetches the model while the
+ * player approaches and switches to it when the player enters the volume.
+ */
+UCLASS(BlueprintType)
+class FPSTYLETRANSFER_API AStyleTransferVolume : public AVolume
+{
+	GENERATED_BODY()
+
+public:
+	AStyleTransferVolume(const FObjectInitializer& ObjectInitializer);
+
+	/** Style applied while the player is inside this volume. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	TObjectPtr<UNNEModelData> ModelData;
+
+	/** Optional NNE runtime name; None uses the default runtime. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	FName RuntimeName;
+
+	/** When volumes overlap, the one with the highest priority wins. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer")
+	int32 Priority = 0;
+
+	/** Distance (cm) from the volume bounds at which the model starts being prefetched. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Style Transfer", meta = (ClampMin = "0.0"))
+	float PrefetchDistance = 3000.0f;
+
+	/** Squared distance from Point to the bounds of this volume, zero when inside. */
+	float GetSquaredDistanceToPoint(const FVector& Point) const;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+};
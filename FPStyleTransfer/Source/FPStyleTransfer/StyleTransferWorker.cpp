@@ -0,0 +1,751 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#include "StyleTransferWorker.h"
+
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NNEModelData.h"
+#include "StyleTransferBenchmarkUtils.h"
+#include "StyleTransferPasses.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include "Windows/WindowsHWrapper.h"
+#include "Windows/HideWindowsPlatformTypes.h"
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferWorker, Log, All);
+
+namespace RealtimeStyleTransfer
+{
+	static FString WorkerPython = TEXT("python");
+	static FAutoConsoleVariableRef CVarWorkerPython(
+		TEXT("r.RealtimeStyleTransfer.Worker.Python"),
+		WorkerPython,
+		TEXT("Python interpreter that runs Scripts/style_transfer_worker.py (needs numpy and onnxruntime). Default: python"));
+
+	static float WorkerStartupTimeout = 30.0f;
+	static FAutoConsoleVariableRef CVarWorkerStartupTimeout(
+		TEXT("r.RealtimeStyleTransfer.Worker.StartupTimeout"),
+		WorkerStartupTimeout,
+		TEXT("Seconds to wait for an inference worker to load its model (default 30)."));
+
+	static float WorkerSubmitTimeoutMs = 100.0f;
+	static FAutoConsoleVariableRef CVarWorkerSubmitTimeoutMs(
+		TEXT("r.RealtimeStyleTransfer.Worker.SubmitTimeoutMs"),
+		WorkerSubmitTimeoutMs,
+		TEXT("How long a submit waits for a free ring slot before the request fails (default 100)."));
+}
+
+namespace
+{
+	using namespace StyleTransferWorkerProtocol;
+
+	constexpr uint32 SharedMemoryReadWrite =
+		static_cast<uint32>(FPlatformMemory::ESharedMemoryAccess::Read) | static_cast<uint32>(FPlatformMemory::ESharedMemoryAccess::Write);
+
+	/** How often the completion thread checks that the worker process is still running while it waits on it. */
+	constexpr double LivenessCheckSeconds = 0.1;
+	constexpr float StopTimeoutSeconds = 2.0f;
+
+	TFuture<FStyleTransferCpuInferenceResult> MakeFailedFuture()
+	{
+		TPromise<FStyleTransferCpuInferenceResult> Promise;
+		Promise.SetValue(FStyleTransferCpuInferenceResult());
+		return Promise.GetFuture();
+	}
+
+	/** The name the worker opens a region by; see FStyleTransferWorkerModel::FSharedRegion. */
+	FString GetSharedRegionName(const FString& BaseName)
+	{
+#if PLATFORM_WINDOWS
+		return TEXT("Local\\") + BaseName;
+#else
+		// The Unix platform layer and Python's shared_memory both add the leading slash.
+		return BaseName;
+#endif
+	}
+
+	const TCHAR* GetWorkerStateName(uint32 State)
+	{
+		switch (static_cast<EWorkerState>(State))
+		{
+		case EWorkerState::Starting: return TEXT("starting");
+		case EWorkerState::ShapeReady: return TEXT("shape ready");
+		case EWorkerState::Ready: return TEXT("ready");
+		case EWorkerState::Failed: return TEXT("failed");
+		case EWorkerState::Exited: return TEXT("exited");
+		}
+		return TEXT("unknown");
+	}
+}
+
+FStyleTransferWorkerModelHandle FStyleTransferWorkerModel::Launch(UNNEModelData* ModelData, FIntPoint Resolution, const FStyleTransferWorkerSettings& Settings)
+{
+	if (!ModelData)
+	{
+		return nullptr;
+	}
+
+#if !PLATFORM_CPU_X86_FAMILY
+	// The worker publishes its output with NumPy stores and no fence, so a weaker memory model could expose a torn slot.
+	UE_LOG(LogStyleTransferWorker, Error, TEXT("Cannot serve '%s' from an inference worker: the worker is only supported on x86 CPUs."), *ModelData->GetName());
+	return nullptr;
+#else
+	FStyleTransferWorkerModelHandle Model = MakeShareable(new FStyleTransferWorkerModel());
+	if (!Model->Start(ModelData, Resolution, Settings))
+	{
+		return nullptr;
+	}
+	return Model;
+#endif
+}
+
+bool FStyleTransferWorkerModel::Start(UNNEModelData* ModelData, FIntPoint InResolution, const FStyleTransferWorkerSettings& Settings)
+{
+	static std::atomic<int32> WorkerCounter = 0;
+
+	Name = ModelData->GetName();
+	SlotCount = FMath::Clamp(Settings.SlotCount, 4, kMaxSlots);
+	const FString RegionName = FString::Printf(TEXT("StyleTransferWorker_%u_%d"), FPlatformProcess::GetCurrentProcessId(), ++WorkerCounter);
+
+	// The worker loads the model from disk; the asset only holds it in memory.
+	const TConstArrayView64<uint8> FileData = ModelData->GetFileData();
+	if (ModelData->GetFileType() != TEXT("onnx") || FileData.IsEmpty())
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("'%s' is not an ONNX model; only ONNX models run in the inference worker."), *Name);
+		return false;
+	}
+
+	ModelPath = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("StyleTransferWorker"), RegionName + TEXT(".onnx")));
+	if (!FFileHelper::SaveArrayToFile(FileData, *ModelPath))
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("Failed to write '%s' for the inference worker."), *ModelPath);
+		return false;
+	}
+
+	if (!MapRegion(RegionName, kControlBytes, ControlRegion))
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("Failed to create shared memory '%s' for the inference worker."), *RegionName);
+		return false;
+	}
+
+	Control = new (ControlRegion.Address) FControl();
+	Control->Version = kVersion;
+	Control->SlotCount = SlotCount;
+	Control->MaxBatchSize = FMath::Max(Settings.MaxBatchSize, 1);
+	Control->InputChannels = InputChannels;
+	Control->Width = InResolution.X;
+	Control->Height = InResolution.Y;
+	for (int32 SlotIndex = 0; SlotIndex < SlotCount; ++SlotIndex)
+	{
+		Control->Slots[SlotIndex].Fence.store(SlotIndex, std::memory_order_relaxed);
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	Control->Magic = kMagic;
+
+	const FString ScriptPath = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::ProjectDir(), TEXT("Scripts"), TEXT("style_transfer_worker.py")));
+	// -u: unbuffered, so the worker's lines reach the log as it prints them.
+	const FString Params = FString::Printf(TEXT("-u \"%s\" --control \"%s\" --data \"%s\" --model \"%s\" --threads %d --parent-pid %u"),
+		*ScriptPath,
+		*ControlRegion.Name,
+		*GetSharedRegionName(RegionName + TEXT("_data")),
+		*ModelPath,
+		FMath::Max(Settings.Threads, 0),
+		FPlatformProcess::GetCurrentProcessId());
+
+	FPlatformProcess::CreatePipe(OutputReadPipe, OutputWritePipe);
+	WorkerProcess = FPlatformProcess::CreateProc(*RealtimeStyleTransfer::WorkerPython, *Params, false, true, true, nullptr, 0, nullptr, OutputWritePipe);
+	if (!WorkerProcess.IsValid())
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("Failed to start '%s %s'; set r.RealtimeStyleTransfer.Worker.Python to a Python with onnxruntime."),
+			*RealtimeStyleTransfer::WorkerPython,
+			*Params);
+		return false;
+	}
+
+	// The worker resolves symbolic dims and reports the output shape; only then can the tensor slots be sized.
+	const double StartSeconds = FPlatformTime::Seconds();
+	if (!WaitForWorker(EWorkerState::ShapeReady, RealtimeStyleTransfer::WorkerStartupTimeout))
+	{
+		return false;
+	}
+
+	InputChannels = Control->InputChannels;
+	Resolution = FIntPoint(Control->Width, Control->Height);
+	OutputChannels = Control->OutputChannels;
+	OutputResolution = FIntPoint(Control->OutputWidth, Control->OutputHeight);
+	if (Resolution.X <= 0 || Resolution.Y <= 0 || OutputResolution.X <= 0 || OutputResolution.Y <= 0 || OutputChannels <= 0)
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("Inference worker reported invalid shapes for '%s' (%dx%dx%d in, %dx%dx%d out)."),
+			*Name,
+			InputChannels,
+			Resolution.Y,
+			Resolution.X,
+			OutputChannels,
+			OutputResolution.Y,
+			OutputResolution.X);
+		return false;
+	}
+
+	const uint64 InputSlotBytes = Align(static_cast<uint64>(InputChannels) * Resolution.X * Resolution.Y * sizeof(float), kSlotAlignment);
+	const uint64 OutputSlotBytes = Align(static_cast<uint64>(OutputChannels) * OutputResolution.X * OutputResolution.Y * sizeof(float), kSlotAlignment);
+	if (!MapRegion(RegionName + TEXT("_data"), SlotCount * (InputSlotBytes + OutputSlotBytes), DataRegion))
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("Failed to create %.1f MB of shared tensor slots for '%s'."),
+			SlotCount * (InputSlotBytes + OutputSlotBytes) / (1024.0 * 1024.0),
+			*Name);
+		return false;
+	}
+
+	Data = static_cast<uint8*>(DataRegion.Address);
+	Control->InputSlotBytes = InputSlotBytes;
+	Control->OutputSlotBytes = OutputSlotBytes;
+	Control->HostState.store(static_cast<uint32>(EHostState::DataReady), std::memory_order_release);
+
+	if (!WaitForWorker(EWorkerState::Ready, RealtimeStyleTransfer::WorkerStartupTimeout))
+	{
+		return false;
+	}
+
+	SlotRequests.SetNum(SlotCount);
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("StyleTransferWorkerCompletion"), 0, TPri_Normal);
+
+	UE_LOG(LogStyleTransferWorker, Log, TEXT("Serving '%s' at %dx%d from a worker process (%d slots, batches of up to %u) after %.2f s."),
+		*Name,
+		Resolution.X,
+		Resolution.Y,
+		SlotCount,
+		Control->MaxBatchSize,
+		FPlatformTime::Seconds() - StartSeconds);
+	return true;
+}
+
+FStyleTransferWorkerModel::~FStyleTransferWorkerModel()
+{
+	// The completion thread goes first: it reads the worker's output and the shared regions.
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	StopWorker();
+	FailOutstanding();
+
+	if (OutputReadPipe || OutputWritePipe)
+	{
+		FPlatformProcess::ClosePipe(OutputReadPipe, OutputWritePipe);
+		OutputReadPipe = nullptr;
+		OutputWritePipe = nullptr;
+	}
+
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+
+	UnmapRegion(DataRegion);
+	UnmapRegion(ControlRegion);
+	if (!ModelPath.IsEmpty())
+	{
+		IFileManager::Get().Delete(*ModelPath, false, false, true);
+	}
+}
+
+bool FStyleTransferWorkerModel::WaitForWorker(EWorkerState State, double TimeoutSeconds)
+{
+	const double DeadlineSeconds = FPlatformTime::Seconds() + TimeoutSeconds;
+	for (;;)
+	{
+		ForwardWorkerOutput();
+		const uint32 WorkerState = Control->WorkerState.load(std::memory_order_acquire);
+		if (WorkerState == static_cast<uint32>(State))
+		{
+			return true;
+		}
+
+		const bool bGone = WorkerState == static_cast<uint32>(EWorkerState::Failed)
+			|| WorkerState == static_cast<uint32>(EWorkerState::Exited)
+			|| !FPlatformProcess::IsProcRunning(WorkerProcess);
+		if (bGone || FPlatformTime::Seconds() > DeadlineSeconds)
+		{
+			ForwardWorkerOutput(bGone);
+			UE_LOG(LogStyleTransferWorker, Error, TEXT("Inference worker for '%s' %s while %s; its output above has the reason."),
+				*Name,
+				bGone ? TEXT("stopped") : TEXT("timed out"),
+				GetWorkerStateName(WorkerState));
+			return false;
+		}
+
+		FPlatformProcess::Sleep(0.01f);
+	}
+}
+
+void FStyleTransferWorkerModel::StopWorker()
+{
+	if (!WorkerProcess.IsValid())
+	{
+		return;
+	}
+
+	if (Control)
+	{
+		Control->HostState.store(static_cast<uint32>(EHostState::Stopping), std::memory_order_release);
+	}
+
+	const double DeadlineSeconds = FPlatformTime::Seconds() + StopTimeoutSeconds;
+	while (FPlatformProcess::IsProcRunning(WorkerProcess) && FPlatformTime::Seconds() < DeadlineSeconds)
+	{
+		FPlatformProcess::Sleep(0.01f);
+	}
+
+	if (FPlatformProcess::IsProcRunning(WorkerProcess))
+	{
+		UE_LOG(LogStyleTransferWorker, Warning, TEXT("Inference worker for '%s' did not exit; terminating it."), *Name);
+		FPlatformProcess::TerminateProc(WorkerProcess, true);
+	}
+
+	FPlatformProcess::CloseProc(WorkerProcess);
+	bWorkerLost = true;
+	ForwardWorkerOutput(true);
+}
+
+void FStyleTransferWorkerModel::ForwardWorkerOutput(bool bFlush)
+{
+	if (!OutputReadPipe)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&OutputLock);
+	OutputBuffer += FPlatformProcess::ReadPipe(OutputReadPipe);
+	if (bFlush && !OutputBuffer.IsEmpty() && !OutputBuffer.EndsWith(TEXT("\n")))
+	{
+		OutputBuffer += TEXT("\n");
+	}
+
+	// The worker tags its lines like the project's scripts do; the tag picks the verbosity.
+	int32 NewlineIndex = INDEX_NONE;
+	while (OutputBuffer.FindChar(TEXT('\n'), NewlineIndex))
+	{
+		const FString Line = OutputBuffer.Left(NewlineIndex).TrimEnd();
+		OutputBuffer.RightChopInline(NewlineIndex + 1, EAllowShrinking::No);
+		if (Line.IsEmpty())
+		{
+			continue;
+		}
+
+		if (Line.StartsWith(TEXT("[FAIL]")) || Line.StartsWith(TEXT("Traceback")))
+		{
+			UE_LOG(LogStyleTransferWorker, Error, TEXT("[%s] %s"), *Name, *Line);
+		}
+		else if (Line.StartsWith(TEXT("[WARN]")))
+		{
+			UE_LOG(LogStyleTransferWorker, Warning, TEXT("[%s] %s"), *Name, *Line);
+		}
+		else
+		{
+			UE_LOG(LogStyleTransferWorker, Log, TEXT("[%s] %s"), *Name, *Line);
+		}
+	}
+}
+
+bool FStyleTransferWorkerModel::MapRegion(const FString& BaseName, uint64 Size, FSharedRegion& OutRegion)
+{
+	OutRegion.Name = GetSharedRegionName(BaseName);
+#if PLATFORM_WINDOWS
+	// Local\ names are per session and need no privilege, unlike the Global\ names FPlatformMemory creates.
+	HANDLE Mapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(Size >> 32), static_cast<DWORD>(Size), *OutRegion.Name);
+	if (!Mapping)
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("CreateFileMapping failed for '%s' (error %u)."), *OutRegion.Name, ::GetLastError());
+		return false;
+	}
+
+	void* Address = ::MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, Size);
+	if (!Address)
+	{
+		UE_LOG(LogStyleTransferWorker, Error, TEXT("MapViewOfFile failed for '%s' (error %u)."), *OutRegion.Name, ::GetLastError());
+		::CloseHandle(Mapping);
+		return false;
+	}
+
+	OutRegion.Handle = Mapping;
+	OutRegion.Address = Address;
+#else
+	OutRegion.PlatformRegion = FPlatformMemory::MapNamedSharedMemoryRegion(BaseName, true, SharedMemoryReadWrite, Size);
+	if (!OutRegion.PlatformRegion)
+	{
+		return false;
+	}
+	OutRegion.Address = OutRegion.PlatformRegion->GetAddress();
+#endif
+	return true;
+}
+
+void FStyleTransferWorkerModel::UnmapRegion(FSharedRegion& Region)
+{
+#if PLATFORM_WINDOWS
+	if (Region.Address)
+	{
+		::UnmapViewOfFile(Region.Address);
+	}
+	if (Region.Handle)
+	{
+		::CloseHandle(Region.Handle);
+	}
+#else
+	if (Region.PlatformRegion)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region.PlatformRegion);
+	}
+#endif
+	Region = FSharedRegion();
+}
+
+float* FStyleTransferWorkerModel::GetInput(int32 SlotIndex) const
+{
+	return reinterpret_cast<float*>(Data + SlotIndex * (Control->InputSlotBytes + Control->OutputSlotBytes));
+}
+
+const float* FStyleTransferWorkerModel::GetOutput(int32 SlotIndex) const
+{
+	return reinterpret_cast<const float*>(Data + SlotIndex * (Control->InputSlotBytes + Control->OutputSlotBytes) + Control->InputSlotBytes);
+}
+
+bool FStyleTransferWorkerModel::Submit(FFillInput Fill, FOnOutput OnOutput)
+{
+	if (bWorkerLost || bStopping)
+	{
+		return false;
+	}
+
+	const double SubmitSeconds = FPlatformTime::Seconds();
+	const double DeadlineSeconds = SubmitSeconds + RealtimeStyleTransfer::WorkerSubmitTimeoutMs / 1000.0;
+
+	// Claim the next ticket once its slot has come round free; a failed exchange reloads Ticket.
+	uint64 Ticket = Control->SubmitTicket.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const uint64 Fence = Control->Slots[Ticket % SlotCount].Fence.load(std::memory_order_acquire);
+		if (Fence == Ticket)
+		{
+			if (Control->SubmitTicket.compare_exchange_weak(Ticket, Ticket + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+			continue;
+		}
+
+		if (Fence < Ticket)
+		{
+			// The slot still holds the previous lap: the ring is full.
+			if (bWorkerLost || FPlatformTime::Seconds() > DeadlineSeconds)
+			{
+				UE_LOG(LogStyleTransferWorker, Verbose, TEXT("No free slot for '%s' within %.0f ms."), *Name, RealtimeStyleTransfer::WorkerSubmitTimeoutMs);
+				return false;
+			}
+			FPlatformProcess::Yield();
+		}
+		Ticket = Control->SubmitTicket.load(std::memory_order_relaxed);
+	}
+
+	const int32 SlotIndex = Ticket % SlotCount;
+	Fill(TArrayView<float>(GetInput(SlotIndex), InputChannels * Resolution.X * Resolution.Y));
+	SlotRequests[SlotIndex].OnOutput = MoveTemp(OnOutput);
+	SlotRequests[SlotIndex].SubmitSeconds = SubmitSeconds;
+	Control->Slots[SlotIndex].Fence.store(Ticket + 1, std::memory_order_release);
+
+	WakeEvent->Trigger();
+	return true;
+}
+
+TFuture<FStyleTransferCpuInferenceResult> FStyleTransferWorkerModel::Submit(TArray<float> Input)
+{
+	const int32 InputFrameSize = InputChannels * Resolution.X * Resolution.Y;
+	if (Input.Num() != InputFrameSize)
+	{
+		UE_LOG(LogStyleTransferWorker, Warning, TEXT("'%s' expects %d input values, got %d."), *Name, InputFrameSize, Input.Num());
+		return MakeFailedFuture();
+	}
+
+	TSharedRef<TPromise<FStyleTransferCpuInferenceResult>, ESPMode::ThreadSafe> Promise = MakeShared<TPromise<FStyleTransferCpuInferenceResult>, ESPMode::ThreadSafe>();
+	TFuture<FStyleTransferCpuInferenceResult> Future = Promise->GetFuture();
+
+	const bool bSubmitted = Submit(
+		[&Input](TArrayView<float> Slot)
+		{
+			FMemory::Memcpy(Slot.GetData(), Input.GetData(), Slot.Num() * sizeof(float));
+		},
+		[Promise](bool bSuccess, TConstArrayView<float> Output, double LatencyMs, int32 BatchSize)
+		{
+			FStyleTransferCpuInferenceResult Result;
+			Result.bSuccess = bSuccess;
+			Result.Output = TArray<float>(Output.GetData(), Output.Num());
+			Result.LatencyMs = LatencyMs;
+			Result.BatchSize = BatchSize;
+			Promise->SetValue(MoveTemp(Result));
+		});
+
+	if (!bSubmitted)
+	{
+		Promise->SetValue(FStyleTransferCpuInferenceResult());
+	}
+	return Future;
+}
+
+void FStyleTransferWorkerModel::CompleteSlot(bool bSuccess)
+{
+	const uint64 Ticket = CompleteTicket.load(std::memory_order_relaxed);
+	const int32 SlotIndex = Ticket % SlotCount;
+	const FSlot& Slot = Control->Slots[SlotIndex];
+	FSlotRequest Request = MoveTemp(SlotRequests[SlotIndex]);
+
+	const double LatencyMs = (FPlatformTime::Seconds() - Request.SubmitSeconds) * 1000.0;
+	const int32 BatchSize = bSuccess ? FMath::Max<int32>(Slot.BatchSize, 1) : 0;
+	if (Request.OnOutput)
+	{
+		const TConstArrayView<float> Output = bSuccess ? TConstArrayView<float>(GetOutput(SlotIndex), OutputChannels * OutputResolution.X * OutputResolution.Y) : TConstArrayView<float>();
+		Request.OnOutput(bSuccess, Output, LatencyMs, BatchSize);
+	}
+
+	if (bSuccess)
+	{
+		FScopeLock ScopeLock(&StatsLock);
+		++StatRequests;
+		StatBatches += 1.0 / BatchSize;
+		StatLatencyMsSum += LatencyMs;
+		StatMaxLatencyMs = FMath::Max(StatMaxLatencyMs, LatencyMs);
+		StatInferenceMsSum += Slot.InferenceMs / BatchSize;
+	}
+
+	// The output has been consumed; the slot is free for the ticket one lap later.
+	Control->Slots[SlotIndex].Fence.store(Ticket + SlotCount, std::memory_order_release);
+	CompleteTicket.store(Ticket + 1, std::memory_order_relaxed);
+}
+
+void FStyleTransferWorkerModel::FailOutstanding()
+{
+	if (!Control || SlotRequests.IsEmpty())
+	{
+		return;
+	}
+
+	// Submits that claimed a ticket publish it right after writing the frame.
+	const double DeadlineSeconds = FPlatformTime::Seconds() + RealtimeStyleTransfer::WorkerSubmitTimeoutMs / 1000.0;
+	while (CompleteTicket.load(std::memory_order_relaxed) < Control->SubmitTicket.load(std::memory_order_acquire))
+	{
+		const uint64 Ticket = CompleteTicket.load(std::memory_order_relaxed);
+		if (Control->Slots[Ticket % SlotCount].Fence.load(std::memory_order_acquire) == Ticket && FPlatformTime::Seconds() < DeadlineSeconds)
+		{
+			FPlatformProcess::Yield();
+			continue;
+		}
+		CompleteSlot(false);
+	}
+}
+
+uint32 FStyleTransferWorkerModel::Run()
+{
+	double NextLivenessCheckSeconds = 0.0;
+	while (!bStopping)
+	{
+		const uint64 Ticket = CompleteTicket.load(std::memory_order_relaxed);
+		if (Ticket == Control->SubmitTicket.load(std::memory_order_acquire))
+		{
+			WakeEvent->Wait(static_cast<uint32>(LivenessCheckSeconds * 1000.0));
+			continue;
+		}
+
+		// After the worker is lost, every published request fails instead of waiting for an output.
+		const uint64 Fence = Control->Slots[Ticket % SlotCount].Fence.load(std::memory_order_acquire);
+		if (Fence == Ticket + 2 || (bWorkerLost && Fence == Ticket + 1))
+		{
+			CompleteSlot(Fence == Ticket + 2 && Control->Slots[Ticket % SlotCount].Status == 0);
+			continue;
+		}
+
+		const double NowSeconds = FPlatformTime::Seconds();
+		if (!bWorkerLost && NowSeconds >= NextLivenessCheckSeconds)
+		{
+			NextLivenessCheckSeconds = NowSeconds + LivenessCheckSeconds;
+			ForwardWorkerOutput();
+			if (!FPlatformProcess::IsProcRunning(WorkerProcess))
+			{
+				int32 ReturnCode = 0;
+				FPlatformProcess::GetProcReturnCode(WorkerProcess, &ReturnCode);
+				UE_LOG(LogStyleTransferWorker, Error, TEXT("Inference worker for '%s' exited with code %d; its requests fail from now on."), *Name, ReturnCode);
+				bWorkerLost = true;
+				continue;
+			}
+		}
+
+		// The worker is mid-run. There is no cross-process event to wait on, and shorter sleeps round to zero on
+		// Windows and spin a core, so poll every millisecond.
+		FPlatformProcess::SleepNoStats(0.001f);
+	}
+
+	return 0;
+}
+
+void FStyleTransferWorkerModel::Stop()
+{
+	bStopping = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+FStyleTransferCpuInferenceStats FStyleTransferWorkerModel::GetStats() const
+{
+	FScopeLock ScopeLock(&StatsLock);
+
+	FStyleTransferCpuInferenceStats Stats;
+	Stats.QueueDepth = Control ? static_cast<int32>(Control->SubmitTicket.load(std::memory_order_relaxed) - CompleteTicket.load(std::memory_order_relaxed)) : 0;
+	Stats.PooledInstances = 1;
+	Stats.Requests = StatRequests;
+	Stats.Batches = FMath::RoundToInt64(StatBatches);
+	if (StatBatches > 0.0)
+	{
+		Stats.AverageBatchSize = StatRequests / StatBatches;
+		Stats.AverageInferenceMs = StatInferenceMsSum / StatBatches;
+	}
+	if (StatRequests > 0)
+	{
+		Stats.AverageLatencyMs = StatLatencyMsSum / StatRequests;
+	}
+	Stats.MaxLatencyMs = StatMaxLatencyMs;
+	return Stats;
+}
+
+void FStyleTransferWorkerModel::ResetStats()
+{
+	FScopeLock ScopeLock(&StatsLock);
+	StatRequests = 0;
+	StatBatches = 0.0;
+	StatLatencyMsSum = 0.0;
+	StatMaxLatencyMs = 0.0;
+	StatInferenceMsSum = 0.0;
+}
+
+namespace RealtimeStyleTransfer
+{
+	/** Submits Requests frames one at a time, then as a burst, and logs throughput and latency percentiles of both. */
+	static void BenchmarkBackend(const TCHAR* BackendName, int32 Requests, TFunctionRef<TFuture<FStyleTransferCpuInferenceResult>()> SubmitFrame)
+	{
+		// The first request also warms up the backend.
+		SubmitFrame().Get();
+
+		for (const bool bBurst : { false, true })
+		{
+			TArray<double> LatenciesMs;
+			int32 Failed = 0;
+			const double StartSeconds = FPlatformTime::Seconds();
+			if (bBurst)
+			{
+				TArray<TFuture<FStyleTransferCpuInferenceResult>> Futures;
+				for (int32 RequestIndex = 0; RequestIndex < Requests; ++RequestIndex)
+				{
+					Futures.Add(SubmitFrame());
+				}
+				for (TFuture<FStyleTransferCpuInferenceResult>& Future : Futures)
+				{
+					const FStyleTransferCpuInferenceResult& Result = Future.Get();
+					Failed += Result.bSuccess ? 0 : 1;
+					LatenciesMs.Add(Result.LatencyMs);
+				}
+			}
+			else
+			{
+				for (int32 RequestIndex = 0; RequestIndex < Requests; ++RequestIndex)
+				{
+					const FStyleTransferCpuInferenceResult Result = SubmitFrame().Get();
+					Failed += Result.bSuccess ? 0 : 1;
+					LatenciesMs.Add(Result.LatencyMs);
+				}
+			}
+			const double ElapsedMs = (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+
+			UE_LOG(LogStyleTransferWorker, Display, TEXT("%-10s %-6s %.1f frames/s, latency p50 %.2f ms p95 %.2f ms p99 %.2f ms max %.2f ms, %d failed."),
+				BackendName,
+				bBurst ? TEXT("burst") : TEXT("serial"),
+				Requests * 1000.0 / FMath::Max(ElapsedMs, UE_SMALL_NUMBER),
+				StyleTransferBenchmarkUtils::Percentile(LatenciesMs, 0.5),
+				StyleTransferBenchmarkUtils::Percentile(LatenciesMs, 0.95),
+				StyleTransferBenchmarkUtils::Percentile(LatenciesMs, 0.99),
+				StyleTransferBenchmarkUtils::Percentile(LatenciesMs, 1.0),
+				Failed);
+		}
+	}
+
+	/** Runs the same frames through the in-process CPU inference service and an inference worker. */
+	static void BenchmarkWorkerInference(const TArray<FString>& Args)
+	{
+		if (Args.IsEmpty())
+		{
+			UE_LOG(LogStyleTransferWorker, Display, TEXT("Usage: StyleTransfer.BenchmarkWorkerInference <NNEModelData asset path> [Requests] [MaxBatchSize]"));
+			return;
+		}
+
+		UNNEModelData* ModelData = LoadObject<UNNEModelData>(nullptr, *Args[0]);
+		if (!ModelData)
+		{
+			UE_LOG(LogStyleTransferWorker, Error, TEXT("Unable to load model data '%s'."), *Args[0]);
+			return;
+		}
+
+		const int32 Requests = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 64;
+		const int32 MaxBatchSize = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 4;
+
+		FStyleTransferCpuInferenceSettings ServiceSettings;
+		ServiceSettings.MaxBatchSize = MaxBatchSize;
+		FStyleTransferCpuInferenceService& Service = FStyleTransferCpuInferenceService::Get();
+		const FStyleTransferCpuModelHandle InProcessModel = Service.RegisterModel(ModelData, FIntPoint::ZeroValue, ServiceSettings);
+
+		FStyleTransferWorkerSettings WorkerSettings;
+		WorkerSettings.MaxBatchSize = MaxBatchSize;
+		const FStyleTransferWorkerModelHandle WorkerModel = FStyleTransferWorkerModel::Launch(
+			ModelData,
+			InProcessModel.IsValid() ? InProcessModel->GetResolution() : FIntPoint::ZeroValue,
+			WorkerSettings);
+
+		if (!InProcessModel.IsValid() || !WorkerModel.IsValid())
+		{
+			return;
+		}
+
+		FRandomStream Random(1234);
+		TArray<float> Frame;
+		Frame.SetNumUninitialized(WorkerModel->GetInputChannels() * WorkerModel->GetResolution().X * WorkerModel->GetResolution().Y);
+		for (float& Value : Frame)
+		{
+			Value = Random.FRand() * StyleTransferPasses::EncodeScale;
+		}
+
+		UE_LOG(LogStyleTransferWorker, Display, TEXT("%s at %dx%d, %d requests, batches of up to %d:"),
+			*WorkerModel->GetName(),
+			WorkerModel->GetResolution().X,
+			WorkerModel->GetResolution().Y,
+			Requests,
+			MaxBatchSize);
+
+		BenchmarkBackend(TEXT("in-process"), Requests, [&]() { return Service.Submit(InProcessModel, Frame); });
+		BenchmarkBackend(TEXT("worker"), Requests, [&]() { return WorkerModel->Submit(Frame); });
+	}
+
+	static FAutoConsoleCommand BenchmarkWorkerInferenceCommand(
+		TEXT("StyleTransfer.BenchmarkWorkerInference"),
+		TEXT("Compares throughput and tail latency of the in-process CPU inference service and an out-of-process inference worker.\n")
+		TEXT("Usage: StyleTransfer.BenchmarkWorkerInference <NNEModelData asset path> [Requests] [MaxBatchSize]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkWorkerInference));
+}
@@ -0,0 +1,226 @@
+// Copyright (C) Microsoft. All rights reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "StyleTransferInferenceService.h"
+#include <atomic>
+
+class FRunnableThread;
+class UNNEModelData;
+
+struct FStyleTransferWorkerSettings
+{
+	/** Frames in flight between the game and the worker. Each slot holds one input and one output tensor. */
+	int32 SlotCount = 8;
+	/** Submitted frames the worker combines into one run. Only models with a symbolic batch dimension batch. */
+	int32 MaxBatchSize = 4;
+	/** ONNX Runtime intra-op threads in the worker; 0 lets the runtime decide. */
+	int32 Threads = 0;
+};
+
+/**
+ * Memory layout shared with Scripts/style_transfer_worker.py, which mirrors these offsets. A fixed-size control region
+ * holds the shapes, the process states and one fence per slot; the tensors live in a data region sized once the
+ * worker has reported the model's output shape.
+ *
+ * Each slot's fence counts through the laps of the ring. For ticket T in slot T % SlotCount it reads T while free,
+ * T + 1 once the host has written the input, T + 2 once the worker has written the output, and T + SlotCount when the
+ * host has read it back. Fences are 8-byte aligned plain stores on the Python side, with no release fence before them,
+ * so only x86 keeps the tensor and slot stores ordered ahead of the fence. Launch fails on other CPUs.
+ */
+namespace StyleTransferWorkerProtocol
+{
+	constexpr uint32 kMagic = 0x4B575453; // "STWK"
+	constexpr uint32 kVersion = 1;
+	constexpr int32 kMaxSlots = 32;
+	constexpr uint32 kControlBytes = 4096;
+	constexpr uint64 kSlotAlignment = 64;
+
+	enum class EWorkerState : uint32
+	{
+		Starting = 0,
+		/** Output shape written; waiting for the data region. */
+		ShapeReady = 1,
+		Ready = 2,
+		Failed = 3,
+		Exited = 4,
+	};
+
+	enum class EHostState : uint32
+	{
+		Starting = 0,
+		DataReady = 1,
+		Stopping = 2,
+	};
+
+	struct FSlot
+	{
+		std::atomic<uint64> Fence;
+		float InferenceMs;
+		uint32 BatchSize;
+		/** Zero when the worker's run succeeded. */
+		uint32 Status;
+		uint8 Padding[44];
+	};
+
+	struct FControl
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 SlotCount;
+		uint32 MaxBatchSize;
+		uint32 InputChannels;
+		uint32 Width;
+		uint32 Height;
+		/** Written by the worker before ShapeReady. */
+		uint32 OutputChannels;
+		uint32 OutputWidth;
+		uint32 OutputHeight;
+		std::atomic<uint32> WorkerState;
+		std::atomic<uint32> HostState;
+		/** Written by the host before DataReady. */
+		uint64 InputSlotBytes;
+		uint64 OutputSlotBytes;
+		/** Next ticket to submit, claimed by compare-exchange so any host thread can submit. */
+		std::atomic<uint64> SubmitTicket;
+		uint8 Padding[56];
+		FSlot Slots[kMaxSlots];
+	};
+
+	static_assert(sizeof(std::atomic<uint64>) == sizeof(uint64) && std::atomic<uint64>::is_always_lock_free, "Fences must be plain lock-free words.");
+	static_assert(sizeof(FSlot) == 64, "Slots are one cache line.");
+	static_assert(offsetof(FControl, WorkerState) == 40 && offsetof(FControl, InputSlotBytes) == 48 && offsetof(FControl, SubmitTicket) == 64, "Layout must match style_transfer_worker.py.");
+	static_assert(offsetof(FControl, Slots) == 128 && sizeof(FControl) <= kControlBytes, "Layout must match style_transfer_worker.py.");
+}
+
+/**
+ * One style model served by a local worker process (Scripts/style_transfer_worker.py on ONNX Runtime CPU) over shared
+ * memory, so model threads never compete with the game for its cores and a runtime crash only loses the worker.
+ * Submitting claims a ring slot without locks and writes the frame straight into it; a completion thread hands the
+ * result out of the same slot. If the worker dies, outstanding and later requests fail.
+ */
+class FPSTYLETRANSFER_API FStyleTransferWorkerModel : public FRunnable, public TSharedFromThis<FStyleTransferWorkerModel, ESPMode::ThreadSafe>
+{
+public:
+	/** Writes one input frame (CHW floats) into its ring slot. */
+	using FFillInput = TFunctionRef<void(TArrayView<float> Input)>;
+	/** Receives the output frame while it is still in its ring slot; copy what must outlive the call. Completion thread. */
+	using FOnOutput = TUniqueFunction<void(bool bSuccess, TConstArrayView<float> Output, double LatencyMs, int32 BatchSize)>;
+
+	/**
+	 * Starts a worker for ModelData at Resolution (the model's static resolution when zero) and waits until it has loaded
+	 * the model, for at most r.RealtimeStyleTransfer.Worker.StartupTimeout seconds. Returns null and logs the reason on
+	 * failure. Game thread only.
+	 */
+	static TSharedPtr<FStyleTransferWorkerModel, ESPMode::ThreadSafe> Launch(
+		UNNEModelData* ModelData,
+		FIntPoint Resolution = FIntPoint::ZeroValue,
+		const FStyleTransferWorkerSettings& Settings = FStyleTransferWorkerSettings());
+
+	virtual ~FStyleTransferWorkerModel() override;
+
+	/**
+	 * Claims a slot, lets Fill write the frame into it and queues it for the worker. Waits up to
+	 * r.RealtimeStyleTransfer.Worker.SubmitTimeoutMs for a free slot. Returns false, without calling OnOutput, if none
+	 * frees up or the worker is gone. Any thread.
+	 */
+	bool Submit(FFillInput Fill, FOnOutput OnOutput);
+
+	/** Copying convenience with the result type of FStyleTransferCpuInferenceService. Any thread. */
+	TFuture<FStyleTransferCpuInferenceResult> Submit(TArray<float> Input);
+
+	const FString& GetName() const { return Name; }
+	FIntPoint GetResolution() const { return Resolution; }
+	int32 GetInputChannels() const { return InputChannels; }
+	int32 GetOutputChannels() const { return OutputChannels; }
+	FIntPoint GetOutputResolution() const { return OutputResolution; }
+	bool IsAlive() const { return !bWorkerLost; }
+
+	FStyleTransferCpuInferenceStats GetStats() const;
+	void ResetStats();
+
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	FStyleTransferWorkerModel() = default;
+
+	bool Start(UNNEModelData* ModelData, FIntPoint InResolution, const FStyleTransferWorkerSettings& InSettings);
+	/** Waits for the worker to reach State; false on failure, exit or timeout. */
+	bool WaitForWorker(StyleTransferWorkerProtocol::EWorkerState State, double TimeoutSeconds);
+	/** Hands ticket CompleteTicket's slot back to the ring, calling its OnOutput first. */
+	void CompleteSlot(bool bSuccess);
+	/** Fails every request still in the ring. Only once the completion thread has stopped. */
+	void FailOutstanding();
+	void StopWorker();
+	/** Logs the complete lines the worker has printed since the last call, and the partial last line if flushing. Any thread. */
+	void ForwardWorkerOutput(bool bFlush = false);
+
+	/**
+	 * A named shared memory region, with the name the worker opens it by. Windows maps a session-local name itself,
+	 * because FPlatformMemory creates Global\ names, which need SeCreateGlobalPrivilege.
+	 */
+	struct FSharedRegion
+	{
+		FString Name;
+		void* Address = nullptr;
+		void* Handle = nullptr;
+		FPlatformMemory::FSharedMemoryRegion* PlatformRegion = nullptr;
+	};
+
+	static bool MapRegion(const FString& BaseName, uint64 Size, FSharedRegion& OutRegion);
+	static void UnmapRegion(FSharedRegion& Region);
+
+	float* GetInput(int32 SlotIndex) const;
+	const float* GetOutput(int32 SlotIndex) const;
+
+	struct FSlotRequest
+	{
+		FOnOutput OnOutput;
+		double SubmitSeconds = 0.0;
+	};
+
+	FString Name;
+	FString ModelPath;
+	FIntPoint Resolution = FIntPoint::ZeroValue;
+	FIntPoint OutputResolution = FIntPoint::ZeroValue;
+	int32 InputChannels = 3;
+	int32 OutputChannels = 3;
+	int32 SlotCount = 0;
+
+	FSharedRegion ControlRegion;
+	FSharedRegion DataRegion;
+	StyleTransferWorkerProtocol::FControl* Control = nullptr;
+	uint8* Data = nullptr;
+	FProcHandle WorkerProcess;
+	/** The worker's stdout, forwarded to the log line by line. */
+	void* OutputReadPipe = nullptr;
+	void* OutputWritePipe = nullptr;
+	FCriticalSection OutputLock;
+	FString OutputBuffer;
+
+	/** Host-side state of each slot, published to the completion thread by the slot's fence. */
+	TArray<FSlotRequest> SlotRequests;
+	/** Next ticket the completion thread waits for. */
+	std::atomic<uint64> CompleteTicket = 0;
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopping = false;
+	std::atomic<bool> bWorkerLost = false;
+
+	mutable FCriticalSection StatsLock;
+	int64 StatRequests = 0;
+	/** Each frame adds its share of the run it was batched into. */
+	double StatBatches = 0.0;
+	double StatLatencyMsSum = 0.0;
+	double StatMaxLatencyMs = 0.0;
+	double StatInferenceMsSum = 0.0;
+};
+
+using FStyleTransferWorkerModelHandle = TSharedPtr<FStyleTransferWorkerModel, ESPMode::ThreadSafe>;
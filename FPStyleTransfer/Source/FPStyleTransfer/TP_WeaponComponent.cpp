@@ -81,6 +81,18 @@ void UTP_WeaponComponent::OnSphereBeginOverlap(UPrimitiveComponent* OverlappedCo
 		FAttachmentTransformRules AttachmentRules(EAttachmentRule::SnapToTarget, true);
 		GetOwner()->AttachToComponent(Character->GetMesh1P(),AttachmentRules, FName(TEXT("GripPoint")));
 
+		// Held weapons share the arms' custom stencil value for r.RealtimeStyleTransfer.Mask
+		TArray<UPrimitiveComponent*> Primitives;
+		GetOwner()->GetComponents(Primitives);
+		for (UPrimitiveComponent* Primitive : Primitives)
+		{
+			if (Primitive != this)
+			{
+				Primitive->SetRenderCustomDepth(true);
+				Primitive->SetCustomDepthStencilValue(Character->GetMesh1P()->CustomDepthStencilValue);
+			}
+		}
+
 		// Unregister from the Overlap Event so it is no longer triggered
 		OnComponentBeginOverlap.RemoveAll(this);
 		// Register so that Fire is called every time the character tries to use the item being held